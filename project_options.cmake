@@ -30,6 +30,10 @@ else ()
 endif ()
 option(obpf_simulator_build_shared_libs "Build shared libraries instead of static libraries" ON)
 set(BUILD_SHARED_LIBS ${obpf_simulator_build_shared_libs})
+option(obpf_simulator_enable_tracing "Record trace spans of the hot paths (see simulator/trace.hpp)" OFF)
+set(obpf_simulator_active_log_level "INFO" CACHE STRING
+        "Log statements below this level (e.g. SPDLOG_DEBUG) are compiled out")
+set_property(CACHE obpf_simulator_active_log_level PROPERTY STRINGS TRACE DEBUG INFO WARN ERROR CRITICAL OFF)
 
 add_library(obpf_simulator_warnings INTERFACE)
 obpf_simulator_set_warnings(obpf_simulator_warnings ${obpf_simulator_warnings_as_errors})
@@ -42,3 +46,10 @@ target_link_libraries(obpf_simulator_project_options
         INTERFACE obpf_simulator_warnings
         INTERFACE obpf_simulator_sanitizers
 )
+target_compile_definitions(obpf_simulator_project_options
+        INTERFACE SPDLOG_ACTIVE_LEVEL=SPDLOG_LEVEL_${obpf_simulator_active_log_level}
+)
+
+if (obpf_simulator_enable_tracing)
+    target_compile_definitions(obpf_simulator_project_options INTERFACE OBPF_ENABLE_TRACING)
+endif ()
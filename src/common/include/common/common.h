@@ -16,8 +16,6 @@ extern "C" {
         OBPF_ACTION_ALL_CLEAR,
     } ObpfAction;
 
-    typedef void (*ObpfActionHandler)(ObpfAction action, void* user_data);
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,42 @@
+#include "input_source.hpp"
+#include <magic_enum.hpp>
+#include <simulator/replay.hpp>
+
+[[nodiscard]] std::vector<std::shared_ptr<InputScript const>> load_input_scripts(std::filesystem::path const& path) {
+    auto const reader = ReplayReader{ path };
+    auto scripts = std::vector<InputScript>(reader.header().players.size());
+    auto playback = reader.playback();
+    while (playback.advance()) {
+        auto const key_states = playback.key_states();
+        for (auto i = usize{ 0 }; i < scripts.size(); ++i) {
+            scripts.at(i).push_back(key_states[i]);
+        }
+    }
+
+    auto result = std::vector<std::shared_ptr<InputScript const>>{};
+    for (auto& script : scripts) {
+        if (script.empty()) {
+            throw ReplayError{ "replay does not contain any frames" };
+        }
+        result.push_back(std::make_shared<InputScript const>(std::move(script)));
+    }
+    return result;
+}
+
+[[nodiscard]] KeyState InputSource::next() {
+    if (m_script != nullptr) {
+        auto const key_state = m_script->at(m_script_position % m_script->size());
+        ++m_script_position;
+        return key_state;
+    }
+
+    if (m_remaining_frames == 0) {
+        static constexpr auto keys = magic_enum::enum_values<Key>();
+        // One more than the number of keys, so that sometimes no key is pressed at all.
+        auto choice = std::uniform_int_distribution<usize>{ 0, keys.size() }(m_random);
+        m_current_key_state = (choice == keys.size() ? KeyState{} : KeyState{}.set(keys.at(choice)));
+        m_remaining_frames = std::uniform_int_distribution<u64>{ 1, 20 }(m_random);
+    }
+    --m_remaining_frames;
+    return m_current_key_state;
+}
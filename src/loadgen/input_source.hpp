@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <lib2k/types.hpp>
+#include <memory>
+#include <random>
+#include <simulator/key_state.hpp>
+#include <vector>
+
+// Key states recorded for a single player, played back in a loop.
+using InputScript = std::vector<KeyState>;
+
+// Loads one script per player of the given replay. Throws a ReplayError if the replay cannot be read.
+[[nodiscard]] std::vector<std::shared_ptr<InputScript const>> load_input_scripts(std::filesystem::path const& path);
+
+// Provides the key states of a synthetic client, either from a script or randomly. Random inputs imitate a player by
+// holding a single key for a few frames at a time.
+class InputSource final {
+private:
+    std::shared_ptr<InputScript const> m_script;  // nullptr for random inputs.
+    usize m_script_position = 0;
+    std::mt19937_64 m_random;
+    KeyState m_current_key_state;
+    u64 m_remaining_frames = 0;
+
+    InputSource(std::shared_ptr<InputScript const> script, usize script_position, u64 seed)
+        : m_script{ std::move(script) }, m_script_position{ script_position }, m_random{ seed } { }
+
+public:
+    [[nodiscard]] static InputSource random(u64 const seed) {
+        return InputSource{ nullptr, 0, seed };
+    }
+
+    // Clients that share a script should start at different positions, so that they don't press the same keys.
+    [[nodiscard]] static InputSource scripted(std::shared_ptr<InputScript const> script, usize const start_position) {
+        return InputSource{ std::move(script), start_position, 0 };
+    }
+
+    [[nodiscard]] KeyState next();
+};
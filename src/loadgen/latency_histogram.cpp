@@ -0,0 +1,61 @@
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration const latency) {
+    auto const microseconds =
+        std::max(std::chrono::duration_cast<std::chrono::microseconds>(latency), std::chrono::microseconds{ 0 });
+    ++m_counts.at(bucket_index(static_cast<u64>(microseconds.count())));
+    ++m_num_samples;
+    m_max = std::max(m_max, microseconds);
+}
+
+void LatencyHistogram::merge(LatencyHistogram const& other) {
+    for (auto i = usize{ 0 }; i < num_buckets; ++i) {
+        m_counts.at(i) += other.m_counts.at(i);
+    }
+    m_num_samples += other.m_num_samples;
+    m_max = std::max(m_max, other.m_max);
+}
+
+[[nodiscard]] std::chrono::microseconds LatencyHistogram::percentile(double const percentile) const {
+    if (m_num_samples == 0) {
+        return std::chrono::microseconds{ 0 };
+    }
+    auto const rank = std::max(
+        u64{ 1 },
+        static_cast<u64>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(m_num_samples)))
+    );
+    auto num_samples_seen = u64{ 0 };
+    for (auto i = usize{ 0 }; i < num_buckets; ++i) {
+        num_samples_seen += m_counts.at(i);
+        if (num_samples_seen >= rank and i < num_buckets - 1) {
+            // The maximum is exact, so it may be a tighter bound.
+            auto const upper_bound = static_cast<std::chrono::microseconds::rep>(bucket_upper_bound(i));
+            return std::min(std::chrono::microseconds{ upper_bound }, m_max);
+        }
+    }
+    return m_max;
+}
+
+// Latencies below num_sub_buckets get a bucket each. Above that, every power of two is split into num_sub_buckets
+// buckets of equal width.
+[[nodiscard]] usize LatencyHistogram::bucket_index(u64 const microseconds) {
+    if (microseconds < num_sub_buckets) {
+        return microseconds;
+    }
+    auto const bit_width = usize{ 64 } - static_cast<usize>(std::countl_zero(microseconds));
+    auto const exponent = bit_width - sub_bucket_bits - 1;
+    auto const index = exponent * num_sub_buckets + (microseconds >> exponent);
+    return std::min(index, num_buckets - 1);
+}
+
+[[nodiscard]] u64 LatencyHistogram::bucket_upper_bound(usize const index) {
+    if (index < num_sub_buckets) {
+        return index;
+    }
+    auto const exponent = index / num_sub_buckets - 1;
+    auto const sub_bucket = index % num_sub_buckets + num_sub_buckets;
+    return ((static_cast<u64>(sub_bucket) + 1) << exponent) - 1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <lib2k/types.hpp>
+
+// Counts latencies in buckets whose width grows with the latency, so that the relative error stays below ~6% while
+// the histogram stays small enough to keep one per client. Latencies are measured in microseconds.
+class LatencyHistogram final {
+private:
+    static constexpr auto sub_bucket_bits = usize{ 4 };
+    static constexpr auto num_sub_buckets = usize{ 1 } << sub_bucket_bits;
+    // Up to 2^32 microseconds (more than an hour), everything above ends up in the last bucket.
+    static constexpr auto num_buckets = num_sub_buckets + (32 - sub_bucket_bits) * num_sub_buckets;
+
+    std::array<u64, num_buckets> m_counts{};
+    u64 m_num_samples = 0;
+    std::chrono::microseconds m_max{ 0 };
+
+public:
+    void record(std::chrono::steady_clock::duration latency);
+    void merge(LatencyHistogram const& other);
+
+    [[nodiscard]] u64 num_samples() const {
+        return m_num_samples;
+    }
+
+    [[nodiscard]] std::chrono::microseconds max() const {
+        return m_max;
+    }
+
+    // Returns the upper bound of the bucket that contains the given percentile (between 0 and 100), or zero if no
+    // samples have been recorded.
+    [[nodiscard]] std::chrono::microseconds percentile(double percentile) const;
+
+private:
+    [[nodiscard]] static usize bucket_index(u64 microseconds);
+    [[nodiscard]] static u64 bucket_upper_bound(usize index);
+};
@@ -0,0 +1,230 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <network/match_starter.hpp>
+#include <simulator/replay.hpp>
+#include <thread>
+#include "load_generator.hpp"
+#include "process_sampler.hpp"
+
+using namespace std::chrono_literals;
+
+static constexpr auto frame_duration = std::chrono::nanoseconds{ 1'000'000'000 / 60 };
+static constexpr auto setup_timeout = std::chrono::seconds{ 30 };
+static constexpr auto progress_interval = std::chrono::seconds{ 5 };
+
+[[nodiscard]] static double to_milliseconds(std::chrono::microseconds const duration) {
+    return static_cast<double>(duration.count()) / 1000.0;
+}
+
+[[nodiscard]] static u64 count_broadcasts(std::span<std::unique_ptr<SyntheticClient> const> const clients) {
+    auto result = u64{ 0 };
+    for (auto const& client : clients) {
+        result += client->num_broadcasts();
+    }
+    return result;
+}
+
+[[nodiscard]] bool LoadGenerator::run() {
+    // The supervisors stop their matches when the control connection is closed, so it has to stay open.
+    auto match_starter = MatchStarter{ m_options.control_port };
+    if (not start_matches(match_starter) or not wait_for_game_starts()) {
+        return false;
+    }
+
+    auto max_pacing_lag = std::atomic<std::chrono::nanoseconds::rep>{ 0 };
+    auto pacing_threads = std::vector<std::jthread>{};
+    auto const num_threads = std::clamp(m_options.num_pacing_threads, usize{ 1 }, m_clients.size());
+    auto const clients_per_thread = (m_clients.size() + num_threads - 1) / num_threads;
+    for (auto first = usize{ 0 }; first < m_clients.size(); first += clients_per_thread) {
+        auto const num_clients = std::min(clients_per_thread, m_clients.size() - first);
+        auto const clients = std::span{ m_clients }.subspan(first, num_clients);
+        pacing_threads.emplace_back([clients, &max_pacing_lag](std::stop_token const& stop_token) {
+            drive_clients(stop_token, clients, max_pacing_lag);
+        });
+    }
+
+    auto const sampler = m_options.server_pid.transform([](int const pid) { return ProcessSampler{ pid }; });
+    auto const take_sample = [&sampler] { return sampler.has_value() ? sampler->sample() : std::nullopt; };
+    auto const first_sample = take_sample();
+    auto last_sample = first_sample;
+    auto peak_resident_bytes = first_sample.has_value() ? first_sample->resident_bytes : u64{ 0 };
+    auto const start_time = std::chrono::steady_clock::now();
+    auto const end_time = start_time + m_options.duration;
+    auto next_progress_time = start_time + progress_interval;
+    auto num_broadcasts_at_last_progress = count_broadcasts(m_clients);
+
+    while (std::chrono::steady_clock::now() < end_time) {
+        std::this_thread::sleep_until(std::min(end_time, std::chrono::steady_clock::now() + 1s));
+        if (auto const sample = take_sample()) {
+            peak_resident_bytes = std::max(peak_resident_bytes, sample->resident_bytes);
+            last_sample = sample;
+        }
+        if (std::chrono::steady_clock::now() >= next_progress_time) {
+            next_progress_time += progress_interval;
+            auto const num_broadcasts = count_broadcasts(m_clients);
+            auto const num_connected = std::ranges::count_if(m_clients, &SyntheticClient::is_connected);
+            spdlog::info(
+                "{} of {} clients connected, {:.0f} broadcasts/s",
+                num_connected,
+                m_clients.size(),
+                static_cast<double>(num_broadcasts - num_broadcasts_at_last_progress)
+                    / std::chrono::duration<double>{ progress_interval }.count()
+            );
+            num_broadcasts_at_last_progress = num_broadcasts;
+        }
+    }
+    pacing_threads.clear();
+    auto const elapsed = std::chrono::duration<double>{ std::chrono::steady_clock::now() - start_time };
+
+    auto total = LatencyHistogram{};
+    auto p99_per_client = std::vector<std::chrono::microseconds>{};
+    for (auto const& client : m_clients) {
+        auto const latencies = client->latencies();
+        total.merge(latencies);
+        if (latencies.num_samples() > 0) {
+            p99_per_client.push_back(latencies.percentile(99.0));
+        }
+    }
+    std::ranges::sort(p99_per_client);
+
+    std::cout << std::format(
+        "matches: {}, clients: {}, duration: {:.1f} s\n",
+        m_options.num_matches,
+        m_clients.size(),
+        elapsed.count()
+    );
+    std::cout << std::format(
+        "broadcasts: {} ({:.0f}/s), clients still connected: {}\n",
+        count_broadcasts(m_clients),
+        static_cast<double>(count_broadcasts(m_clients)) / elapsed.count(),
+        std::ranges::count_if(m_clients, &SyntheticClient::is_connected)
+    );
+    std::cout << std::format(
+        "input-to-broadcast latency: p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms, p99.9 {:.2f} ms, max {:.2f} ms\n",
+        to_milliseconds(total.percentile(50.0)),
+        to_milliseconds(total.percentile(90.0)),
+        to_milliseconds(total.percentile(99.0)),
+        to_milliseconds(total.percentile(99.9)),
+        to_milliseconds(total.max())
+    );
+    if (not p99_per_client.empty()) {
+        std::cout << std::format(
+            "p99 latency per client: median {:.2f} ms, worst {:.2f} ms\n",
+            to_milliseconds(p99_per_client.at(p99_per_client.size() / 2)),
+            to_milliseconds(p99_per_client.back())
+        );
+    }
+    if (first_sample.has_value() and last_sample.has_value() and last_sample->time > first_sample->time) {
+        auto const cores = (last_sample->cpu_time - first_sample->cpu_time)
+                           / std::chrono::duration<double>{ last_sample->time - first_sample->time };
+        std::cout << std::format(
+            "server: {:.2f} cores, peak resident memory {:.1f} MiB, {:.1f} matches per core\n",
+            cores,
+            static_cast<double>(peak_resident_bytes) / (1024.0 * 1024.0),
+            cores > 0.0 ? static_cast<double>(m_options.num_matches) / cores : 0.0
+        );
+    } else if (m_options.server_pid.has_value()) {
+        spdlog::warn("unable to sample the resource usage of process {}", m_options.server_pid.value());
+    }
+
+    auto const pacing_lag = std::chrono::nanoseconds{ max_pacing_lag.load() };
+    std::cout << std::format(
+        "max pacing lag of the load generator: {:.2f} ms\n",
+        static_cast<double>(pacing_lag.count()) / 1e6
+    );
+    if (pacing_lag > frame_duration) {
+        spdlog::warn("the load generator could not keep up, the latencies include its own delays");
+    }
+
+    // Disconnecting ends the matches before the control connection is closed.
+    m_clients.clear();
+    return true;
+}
+
+[[nodiscard]] bool LoadGenerator::start_matches(MatchStarter& match_starter) {
+    auto scripts = std::vector<std::shared_ptr<InputScript const>>{};
+    if (m_options.script.has_value()) {
+        try {
+            scripts = load_input_scripts(m_options.script.value());
+        } catch (ReplayError const& exception) {
+            spdlog::error("unable to load inputs from replay: {}", exception.what());
+            return false;
+        }
+    }
+
+    spdlog::info("waiting for a game server supervisor on port {}", match_starter.port());
+    auto const deadline = std::chrono::steady_clock::now() + setup_timeout;
+    while (match_starter.num_supervisors() == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            spdlog::error("no game server supervisor connected");
+            return false;
+        }
+        std::this_thread::sleep_for(100ms);
+    }
+
+    m_clients.reserve(m_options.num_matches * m_options.players_per_match);
+    for (auto match = usize{ 0 }; match < m_options.num_matches; ++match) {
+        auto const port = match_starter.start_match(m_options.players_per_match);
+        if (not port.has_value()) {
+            spdlog::error("unable to start match {}", match);
+            return false;
+        }
+        for (auto player = usize{ 0 }; player < m_options.players_per_match; ++player) {
+            auto const client_index = m_clients.size();
+            auto inputs = InputSource::random(m_options.seed + client_index);
+            if (not scripts.empty()) {
+                // Matches are offset against each other, so that they don't run in lockstep.
+                inputs = InputSource::scripted(scripts.at(player % scripts.size()), match * 997);
+            }
+            try {
+                m_clients.push_back(std::make_unique<SyntheticClient>(
+                    m_options.server,
+                    port.value(),
+                    std::format("load-{}-{}", match, player),
+                    std::move(inputs)
+                ));
+            } catch (std::exception const& exception) {
+                spdlog::error("unable to connect to game server on port {}: {}", port.value(), exception.what());
+                return false;
+            }
+        }
+    }
+    spdlog::info("started {} matches with {} clients", m_options.num_matches, m_clients.size());
+    return true;
+}
+
+[[nodiscard]] bool LoadGenerator::wait_for_game_starts() const {
+    auto const deadline = std::chrono::steady_clock::now() + setup_timeout;
+    while (not std::ranges::all_of(m_clients, &SyntheticClient::has_started)) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            spdlog::error("not all matches started in time");
+            return false;
+        }
+        std::this_thread::sleep_for(100ms);
+    }
+    return true;
+}
+
+// Ticks are scheduled at fixed points in time, so that a late tick is followed by shorter pauses instead of shifting
+// all subsequent ones.
+void LoadGenerator::drive_clients(
+    std::stop_token const& stop_token,
+    std::span<std::unique_ptr<SyntheticClient> const> const clients,
+    std::atomic<std::chrono::nanoseconds::rep>& max_pacing_lag
+) {
+    auto next_tick = std::chrono::steady_clock::now();
+    while (not stop_token.stop_requested()) {
+        auto const now = std::chrono::steady_clock::now();
+        auto const lag = std::chrono::duration_cast<std::chrono::nanoseconds>(now - next_tick).count();
+        auto previous_max = max_pacing_lag.load();
+        while (lag > previous_max and not max_pacing_lag.compare_exchange_weak(previous_max, lag)) { }
+
+        for (auto const& client : clients) {
+            client->tick(now);
+        }
+        next_tick += frame_duration;
+        std::this_thread::sleep_until(next_tick);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <lib2k/types.hpp>
+#include <memory>
+#include <network/match_starter.hpp>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <vector>
+#include "synthetic_client.hpp"
+
+struct LoadOptions final {
+    std::string server = "127.0.0.1";
+    std::uint16_t control_port = 0;
+    usize num_matches = 1;
+    u8 players_per_match = 2;
+    std::chrono::seconds duration{ 60 };
+    std::optional<int> server_pid;                // Enables sampling the CPU and memory usage of the server.
+    std::optional<std::filesystem::path> script;  // Replay to take the inputs from, random inputs otherwise.
+    u64 seed = 0;
+    usize num_pacing_threads = 1;
+};
+
+// Requests matches from game server supervisors (`server --supervise <control-port>`) just like the lobby server
+// does, fills them with synthetic clients and reports the latencies observed by the clients together with the
+// resource usage of the server.
+class LoadGenerator final {
+private:
+    LoadOptions m_options;
+    std::vector<std::unique_ptr<SyntheticClient>> m_clients;
+
+public:
+    explicit LoadGenerator(LoadOptions options) : m_options{ std::move(options) } { }
+
+    // Returns false if the matches could not be set up.
+    [[nodiscard]] bool run();
+
+private:
+    [[nodiscard]] bool start_matches(MatchStarter& match_starter);
+    [[nodiscard]] bool wait_for_game_starts() const;
+
+    static void drive_clients(
+        std::stop_token const& stop_token,
+        std::span<std::unique_ptr<SyntheticClient> const> clients,
+        std::atomic<std::chrono::nanoseconds::rep>& max_pacing_lag
+    );
+};
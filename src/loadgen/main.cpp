@@ -0,0 +1,133 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <charconv>
+#include <concepts>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "load_generator.hpp"
+
+template<std::integral Integer>
+[[nodiscard]] static std::optional<Integer> parse_integer(std::string_view const chars) {
+    if (chars.empty()) {
+        return std::nullopt;
+    }
+    auto value = Integer{};
+    auto const begin = chars.data();
+    auto const end = chars.data() + chars.length();
+    auto const result = std::from_chars(begin, end, value);
+    if (result.ptr == end and result.ec == std::errc{}) {
+        return value;
+    }
+    return std::nullopt;
+}
+
+static constexpr auto server_flag = std::string_view{ "--server=" };
+static constexpr auto duration_flag = std::string_view{ "--duration=" };
+static constexpr auto server_pid_flag = std::string_view{ "--server-pid=" };
+static constexpr auto script_flag = std::string_view{ "--script=" };
+static constexpr auto seed_flag = std::string_view{ "--seed=" };
+static constexpr auto pacing_threads_flag = std::string_view{ "--pacing-threads=" };
+
+static void print_usage(char const* const program_name) {
+    std::cout << std::format(
+        "Usage: {} <control-port> <num_matches> <players_per_match> [{}<host>] [{}<seconds>] [{}<pid>] "
+        "[{}<replay>] [{}<seed>] [{}<num_threads>]\n"
+        "Game servers are provided by `server --supervise <control-port>`.\n",
+        program_name,
+        server_flag,
+        duration_flag,
+        server_pid_flag,
+        script_flag,
+        seed_flag,
+        pacing_threads_flag
+    );
+}
+
+int main(int const argc, char const* const* const argv) {
+    auto positional_arguments = std::vector<std::string_view>{};
+    auto options = LoadOptions{};
+    options.num_pacing_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (auto i = 1; i < argc; ++i) {
+        auto const argument = std::string_view{ argv[i] };
+        if (argument.starts_with(server_flag)) {
+            options.server = argument.substr(server_flag.length());
+        } else if (argument.starts_with(duration_flag)) {
+            auto const value = argument.substr(duration_flag.length());
+            auto const seconds = parse_integer<std::chrono::seconds::rep>(value);
+            if (not seconds.has_value() or seconds.value() < 1) {
+                std::cout << std::format("'{}' is not a valid number of seconds\n", value);
+                return EXIT_FAILURE;
+            }
+            options.duration = std::chrono::seconds{ seconds.value() };
+        } else if (argument.starts_with(server_pid_flag)) {
+            auto const value = argument.substr(server_pid_flag.length());
+            auto const pid = parse_integer<int>(value);
+            if (not pid.has_value()) {
+                std::cout << std::format("'{}' is not a valid process ID\n", value);
+                return EXIT_FAILURE;
+            }
+            options.server_pid = pid.value();
+        } else if (argument.starts_with(script_flag)) {
+            options.script = argument.substr(script_flag.length());
+        } else if (argument.starts_with(seed_flag)) {
+            auto const value = argument.substr(seed_flag.length());
+            auto const seed = parse_integer<u64>(value);
+            if (not seed.has_value()) {
+                std::cout << std::format("'{}' is not a valid seed\n", value);
+                return EXIT_FAILURE;
+            }
+            options.seed = seed.value();
+        } else if (argument.starts_with(pacing_threads_flag)) {
+            auto const value = argument.substr(pacing_threads_flag.length());
+            auto const num_threads = parse_integer<usize>(value);
+            if (not num_threads.has_value() or num_threads.value() < 1) {
+                std::cout << std::format("'{}' is not a valid number of threads\n", value);
+                return EXIT_FAILURE;
+            }
+            options.num_pacing_threads = num_threads.value();
+        } else if (argument.starts_with("--")) {
+            std::cout << std::format("unknown option '{}'\n", argument);
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            positional_arguments.push_back(argument);
+        }
+    }
+
+    if (positional_arguments.size() != 3) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    auto const control_port = parse_integer<std::uint16_t>(positional_arguments.at(0));
+    if (not control_port.has_value()) {
+        std::cout << std::format("'{}' is not a valid port number\n", positional_arguments.at(0));
+        return EXIT_FAILURE;
+    }
+    auto const num_matches = parse_integer<usize>(positional_arguments.at(1));
+    if (not num_matches.has_value() or num_matches.value() < 1) {
+        std::cout << std::format("'{}' is not a valid number of matches\n", positional_arguments.at(1));
+        return EXIT_FAILURE;
+    }
+    auto const players_per_match = parse_integer<u8>(positional_arguments.at(2));
+    if (not players_per_match.has_value() or players_per_match.value() < 1) {
+        std::cout << std::format("'{}' is not a valid number of players\n", positional_arguments.at(2));
+        return EXIT_FAILURE;
+    }
+    options.control_port = control_port.value();
+    options.num_matches = num_matches.value();
+    options.players_per_match = players_per_match.value();
+
+    spdlog::info(
+        "starting {} matches with {} players each for {} s",
+        options.num_matches,
+        options.players_per_match,
+        options.duration.count()
+    );
+    auto generator = LoadGenerator{ std::move(options) };
+    return generator.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+#include "process_sampler.hpp"
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+[[nodiscard]] std::optional<ProcessSample> ProcessSampler::sample() const {
+#ifdef __linux__
+    auto const time = std::chrono::steady_clock::now();
+    auto file = std::ifstream{ std::format("/proc/{}/stat", m_pid) };
+    auto line = std::string{};
+    if (not std::getline(file, line)) {
+        return std::nullopt;
+    }
+    // The second field is the name of the executable in parentheses, which may contain spaces.
+    auto const name_end = line.rfind(')');
+    if (name_end == std::string::npos) {
+        return std::nullopt;
+    }
+    auto fields = std::istringstream{ line.substr(name_end + 1) };
+    auto field = std::string{};
+    auto user_ticks = u64{};
+    auto system_ticks = u64{};
+    auto resident_pages = u64{};
+    // Counting starts at the third field (the state of the process), see proc(5).
+    for (auto number = 3; number <= 24 and fields >> field; ++number) {
+        switch (number) {
+            case 14:
+                user_ticks = std::stoull(field);
+                break;
+            case 15:
+                system_ticks = std::stoull(field);
+                break;
+            case 24:
+                resident_pages = std::stoull(field);
+                break;
+            default:
+                break;
+        }
+    }
+    if (not fields) {
+        return std::nullopt;
+    }
+    auto const ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+    auto const page_size = static_cast<u64>(sysconf(_SC_PAGESIZE));
+    return ProcessSample{
+        .time = time,
+        .cpu_time = std::chrono::duration<double>{ static_cast<double>(user_ticks + system_ticks) / ticks_per_second },
+        .resident_bytes = resident_pages * page_size,
+    };
+#else
+    std::ignore = m_pid;
+    return std::nullopt;
+#endif
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <lib2k/types.hpp>
+#include <optional>
+
+struct ProcessSample final {
+    std::chrono::steady_clock::time_point time;
+    std::chrono::duration<double> cpu_time;  // User and system time of all threads since the process started.
+    u64 resident_bytes;
+};
+
+// Reads the resource usage of another process (e.g. the game server) from /proc. Only supported on Linux, other
+// platforms never get any samples.
+class ProcessSampler final {
+private:
+    int m_pid;
+
+public:
+    explicit ProcessSampler(int const pid) : m_pid{ pid } { }
+
+    // Returns std::nullopt if the process does not exist (anymore) or the platform is not supported.
+    [[nodiscard]] std::optional<ProcessSample> sample() const;
+};
@@ -0,0 +1,87 @@
+#include <spdlog/spdlog.h>
+#include <magic_enum.hpp>
+#include <network/messages.hpp>
+#include "synthetic_client.hpp"
+
+SyntheticClient::SyntheticClient(
+    std::string const& server,
+    std::uint16_t const port,
+    std::string const& player_name,
+    InputSource inputs
+)
+    : m_inputs{ std::move(inputs) },
+      m_socket{ c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, server, port) } {
+    m_socket.send(Connect{ player_name }.serialize()).wait();
+    m_receiving_thread = std::jthread{ [this](std::stop_token const& stop_token) { keep_receiving(stop_token); } };
+}
+
+void SyntheticClient::tick(std::chrono::steady_clock::time_point const now) {
+    auto frame = u64{};
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        if (not m_next_frame.has_value()) {
+            return;
+        }
+        frame = m_next_frame.value()++;
+    }
+
+    m_key_state_buffer.at(m_num_buffered_key_states) = m_inputs.next();
+    ++m_num_buffered_key_states;
+    if (m_num_buffered_key_states < heartbeat_interval) {
+        return;
+    }
+    m_num_buffered_key_states = 0;
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        m_sent_windows.push_back(SentWindow{ frame, now });
+    }
+    // Like a real client, we don't wait for the send to complete.
+    std::ignore = m_socket.send(Heartbeat{ frame, m_key_state_buffer }.serialize());
+}
+
+void SyntheticClient::keep_receiving(std::stop_token const& stop_token) {
+    using namespace std::chrono_literals;
+    while (not stop_token.stop_requested()) {
+        auto message = std::unique_ptr<AbstractMessage>{};
+        try {
+            message = AbstractMessage::from_socket(m_socket, 100ms);
+        } catch (c2k::TimeoutError const&) {
+            continue;
+        } catch (std::exception const& exception) {
+            spdlog::error("synthetic client lost connection: {}", exception.what());
+            break;
+        }
+        auto const received_at = std::chrono::steady_clock::now();
+
+        switch (message->type()) {
+            case MessageType::GameStart: {
+                // Like the frames of a tetrion, the frames of the heartbeats are counted from the beginning of the
+                // countdown. The start frame is where the countdown ends.
+                auto const lock = std::scoped_lock{ m_mutex };
+                m_next_frame = 0;
+                break;
+            }
+            case MessageType::StateBroadcast: {
+                auto const frame = dynamic_cast<StateBroadcast const&>(*message).frame;
+                ++m_num_broadcasts;
+                auto const lock = std::scoped_lock{ m_mutex };
+                // Windows without a matching broadcast must not pile up.
+                while (not m_sent_windows.empty() and m_sent_windows.front().frame < frame) {
+                    m_sent_windows.pop_front();
+                }
+                if (not m_sent_windows.empty() and m_sent_windows.front().frame == frame) {
+                    m_latencies.record(received_at - m_sent_windows.front().sent_at);
+                    m_sent_windows.pop_front();
+                }
+                break;
+            }
+            case MessageType::ClientDisconnected:
+            case MessageType::ClientReconnected:
+                break;
+            default:
+                spdlog::warn("received message of unexpected type: {}", magic_enum::enum_name(message->type()));
+                break;
+        }
+    }
+    m_is_connected = false;
+}
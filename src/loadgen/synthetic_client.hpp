@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <lib2k/types.hpp>
+#include <mutex>
+#include <network/constants.hpp>
+#include <optional>
+#include <sockets/sockets.hpp>
+#include <string>
+#include <thread>
+#include "input_source.hpp"
+#include "latency_histogram.hpp"
+
+// A client that speaks the gameplay protocol without simulating any tetrions, so that many of them fit into a single
+// process. Its frames are driven from the outside (see tick()), the broadcasts are received on a thread of its own.
+class SyntheticClient final {
+private:
+    struct SentWindow final {
+        u64 frame;  // Last frame of the window, which is also the frame of the matching broadcast.
+        std::chrono::steady_clock::time_point sent_at;
+    };
+
+    InputSource m_inputs;
+    c2k::ClientSocket m_socket;
+
+    std::mutex m_mutex;  // Guards the members up to (including) m_latencies.
+    std::optional<u64> m_next_frame;  // Set once the game has started.
+    std::deque<SentWindow> m_sent_windows;
+    LatencyHistogram m_latencies;
+
+    std::array<KeyState, heartbeat_interval> m_key_state_buffer{};
+    usize m_num_buffered_key_states = 0;
+    std::atomic<u64> m_num_broadcasts = 0;
+    std::atomic_bool m_is_connected = true;
+    std::jthread m_receiving_thread;  // Declared last, since it accesses the other members.
+
+public:
+    // Connects and identifies at the game server. Throws if the connection cannot be established.
+    SyntheticClient(std::string const& server, std::uint16_t port, std::string const& player_name, InputSource inputs);
+
+    // Presses the keys of the next frame and sends a heartbeat whenever a window is complete. Does nothing before the
+    // game has started. Must not be called concurrently.
+    void tick(std::chrono::steady_clock::time_point now);
+
+    [[nodiscard]] bool has_started() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_next_frame.has_value();
+    }
+
+    [[nodiscard]] bool is_connected() const {
+        return m_is_connected;
+    }
+
+    [[nodiscard]] u64 num_broadcasts() const {
+        return m_num_broadcasts;
+    }
+
+    // Time from sending the last key states of a window until the broadcast of that window arrived.
+    [[nodiscard]] LatencyHistogram latencies() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_latencies;
+    }
+
+private:
+    void keep_receiving(std::stop_token const& stop_token);
+};
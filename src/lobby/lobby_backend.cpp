@@ -0,0 +1,368 @@
+#include "lobby_backend.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <lib2k/random.hpp>
+#include <network/lobby_protocol.hpp>
+#include <ranges>
+
+[[nodiscard]] static HttpResponse empty_response(HttpStatus const status) {
+    return HttpResponse{ .status = status, .headers = {}, .body = {} };
+}
+
+template<typename Payload>
+[[nodiscard]] static HttpResponse json_response(HttpStatus const status, Payload const& payload) {
+    return HttpResponse{
+        .status = status,
+        .headers = { { "Content-Type", "application/json" } },
+        .body = nlohmann::json(payload).dump(),
+    };
+}
+
+[[nodiscard]] static std::vector<std::string_view> split_path(std::string_view const path) {
+    return path | std::views::split('/') | std::views::transform([](auto const& segment) {
+               return std::string_view{ segment.begin(), segment.end() };
+           })
+           | std::views::filter([](std::string_view const segment) { return not segment.empty(); })
+           | std::ranges::to<std::vector>();
+}
+
+[[nodiscard]] static std::optional<std::uint64_t> parse_since(std::string_view const query) {
+    static constexpr auto prefix = std::string_view{ "since=" };
+    for (auto const parameter : query | std::views::split('&')) {
+        auto const view = std::string_view{ parameter.begin(), parameter.end() };
+        if (not view.starts_with(prefix)) {
+            continue;
+        }
+        auto revision = std::uint64_t{};
+        auto const value = view.substr(prefix.length());
+        auto const [end, error] = std::from_chars(value.data(), value.data() + value.size(), revision);
+        if (error == std::errc{} and end == value.data() + value.size()) {
+            return revision;
+        }
+    }
+    return std::nullopt;
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::handle(HttpRequest const& request) try {
+    auto const query_start = request.path.find('?');
+    auto const path = std::string_view{ request.path }.substr(0, query_start);
+    auto const query = (query_start == std::string::npos ? std::string_view{}
+                                                         : std::string_view{ request.path }.substr(query_start + 1));
+    auto const segments = split_path(path);
+    auto const& method = request.method;
+
+    if (segments.size() == 1) {
+        if (method == "POST" and segments.at(0) == "register") {
+            return register_user(request);
+        }
+        if (method == "POST" and segments.at(0) == "login") {
+            return login(request);
+        }
+        if (method == "POST" and segments.at(0) == "unregister") {
+            return unregister(request);
+        }
+        if (method == "GET" and segments.at(0) == "lobbies") {
+            return lobby_list(request, query);
+        }
+        if (method == "POST" and segments.at(0) == "lobbies") {
+            return create_lobby(request);
+        }
+    } else if (segments.size() == 2 and segments.at(0) == "lobbies") {
+        if (method == "GET") {
+            return lobby_details(request, segments.at(1));
+        }
+        if (method == "POST") {
+            return join(request, segments.at(1));
+        }
+        if (method == "DELETE") {
+            return destroy_lobby(request, segments.at(1));
+        }
+    } else if (segments.size() == 3 and method == "POST") {
+        if (segments.at(0) == "lobbies" and segments.at(2) == "start") {
+            return start(request, segments.at(1));
+        }
+        if (segments.at(0) == "lobby" and segments.at(2) == "ready") {
+            return set_ready(request, segments.at(1));
+        }
+    }
+    return empty_response(HttpStatus::NotFound);
+} catch (nlohmann::json::exception const& exception) {
+    spdlog::warn("invalid request body: {}", exception.what());
+    return empty_response(HttpStatus::BadRequest);
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::register_user(HttpRequest const& request) {
+    auto credentials = nlohmann::json::parse(request.body).get<Credentials>();
+    auto const lock = std::scoped_lock{ m_mutex };
+    if (credentials.username.empty() or m_accounts.contains(credentials.username)) {
+        return empty_response(HttpStatus::BadRequest);
+    }
+    auto id = std::to_string(m_next_id++);
+    auto name = credentials.username;
+    m_accounts.emplace(
+        std::move(credentials.username),
+        Account{ std::move(id), std::move(name), std::move(credentials.password) }
+    );
+    return empty_response(HttpStatus::NoContent);
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::login(HttpRequest const& request) {
+    auto const credentials = nlohmann::json::parse(request.body).get<Credentials>();
+    auto const lock = std::scoped_lock{ m_mutex };
+    auto const account = m_accounts.find(credentials.username);
+    if (account == m_accounts.cend() or account->second.password != credentials.password) {
+        return empty_response(HttpStatus::Forbidden);
+    }
+    // The counter keeps tokens unique, the random part makes them hard to guess.
+    auto token = std::format("{}-{:016x}", m_next_id++, c2k::Random{}.next_integral<std::uint64_t>());
+    m_sessions.emplace(token, credentials.username);
+    return json_response(HttpStatus::Ok, LoginResponse{ std::move(token) });
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::unregister(HttpRequest const& request) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    auto const account = authenticate(request);
+    if (account == nullptr) {
+        return empty_response(HttpStatus::Unauthorized);
+    }
+    auto const name = account->name;
+    std::erase_if(m_sessions, [&name](auto const& session) { return session.second == name; });
+    m_accounts.erase(name);
+    return empty_response(HttpStatus::NoContent);
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::create_lobby(HttpRequest const& request) {
+    auto const settings = nlohmann::json::parse(request.body);
+    auto name = settings.at("name").get<std::string>();
+    auto const size = settings.at("size").get<std::uint16_t>();
+
+    auto const lock = std::scoped_lock{ m_mutex };
+    auto const account = authenticate(request);
+    if (account == nullptr) {
+        return empty_response(HttpStatus::Unauthorized);
+    }
+    if (size == 0 or is_in_any_lobby(account->id)) {
+        return empty_response(HttpStatus::BadRequest);
+    }
+    auto const id = m_next_id++;
+    auto& lobby = m_lobbies[id];
+    lobby.id = std::to_string(id);
+    lobby.name = std::move(name);
+    lobby.size = size;
+    lobby.host = PlayerInfo{ account->id, account->name };
+    // The host does not have to declare that they're ready.
+    lobby.players.push_back(LobbyPlayer{ account->id, account->name, true });
+    mark_changed(lobby);
+    return json_response(HttpStatus::Created, LobbyCreationResponse{ lobby.id });
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::lobby_list(HttpRequest const& request, std::string_view const query) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    auto etag = std::format("\"{}\"", m_revision);
+    if (request.header("if-none-match") == etag) {
+        auto response = empty_response(HttpStatus::NotModified);
+        response.headers.emplace_back("ETag", std::move(etag));
+        return response;
+    }
+
+    auto update = LobbyListUpdate{ .lobbies = {}, .revision = m_revision, .is_delta = false, .removed = {} };
+    auto const since = parse_since(query);
+    // Revisions from the future can only come from a previous run of this server.
+    if (since.has_value() and since.value() <= m_revision) {
+        update.is_delta = true;
+        for (auto const& [id, revision] : m_removed_lobbies) {
+            if (revision > since.value()) {
+                update.removed.push_back(id);
+            }
+        }
+    }
+    for (auto const& lobby : m_lobbies | std::views::values) {
+        if (update.is_delta and lobby.revision <= since.value()) {
+            continue;
+        }
+        update.lobbies.push_back(LobbyInfo{
+            .id = lobby.id,
+            .name = lobby.name,
+            .size = lobby.size,
+            .num_players_in_lobby = static_cast<std::uint16_t>(lobby.players.size()),
+            .host_info = lobby.host,
+        });
+    }
+    auto response = json_response(HttpStatus::Ok, update);
+    response.headers.emplace_back("ETag", std::move(etag));
+    return response;
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::lobby_details(HttpRequest const& request, std::string_view const lobby_id) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    if (authenticate(request) == nullptr) {
+        return empty_response(HttpStatus::Unauthorized);
+    }
+    auto const lobby = find_lobby(lobby_id);
+    if (lobby == nullptr) {
+        return empty_response(HttpStatus::NotFound);
+    }
+    auto details = LobbyDetailsResponse{
+        .name = lobby->name,
+        .size = lobby->size,
+        .host_info = HostInfo{ lobby->host.id, lobby->host.name },
+        .player_infos = {},
+        .gameserver_port = lobby->gameserver_port,
+    };
+    for (auto const& player : lobby->players) {
+        details.player_infos.push_back(ClientPlayerInfo{ player.user_id, player.name, player.is_ready });
+    }
+    return json_response(HttpStatus::Ok, details);
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::join(HttpRequest const& request, std::string_view const lobby_id) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    auto const account = authenticate(request);
+    if (account == nullptr) {
+        return empty_response(HttpStatus::Unauthorized);
+    }
+    auto const lobby = find_lobby(lobby_id);
+    if (lobby == nullptr) {
+        return empty_response(HttpStatus::NotFound);
+    }
+    if (lobby->is_starting or lobby->gameserver_port.has_value() or lobby->players.size() >= lobby->size
+        or is_in_any_lobby(account->id)) {
+        return empty_response(HttpStatus::BadRequest);
+    }
+    lobby->players.push_back(LobbyPlayer{ account->id, account->name, false });
+    mark_changed(*lobby);
+    return empty_response(HttpStatus::NoContent);
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::destroy_lobby(HttpRequest const& request, std::string_view const lobby_id) {
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        auto const account = authenticate(request);
+        if (account == nullptr) {
+            return empty_response(HttpStatus::Unauthorized);
+        }
+        auto const lobby = find_lobby(lobby_id);
+        if (lobby == nullptr) {
+            return empty_response(HttpStatus::NotFound);
+        }
+        if (lobby->host.id != account->id) {
+            return empty_response(HttpStatus::Forbidden);
+        }
+        m_removed_lobbies.emplace_back(lobby->id, ++m_revision);
+        std::erase_if(m_lobbies, [lobby](auto const& entry) { return &entry.second == lobby; });
+    }
+    // Players that wait for the match to start are turned away.
+    m_lobby_changed.notify_all();
+    return empty_response(HttpStatus::NoContent);
+}
+
+[[nodiscard]] HttpResponse LobbyBackend::start(HttpRequest const& request, std::string_view const lobby_id) {
+    auto num_players = std::uint16_t{};
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        auto const account = authenticate(request);
+        if (account == nullptr) {
+            return empty_response(HttpStatus::Unauthorized);
+        }
+        auto const lobby = find_lobby(lobby_id);
+        if (lobby == nullptr) {
+            return empty_response(HttpStatus::NotFound);
+        }
+        if (lobby->host.id != account->id) {
+            return empty_response(HttpStatus::Forbidden);
+        }
+        if (lobby->is_starting or lobby->gameserver_port.has_value()) {
+            return empty_response(HttpStatus::BadRequest);
+        }
+        if (not std::ranges::all_of(lobby->players, &LobbyPlayer::is_ready)) {
+            return empty_response(HttpStatus::TooEarly);
+        }
+        lobby->is_starting = true;
+        num_players = static_cast<std::uint16_t>(lobby->players.size());
+    }
+
+    // Other lobbies must not have to wait for the game server.
+    auto const port = m_match_starter->start_match(num_players);
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        if (auto const lobby = find_lobby(lobby_id)) {
+            lobby->is_starting = false;
+            lobby->gameserver_port = port;
+            mark_changed(*lobby);
+        }
+    }
+    m_lobby_changed.notify_all();
+
+    if (not port.has_value()) {
+        return empty_response(HttpStatus::ServiceUnavailable);
+    }
+    return json_response(HttpStatus::Ok, StartResponse{ port.value() });
+}
+
+// Answers once the host has started the match, so that the players learn the port of the game server.
+[[nodiscard]] HttpResponse LobbyBackend::set_ready(HttpRequest const& request, std::string_view const lobby_id) {
+    auto lock = std::unique_lock{ m_mutex };
+    auto const account = authenticate(request);
+    if (account == nullptr) {
+        return empty_response(HttpStatus::Unauthorized);
+    }
+    auto const lobby = find_lobby(lobby_id);
+    if (lobby == nullptr) {
+        return empty_response(HttpStatus::NotFound);
+    }
+    auto const player = std::ranges::find(lobby->players, account->id, &LobbyPlayer::user_id);
+    if (player == lobby->players.end()) {
+        return empty_response(HttpStatus::Forbidden);
+    }
+    if (not player->is_ready) {
+        player->is_ready = true;
+        mark_changed(*lobby);
+    }
+
+    // The lobby may be destroyed while waiting, so it has to be looked up again.
+    m_lobby_changed.wait(lock, [this, lobby_id] {
+        auto const current = find_lobby(lobby_id);
+        return current == nullptr or current->gameserver_port.has_value();
+    });
+    auto const started = find_lobby(lobby_id);
+    if (started == nullptr) {
+        return empty_response(HttpStatus::NotFound);
+    }
+    return json_response(HttpStatus::Ok, SetClientReadyResponse{ started->gameserver_port.value() });
+}
+
+[[nodiscard]] LobbyBackend::Account const* LobbyBackend::authenticate(HttpRequest const& request) const {
+    static constexpr auto prefix = std::string_view{ "Bearer " };
+    auto const authorization = request.header("authorization");
+    if (not authorization.has_value() or not authorization->starts_with(prefix)) {
+        return nullptr;
+    }
+    auto const session = m_sessions.find(std::string{ authorization->substr(prefix.length()) });
+    if (session == m_sessions.cend()) {
+        return nullptr;
+    }
+    auto const account = m_accounts.find(session->second);
+    return account == m_accounts.cend() ? nullptr : &account->second;
+}
+
+[[nodiscard]] LobbyBackend::OpenLobby* LobbyBackend::find_lobby(std::string_view const lobby_id) {
+    auto id = std::uint64_t{};
+    auto const [end, error] = std::from_chars(lobby_id.data(), lobby_id.data() + lobby_id.size(), id);
+    if (error != std::errc{} or end != lobby_id.data() + lobby_id.size()) {
+        return nullptr;
+    }
+    auto const lobby = m_lobbies.find(id);
+    return lobby == m_lobbies.end() ? nullptr : &lobby->second;
+}
+
+[[nodiscard]] bool LobbyBackend::is_in_any_lobby(std::string_view const user_id) const {
+    return std::ranges::any_of(m_lobbies | std::views::values, [user_id](OpenLobby const& lobby) {
+        return std::ranges::find(lobby.players, user_id, &LobbyPlayer::user_id) != lobby.players.cend();
+    });
+}
+
+void LobbyBackend::mark_changed(OpenLobby& lobby) {
+    lobby.revision = ++m_revision;
+}
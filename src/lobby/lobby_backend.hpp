@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <network/http_connection.hpp>
+#include <network/lobby_server.hpp>
+#include <network/match_starter.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Implements the REST API of the lobby server (as used by LobbyServerConnection) in memory. Nothing is persisted,
+// since this is only meant for local testing.
+class LobbyBackend final {
+private:
+    struct Account final {
+        std::string id;
+        std::string name;
+        std::string password;
+    };
+
+    struct LobbyPlayer final {
+        std::string user_id;
+        std::string name;
+        bool is_ready = false;
+    };
+
+    struct OpenLobby final {
+        std::string id;
+        std::string name;
+        std::uint16_t size = 0;
+        PlayerInfo host;
+        std::vector<LobbyPlayer> players;  // Including the host.
+        bool is_starting = false;
+        std::optional<std::uint16_t> gameserver_port;
+        std::uint64_t revision = 0;  // Revision of the lobby list in which this lobby changed last.
+    };
+
+    MatchStarter* m_match_starter;
+    std::mutex m_mutex;
+    std::condition_variable m_lobby_changed;  // Notified when a lobby starts or is destroyed.
+    std::unordered_map<std::string, Account> m_accounts;   // By name.
+    std::unordered_map<std::string, std::string> m_sessions;  // Maps tokens to account names.
+    std::map<std::uint64_t, OpenLobby> m_lobbies;             // By ID, i.e. in the order of creation.
+    std::vector<std::pair<std::string, std::uint64_t>> m_removed_lobbies;  // IDs and the revisions of their removal.
+    std::uint64_t m_revision = 0;
+    std::uint64_t m_next_id = 1;
+
+public:
+    explicit LobbyBackend(MatchStarter& match_starter) : m_match_starter{ &match_starter } { }
+
+    [[nodiscard]] HttpResponse handle(HttpRequest const& request);
+
+private:
+    [[nodiscard]] HttpResponse register_user(HttpRequest const& request);
+    [[nodiscard]] HttpResponse login(HttpRequest const& request);
+    [[nodiscard]] HttpResponse unregister(HttpRequest const& request);
+    [[nodiscard]] HttpResponse create_lobby(HttpRequest const& request);
+    [[nodiscard]] HttpResponse lobby_list(HttpRequest const& request, std::string_view query);
+    [[nodiscard]] HttpResponse lobby_details(HttpRequest const& request, std::string_view lobby_id);
+    [[nodiscard]] HttpResponse join(HttpRequest const& request, std::string_view lobby_id);
+    [[nodiscard]] HttpResponse destroy_lobby(HttpRequest const& request, std::string_view lobby_id);
+    [[nodiscard]] HttpResponse start(HttpRequest const& request, std::string_view lobby_id);
+    [[nodiscard]] HttpResponse set_ready(HttpRequest const& request, std::string_view lobby_id);
+
+    // The following have to be called while holding m_mutex.
+    [[nodiscard]] Account const* authenticate(HttpRequest const& request) const;
+    [[nodiscard]] OpenLobby* find_lobby(std::string_view lobby_id);
+    [[nodiscard]] bool is_in_any_lobby(std::string_view user_id) const;
+    void mark_changed(OpenLobby& lobby);
+};
@@ -0,0 +1,50 @@
+#include <spdlog/spdlog.h>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <network/http_server.hpp>
+#include <network/match_starter.hpp>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include "lobby_backend.hpp"
+
+[[nodiscard]] static std::optional<std::uint16_t> parse_port(std::string_view const chars) {
+    auto value = std::uint16_t{};
+    auto const begin = chars.data();
+    auto const end = chars.data() + chars.length();
+    auto const result = std::from_chars(begin, end, value);
+    if (chars.empty() or result.ptr != end or result.ec != std::errc{}) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+int main(int const argc, char const* const* const argv) {
+    if (argc != 3) {
+        std::cout << std::format("Usage: {} <http-port> <control-port>\n", argv[0]);
+        std::cout << "Game servers are provided by `server --supervise <control-port>`.\n";
+        return EXIT_FAILURE;
+    }
+    auto const http_port = parse_port(argv[1]);
+    auto const control_port = parse_port(argv[2]);
+    if (not http_port.has_value() or not control_port.has_value()) {
+        std::cout << std::format("'{}' is not a valid port number\n", http_port.has_value() ? argv[2] : argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    auto match_starter = MatchStarter{ control_port.value() };
+    auto backend = LobbyBackend{ match_starter };
+    auto const handle_request = [&backend](HttpRequest const& request) { return backend.handle(request); };
+    auto const server = HttpServer{ http_port.value(), handle_request };
+    spdlog::info("lobby listening on port {}", server.port());
+    spdlog::info("waiting for supervisors on port {}", match_starter.port());
+
+    // Runs until the process is terminated.
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::hours{ 1 });
+    }
+}
@@ -0,0 +1,303 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <network/http_connection.hpp>
+
+static constexpr auto max_receive_size = std::size_t{ 4096 };
+
+[[nodiscard]] static std::string to_lower(std::string_view const text) {
+    auto result = std::string{ text };
+    std::ranges::transform(result, result.begin(), [](char const c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    return result;
+}
+
+[[nodiscard]] static std::string_view trim(std::string_view text) {
+    while (not text.empty() and (text.front() == ' ' or text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (not text.empty() and (text.back() == ' ' or text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+[[nodiscard]] static std::size_t parse_number(std::string_view const text, int const base) {
+    auto result = std::size_t{};
+    auto const trimmed = trim(text);
+    auto const [end, error] = std::from_chars(trimmed.data(), trimmed.data() + trimmed.size(), result, base);
+    if (error != std::errc{} or end != trimmed.data() + trimmed.size()) {
+        throw HttpError{ std::format("invalid number in HTTP response: '{}'", text) };
+    }
+    return result;
+}
+
+[[nodiscard]] std::optional<std::string_view> find_header(HttpHeaders const& headers, std::string_view const name) {
+    auto const lower_case_name = to_lower(name);
+    auto const it = std::ranges::find(headers, lower_case_name, &HttpHeaders::value_type::first);
+    if (it == headers.cend()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+HttpConnection::HttpConnection(std::string_view host, std::uint16_t const port) : m_port{ port } {
+    static constexpr auto scheme = std::string_view{ "http://" };
+    if (host.starts_with(scheme)) {
+        host.remove_prefix(scheme.length());
+    }
+    if (host.ends_with('/')) {
+        host.remove_suffix(1);
+    }
+    m_host = std::string{ host };
+}
+
+[[nodiscard]] HttpResponse HttpConnection::send(HttpRequest const& request) {
+    return std::move(send_all(std::span{ &request, 1 }).front());
+}
+
+[[nodiscard]] static bool is_idempotent(HttpRequest const& request) {
+    return request.method == "GET" or request.method == "HEAD";
+}
+
+[[nodiscard]] std::vector<HttpResponse> HttpConnection::send_all(std::span<HttpRequest const> const requests) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    auto responses = std::vector<HttpResponse>{};
+    while (responses.size() < requests.size()) {
+        auto const remaining_requests = requests.subspan(responses.size());
+        auto const idle_time = std::chrono::steady_clock::now() - m_last_response_time;
+        if (m_socket.has_value() and idle_time > max_idle_time_for_unsafe_requests
+            and not std::ranges::all_of(remaining_requests, is_idempotent)) {
+            disconnect();
+        }
+        auto const is_reused = m_socket.has_value();
+        auto const num_responses_before = responses.size();
+        try {
+            if (not m_socket.has_value()) {
+                m_socket = c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, m_host, m_port);
+                m_reader.emplace(m_socket.value());
+            }
+            try {
+                send_requests(remaining_requests);
+            } catch (HttpConnectionClosed const& exception) {
+                // Nothing has been handled by the server if it did not even receive the requests.
+                disconnect();
+                if (not is_reused) {
+                    throw HttpError{
+                        std::format("connection to {}:{} has been closed: {}", m_host, m_port, exception.what())
+                    };
+                }
+                spdlog::info("HTTP connection to {}:{} has been closed, reconnecting", m_host, m_port);
+                continue;
+            }
+            receive_responses(remaining_requests.size(), responses);
+        } catch (HttpConnectionClosed const& exception) {
+            disconnect();
+            // The server may close an idle connection at any time, but it may also have handled the requests that
+            // have not been answered. Fresh connections that don't make any progress are not retried.
+            auto const unanswered_requests = requests.subspan(responses.size());
+            if ((not is_reused and responses.size() == num_responses_before)
+                or not std::ranges::all_of(unanswered_requests, is_idempotent)) {
+                throw HttpError{ std::format(
+                    "connection to {}:{} has been closed before all requests have been answered: {}",
+                    m_host,
+                    m_port,
+                    exception.what()
+                ) };
+            }
+            spdlog::info("HTTP connection to {}:{} has been closed, reconnecting", m_host, m_port);
+        } catch (HttpError const&) {
+            disconnect();
+            throw;
+        } catch (std::exception const& exception) {
+            disconnect();
+            throw HttpError{
+                std::format("unable to send HTTP request to {}:{}: {}", m_host, m_port, exception.what())
+            };
+        }
+    }
+    return responses;
+}
+
+void HttpConnection::send_requests(std::span<HttpRequest const> const requests) {
+    auto text = std::string{};
+    for (auto const& request : requests) {
+        text += std::format("{} {} HTTP/1.1\r\n", request.method, request.path);
+        text += std::format("Host: {}:{}\r\nConnection: keep-alive\r\n", m_host, m_port);
+        for (auto const& [name, value] : request.headers) {
+            text += std::format("{}: {}\r\n", name, value);
+        }
+        if (not request.body.empty() or request.method != "GET") {
+            text += std::format("Content-Length: {}\r\n", request.body.length());
+        }
+        text += "\r\n";
+        text += request.body;
+    }
+    auto bytes = std::vector<std::byte>(text.length());
+    std::ranges::transform(text, bytes.begin(), [](char const c) { return static_cast<std::byte>(c); });
+    auto buffer = c2k::MessageBuffer{};
+    buffer << bytes;
+    try {
+        m_socket->send(buffer).wait();
+    } catch (c2k::SendError const& exception) {
+        throw HttpConnectionClosed{ exception.what() };
+    }
+}
+
+// Responses are appended as they arrive, so that they are kept even if the connection is closed before the next one.
+// If the server announces to close the connection, it does not handle the requests after that one, so they can
+// safely be sent again.
+void HttpConnection::receive_responses(std::size_t const num_requests, std::vector<HttpResponse>& responses) {
+    for (auto i = std::size_t{ 0 }; i < num_requests; ++i) {
+        auto response = m_reader->receive_response();
+        m_last_response_time = std::chrono::steady_clock::now();
+        auto const connection = response.header("connection");
+        auto const must_close = connection.has_value() and to_lower(connection.value()) == "close";
+        responses.push_back(std::move(response));
+        if (must_close) {
+            disconnect();
+            return;
+        }
+    }
+}
+
+void HttpConnection::disconnect() {
+    m_reader.reset();
+    m_socket.reset();
+}
+
+[[nodiscard]] bool HttpReader::wait_for_message() {
+    return not m_received.empty() or receive_more();
+}
+
+[[nodiscard]] HttpRequest HttpReader::receive_request() {
+    auto request = HttpRequest{};
+    auto const request_line = receive_line();
+    // Example: "GET /lobbies HTTP/1.1"
+    auto const first_space = request_line.find(' ');
+    auto const second_space = request_line.find(' ', first_space + 1);
+    if (first_space == std::string::npos or second_space == std::string::npos) {
+        throw HttpError{ std::format("invalid HTTP request line: '{}'", request_line) };
+    }
+    request.method = request_line.substr(0, first_space);
+    request.path = request_line.substr(first_space + 1, second_space - first_space - 1);
+    request.headers = receive_headers();
+    // Requests without a length don't have a body.
+    request.body = receive_sized_body(request.headers).value_or("");
+    return request;
+}
+
+[[nodiscard]] HttpResponse HttpReader::receive_response() {
+    auto response = HttpResponse{};
+    auto const status_line = receive_line();
+    // Example: "HTTP/1.1 200 OK"
+    auto const first_space = status_line.find(' ');
+    if (not status_line.starts_with("HTTP/") or first_space == std::string::npos) {
+        throw HttpError{ std::format("invalid HTTP status line: '{}'", status_line) };
+    }
+    auto const status_code = std::string_view{ status_line }.substr(first_space + 1, 3);
+    response.status = static_cast<HttpStatus>(parse_number(status_code, 10));
+    response.headers = receive_headers();
+
+    if (auto body = receive_sized_body(response.headers)) {
+        response.body = std::move(body).value();
+    } else if (response.status != HttpStatus::NoContent and response.status != HttpStatus::NotModified) {
+        // Without a length, the body ends when the server closes the connection.
+        while (receive_more()) { }
+        response.body = std::exchange(m_received, {});
+        response.headers.emplace_back("connection", "close");
+    }
+    return response;
+}
+
+[[nodiscard]] HttpHeaders HttpReader::receive_headers() {
+    auto headers = HttpHeaders{};
+    while (true) {
+        auto const line = receive_line();
+        if (line.empty()) {
+            return headers;
+        }
+        if ((line.front() == ' ' or line.front() == '\t') and not headers.empty()) {
+            // Obsolete line folding: the line continues the value of the previous header.
+            auto& value = headers.back().second;
+            value += ' ';
+            value += trim(line);
+            continue;
+        }
+        auto const colon = line.find(':');
+        if (colon == std::string::npos) {
+            throw HttpError{ std::format("invalid HTTP header: '{}'", line) };
+        }
+        auto const view = std::string_view{ line };
+        auto const name = to_lower(trim(view.substr(0, colon)));
+        headers.emplace_back(name, std::string{ trim(view.substr(colon + 1)) });
+    }
+}
+
+// Returns std::nullopt if the headers specify neither a length nor chunked encoding.
+[[nodiscard]] std::optional<std::string> HttpReader::receive_sized_body(HttpHeaders const& headers) {
+    auto const transfer_encoding = find_header(headers, "transfer-encoding");
+    auto const content_length = find_header(headers, "content-length");
+    if (transfer_encoding.has_value() and to_lower(transfer_encoding.value()).contains("chunked")) {
+        auto body = std::string{};
+        while (true) {
+            auto const size_line = receive_line();
+            auto const chunk_size = parse_number(std::string_view{ size_line }.substr(0, size_line.find(';')), 16);
+            if (chunk_size == 0) {
+                // Trailers are ignored.
+                while (not receive_line().empty()) { }
+                return body;
+            }
+            body += receive_exactly(chunk_size);
+            std::ignore = receive_exactly(2);  // CRLF
+        }
+    }
+    if (content_length.has_value()) {
+        return receive_exactly(parse_number(content_length.value(), 10));
+    }
+    return std::nullopt;
+}
+
+[[nodiscard]] std::string HttpReader::receive_line() {
+    auto end = m_received.find("\r\n");
+    while (end == std::string::npos) {
+        if (not receive_more()) {
+            throw HttpConnectionClosed{ "connection has been closed while receiving a line" };
+        }
+        end = m_received.find("\r\n");
+    }
+    auto line = m_received.substr(0, end);
+    m_received.erase(0, end + 2);
+    return line;
+}
+
+[[nodiscard]] std::string HttpReader::receive_exactly(std::size_t const num_bytes) {
+    while (m_received.length() < num_bytes) {
+        if (not receive_more()) {
+            throw HttpConnectionClosed{ "connection has been closed while receiving the body" };
+        }
+    }
+    auto result = m_received.substr(0, num_bytes);
+    m_received.erase(0, num_bytes);
+    return result;
+}
+
+[[nodiscard]] bool HttpReader::receive_more() {
+    auto bytes = std::vector<std::byte>{};
+    try {
+        bytes = m_socket->receive(max_receive_size).get();
+    } catch (c2k::ReadError const&) {
+        return false;
+    }
+    if (bytes.empty()) {
+        return false;
+    }
+    std::ranges::transform(bytes, std::back_inserter(m_received), [](std::byte const byte) {
+        return static_cast<char>(byte);
+    });
+    return true;
+}
@@ -0,0 +1,80 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <format>
+#include <magic_enum.hpp>
+#include <network/http_server.hpp>
+
+[[nodiscard]] static c2k::MessageBuffer serialize(HttpResponse const& response, bool const closes_connection) {
+    auto text = std::format(
+        "HTTP/1.1 {} {}\r\n",
+        std::to_underlying(response.status),
+        magic_enum::enum_name(response.status)
+    );
+    for (auto const& [name, value] : response.headers) {
+        text += std::format("{}: {}\r\n", name, value);
+    }
+    if (closes_connection) {
+        text += "Connection: close\r\n";
+    }
+    if (response.status != HttpStatus::NoContent and response.status != HttpStatus::NotModified) {
+        text += std::format("Content-Length: {}\r\n", response.body.length());
+    }
+    text += "\r\n";
+    text += response.body;
+
+    auto bytes = std::vector<std::byte>(text.length());
+    std::ranges::transform(text, bytes.begin(), [](char const c) { return static_cast<std::byte>(c); });
+    auto buffer = c2k::MessageBuffer{};
+    buffer << bytes;
+    return buffer;
+}
+
+HttpServer::HttpServer(std::uint16_t const port, Handler handler)
+    : m_handler{ std::move(handler) },
+      m_server_socket{ c2k::Sockets::create_server(
+          c2k::AddressFamily::Ipv4,
+          port,
+          [this](c2k::ClientSocket socket) { accept_connection(std::move(socket)); }
+      ) } { }
+
+void HttpServer::accept_connection(c2k::ClientSocket socket) {
+    auto const lock = std::scoped_lock{ m_connections_mutex };
+    // Clients that come and go would otherwise pile up threads that have long finished.
+    std::erase_if(m_connections, [](Connection const& connection) { return connection.has_finished->load(); });
+
+    auto has_finished = std::make_unique<std::atomic_bool>(false);
+    auto thread = std::jthread{ serve, std::move(socket), std::cref(m_handler), std::ref(*has_finished) };
+    m_connections.push_back(Connection{ std::move(has_finished), std::move(thread) });
+}
+
+void HttpServer::serve(
+    std::stop_token const& stop_token,
+    c2k::ClientSocket socket,
+    Handler const& handler,
+    std::atomic_bool& has_finished
+) {
+    auto reader = HttpReader{ socket };
+    while (not stop_token.stop_requested()) {
+        try {
+            if (not reader.wait_for_message()) {
+                break;
+            }
+        } catch (c2k::TimeoutError const&) {
+            // The connection is idle, which is fine for keep-alive connections.
+            continue;
+        }
+        try {
+            auto const request = reader.receive_request();
+            auto const connection = request.header("connection");
+            auto const closes_connection = connection.has_value() and connection.value() == "close";
+            socket.send(serialize(handler(request), closes_connection)).wait();
+            if (closes_connection) {
+                break;
+            }
+        } catch (std::exception const& exception) {
+            spdlog::warn("closing HTTP connection: {}", exception.what());
+            break;
+        }
+    }
+    has_finished = true;
+}
@@ -6,3 +6,6 @@
 
 inline constexpr auto heartbeat_interval = std::size_t{ 15 };
 inline constexpr auto max_payload_size = std::numeric_limits<std::uint16_t>::max();
+
+// Maximum number of input windows (of heartbeat_interval frames each) that are repeated within a single datagram.
+inline constexpr auto max_redundant_windows = std::size_t{ 8 };
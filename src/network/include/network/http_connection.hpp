@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <sockets/sockets.hpp>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class HttpError final : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Thrown if the peer closes the connection in the middle of a message (or before it started).
+class HttpConnectionClosed final : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+enum class HttpStatus : std::uint16_t {
+    Ok = 200,
+    Created = 201,
+    NoContent = 204,
+    NotModified = 304,
+    BadRequest = 400,
+    Unauthorized = 401,
+    Forbidden = 403,
+    NotFound = 404,
+    TooEarly = 425,
+    InternalServerError = 500,
+    ServiceUnavailable = 503,
+};
+
+using HttpHeaders = std::vector<std::pair<std::string, std::string>>;
+
+// Header names are case-insensitive.
+[[nodiscard]] std::optional<std::string_view> find_header(HttpHeaders const& headers, std::string_view name);
+
+struct HttpRequest final {
+    std::string method;
+    std::string path;  // Including the query string.
+    HttpHeaders headers;  // Names are converted to lower case when receiving a request.
+    std::string body;
+
+    [[nodiscard]] std::optional<std::string_view> header(std::string_view const name) const {
+        return find_header(headers, name);
+    }
+};
+
+struct HttpResponse final {
+    HttpStatus status{};
+    HttpHeaders headers;  // Names are converted to lower case when receiving a response.
+    std::string body;
+
+    [[nodiscard]] std::optional<std::string_view> header(std::string_view const name) const {
+        return find_header(headers, name);
+    }
+};
+
+// Parses HTTP/1.1 messages from a socket. Bytes that have been received beyond the end of a message are kept for the
+// next one, which is what makes keep-alive connections (and pipelining) work. Throws an HttpConnectionClosed error if
+// the connection is closed in the middle of a message, and an HttpError if the message is invalid.
+class HttpReader final {
+private:
+    c2k::ClientSocket* m_socket;
+    std::string m_received;  // Bytes that have been received, but not yet been parsed.
+
+public:
+    explicit HttpReader(c2k::ClientSocket& socket) : m_socket{ &socket } { }
+
+    // Blocks until the next message starts to arrive. Returns false if the connection has been closed instead.
+    [[nodiscard]] bool wait_for_message();
+    [[nodiscard]] HttpRequest receive_request();
+    [[nodiscard]] HttpResponse receive_response();
+
+private:
+    [[nodiscard]] HttpHeaders receive_headers();
+    [[nodiscard]] std::optional<std::string> receive_sized_body(HttpHeaders const& headers);
+    [[nodiscard]] std::string receive_line();
+    [[nodiscard]] std::string receive_exactly(std::size_t num_bytes);
+    [[nodiscard]] bool receive_more();
+};
+
+// A single HTTP/1.1 connection that is kept alive across requests, so that only the first request (and the first one
+// after the server closed the connection) has to wait for the TCP handshake. Requests are serialized, so the
+// connection can be shared between threads.
+//
+// If a reused connection turns out to be closed, requests are sent again on a new connection, but only if the server
+// cannot have handled them already: either sending them failed, the server announced to close the connection before
+// them, or they are idempotent (GET and HEAD). Since the server may have closed an idle connection without us noticing,
+// other requests are never sent on a connection that has been idle for a while.
+class HttpConnection final {
+private:
+    static constexpr auto max_idle_time_for_unsafe_requests = std::chrono::seconds{ 1 };
+
+    std::string m_host;
+    std::uint16_t m_port;
+    std::mutex m_mutex;
+    std::optional<c2k::ClientSocket> m_socket;
+    std::optional<HttpReader> m_reader;  // Reads from m_socket.
+    std::chrono::steady_clock::time_point m_last_response_time;
+
+public:
+    // The host may start with "http://". Nothing is connected until the first request is sent.
+    HttpConnection(std::string_view host, std::uint16_t port);
+
+    // Throws an HttpError if the server cannot be reached, sends an invalid response, or closes the connection before
+    // responding to a request that cannot be sent again (see above).
+    [[nodiscard]] HttpResponse send(HttpRequest const& request);
+
+    // Pipelines the requests, i.e. they are all sent before the first response is awaited. This is only correct if no
+    // request depends on the side effects of the ones before it having succeeded.
+    [[nodiscard]] std::vector<HttpResponse> send_all(std::span<HttpRequest const> requests);
+
+private:
+    void send_requests(std::span<HttpRequest const> requests);
+    void receive_responses(std::size_t num_requests, std::vector<HttpResponse>& responses);
+    void disconnect();
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <network/http_connection.hpp>
+#include <sockets/sockets.hpp>
+#include <thread>
+#include <vector>
+
+// Serves HTTP/1.1 requests on keep-alive connections. Every connection is handled on a thread of its own, so the
+// handler may block (e.g. to implement long polling).
+class HttpServer final {
+public:
+    using Handler = std::function<HttpResponse(HttpRequest const& request)>;
+
+private:
+    struct Connection final {
+        std::unique_ptr<std::atomic_bool> has_finished;  // On the heap, since the thread refers to it.
+        std::jthread thread;
+    };
+
+    Handler m_handler;
+    std::mutex m_connections_mutex;
+    std::vector<Connection> m_connections;
+    c2k::ServerSocket m_server_socket;  // Declared last, so that no connections are accepted during destruction.
+
+public:
+    HttpServer(std::uint16_t port, Handler handler);
+
+    [[nodiscard]] std::uint16_t port() const {
+        return m_server_socket.local_address().port;
+    }
+
+private:
+    void accept_connection(c2k::ClientSocket socket);
+
+    static void serve(
+        std::stop_token const& stop_token,
+        c2k::ClientSocket socket,
+        Handler const& handler,
+        std::atomic_bool& has_finished
+    );
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+#include "lobby_server.hpp"
+
+// Request and response bodies of the lobby server's REST API that are not part of the interface of
+// LobbyServerConnection. They are shared by the client and the local lobby server.
+
+struct Credentials final {
+    std::string username;
+    std::string password;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Credentials, username, password);
+
+struct LoginResponse final {
+    std::string jwt;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LoginResponse, jwt);
+
+struct LobbyCreationResponse final {
+    std::string id;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LobbyCreationResponse, id);
+
+struct StartResponse final {
+    std::uint16_t port;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(StartResponse, port);
+
+struct SetClientReadyResponse final {
+    std::uint16_t port;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SetClientReadyResponse, port);
+
+struct HostInfo final {
+    std::string id;
+    std::string name;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(HostInfo, id, name);
+
+struct LobbyDetailsResponse final {
+    std::string name;
+    std::uint16_t size{};
+    HostInfo host_info;
+    std::vector<ClientPlayerInfo> player_infos;
+    std::optional<std::uint16_t> gameserver_port;
+};
+
+inline void to_json(nlohmann::json& json, LobbyDetailsResponse const& response) {
+    json = nlohmann::json{
+        {         "name",         response.name },
+        {         "size",         response.size },
+        {    "host_info",    response.host_info },
+        { "player_infos", response.player_infos },
+    };
+    if (response.gameserver_port.has_value()) {
+        json["gameserver_port"] = response.gameserver_port.value();
+    }
+}
+
+inline void from_json(nlohmann::json const& json, LobbyDetailsResponse& response) {
+    json.at("name").get_to(response.name);
+    json.at("size").get_to(response.size);
+    json.at("host_info").get_to(response.host_info);
+    json.at("player_infos").get_to(response.player_infos);
+    if (json.contains("gameserver_port")) {
+        response.gameserver_port = std::uint16_t{};
+        json.at("gameserver_port").get_to(response.gameserver_port.value());
+    } else {
+        response.gameserver_port = std::nullopt;
+    }
+}
+
+// Response to a request for the lobby list. If the request contained the revision of the list the client already has
+// (and the server supports this), only the lobbies that have been added or changed since then are contained, together
+// with the IDs of the removed ones.
+struct LobbyListUpdate final {
+    std::vector<LobbyInfo> lobbies;
+    std::optional<std::uint64_t> revision;
+    bool is_delta = false;
+    std::vector<std::string> removed;
+};
+
+inline void from_json(nlohmann::json const& json, LobbyListUpdate& update) {
+    json.at("lobbies").get_to(update.lobbies);
+    if (json.contains("revision")) {
+        update.revision = json.at("revision").get<std::uint64_t>();
+    }
+    if (json.contains("delta")) {
+        json.at("delta").get_to(update.is_delta);
+    }
+    if (json.contains("removed")) {
+        json.at("removed").get_to(update.removed);
+    }
+}
+
+inline void to_json(nlohmann::json& json, LobbyListUpdate const& update) {
+    json = nlohmann::json{
+        { "lobbies", update.lobbies },
+    };
+    if (update.revision.has_value()) {
+        json["revision"] = update.revision.value();
+    }
+    if (update.is_delta) {
+        json["delta"] = true;
+        json["removed"] = update.removed;
+    }
+}
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "http_connection.hpp"
 #include "lobby.hpp"
 #include "user.hpp"
 #include <cstdint>
 #include <format>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <tl/expected.hpp>
@@ -99,27 +102,18 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LobbyDetails, id, name, size, client_infos, h
 
 class LobbyServerConnection final {
 private:
-    std::string m_url;
+    HttpConnection m_connection;
 
-    [[nodiscard]] std::string const& url() const {
-        return m_url;
-    }
-
-    [[nodiscard]] std::string endpoint(std::string_view const path) const {
-        if (path.starts_with('/')) {
-            return std::format("{}{}", url(), path);
-        }
-        return std::format("{}/{}", url(), path);
-    }
+    // The lobby list is polled continuously by the lobby browser, so the last one is kept to make refreshing it cheap:
+    // The server answers with 304 Not Modified if nothing has changed (based on the ETag), and only sends the changes
+    // since the last revision otherwise (if it supports this).
+    std::mutex m_lobby_list_mutex;
+    LobbyList m_lobby_list;
+    std::string m_lobby_list_etag;
+    std::optional<std::uint64_t> m_lobby_list_revision;
 
 public:
-    LobbyServerConnection(std::string_view const host, std::uint16_t const port) {
-        if (host.ends_with('/')) {
-            m_url = std::format("{}:{}", host.substr(0, host.length() - 1), port);
-        } else {
-            m_url = std::format("{}:{}", host, port);
-        }
-    }
+    LobbyServerConnection(std::string_view const host, std::uint16_t const port) : m_connection{ host, port } { }
 
     LobbyServerConnection(LobbyServerConnection const& other) = delete;
     LobbyServerConnection(LobbyServerConnection&& other) noexcept = delete;
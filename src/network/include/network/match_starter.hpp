@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <sockets/sockets.hpp>
+
+// Accepts the control connections of game server supervisors (`server --supervise <control-port>`) and asks them to
+// start matches. Matches are distributed round robin if there are multiple supervisors.
+class MatchStarter final {
+private:
+    std::mutex m_mutex;
+    std::deque<c2k::ClientSocket> m_supervisors;
+    c2k::ServerSocket m_server_socket;  // Declared last, so that no supervisors are accepted during destruction.
+
+public:
+    explicit MatchStarter(std::uint16_t port);
+
+    [[nodiscard]] std::uint16_t port() const {
+        return m_server_socket.local_address().port;
+    }
+
+    [[nodiscard]] std::size_t num_supervisors() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_supervisors.size();
+    }
+
+    // Returns the port of the game server, or std::nullopt if no supervisor was able to start the match.
+    [[nodiscard]] std::optional<std::uint16_t> start_match(std::uint16_t num_players);
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <sockets/sockets.hpp>
+#include <stop_token>
+#include <thread>
+#include "messages.hpp"
+
+// A reliable and ordered connection that carries whole messages. Besides sockets, this can be an in-process
+// connection of a SimulatedNetwork (see simulated_network.hpp), so that the netcode can be tested without real
+// sockets and timing.
+class MessageTransport {
+public:
+    MessageTransport() = default;
+    MessageTransport(MessageTransport const& other) = delete;
+    MessageTransport(MessageTransport&& other) noexcept = delete;
+    MessageTransport& operator=(MessageTransport const& other) = delete;
+    MessageTransport& operator=(MessageTransport&& other) noexcept = delete;
+    virtual ~MessageTransport() = default;
+
+    // Never blocks. Messages that cannot be sent (e.g. because the connection has been closed) are dropped.
+    virtual void send(c2k::MessageBuffer const& buffer) = 0;
+
+    // Returns all messages that have arrived since the last call. Never blocks.
+    [[nodiscard]] virtual std::deque<std::unique_ptr<AbstractMessage>> take_received_messages() = 0;
+};
+
+// Receives the messages on a thread of its own, since reading from a socket blocks.
+class SocketTransport final : public MessageTransport {
+private:
+    c2k::ClientSocket m_socket;
+    c2k::Synchronized<std::deque<std::unique_ptr<AbstractMessage>>> m_received_messages{ {} };
+    std::jthread m_receiving_thread;  // Declared last, since it accesses the other members.
+
+public:
+    explicit SocketTransport(c2k::ClientSocket socket);
+
+    void send(c2k::MessageBuffer const& buffer) override;
+    [[nodiscard]] std::deque<std::unique_ptr<AbstractMessage>> take_received_messages() override;
+
+private:
+    void keep_receiving(std::stop_token const& stop_token);
+};
@@ -9,4 +9,12 @@ enum class MessageType : std::uint8_t {
     GameStart,
     StateBroadcast,
     ClientDisconnected,
+    RedundantHeartbeat,
+    RedundantStateBroadcast,
+    SnapshotSubscription,
+    SnapshotBroadcast,
+    Reconnect,
+    MatchSnapshot,
+    TetrionSnapshot,
+    ClientReconnected,
 };
@@ -3,6 +3,7 @@
 #include <spdlog/spdlog.h>
 #include <array>
 #include <memory>
+#include <simulator/garbage.hpp>
 #include <simulator/input.hpp>
 #include <simulator/key_state.hpp>
 #include <simulator/matrix.hpp>
@@ -43,6 +44,13 @@ struct AbstractMessage {
     );
     // clang-format on
 
+    // Parses a message that has been received as a single datagram. Only the message types that are meant to
+    // be sent via UDP are accepted.
+    [[nodiscard]] static std::unique_ptr<AbstractMessage> from_datagram(c2k::MessageBuffer& buffer);
+
+    // Parses a buffer that contains exactly one serialized message of any type.
+    [[nodiscard]] static std::unique_ptr<AbstractMessage> from_buffer(c2k::MessageBuffer& buffer);
+
 private:
     [[nodiscard]] virtual bool equals(AbstractMessage const& other) const = 0;
 };
@@ -66,18 +74,33 @@ struct Connect final : AbstractMessage {
     [[nodiscard]] bool equals(AbstractMessage const& other) const override;
 };
 
+// Hash of the simulation state of a tetrion (see ObpfTetrion::state_hash()) before the given frame is simulated.
+// A frame of 0 means that no hash is available.
+struct StateHash final {
+    std::uint64_t frame = 0;
+    std::uint64_t hash = 0;
+
+    [[nodiscard]] bool operator==(StateHash const& other) const = default;
+};
+
 struct Heartbeat final : AbstractMessage {
 public:
     std::uint64_t frame;
     std::array<KeyState, heartbeat_interval> key_states;
+    StateHash state_hash;  // Of the client's own tetrion, as simulated using the latest broadcast.
 
 private:
-    static constexpr auto precalculated_payload_size =
-        sizeof(frame) + std::tuple_size_v<decltype(key_states)> * sizeof(KeyState);
+    static constexpr auto precalculated_payload_size = sizeof(frame)
+                                                       + std::tuple_size_v<decltype(key_states)> * sizeof(KeyState)
+                                                       + sizeof(StateHash::frame) + sizeof(StateHash::hash);
 
 public:
-    Heartbeat(std::uint64_t const frame, std::array<KeyState, heartbeat_interval> const key_states)
-        : frame{ frame }, key_states{ key_states } {}
+    Heartbeat(
+        std::uint64_t const frame,
+        std::array<KeyState, heartbeat_interval> const key_states,
+        StateHash const state_hash = {}
+    )
+        : frame{ frame }, key_states{ key_states }, state_hash{ state_hash } {}
 
     [[nodiscard]] MessageType type() const override;
 
@@ -95,7 +118,8 @@ public:
 private:
     [[nodiscard]] bool equals(AbstractMessage const& other) const override {
         auto const& other_heartbeat = static_cast<decltype(*this)&>(other);
-        return std::tie(frame, key_states) == std::tie(other_heartbeat.frame, other_heartbeat.key_states);
+        return std::tie(frame, key_states, state_hash)
+               == std::tie(other_heartbeat.frame, other_heartbeat.key_states, other_heartbeat.state_hash);
     }
 };
 
@@ -250,3 +274,252 @@ struct ClientDisconnected final : AbstractMessage {
 private:
     [[nodiscard]] bool equals(AbstractMessage const& other) const override;
 };
+
+// Replaces Heartbeat messages when using UDP. Each datagram repeats all input windows that have not been
+// acknowledged by the server yet, so that a lost datagram is compensated by the next one.
+struct RedundantHeartbeat final : AbstractMessage {
+    u8 client_id;
+    std::uint64_t acknowledged_until_frame;  // All StateBroadcasts for frames before this one have been received.
+    std::vector<Heartbeat> heartbeats;       // Consecutive windows in ascending order.
+
+    RedundantHeartbeat(u8 client_id, std::uint64_t acknowledged_until_frame, std::vector<Heartbeat> heartbeats);
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static RedundantHeartbeat deserialize(c2k::MessageBuffer& buffer);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return calculate_payload_size(max_redundant_windows);
+    }
+
+private:
+    // clang-format off
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) calculate_payload_size(
+        std::size_t const num_windows
+    ) {  // clang-format on
+        return gsl::narrow<decltype(MessageHeader::payload_size)>(
+            sizeof(client_id) + sizeof(acknowledged_until_frame) + sizeof(std::uint8_t) /* num windows */
+            + num_windows * Heartbeat::max_payload_size()
+        );
+    }
+
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        auto const& other_heartbeat = static_cast<decltype(*this)&>(other);
+        return std::tie(client_id, acknowledged_until_frame, heartbeats)
+               == std::tie(
+                   other_heartbeat.client_id,
+                   other_heartbeat.acknowledged_until_frame,
+                   other_heartbeat.heartbeats
+               );
+    }
+};
+
+// Replaces StateBroadcast messages when using UDP. Contains all broadcasts that have not been acknowledged
+// by the receiving client yet.
+struct RedundantStateBroadcast final : AbstractMessage {
+    std::uint64_t acknowledged_until_frame;  // All key states of the receiver before this frame have been received.
+    std::vector<StateBroadcast> broadcasts;  // Consecutive windows in ascending order.
+
+    RedundantStateBroadcast(std::uint64_t acknowledged_until_frame, std::vector<StateBroadcast> broadcasts);
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static RedundantStateBroadcast deserialize(c2k::MessageBuffer& buffer);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return gsl::narrow<decltype(MessageHeader::payload_size)>(
+            sizeof(acknowledged_until_frame) + sizeof(std::uint8_t) /* num windows */
+            + max_redundant_windows * StateBroadcast::max_payload_size()
+        );
+    }
+
+private:
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        auto const& other_broadcast = static_cast<decltype(*this)&>(other);
+        return std::tie(acknowledged_until_frame, broadcasts)
+               == std::tie(other_broadcast.acknowledged_until_frame, other_broadcast.broadcasts);
+    }
+};
+
+// Sent by clients that don't want to simulate the other tetrions themselves (e.g. because they are running on a
+// mobile device). From then on, the server sends SnapshotBroadcast messages instead of StateBroadcast messages to
+// this client.
+struct SnapshotSubscription final : AbstractMessage {
+    u8 interval;  // Number of windows between two board snapshots, at least 1.
+
+    explicit SnapshotSubscription(u8 interval);
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static SnapshotSubscription deserialize(c2k::MessageBuffer& buffer);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return sizeof(interval);
+    }
+
+private:
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        auto const& other_subscription = static_cast<decltype(*this)&>(other);
+        return interval == other_subscription.interval;
+    }
+};
+
+// Replaces StateBroadcast messages for clients with a SnapshotSubscription. It only contains the key states and
+// the received garbage of the receiving client, so that it can keep its own confirmed state in sync. The boards of
+// the other clients (as simulated by the server) are only contained every few windows.
+struct SnapshotBroadcast final : AbstractMessage {
+    struct BoardSnapshot final {
+        u8 client_id = 0;
+        bool is_game_over = false;
+        Matrix matrix;
+
+        [[nodiscard]] bool operator==(BoardSnapshot const&) const = default;
+
+        // Two minos are packed into each byte.
+        [[nodiscard]] static constexpr std::size_t size_in_bytes() {
+            return sizeof(client_id) + sizeof(std::uint8_t) + (Matrix::width * Matrix::height + 1) / 2;
+        }
+    };
+
+    static constexpr auto garbage_event_size_in_bytes = sizeof(GarbageSendEvent::frame)
+                                                        + sizeof(GarbageSendEvent::num_lines);
+
+    std::uint64_t frame;
+    std::array<KeyState, heartbeat_interval> key_states;
+    std::vector<GarbageSendEvent> received_garbage;
+    std::vector<BoardSnapshot> boards;  // Empty if no snapshots are due for this window.
+
+    SnapshotBroadcast(
+        std::uint64_t frame,
+        std::array<KeyState, heartbeat_interval> const& key_states,
+        std::vector<GarbageSendEvent> received_garbage,
+        std::vector<BoardSnapshot> boards
+    );
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static SnapshotBroadcast deserialize(c2k::MessageBuffer& buffer);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        constexpr auto max_count = std::numeric_limits<std::uint8_t>::max();
+        return calculate_payload_size(max_count, max_count);
+    }
+
+private:
+    // clang-format off
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) calculate_payload_size(
+        std::size_t const num_garbage_events,
+        std::size_t const num_boards
+    ) {  // clang-format on
+        return gsl::narrow<decltype(MessageHeader::payload_size)>(
+            sizeof(frame) + heartbeat_interval * sizeof(KeyState) + sizeof(std::uint8_t) /* num garbage events */
+            + num_garbage_events * garbage_event_size_in_bytes + sizeof(std::uint8_t) /* num boards */
+            + num_boards * BoardSnapshot::size_in_bytes()
+        );
+    }
+
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override;
+};
+
+// Sent instead of Connect by a client that lost its connection during a match.
+struct Reconnect final : AbstractMessage {
+    u8 client_id;
+    std::string player_name;  // Has to match the name that was used to connect initially.
+
+    Reconnect(u8 client_id, std::string_view player_name);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return static_cast<decltype(MessageHeader::payload_size)>(sizeof(client_id) + player_name_buffer_size);
+    }
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static Reconnect deserialize(c2k::MessageBuffer& buffer);
+
+private:
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        auto const& other_reconnect = static_cast<decltype(*this)&>(other);
+        return std::tie(client_id, player_name) == std::tie(other_reconnect.client_id, other_reconnect.player_name);
+    }
+};
+
+// Answer to a Reconnect message. It is immediately followed by one TetrionSnapshot message per player
+// (including the reconnecting one).
+struct MatchSnapshot final : AbstractMessage {
+    u8 client_id;
+    std::uint64_t frame;  // The next frame to be simulated, i.e. the first frame of the next window.
+    u8 num_players;
+
+    MatchSnapshot(u8 const client_id, std::uint64_t const frame, u8 const num_players)
+        : client_id{ client_id }, frame{ frame }, num_players{ num_players } {}
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return sizeof(client_id) + sizeof(frame) + sizeof(num_players);
+    }
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static MatchSnapshot deserialize(c2k::MessageBuffer& buffer);
+
+private:
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        auto const& other_snapshot = static_cast<decltype(*this)&>(other);
+        return std::tie(client_id, frame, num_players)
+               == std::tie(other_snapshot.client_id, other_snapshot.frame, other_snapshot.num_players);
+    }
+};
+
+struct TetrionSnapshot final : AbstractMessage {
+    static constexpr auto max_snapshot_size = usize{ 8192 };
+
+    u8 client_id;
+    bool is_connected;
+    std::vector<u8> snapshot;  // See ObpfTetrion::save_snapshot().
+
+    TetrionSnapshot(u8 client_id, bool is_connected, std::vector<u8> snapshot);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return static_cast<decltype(MessageHeader::payload_size)>(
+            sizeof(client_id) + sizeof(std::uint8_t) /* is connected */ + max_snapshot_size
+        );
+    }
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static TetrionSnapshot deserialize(c2k::MessageBuffer& buffer);
+
+private:
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        auto const& other_snapshot = static_cast<decltype(*this)&>(other);
+        return std::tie(client_id, is_connected, snapshot)
+               == std::tie(other_snapshot.client_id, other_snapshot.is_connected, other_snapshot.snapshot);
+    }
+};
+
+struct ClientReconnected final : AbstractMessage {
+    u8 client_id;
+
+    explicit ClientReconnected(u8 const client_id)
+        : client_id{ client_id } {}
+
+    [[nodiscard]] MessageType type() const override;
+    [[nodiscard]] decltype(MessageHeader::payload_size) payload_size() const override;
+    [[nodiscard]] c2k::MessageBuffer serialize() const override;
+    [[nodiscard]] static ClientReconnected deserialize(c2k::MessageBuffer& buffer);
+
+    [[nodiscard]] static constexpr decltype(MessageHeader::payload_size) max_payload_size() {
+        return sizeof(client_id);
+    }
+
+private:
+    [[nodiscard]] bool equals(AbstractMessage const& other) const override {
+        return client_id == static_cast<decltype(*this)&>(other).client_id;
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <lib2k/types.hpp>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include "message_transport.hpp"
+
+// Properties of one direction of a simulated connection. Connections are reliable and ordered like TCP: a lost
+// message is delivered after a retransmission timeout, and messages that have been delayed by jitter (or losses) hold
+// up the ones sent after them.
+struct LinkModel final {
+    std::chrono::microseconds latency{ 0 };  // One-way.
+    std::chrono::microseconds jitter{ 0 };   // Maximum random delay on top of the latency (uniformly distributed).
+    double loss = 0.0;                       // Probability that a transmission is lost, less than 1.
+    std::chrono::microseconds retransmission_timeout{ 200'000 };
+    u64 bytes_per_second = 0;  // 0 means unlimited. Messages queue up behind each other if the link is busy.
+};
+
+struct LinkStatistics final {
+    u64 num_messages = 0;
+    u64 num_bytes = 0;
+    u64 num_retransmissions = 0;
+    std::chrono::nanoseconds total_delay{ 0 };  // From sending until delivery, summed over all messages.
+    std::chrono::nanoseconds max_delay{ 0 };
+};
+
+class SimulatedNetwork;
+
+// One end of a connection within a SimulatedNetwork. Must not outlive the network.
+class SimulatedConnection final : public MessageTransport {
+    friend class SimulatedNetwork;
+
+private:
+    struct Link final {
+        LinkModel model;
+        std::chrono::nanoseconds busy_until{ 0 };
+        std::chrono::nanoseconds last_arrival{ 0 };
+        LinkStatistics statistics;
+        std::deque<std::unique_ptr<AbstractMessage>> delivered_messages;
+    };
+
+    SimulatedNetwork* m_network;
+    // Shared with the network (for messages in flight) and the other end of the connection.
+    std::shared_ptr<Link> m_outgoing;
+    std::shared_ptr<Link> m_incoming;
+
+    struct Key {};
+
+public:
+    SimulatedConnection(SimulatedNetwork& network, std::shared_ptr<Link> outgoing, std::shared_ptr<Link> incoming, Key)
+        : m_network{ &network }, m_outgoing{ std::move(outgoing) }, m_incoming{ std::move(incoming) } { }
+
+    void send(c2k::MessageBuffer const& buffer) override;
+    [[nodiscard]] std::deque<std::unique_ptr<AbstractMessage>> take_received_messages() override;
+
+    [[nodiscard]] LinkStatistics const& outgoing_statistics() const {
+        return m_outgoing->statistics;
+    }
+};
+
+// Delivers messages between in-process connections according to their link models. Time only passes when the network
+// is advanced, so whole matches can be simulated faster than real time. Given the same seed and the same sequence of
+// calls, the network behaves exactly the same. Not thread-safe.
+class SimulatedNetwork final {
+    friend class SimulatedConnection;
+
+private:
+    struct InFlightMessage final {
+        std::shared_ptr<SimulatedConnection::Link> link;
+        c2k::MessageBuffer buffer;
+    };
+
+    std::mt19937_64 m_random;
+    std::chrono::nanoseconds m_now{ 0 };
+    u64 m_num_messages_sent = 0;
+    // Ordered by arrival time. The sequence number keeps messages that arrive at the same time in sending order.
+    std::map<std::pair<std::chrono::nanoseconds, u64>, InFlightMessage> m_in_flight;
+
+public:
+    explicit SimulatedNetwork(u64 const seed) : m_random{ seed } { }
+
+    // Time that has passed since the creation of the network.
+    [[nodiscard]] std::chrono::nanoseconds now() const {
+        return m_now;
+    }
+
+    // Returns both ends of the new connection. The first one sends along the first link model.
+    [[nodiscard]] std::pair<std::unique_ptr<SimulatedConnection>, std::unique_ptr<SimulatedConnection>> connect(
+        LinkModel const& forward,
+        LinkModel const& backward
+    );
+
+    // Delivers all messages that arrive within the given duration. Throws a MessageDeserializationError if a message
+    // cannot be parsed.
+    void advance(std::chrono::nanoseconds duration);
+
+private:
+    void send(std::shared_ptr<SimulatedConnection::Link> const& link, c2k::MessageBuffer buffer);
+};
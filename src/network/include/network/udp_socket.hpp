@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <lib2k/types.hpp>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sockets/sockets.hpp>
+#include <stdexcept>
+#include <string>
+
+class UdpSocketError final : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+struct UdpEndpoint final {
+    std::array<u8, 4> address{};  // IPv4 address, most significant byte first
+    std::uint16_t port = 0;
+
+    [[nodiscard]] static UdpEndpoint resolve(std::string const& host, std::uint16_t port);
+
+    [[nodiscard]] bool operator==(UdpEndpoint const& other) const = default;
+};
+
+struct Datagram final {
+    UdpEndpoint sender;
+    c2k::MessageBuffer buffer;
+};
+
+// Minimal IPv4 datagram socket. The sockets library we use for everything else only supports TCP, but
+// the gameplay traffic can optionally be sent via UDP to avoid head-of-line blocking.
+class UdpSocket final {
+public:
+    static constexpr auto max_datagram_size = usize{ 65'507 };
+
+private:
+    std::uintptr_t m_handle;
+    std::uint16_t m_local_port = 0;
+
+    // Used to simulate an unreliable network on loopback. Only affects outgoing datagrams.
+    std::mutex m_packet_loss_mutex;
+    double m_simulated_packet_loss = 0.0;
+    std::mt19937_64 m_packet_loss_random;
+
+public:
+    explicit UdpSocket(std::uint16_t port = 0);
+    UdpSocket(UdpSocket const& other) = delete;
+    UdpSocket(UdpSocket&& other) noexcept = delete;
+    UdpSocket& operator=(UdpSocket const& other) = delete;
+    UdpSocket& operator=(UdpSocket&& other) noexcept = delete;
+    ~UdpSocket();
+
+    [[nodiscard]] std::uint16_t local_port() const {
+        return m_local_port;
+    }
+
+    // Drops the given fraction of all outgoing datagrams (deterministically for a given seed).
+    void simulate_packet_loss(double probability, u64 seed);
+
+    void send_to(UdpEndpoint const& receiver, c2k::MessageBuffer const& buffer);
+
+    // Returns std::nullopt if no datagram arrived within the given time.
+    [[nodiscard]] std::optional<Datagram> receive(std::chrono::milliseconds timeout);
+};
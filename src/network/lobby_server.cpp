@@ -1,83 +1,58 @@
 #include <spdlog/spdlog.h>
-#include <crapper/crapper.hpp>
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <network/lobby_protocol.hpp>
 #include <network/lobby_server.hpp>
 
-struct Credentials final {
-    std::string username;
-    std::string password;
-};
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Credentials, username, password);
-
-struct LoginResponse final {
-    std::string jwt;
-};
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LoginResponse, jwt);
-
-struct LobbyCreationResponse final {
-    std::string id;
-};
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LobbyCreationResponse, id);
-
-struct StartResponse final {
-    std::uint16_t port;
-};
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(StartResponse, port);
-
-struct SetClientReadyResponse final {
-    std::uint16_t port;
-};
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SetClientReadyResponse, port);
-
-struct HostInfo final {
-    std::string id;
-    std::string name;
-};
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(HostInfo, id, name);
-
-struct LobbyDetailsResponse final {
-    std::string name;
-    std::uint16_t size{};
-    HostInfo host_info;
-    std::vector<ClientPlayerInfo> player_infos;
-    std::optional<std::uint16_t> gameserver_port;
-};
+static void apply_delta(LobbyList& lobby_list, LobbyListUpdate&& update) {
+    std::erase_if(lobby_list.lobbies, [&update](LobbyInfo const& lobby) {
+        return std::ranges::find(update.removed, lobby.id) != update.removed.cend();
+    });
+    for (auto& changed : update.lobbies) {
+        auto const it = std::ranges::find(lobby_list.lobbies, changed.id, &LobbyInfo::id);
+        if (it == lobby_list.lobbies.end()) {
+            lobby_list.lobbies.push_back(std::move(changed));
+        } else {
+            *it = std::move(changed);
+        }
+    }
+}
 
-void to_json(nlohmann::json& json, LobbyDetailsResponse const& response) {
-    json = nlohmann::json{
-        {         "name",         response.name },
-        {         "size",         response.size },
-        {    "host_info",    response.host_info },
-        { "player_infos", response.player_infos },
+[[nodiscard]] static HttpRequest create_request(
+    std::string method,
+    std::string_view const path,
+    std::string_view const auth_token = {}
+) {
+    auto request = HttpRequest{
+        .method = std::move(method),
+        .path = path.starts_with('/') ? std::string{ path } : std::format("/{}", path),
+        .headers = {},
+        .body = {},
     };
-    if (response.gameserver_port.has_value()) {
-        json["gameserver_port"] = response.gameserver_port.value();
+    if (not auth_token.empty()) {
+        request.headers.emplace_back("Authorization", std::format("Bearer {}", auth_token));
     }
+    return request;
 }
 
-void from_json(nlohmann::json const& json, LobbyDetailsResponse& response) {
-    json.at("name").get_to(response.name);
-    json.at("size").get_to(response.size);
-    json.at("host_info").get_to(response.host_info);
-    json.at("player_infos").get_to(response.player_infos);
-    if (json.contains("gameserver_port")) {
-        response.gameserver_port = std::uint16_t{};
-        json.at("gameserver_port").get_to(response.gameserver_port.value());
-    } else {
-        response.gameserver_port = std::nullopt;
-    }
+template<typename Payload>
+[[nodiscard]] static HttpRequest create_json_request(
+    std::string method,
+    std::string_view const path,
+    Payload const& payload,
+    std::string_view const auth_token = {}
+) {
+    auto request = create_request(std::move(method), path, auth_token);
+    request.headers.emplace_back("Content-Type", "application/json");
+    request.body = nlohmann::json(payload).dump();
+    return request;
 }
 
 template<typename Deserialized>
-[[nodiscard]] static std::optional<Deserialized> deserialize(Response const& response) {
+[[nodiscard]] static std::optional<Deserialized> deserialize(HttpResponse const& response) {
     try {
-        return nlohmann::json::parse(response.body()).get<Deserialized>();
+        return nlohmann::json::parse(response.body).get<Deserialized>();
     } catch (nlohmann::json::parse_error const& exception) {
         spdlog::error("invalid JSON in response to HTTP request: {}", exception.what());
     } catch (nlohmann::json::out_of_range const& exception) {
@@ -94,23 +69,31 @@ template<typename Deserialized>
     std::string username,
     std::string password
 ) {
-    auto const response =
-        Crapper{}.post(endpoint("register")).json(Credentials{ username, password }).send();
-    if (response.status() != HttpStatusCode::NoContent) {
+    // The login is pipelined with the registration to save a round trip. If the registration fails, the response to
+    // the login is ignored.
+    auto const credentials = Credentials{ std::move(username), std::move(password) };
+    auto const requests = std::array{
+        create_json_request("POST", "register", credentials),
+        create_json_request("POST", "login", credentials),
+    };
+    auto const responses = m_connection.send_all(requests);
+    if (responses.at(0).status != HttpStatus::NoContent or responses.at(1).status != HttpStatus::Ok) {
+        return std::nullopt;
+    }
+    auto login_response = deserialize<LoginResponse>(responses.at(1));
+    if (not login_response.has_value()) {
         return std::nullopt;
     }
-    return authenticate(std::move(username), std::move(password));
+    return User{ std::move(login_response).value().jwt };
 }
 
 [[nodiscard]] std::optional<User> LobbyServerConnection::authenticate(
     std::string username,
     std::string password
 ) {
-    auto const response = Crapper{}
-                              .post(endpoint("login"))
-                              .json(Credentials{ std::move(username), std::move(password) })
-                              .send();
-    if (response.status() != HttpStatusCode::Ok) {
+    auto const credentials = Credentials{ std::move(username), std::move(password) };
+    auto const response = m_connection.send(create_json_request("POST", "login", credentials));
+    if (response.status != HttpStatus::Ok) {
         return std::nullopt;
     }
     auto login_response = deserialize<LoginResponse>(response);
@@ -121,10 +104,7 @@ template<typename Deserialized>
 }
 
 void LobbyServerConnection::unregister(User& user) {
-    std::ignore = Crapper{}
-                      .post(endpoint("unregister"))
-                      .header(HeaderKey::Authorization, std::format("Bearer {}", user.m_token))
-                      .send();
+    std::ignore = m_connection.send(create_request("POST", "unregister", user.m_token));
     user.m_token.clear();
 }
 
@@ -135,16 +115,11 @@ void LobbyServerConnection::unregister(User& user) {
     if (not user.is_logged_in()) {
         return tl::unexpected{ LobbyCreationError::NotLoggedIn };
     }
-    auto const response =
-        Crapper{}
-            .post(endpoint("lobbies"))
-            .header(HeaderKey::Authorization, std::format("Bearer {}", user.auth_token()))
-            .json(settings)
-            .send();
-    if (response.status() == HttpStatusCode::BadRequest) {
+    auto const response = m_connection.send(create_json_request("POST", "lobbies", settings, user.auth_token()));
+    if (response.status == HttpStatus::BadRequest) {
         return tl::unexpected{ LobbyCreationError::AlreadyJoined };
     }
-    if (response.status() != HttpStatusCode::Created) {
+    if (response.status != HttpStatus::Created) {
         return tl::unexpected{ LobbyCreationError::Unknown };
     }
     auto lobby_creation_response = deserialize<LobbyCreationResponse>(response);
@@ -162,21 +137,18 @@ void LobbyServerConnection::unregister(User& user) {
         return tl::unexpected{ GameStartError::NotLoggedIn };
     }
     auto const response =
-        Crapper{}
-            .post(endpoint(std::format("lobbies/{}/start", lobby.id)))
-            .header(HeaderKey::Authorization, std::format("Bearer {}", user.auth_token()))
-            .send();
-    switch (response.status()) {
-        case HttpStatusCode::NotFound:
+        m_connection.send(create_request("POST", std::format("lobbies/{}/start", lobby.id), user.auth_token()));
+    switch (response.status) {
+        case HttpStatus::NotFound:
             return tl::unexpected{ GameStartError::LobbyNotFound };
-        case HttpStatusCode::Forbidden:
+        case HttpStatus::Forbidden:
             return tl::unexpected{ GameStartError::IsNotHost };
-        case HttpStatusCode::BadRequest:
+        case HttpStatus::BadRequest:
             return tl::unexpected{ GameStartError::AlreadyRunning };
-        case HttpStatusCode::TooEarly:
+        case HttpStatus::TooEarly:
             return tl::unexpected{ GameStartError::NotAllPlayersReady };
         default:
-            if (response.status() != HttpStatusCode::Ok) {
+            if (response.status != HttpStatus::Ok) {
                 return tl::unexpected{ GameStartError::Unknown };
             }
     }
@@ -188,12 +160,31 @@ void LobbyServerConnection::unregister(User& user) {
 }
 
 [[nodiscard]] LobbyList LobbyServerConnection::lobbies() {
-    auto const response = Crapper{}.get(endpoint("lobbies")).send();
-    if (response.status() != HttpStatusCode::Ok) {
+    auto const lock = std::scoped_lock{ m_lobby_list_mutex };
+    auto request = create_request(
+        "GET",
+        m_lobby_list_revision.has_value() ? std::format("lobbies?since={}", m_lobby_list_revision.value()) : "lobbies"
+    );
+    if (not m_lobby_list_etag.empty()) {
+        request.headers.emplace_back("If-None-Match", m_lobby_list_etag);
+    }
+    auto const response = m_connection.send(request);
+    if (response.status == HttpStatus::NotModified) {
+        return m_lobby_list;
+    }
+    if (response.status != HttpStatus::Ok) {
         throw std::runtime_error{ "internal lobby error" };
     }
 
-    return nlohmann::json::parse(response.body()).get<LobbyList>();
+    auto update = nlohmann::json::parse(response.body).get<LobbyListUpdate>();
+    m_lobby_list_revision = update.revision;
+    if (update.is_delta) {
+        apply_delta(m_lobby_list, std::move(update));
+    } else {
+        m_lobby_list.lobbies = std::move(update.lobbies);
+    }
+    m_lobby_list_etag = std::string{ response.header("etag").value_or("") };
+    return m_lobby_list;
 }
 
 [[nodiscard]] tl::expected<void, LobbyDestructionError> LobbyServerConnection::destroy_lobby(
@@ -204,16 +195,13 @@ void LobbyServerConnection::unregister(User& user) {
         return tl::unexpected{ LobbyDestructionError::NotLoggedIn };
     }
     auto const response =
-        Crapper{}
-            .delete_(endpoint(std::format("lobbies/{}", lobby.id)))
-            .header(HeaderKey::Authorization, std::format("Bearer {}", user.auth_token()))
-            .send();
-    switch (response.status()) {
-        case HttpStatusCode::NoContent:
+        m_connection.send(create_request("DELETE", std::format("lobbies/{}", lobby.id), user.auth_token()));
+    switch (response.status) {
+        case HttpStatus::NoContent:
             return {};
-        case HttpStatusCode::NotFound:
+        case HttpStatus::NotFound:
             return tl::unexpected{ LobbyDestructionError::LobbyNotFound };
-        case HttpStatusCode::Forbidden:
+        case HttpStatus::Forbidden:
             return tl::unexpected{ LobbyDestructionError::IsNotHost };
         default:
             return tl::unexpected{ LobbyDestructionError::Unknown };
@@ -233,18 +221,15 @@ void LobbyServerConnection::unregister(User& user) {
     std::cerr << "user is logged in\n";
     std::cerr << "lobby id is: " << lobby_info.id << '\n';
     auto const response =
-        Crapper{}
-            .post(endpoint(std::format("lobbies/{}", lobby_info.id)))
-            .header(HeaderKey::Authorization, std::format("Bearer {}", user.auth_token()))
-            .send();
-    std::cerr << "received response, status: " << std::to_underlying(response.status()) << '\n';
-    if (response.status() == HttpStatusCode::NotFound) {
+        m_connection.send(create_request("POST", std::format("lobbies/{}", lobby_info.id), user.auth_token()));
+    std::cerr << "received response, status: " << std::to_underlying(response.status) << '\n';
+    if (response.status == HttpStatus::NotFound) {
         return tl::unexpected{ LobbyJoinError::LobbyNotFound };
     }
-    if (response.status() == HttpStatusCode::BadRequest) {
+    if (response.status == HttpStatus::BadRequest) {
         return tl::unexpected{ LobbyJoinError::LobbyFullOrAlreadyJoined };
     }
-    if (response.status() == HttpStatusCode::NoContent) {
+    if (response.status == HttpStatus::NoContent) {
         return Lobby{ lobby_info.id };
     }
     return tl::unexpected{ LobbyJoinError::Unknown };
@@ -258,20 +243,17 @@ void LobbyServerConnection::unregister(User& user) {
         return tl::unexpected{ SetClientReadyError::NotLoggedIn };
     }
     auto const response =
-        Crapper{}
-            .post(endpoint(std::format("lobby/{}/ready", lobby.id)))
-            .header(HeaderKey::Authorization, std::format("Bearer {}", user.auth_token()))
-            .send();
-    if (response.status() == HttpStatusCode::NotFound) {
+        m_connection.send(create_request("POST", std::format("lobby/{}/ready", lobby.id), user.auth_token()));
+    if (response.status == HttpStatus::NotFound) {
         return tl::unexpected{ SetClientReadyError::LobbyNotFoundOrClosed };
     }
 
-    if (response.status() == HttpStatusCode::Forbidden) {
+    if (response.status == HttpStatus::Forbidden) {
         return tl::unexpected{ SetClientReadyError::NotInsideLobby };
     }
 
-    if (response.status() == HttpStatusCode::Ok) {
-        return TcpPort{ nlohmann::json::parse(response.body()).get<SetClientReadyResponse>().port };
+    if (response.status == HttpStatus::Ok) {
+        return TcpPort{ nlohmann::json::parse(response.body).get<SetClientReadyResponse>().port };
     }
 
     return tl::unexpected{ SetClientReadyError::Unknown };
@@ -285,16 +267,13 @@ tl::expected<LobbyDetails, LobbyDetailsError> LobbyServerConnection::lobby_detai
         return tl::unexpected{ LobbyDetailsError::NotLoggedIn };
     }
     auto const response =
-        Crapper{}
-            .get(endpoint(std::format("lobbies/{}", lobby_info.id)))
-            .header(HeaderKey::Authorization, std::format("Bearer {}", user.auth_token()))
-            .send();
-    if (response.status() == HttpStatusCode::NotFound) {
+        m_connection.send(create_request("GET", std::format("lobbies/{}", lobby_info.id), user.auth_token()));
+    if (response.status == HttpStatus::NotFound) {
         return tl::unexpected{ LobbyDetailsError::LobbyNotFoundOrClosed };
     }
 
-    std::cerr << response.body() << '\n';
-    auto data = nlohmann::json::parse(response.body()).get<LobbyDetailsResponse>();
+    std::cerr << response.body << '\n';
+    auto data = nlohmann::json::parse(response.body).get<LobbyDetailsResponse>();
     return LobbyDetails{
         lobby_info.id,
         std::move(data.name),
@@ -0,0 +1,33 @@
+#include <spdlog/spdlog.h>
+#include <network/match_starter.hpp>
+
+MatchStarter::MatchStarter(std::uint16_t const port)
+    : m_server_socket{ c2k::Sockets::create_server(c2k::AddressFamily::Ipv4, port, [this](c2k::ClientSocket socket) {
+          spdlog::info("game server supervisor connected");
+          auto const lock = std::scoped_lock{ m_mutex };
+          m_supervisors.push_back(std::move(socket));
+      }) } { }
+
+[[nodiscard]] std::optional<std::uint16_t> MatchStarter::start_match(std::uint16_t const num_players) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    while (not m_supervisors.empty()) {
+        auto supervisor = std::move(m_supervisors.front());
+        m_supervisors.pop_front();
+        try {
+            if (supervisor.send(num_players).get() != sizeof(num_players)) {
+                throw c2k::SendError{ "unable to send the number of players" };
+            }
+            auto const port = supervisor.receive<std::uint16_t>().get();
+            m_supervisors.push_back(std::move(supervisor));
+            if (port == 0) {
+                return std::nullopt;
+            }
+            return port;
+        } catch (std::exception const& exception) {
+            // The supervisor is dropped, the next one gets a chance.
+            spdlog::warn("lost connection to game server supervisor: {}", exception.what());
+        }
+    }
+    spdlog::error("unable to start match: no game server supervisor is connected");
+    return std::nullopt;
+}
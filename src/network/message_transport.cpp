@@ -0,0 +1,37 @@
+#include <spdlog/spdlog.h>
+#include <magic_enum.hpp>
+#include <network/message_transport.hpp>
+#include <simulator/trace.hpp>
+
+SocketTransport::SocketTransport(c2k::ClientSocket socket)
+    : m_socket{ std::move(socket) },
+      m_receiving_thread{ [this](std::stop_token const& stop_token) { keep_receiving(stop_token); } } { }
+
+void SocketTransport::send(c2k::MessageBuffer const& buffer) {
+    // don't wait blocking for the send to complete
+    std::ignore = m_socket.send(buffer);
+}
+
+[[nodiscard]] std::deque<std::unique_ptr<AbstractMessage>> SocketTransport::take_received_messages() {
+    return m_received_messages.apply([](std::deque<std::unique_ptr<AbstractMessage>>& messages) {
+        return std::exchange(messages, {});
+    });
+}
+
+void SocketTransport::keep_receiving(std::stop_token const& stop_token) {
+    OBPF_TRACE_THREAD_NAME("receiving");
+    while (not stop_token.stop_requested()) {
+        try {
+            auto message = AbstractMessage::from_socket(m_socket);
+            SPDLOG_TRACE("queueing message of type {}", magic_enum::enum_name(message->type()));
+            m_received_messages.apply([&message](std::deque<std::unique_ptr<AbstractMessage>>& messages) {
+                messages.push_back(std::move(message));
+            });
+        } catch (c2k::TimeoutError const&) {
+            // swallow exception because this is expected
+        } catch (c2k::ReadError const& exception) {
+            spdlog::error("error while reading from socket: {}", exception.what());
+            break;
+        }
+    }
+}
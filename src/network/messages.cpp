@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <chrono>
 #include <limits>
 #include <network/messages.hpp>
+#include <simulator/trace.hpp>
 #include <unordered_set>
 #include "network/constants.hpp"
 #include "network/message_header.hpp"
@@ -10,6 +12,83 @@
 [[maybe_unused]] static constexpr auto header_size =
     sizeof(std::underlying_type_t<MessageType>) + sizeof(MessageHeader::payload_size);
 
+[[nodiscard]] static decltype(MessageHeader::payload_size) max_payload_size_of(MessageType const message_type) {
+    switch (message_type) {
+        case MessageType::Connect:
+            return Connect::max_payload_size();
+        case MessageType::Heartbeat:
+            return Heartbeat::max_payload_size();
+        case MessageType::GridState:
+            return GridState::max_payload_size();
+        case MessageType::GameStart:
+            return GameStart::max_payload_size();
+        case MessageType::StateBroadcast:
+            return StateBroadcast::max_payload_size();
+        case MessageType::ClientDisconnected:
+            return ClientDisconnected::max_payload_size();
+        case MessageType::RedundantHeartbeat:
+            return RedundantHeartbeat::max_payload_size();
+        case MessageType::RedundantStateBroadcast:
+            return RedundantStateBroadcast::max_payload_size();
+        case MessageType::SnapshotSubscription:
+            return SnapshotSubscription::max_payload_size();
+        case MessageType::SnapshotBroadcast:
+            return SnapshotBroadcast::max_payload_size();
+        case MessageType::Reconnect:
+            return Reconnect::max_payload_size();
+        case MessageType::MatchSnapshot:
+            return MatchSnapshot::max_payload_size();
+        case MessageType::TetrionSnapshot:
+            return TetrionSnapshot::max_payload_size();
+        case MessageType::ClientReconnected:
+            return ClientReconnected::max_payload_size();
+            // todo: add case for custom messages
+    }
+    throw MessageDeserializationError{ std::format("{} is an unknown message type", static_cast<int>(message_type)) };
+}
+
+// clang-format off
+[[nodiscard]] static std::unique_ptr<AbstractMessage> deserialize_payload(
+    MessageType const message_type,
+    c2k::MessageBuffer& buffer
+) {  // clang-format on
+    try {
+        switch (message_type) {
+            case MessageType::Connect:
+                return std::make_unique<Connect>(Connect::deserialize(buffer));
+            case MessageType::Heartbeat:
+                return std::make_unique<Heartbeat>(Heartbeat::deserialize(buffer));
+            case MessageType::GridState:
+                return std::make_unique<GridState>(GridState::deserialize(buffer));
+            case MessageType::GameStart:
+                return std::make_unique<GameStart>(GameStart::deserialize(buffer));
+            case MessageType::StateBroadcast:
+                return std::make_unique<StateBroadcast>(StateBroadcast::deserialize(buffer));
+            case MessageType::ClientDisconnected:
+                return std::make_unique<ClientDisconnected>(ClientDisconnected::deserialize(buffer));
+            case MessageType::RedundantHeartbeat:
+                return std::make_unique<RedundantHeartbeat>(RedundantHeartbeat::deserialize(buffer));
+            case MessageType::RedundantStateBroadcast:
+                return std::make_unique<RedundantStateBroadcast>(RedundantStateBroadcast::deserialize(buffer));
+            case MessageType::SnapshotSubscription:
+                return std::make_unique<SnapshotSubscription>(SnapshotSubscription::deserialize(buffer));
+            case MessageType::SnapshotBroadcast:
+                return std::make_unique<SnapshotBroadcast>(SnapshotBroadcast::deserialize(buffer));
+            case MessageType::Reconnect:
+                return std::make_unique<Reconnect>(Reconnect::deserialize(buffer));
+            case MessageType::MatchSnapshot:
+                return std::make_unique<MatchSnapshot>(MatchSnapshot::deserialize(buffer));
+            case MessageType::TetrionSnapshot:
+                return std::make_unique<TetrionSnapshot>(TetrionSnapshot::deserialize(buffer));
+            case MessageType::ClientReconnected:
+                return std::make_unique<ClientReconnected>(ClientReconnected::deserialize(buffer));
+        }
+    } catch (MessageInstantiationError const& exception) {
+        throw MessageDeserializationError{ std::format("failed to deserialize message: {}", exception.what()) };
+    }
+    std::unreachable();
+}
+
 // clang-format off
 [[nodiscard]] std::unique_ptr<AbstractMessage> AbstractMessage::from_socket(
     c2k::ClientSocket& socket,
@@ -23,25 +102,7 @@
     };
 
     auto const message_type = static_cast<MessageType>(socket.receive<std::uint8_t>().get());
-
-    auto const message_max_payload_size = [message_type] {
-        switch (message_type) {
-            case MessageType::Connect:
-                return Connect::max_payload_size();
-            case MessageType::Heartbeat:
-                return Heartbeat::max_payload_size();
-            case MessageType::GridState:
-                return GridState::max_payload_size();
-            case MessageType::GameStart:
-                return GameStart::max_payload_size();
-            case MessageType::StateBroadcast:
-                return StateBroadcast::max_payload_size();
-            case MessageType::ClientDisconnected:
-                return ClientDisconnected::max_payload_size();
-                // todo: add case for custom messages
-        }
-        throw MessageDeserializationError{ std::format("{} is an unknown message type", static_cast<int>(message_type)) };
-    }();
+    auto const message_max_payload_size = max_payload_size_of(message_type);
 
     auto buffer = c2k::MessageBuffer{};
     buffer << socket.receive_exact(sizeof(MessageHeader::payload_size), remaining_time()).get();
@@ -71,25 +132,66 @@
     buffer << socket.receive_exact(payload_size, remaining_time()).get();
     assert(buffer.size() == payload_size);
 
-    try {
-        switch (message_type) {
-            case MessageType::Connect:
-                return std::make_unique<Connect>(Connect::deserialize(buffer));
-            case MessageType::Heartbeat:
-                return std::make_unique<Heartbeat>(Heartbeat::deserialize(buffer));
-            case MessageType::GridState:
-                return std::make_unique<GridState>(GridState::deserialize(buffer));
-            case MessageType::GameStart:
-                return std::make_unique<GameStart>(GameStart::deserialize(buffer));
-            case MessageType::StateBroadcast:
-                return std::make_unique<StateBroadcast>(StateBroadcast::deserialize(buffer));
-            case MessageType::ClientDisconnected:
-                return std::make_unique<ClientDisconnected>(ClientDisconnected::deserialize(buffer));
-        }
-    } catch (MessageInstantiationError const& exception) {
-        throw MessageDeserializationError{ std::format("failed to deserialize message: {}", exception.what()) };
+    return deserialize_payload(message_type, buffer);
+}
+
+// Expects the buffer to contain exactly the payload of the given message.
+// clang-format off
+[[nodiscard]] static std::unique_ptr<AbstractMessage> deserialize_exact_payload(
+    MessageType const message_type,
+    decltype(MessageHeader::payload_size) const payload_size,
+    c2k::MessageBuffer& buffer
+) {  // clang-format on
+    if (payload_size != buffer.size()) {
+        throw MessageDeserializationError{ std::format(
+            "message payload size {} does not match buffer payload size {}",
+            payload_size,
+            buffer.size()
+        ) };
     }
-    std::unreachable();
+
+    auto const message_max_payload_size = max_payload_size_of(message_type);
+    if (payload_size > message_max_payload_size) {
+        throw MessageDeserializationError{ std::format(
+            "message payload size {} is too big for message type {} (maximum is {})",
+            payload_size,
+            std::to_underlying(message_type),
+            message_max_payload_size
+        ) };
+    }
+
+    auto message = deserialize_payload(message_type, buffer);
+    if (buffer.size() > 0) {
+        throw MessageDeserializationError{ "excess bytes while deserializing message" };
+    }
+    return message;
+}
+
+[[nodiscard]] std::unique_ptr<AbstractMessage> AbstractMessage::from_datagram(c2k::MessageBuffer& buffer) {
+    using Type = std::underlying_type_t<MessageType>;
+    using PayloadSize = decltype(MessageHeader::payload_size);
+    auto const header = buffer.try_extract<Type, PayloadSize>();
+    if (not header.has_value()) {
+        throw MessageDeserializationError{ "datagram is too small to contain a message header" };
+    }
+    auto const [type, payload_size] = header.value();
+    auto const message_type = static_cast<MessageType>(type);
+    if (message_type != MessageType::RedundantHeartbeat and message_type != MessageType::RedundantStateBroadcast) {
+        throw MessageDeserializationError{ std::format("message type {} cannot be sent as datagram", type) };
+    }
+    // A datagram contains exactly one message, so there must neither be missing nor excess bytes.
+    return deserialize_exact_payload(message_type, payload_size, buffer);
+}
+
+[[nodiscard]] std::unique_ptr<AbstractMessage> AbstractMessage::from_buffer(c2k::MessageBuffer& buffer) {
+    using Type = std::underlying_type_t<MessageType>;
+    using PayloadSize = decltype(MessageHeader::payload_size);
+    auto const header = buffer.try_extract<Type, PayloadSize>();
+    if (not header.has_value()) {
+        throw MessageDeserializationError{ "buffer is too small to contain a message header" };
+    }
+    auto const [type, payload_size] = header.value();
+    return deserialize_exact_payload(static_cast<MessageType>(type), payload_size, buffer);
 }
 
 [[nodiscard]] static std::string sanitize(std::string_view const player_name) {
@@ -107,6 +209,31 @@
     return sanitized;
 }
 
+static void append_key_states(c2k::MessageBuffer& buffer, std::array<KeyState, heartbeat_interval> const& key_states) {
+    for (auto const& key_state : key_states) {
+        buffer << key_state.get_bitmask();
+    }
+}
+
+[[nodiscard]] static std::array<KeyState, heartbeat_interval> extract_key_states(c2k::MessageBuffer& buffer) {
+    if (buffer.size() < heartbeat_interval * sizeof(std::uint8_t)) {
+        throw MessageDeserializationError{ "too few bytes to deserialize key states" };
+    }
+    auto key_states = std::array<KeyState, heartbeat_interval>{};
+    for (auto& key_state : key_states) {
+        auto const state = KeyState::from_bitmask(buffer.try_extract<std::uint8_t>().value());
+        if (not state.has_value()) {
+            throw MessageDeserializationError{ "failed to deserialize KeyState from bitmask" };
+        }
+        key_state = state.value();
+    }
+    return key_states;
+}
+
+[[nodiscard]] static bool is_window_end(std::uint64_t const frame) {
+    return (frame + 1) % heartbeat_interval == 0;
+}
+
 Connect::Connect(std::string_view const player_name)
     : player_name{ sanitize(player_name) } {}
 
@@ -141,13 +268,15 @@ decltype(MessageHeader::payload_size) Connect::payload_size() const {
             buffer.size()
         ) };
     }
+    // The name is padded with null characters up to the fixed size, the padding is consumed as well.
     auto player_name = std::string{};
-    while (buffer.size() != 0) {
+    auto has_reached_end = false;
+    for (auto i = usize{ 0 }; i < required_num_bytes; ++i) {
         auto const c = buffer.try_extract<char>().value();
-        if (c == '\0') {
-            break;
+        has_reached_end = has_reached_end or c == '\0';
+        if (not has_reached_end) {
+            player_name += c;
         }
-        player_name += c;
     }
     return Connect{ sanitize(std::move(player_name)) };
 }
@@ -161,28 +290,21 @@ decltype(MessageHeader::payload_size) Connect::payload_size() const {
 }
 
 [[nodiscard]] c2k::MessageBuffer Heartbeat::serialize() const {
+    OBPF_TRACE_SCOPE("Heartbeat::serialize");
     auto buffer = c2k::MessageBuffer{};
     buffer << static_cast<std::uint8_t>(MessageType::Heartbeat) << payload_size() << frame;
-    for (auto const& key_state : key_states) {
-        buffer << key_state.get_bitmask();
-    }
+    append_key_states(buffer, key_states);
+    buffer << state_hash.frame << state_hash.hash;
     assert(buffer.size() == payload_size() + header_size);
     return buffer;
 }
 
 [[nodiscard]] Heartbeat Heartbeat::deserialize(c2k::MessageBuffer& buffer) {
+    OBPF_TRACE_SCOPE("Heartbeat::deserialize");
     auto const frame = buffer.try_extract<std::uint64_t>().value();
-
-    auto key_states = decltype(Heartbeat::key_states){};
-    for (auto& key_state : key_states) {
-        auto const state = KeyState::from_bitmask(buffer.try_extract<std::uint8_t>().value());
-        if (not state.has_value()) {
-            throw MessageDeserializationError{ "failed to deserialize KeyState from bitmask" };
-        }
-        key_state = state.value();
-    }
-
-    return Heartbeat{ frame, key_states };
+    auto const key_states = extract_key_states(buffer);
+    auto const [hashed_frame, hash] = buffer.try_extract<std::uint64_t, std::uint64_t>().value();
+    return Heartbeat{ frame, key_states, StateHash{ hashed_frame, hash } };
 }
 
 [[nodiscard]] MessageType GridState::type() const {
@@ -347,6 +469,7 @@ StateBroadcast::StateBroadcast(std::uint64_t const frame, std::vector<ClientStat
 }
 
 [[nodiscard]] c2k::MessageBuffer StateBroadcast::serialize() const {
+    OBPF_TRACE_SCOPE("StateBroadcast::serialize");
     assert(states_per_client.size() <= std::numeric_limits<std::uint8_t>::max());
     auto buffer = c2k::MessageBuffer{};
     // clang-format off
@@ -355,46 +478,48 @@ StateBroadcast::StateBroadcast(std::uint64_t const frame, std::vector<ClientStat
            << frame
            << static_cast<std::uint8_t>(states_per_client.size()); // num clients
     // clang-format on
-    for (auto const [client_id, states] : states_per_client) {
+    for (auto const& [client_id, states] : states_per_client) {
         buffer << client_id;
-        for (auto const state : states) {
-            buffer << state.get_bitmask();
-        }
+        append_key_states(buffer, states);
     }
     assert(buffer.size() == payload_size() + header_size);
     return buffer;
 }
 
-[[nodiscard]] StateBroadcast StateBroadcast::deserialize(c2k::MessageBuffer& buffer) {
-    using Frame = decltype(frame);
+// Extracts the payload of a StateBroadcast message. In contrast to StateBroadcast::deserialize(), there may be
+// remaining bytes in the buffer afterwards.
+[[nodiscard]] static StateBroadcast extract_state_broadcast(c2k::MessageBuffer& buffer) {
+    using Frame = decltype(StateBroadcast::frame);
     using NumClients = std::uint8_t;
     if (buffer.size() < sizeof(Frame) + sizeof(NumClients)) {
         throw MessageDeserializationError{ "too few bytes to deserialize StateBroadcast message" };
     }
     auto const frame = buffer.try_extract<Frame>().value();
+    if (not is_window_end(frame)) {
+        throw MessageDeserializationError{ std::format("{} is not a valid frame for a StateBroadcast message", frame) };
+    }
     auto const num_clients = static_cast<std::size_t>(buffer.try_extract<NumClients>().value());
+    if (buffer.size() < num_clients * StateBroadcast::ClientStates::size_in_bytes()) {
+        throw MessageDeserializationError{ "too few bytes to deserialize client states of StateBroadcast message" };
+    }
 
     auto states_per_client = decltype(StateBroadcast::states_per_client){};
     states_per_client.reserve(num_clients);
 
     for (auto i = std::size_t{ 0 }; i < num_clients; ++i) {
         auto const client_id = buffer.try_extract<std::uint8_t>().value();
-        auto states = std::array<KeyState, heartbeat_interval>{};
-        for (auto& state : states) {
-            auto const bitmask = buffer.try_extract<std::uint8_t>().value();
-            auto const key_state = KeyState::from_bitmask(bitmask);
-            if (not key_state.has_value()) {
-                throw MessageDeserializationError{ "failed to deserialize KeyState from bitmask" };
-            }
-            state = key_state.value();
-        }
-        states_per_client.emplace_back(client_id, states);
+        states_per_client.emplace_back(client_id, extract_key_states(buffer));
     }
+    return StateBroadcast{ frame, std::move(states_per_client) };
+}
 
+[[nodiscard]] StateBroadcast StateBroadcast::deserialize(c2k::MessageBuffer& buffer) {
+    OBPF_TRACE_SCOPE("StateBroadcast::deserialize");
+    auto result = extract_state_broadcast(buffer);
     if (buffer.size() > 0) {
         throw MessageDeserializationError{ "excess bytes while deserializing EventBroadcast message" };
     }
-    return StateBroadcast{ frame, std::move(states_per_client) };
+    return result;
 }
 
 [[nodiscard]] MessageType ClientDisconnected::type() const {
@@ -426,3 +551,442 @@ bool ClientDisconnected::equals(AbstractMessage const& other) const {
     auto const other_client_disconnected = dynamic_cast<ClientDisconnected const*>(&other);
     return other_client_disconnected != nullptr and client_id == other_client_disconnected->client_id;
 }
+
+// Windows have to be aligned to the heartbeat interval and must not have any gaps between them.
+template<typename Window>
+static void validate_windows(std::vector<Window> const& windows, std::string_view const message_name) {
+    if (windows.size() > max_redundant_windows) {
+        throw MessageInstantiationError{ std::format(
+            "cannot instantiate {} message with {} windows ({} is maximum)",
+            message_name,
+            windows.size(),
+            max_redundant_windows
+        ) };
+    }
+    for (auto i = usize{ 0 }; i < windows.size(); ++i) {
+        auto const frame = windows.at(i).frame;
+        if (not is_window_end(frame)) {
+            throw MessageInstantiationError{
+                std::format("{} is not a valid window frame for {} message", frame, message_name)
+            };
+        }
+        if (i > 0 and frame != windows.at(i - 1).frame + heartbeat_interval) {
+            throw MessageInstantiationError{ std::format("windows of {} message are not consecutive", message_name) };
+        }
+    }
+}
+
+[[nodiscard]] static usize extract_num_windows(c2k::MessageBuffer& buffer) {
+    auto const num_windows = static_cast<usize>(buffer.try_extract<std::uint8_t>().value());
+    if (num_windows > max_redundant_windows) {
+        throw MessageDeserializationError{
+            std::format("{} windows exceed the maximum of {} windows", num_windows, max_redundant_windows)
+        };
+    }
+    return num_windows;
+}
+
+RedundantHeartbeat::RedundantHeartbeat(
+    u8 const client_id,
+    std::uint64_t const acknowledged_until_frame,
+    std::vector<Heartbeat> heartbeats
+)
+    : client_id{ client_id },
+      acknowledged_until_frame{ acknowledged_until_frame },
+      heartbeats{ std::move(heartbeats) } {
+    validate_windows(this->heartbeats, "RedundantHeartbeat");
+}
+
+[[nodiscard]] MessageType RedundantHeartbeat::type() const {
+    return MessageType::RedundantHeartbeat;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) RedundantHeartbeat::payload_size() const {
+    return calculate_payload_size(heartbeats.size());
+}
+
+[[nodiscard]] c2k::MessageBuffer RedundantHeartbeat::serialize() const {
+    OBPF_TRACE_SCOPE("RedundantHeartbeat::serialize");
+    auto buffer = c2k::MessageBuffer{};
+    // clang-format off
+    buffer << static_cast<std::uint8_t>(type())
+           << payload_size()
+           << client_id
+           << acknowledged_until_frame
+           << static_cast<std::uint8_t>(heartbeats.size());
+    // clang-format on
+    for (auto const& heartbeat : heartbeats) {
+        buffer << heartbeat.frame;
+        append_key_states(buffer, heartbeat.key_states);
+        buffer << heartbeat.state_hash.frame << heartbeat.state_hash.hash;
+    }
+    assert(buffer.size() == payload_size() + header_size);
+    return buffer;
+}
+
+[[nodiscard]] RedundantHeartbeat RedundantHeartbeat::deserialize(c2k::MessageBuffer& buffer) {
+    OBPF_TRACE_SCOPE("RedundantHeartbeat::deserialize");
+    static constexpr auto required_num_bytes =
+        c2k::detail::summed_sizeof<decltype(client_id), decltype(acknowledged_until_frame), std::uint8_t>();
+    if (buffer.size() < required_num_bytes) {
+        throw MessageDeserializationError{ "too few bytes to deserialize RedundantHeartbeat message" };
+    }
+    using ClientId = decltype(RedundantHeartbeat::client_id);
+    using Frame = decltype(RedundantHeartbeat::acknowledged_until_frame);
+    auto const [client_id, acknowledged_until_frame] = buffer.try_extract<ClientId, Frame>().value();
+    auto const num_windows = extract_num_windows(buffer);
+    if (buffer.size() < num_windows * Heartbeat::max_payload_size()) {
+        throw MessageDeserializationError{ "too few bytes to deserialize windows of RedundantHeartbeat message" };
+    }
+
+    auto heartbeats = std::vector<Heartbeat>{};
+    heartbeats.reserve(num_windows);
+    for (auto i = usize{ 0 }; i < num_windows; ++i) {
+        auto const frame = buffer.try_extract<std::uint64_t>().value();
+        auto const key_states = extract_key_states(buffer);
+        auto const [hashed_frame, hash] = buffer.try_extract<std::uint64_t, std::uint64_t>().value();
+        heartbeats.emplace_back(frame, key_states, StateHash{ hashed_frame, hash });
+    }
+    if (buffer.size() > 0) {
+        throw MessageDeserializationError{ "excess bytes while deserializing RedundantHeartbeat message" };
+    }
+    return RedundantHeartbeat{ client_id, acknowledged_until_frame, std::move(heartbeats) };
+}
+
+RedundantStateBroadcast::RedundantStateBroadcast(
+    std::uint64_t const acknowledged_until_frame,
+    std::vector<StateBroadcast> broadcasts
+)
+    : acknowledged_until_frame{ acknowledged_until_frame }, broadcasts{ std::move(broadcasts) } {
+    validate_windows(this->broadcasts, "RedundantStateBroadcast");
+}
+
+[[nodiscard]] MessageType RedundantStateBroadcast::type() const {
+    return MessageType::RedundantStateBroadcast;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) RedundantStateBroadcast::payload_size() const {
+    auto result = sizeof(acknowledged_until_frame) + sizeof(std::uint8_t);
+    for (auto const& broadcast : broadcasts) {
+        result += broadcast.payload_size();
+    }
+    return gsl::narrow<decltype(MessageHeader::payload_size)>(result);
+}
+
+[[nodiscard]] c2k::MessageBuffer RedundantStateBroadcast::serialize() const {
+    OBPF_TRACE_SCOPE("RedundantStateBroadcast::serialize");
+    auto buffer = c2k::MessageBuffer{};
+    // clang-format off
+    buffer << static_cast<std::uint8_t>(type())
+           << payload_size()
+           << acknowledged_until_frame
+           << static_cast<std::uint8_t>(broadcasts.size());
+    // clang-format on
+    for (auto const& broadcast : broadcasts) {
+        buffer << broadcast.frame << static_cast<std::uint8_t>(broadcast.states_per_client.size());
+        for (auto const& [client_id, states] : broadcast.states_per_client) {
+            buffer << client_id;
+            append_key_states(buffer, states);
+        }
+    }
+    assert(buffer.size() == payload_size() + header_size);
+    return buffer;
+}
+
+[[nodiscard]] RedundantStateBroadcast RedundantStateBroadcast::deserialize(c2k::MessageBuffer& buffer) {
+    OBPF_TRACE_SCOPE("RedundantStateBroadcast::deserialize");
+    if (buffer.size() < sizeof(acknowledged_until_frame) + sizeof(std::uint8_t)) {
+        throw MessageDeserializationError{ "too few bytes to deserialize RedundantStateBroadcast message" };
+    }
+    auto const acknowledged_until_frame =
+        buffer.try_extract<decltype(RedundantStateBroadcast::acknowledged_until_frame)>().value();
+    auto const num_windows = extract_num_windows(buffer);
+
+    auto broadcasts = std::vector<StateBroadcast>{};
+    broadcasts.reserve(num_windows);
+    for (auto i = usize{ 0 }; i < num_windows; ++i) {
+        broadcasts.push_back(extract_state_broadcast(buffer));
+    }
+    if (buffer.size() > 0) {
+        throw MessageDeserializationError{ "excess bytes while deserializing RedundantStateBroadcast message" };
+    }
+    return RedundantStateBroadcast{ acknowledged_until_frame, std::move(broadcasts) };
+}
+
+SnapshotSubscription::SnapshotSubscription(u8 const interval)
+    : interval{ interval } {
+    if (interval == 0) {
+        throw MessageInstantiationError{ "cannot instantiate SnapshotSubscription message with an interval of 0" };
+    }
+}
+
+[[nodiscard]] MessageType SnapshotSubscription::type() const {
+    return MessageType::SnapshotSubscription;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) SnapshotSubscription::payload_size() const {
+    return max_payload_size();
+}
+
+[[nodiscard]] c2k::MessageBuffer SnapshotSubscription::serialize() const {
+    auto buffer = c2k::MessageBuffer{};
+    buffer << static_cast<std::uint8_t>(type()) << payload_size() << interval;
+    return buffer;
+}
+
+[[nodiscard]] SnapshotSubscription SnapshotSubscription::deserialize(c2k::MessageBuffer& buffer) {
+    if (buffer.size() != max_payload_size()) {
+        throw MessageDeserializationError{ "invalid number of bytes for SnapshotSubscription message" };
+    }
+    return SnapshotSubscription{ buffer.try_extract<u8>().value() };
+}
+
+// clang-format off
+SnapshotBroadcast::SnapshotBroadcast(
+    std::uint64_t const frame,
+    std::array<KeyState, heartbeat_interval> const& key_states,
+    std::vector<GarbageSendEvent> received_garbage,
+    std::vector<BoardSnapshot> boards
+)  // clang-format on
+    : frame{ frame },
+      key_states{ key_states },
+      received_garbage{ std::move(received_garbage) },
+      boards{ std::move(boards) } {
+    if (not is_window_end(frame)) {
+        throw MessageInstantiationError{ std::format("{} is not a valid frame for SnapshotBroadcast message", frame) };
+    }
+    if (this->received_garbage.size() > std::numeric_limits<std::uint8_t>::max()
+        or this->boards.size() > std::numeric_limits<std::uint8_t>::max()) {
+        throw MessageInstantiationError{ "too many garbage events or boards for SnapshotBroadcast message" };
+    }
+}
+
+[[nodiscard]] MessageType SnapshotBroadcast::type() const {
+    return MessageType::SnapshotBroadcast;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) SnapshotBroadcast::payload_size() const {
+    return calculate_payload_size(received_garbage.size(), boards.size());
+}
+
+[[nodiscard]] static Vec2 mino_position(usize const index) {
+    return Vec2{
+        gsl::narrow<decltype(Vec2::x)>(index % Matrix::width),
+        gsl::narrow<decltype(Vec2::y)>(index / Matrix::width),
+    };
+}
+
+[[nodiscard]] c2k::MessageBuffer SnapshotBroadcast::serialize() const {
+    OBPF_TRACE_SCOPE("SnapshotBroadcast::serialize");
+    auto buffer = c2k::MessageBuffer{};
+    buffer << static_cast<std::uint8_t>(type()) << payload_size() << frame;
+    append_key_states(buffer, key_states);
+    buffer << static_cast<std::uint8_t>(received_garbage.size());
+    for (auto const& [garbage_frame, num_lines] : received_garbage) {
+        buffer << garbage_frame << num_lines;
+    }
+    buffer << static_cast<std::uint8_t>(boards.size());
+    for (auto const& [client_id, is_game_over, matrix] : boards) {
+        buffer << client_id << static_cast<std::uint8_t>(is_game_over);
+        // Every TetrominoType fits into 4 bits.
+        static_assert(std::to_underlying(TetrominoType::Last) < 16);
+        for (auto i = usize{ 0 }; i < Matrix::width * Matrix::height; i += 2) {
+            auto const first = static_cast<u8>(matrix[mino_position(i)]);
+            auto const second =
+                (i + 1 < Matrix::width * Matrix::height ? static_cast<u8>(matrix[mino_position(i + 1)]) : u8{ 0 });
+            buffer << static_cast<u8>(first << 4 | second);
+        }
+    }
+    assert(buffer.size() == payload_size() + header_size);
+    return buffer;
+}
+
+[[nodiscard]] static TetrominoType to_tetromino_type(u8 const value) {
+    if (value > std::to_underlying(TetrominoType::Last)) {
+        throw MessageDeserializationError{ std::format("{} is not a valid tetromino type", value) };
+    }
+    return static_cast<TetrominoType>(value);
+}
+
+[[nodiscard]] SnapshotBroadcast SnapshotBroadcast::deserialize(c2k::MessageBuffer& buffer) {
+    OBPF_TRACE_SCOPE("SnapshotBroadcast::deserialize");
+    if (buffer.size() < calculate_payload_size(0, 0)) {
+        throw MessageDeserializationError{ "too few bytes to deserialize SnapshotBroadcast message" };
+    }
+    auto const frame = buffer.try_extract<decltype(SnapshotBroadcast::frame)>().value();
+    if (not is_window_end(frame)) {
+        throw MessageDeserializationError{
+            std::format("{} is not a valid frame for a SnapshotBroadcast message", frame)
+        };
+    }
+    auto const key_states = extract_key_states(buffer);
+
+    auto const num_garbage_events = static_cast<usize>(buffer.try_extract<std::uint8_t>().value());
+    if (buffer.size() < num_garbage_events * garbage_event_size_in_bytes + sizeof(std::uint8_t)) {
+        throw MessageDeserializationError{ "too few bytes to deserialize garbage events of SnapshotBroadcast message" };
+    }
+    auto received_garbage = std::vector<GarbageSendEvent>{};
+    received_garbage.reserve(num_garbage_events);
+    for (auto i = usize{ 0 }; i < num_garbage_events; ++i) {
+        using Frame = decltype(GarbageSendEvent::frame);
+        using NumLines = decltype(GarbageSendEvent::num_lines);
+        auto const [garbage_frame, num_lines] = buffer.try_extract<Frame, NumLines>().value();
+        received_garbage.emplace_back(garbage_frame, num_lines);
+    }
+
+    auto const num_boards = static_cast<usize>(buffer.try_extract<std::uint8_t>().value());
+    if (buffer.size() != num_boards * BoardSnapshot::size_in_bytes()) {
+        throw MessageDeserializationError{ "invalid number of bytes for boards of SnapshotBroadcast message" };
+    }
+    auto boards = std::vector<BoardSnapshot>{};
+    boards.reserve(num_boards);
+    for (auto i = usize{ 0 }; i < num_boards; ++i) {
+        auto board = BoardSnapshot{};
+        auto const [client_id, is_game_over] = buffer.try_extract<u8, u8>().value();
+        board.client_id = client_id;
+        board.is_game_over = (is_game_over != 0);
+        for (auto j = usize{ 0 }; j < Matrix::width * Matrix::height; j += 2) {
+            auto const packed = buffer.try_extract<u8>().value();
+            board.matrix.set(mino_position(j), to_tetromino_type(static_cast<u8>(packed >> 4)));
+            if (j + 1 < Matrix::width * Matrix::height) {
+                board.matrix.set(mino_position(j + 1), to_tetromino_type(static_cast<u8>(packed & 0x0F)));
+            }
+        }
+        boards.push_back(board);
+    }
+    assert(buffer.size() == 0);
+    return SnapshotBroadcast{ frame, key_states, std::move(received_garbage), std::move(boards) };
+}
+
+bool SnapshotBroadcast::equals(AbstractMessage const& other) const {
+    auto const& other_broadcast = static_cast<SnapshotBroadcast const&>(other);
+    auto const garbage_event_equals = [](GarbageSendEvent const& lhs, GarbageSendEvent const& rhs) {
+        return lhs.frame == rhs.frame and lhs.num_lines == rhs.num_lines;
+    };
+    return std::tie(frame, key_states, boards)
+               == std::tie(other_broadcast.frame, other_broadcast.key_states, other_broadcast.boards)
+           and std::ranges::equal(received_garbage, other_broadcast.received_garbage, garbage_event_equals);
+}
+
+Reconnect::Reconnect(u8 const client_id, std::string_view const player_name)
+    : client_id{ client_id }, player_name{ sanitize(player_name) } {}
+
+[[nodiscard]] MessageType Reconnect::type() const {
+    return MessageType::Reconnect;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) Reconnect::payload_size() const {
+    return max_payload_size();
+}
+
+[[nodiscard]] c2k::MessageBuffer Reconnect::serialize() const {
+    auto buffer = c2k::MessageBuffer{};
+    buffer << static_cast<u8>(type()) << payload_size() << client_id;
+    for (auto i = usize{ 0 }; i < player_name_buffer_size; ++i) {
+        buffer << (i < player_name.length() ? player_name.at(i) : '\0');
+    }
+    assert(buffer.size() == payload_size() + header_size);
+    return buffer;
+}
+
+[[nodiscard]] Reconnect Reconnect::deserialize(c2k::MessageBuffer& buffer) {
+    if (buffer.size() != max_payload_size()) {
+        throw MessageDeserializationError{ "invalid number of bytes for Reconnect message" };
+    }
+    auto const client_id = buffer.try_extract<u8>().value();
+    auto player_name = std::string{};
+    for (auto i = usize{ 0 }; i < player_name_buffer_size; ++i) {
+        if (auto const c = buffer.try_extract<char>().value(); c != '\0') {
+            player_name += c;
+        }
+    }
+    return Reconnect{ client_id, player_name };
+}
+
+[[nodiscard]] MessageType MatchSnapshot::type() const {
+    return MessageType::MatchSnapshot;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) MatchSnapshot::payload_size() const {
+    return max_payload_size();
+}
+
+[[nodiscard]] c2k::MessageBuffer MatchSnapshot::serialize() const {
+    auto buffer = c2k::MessageBuffer{};
+    buffer << static_cast<u8>(type()) << payload_size() << client_id << frame << num_players;
+    return buffer;
+}
+
+[[nodiscard]] MatchSnapshot MatchSnapshot::deserialize(c2k::MessageBuffer& buffer) {
+    if (buffer.size() != max_payload_size()) {
+        throw MessageDeserializationError{ "invalid number of bytes for MatchSnapshot message" };
+    }
+    using Frame = decltype(MatchSnapshot::frame);
+    auto const [client_id, frame, num_players] = buffer.try_extract<u8, Frame, u8>().value();
+    return MatchSnapshot{ client_id, frame, num_players };
+}
+
+TetrionSnapshot::TetrionSnapshot(u8 const client_id, bool const is_connected, std::vector<u8> snapshot)
+    : client_id{ client_id }, is_connected{ is_connected }, snapshot{ std::move(snapshot) } {
+    if (this->snapshot.size() > max_snapshot_size) {
+        throw MessageInstantiationError{ std::format(
+            "snapshot of {} bytes is too big for TetrionSnapshot message ({} is maximum)",
+            this->snapshot.size(),
+            max_snapshot_size
+        ) };
+    }
+}
+
+[[nodiscard]] MessageType TetrionSnapshot::type() const {
+    return MessageType::TetrionSnapshot;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) TetrionSnapshot::payload_size() const {
+    return gsl::narrow<decltype(MessageHeader::payload_size)>(
+        sizeof(client_id) + sizeof(std::uint8_t) + snapshot.size()
+    );
+}
+
+[[nodiscard]] c2k::MessageBuffer TetrionSnapshot::serialize() const {
+    auto buffer = c2k::MessageBuffer{};
+    buffer << static_cast<u8>(type()) << payload_size() << client_id << static_cast<u8>(is_connected);
+    for (auto const byte : snapshot) {
+        buffer << byte;
+    }
+    assert(buffer.size() == payload_size() + header_size);
+    return buffer;
+}
+
+[[nodiscard]] TetrionSnapshot TetrionSnapshot::deserialize(c2k::MessageBuffer& buffer) {
+    if (buffer.size() < sizeof(client_id) + sizeof(std::uint8_t)) {
+        throw MessageDeserializationError{ "too few bytes to deserialize TetrionSnapshot message" };
+    }
+    auto const [client_id, is_connected] = buffer.try_extract<u8, u8>().value();
+    auto snapshot = std::vector<u8>{};
+    snapshot.reserve(buffer.size());
+    while (buffer.size() > 0) {
+        snapshot.push_back(buffer.try_extract<u8>().value());
+    }
+    return TetrionSnapshot{ client_id, is_connected != 0, std::move(snapshot) };
+}
+
+[[nodiscard]] MessageType ClientReconnected::type() const {
+    return MessageType::ClientReconnected;
+}
+
+[[nodiscard]] decltype(MessageHeader::payload_size) ClientReconnected::payload_size() const {
+    return max_payload_size();
+}
+
+[[nodiscard]] c2k::MessageBuffer ClientReconnected::serialize() const {
+    auto buffer = c2k::MessageBuffer{};
+    buffer << static_cast<u8>(type()) << payload_size() << client_id;
+    return buffer;
+}
+
+[[nodiscard]] ClientReconnected ClientReconnected::deserialize(c2k::MessageBuffer& buffer) {
+    if (buffer.size() != max_payload_size()) {
+        throw MessageDeserializationError{ "invalid number of bytes for ClientReconnected message" };
+    }
+    return ClientReconnected{ buffer.try_extract<u8>().value() };
+}
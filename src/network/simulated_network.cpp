@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cassert>
+#include <network/simulated_network.hpp>
+
+void SimulatedConnection::send(c2k::MessageBuffer const& buffer) {
+    m_network->send(m_outgoing, buffer);
+}
+
+[[nodiscard]] std::deque<std::unique_ptr<AbstractMessage>> SimulatedConnection::take_received_messages() {
+    return std::exchange(m_incoming->delivered_messages, {});
+}
+
+[[nodiscard]] std::pair<std::unique_ptr<SimulatedConnection>, std::unique_ptr<SimulatedConnection>>
+SimulatedNetwork::connect(LinkModel const& forward, LinkModel const& backward) {
+    assert(forward.loss >= 0.0 and forward.loss < 1.0);
+    assert(backward.loss >= 0.0 and backward.loss < 1.0);
+    auto forward_link = std::make_shared<SimulatedConnection::Link>();
+    forward_link->model = forward;
+    auto backward_link = std::make_shared<SimulatedConnection::Link>();
+    backward_link->model = backward;
+    return {
+        std::make_unique<SimulatedConnection>(*this, forward_link, backward_link, SimulatedConnection::Key{}),
+        std::make_unique<SimulatedConnection>(*this, backward_link, forward_link, SimulatedConnection::Key{}),
+    };
+}
+
+void SimulatedNetwork::advance(std::chrono::nanoseconds const duration) {
+    auto const target = m_now + duration;
+    while (not m_in_flight.empty() and m_in_flight.begin()->first.first <= target) {
+        auto node = m_in_flight.extract(m_in_flight.begin());
+        m_now = node.key().first;
+        auto& [link, buffer] = node.mapped();
+        link->delivered_messages.push_back(AbstractMessage::from_buffer(buffer));
+    }
+    m_now = target;
+}
+
+void SimulatedNetwork::send(std::shared_ptr<SimulatedConnection::Link> const& link, c2k::MessageBuffer buffer) {
+    using namespace std::chrono_literals;
+    auto const& model = link->model;
+    auto const size = buffer.size();
+
+    auto const transmission_time = (model.bytes_per_second == 0)
+                                       ? 0ns
+                                       : std::chrono::nanoseconds{ size * 1'000'000'000 / model.bytes_per_second };
+    auto const transmission_start = std::max(m_now, link->busy_until);
+    link->busy_until = transmission_start + transmission_time;
+
+    auto delay = std::chrono::nanoseconds{ model.latency };
+    if (model.jitter > 0us) {
+        auto distribution = std::uniform_int_distribution<std::chrono::nanoseconds::rep>{
+            0,
+            std::chrono::nanoseconds{ model.jitter }.count(),
+        };
+        delay += std::chrono::nanoseconds{ distribution(m_random) };
+    }
+    if (model.loss > 0.0) {
+        auto distribution = std::bernoulli_distribution{ model.loss };
+        while (distribution(m_random)) {
+            delay += model.retransmission_timeout;
+            ++link->statistics.num_retransmissions;
+        }
+    }
+
+    // Messages cannot overtake each other since the connection is ordered.
+    auto const arrival = std::max(link->busy_until + delay, link->last_arrival);
+    link->last_arrival = arrival;
+
+    auto& statistics = link->statistics;
+    ++statistics.num_messages;
+    statistics.num_bytes += size;
+    statistics.total_delay += arrival - m_now;
+    statistics.max_delay = std::max(statistics.max_delay, arrival - m_now);
+
+    m_in_flight.emplace(std::pair{ arrival, m_num_messages_sent }, InFlightMessage{ link, std::move(buffer) });
+    ++m_num_messages_sent;
+}
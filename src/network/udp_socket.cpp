@@ -0,0 +1,207 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <network/udp_socket.hpp>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using NativeSocket = SOCKET;
+static constexpr auto invalid_native_socket = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using NativeSocket = int;
+static constexpr auto invalid_native_socket = NativeSocket{ -1 };
+#endif
+
+#ifdef _WIN32
+struct WinsockInitializer final {
+    WinsockInitializer() {
+        auto data = WSADATA{};
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            throw UdpSocketError{ "unable to initialize Winsock" };
+        }
+    }
+
+    WinsockInitializer(WinsockInitializer const& other) = delete;
+    WinsockInitializer(WinsockInitializer&& other) noexcept = delete;
+    WinsockInitializer& operator=(WinsockInitializer const& other) = delete;
+    WinsockInitializer& operator=(WinsockInitializer&& other) noexcept = delete;
+
+    ~WinsockInitializer() {
+        WSACleanup();
+    }
+};
+#endif
+
+[[nodiscard]] static NativeSocket native(std::uintptr_t const handle) {
+    return static_cast<NativeSocket>(handle);
+}
+
+[[nodiscard]] static auto buffer_length(usize const length) {
+#ifdef _WIN32
+    return static_cast<int>(length);
+#else
+    return length;
+#endif
+}
+
+static void close_native_socket(NativeSocket const socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+[[nodiscard]] static sockaddr_in to_sockaddr(UdpEndpoint const& endpoint) {
+    auto result = sockaddr_in{};
+    result.sin_family = AF_INET;
+    result.sin_port = htons(endpoint.port);
+    std::memcpy(&result.sin_addr, endpoint.address.data(), endpoint.address.size());
+    return result;
+}
+
+[[nodiscard]] static UdpEndpoint from_sockaddr(sockaddr_in const& address) {
+    auto result = UdpEndpoint{};
+    std::memcpy(result.address.data(), &address.sin_addr, result.address.size());
+    result.port = ntohs(address.sin_port);
+    return result;
+}
+
+[[nodiscard]] UdpEndpoint UdpEndpoint::resolve(std::string const& host, std::uint16_t const port) {
+#ifdef _WIN32
+    static auto const winsock_initializer = WinsockInitializer{};
+#endif
+    auto hints = addrinfo{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    auto* results = static_cast<addrinfo*>(nullptr);
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &results) != 0 or results == nullptr) {
+        throw UdpSocketError{ std::format("unable to resolve host '{}'", host) };
+    }
+    auto address = sockaddr_in{};
+    std::memcpy(&address, results->ai_addr, sizeof(address));
+    freeaddrinfo(results);
+    auto result = from_sockaddr(address);
+    result.port = port;
+    return result;
+}
+
+UdpSocket::UdpSocket(std::uint16_t const port) {
+#ifdef _WIN32
+    static auto const winsock_initializer = WinsockInitializer{};
+#endif
+    auto const socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket == invalid_native_socket) {
+        throw UdpSocketError{ "unable to create UDP socket" };
+    }
+    m_handle = static_cast<std::uintptr_t>(socket);
+
+    auto address = sockaddr_in{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0) {
+        close_native_socket(socket);
+        throw UdpSocketError{ std::format("unable to bind UDP socket to port {}", port) };
+    }
+
+    auto bound_address = sockaddr_in{};
+    auto bound_address_length = static_cast<socklen_t>(sizeof(bound_address));
+    if (getsockname(socket, reinterpret_cast<sockaddr*>(&bound_address), &bound_address_length) != 0) {
+        close_native_socket(socket);
+        throw UdpSocketError{ "unable to determine local port of UDP socket" };
+    }
+    m_local_port = ntohs(bound_address.sin_port);
+}
+
+UdpSocket::~UdpSocket() {
+    close_native_socket(native(m_handle));
+}
+
+void UdpSocket::simulate_packet_loss(double const probability, u64 const seed) {
+    auto const lock = std::scoped_lock{ m_packet_loss_mutex };
+    m_simulated_packet_loss = std::clamp(probability, 0.0, 1.0);
+    m_packet_loss_random.seed(seed);
+}
+
+void UdpSocket::send_to(UdpEndpoint const& receiver, c2k::MessageBuffer const& buffer) {
+    {
+        auto const lock = std::scoped_lock{ m_packet_loss_mutex };
+        if (m_simulated_packet_loss > 0.0) {
+            // We don't use std::uniform_real_distribution here since it is not guaranteed to produce the same
+            // values across different standard libraries.
+            auto const random_value = static_cast<double>(m_packet_loss_random() >> 11) * 0x1.0p-53;
+            if (random_value < m_simulated_packet_loss) {
+                return;
+            }
+        }
+    }
+
+    auto const data = buffer.data();
+    if (data.size() > max_datagram_size) {
+        spdlog::error("cannot send datagram of {} bytes (maximum is {})", data.size(), max_datagram_size);
+        return;
+    }
+    auto const address = to_sockaddr(receiver);
+    auto const result = sendto(
+        native(m_handle),
+        reinterpret_cast<char const*>(data.data()),
+        buffer_length(data.size()),
+        0,
+        reinterpret_cast<sockaddr const*>(&address),
+        sizeof(address)
+    );
+    // Datagrams are unreliable anyway, so the callers have to cope with lost datagrams. Therefore, we don't
+    // treat a failed send as an error.
+    if (result < 0) {
+        spdlog::warn("failed to send datagram to port {}", receiver.port);
+    }
+}
+
+[[nodiscard]] std::optional<Datagram> UdpSocket::receive(std::chrono::milliseconds const timeout) {
+#ifdef _WIN32
+    auto descriptor = WSAPOLLFD{};
+    descriptor.fd = native(m_handle);
+    descriptor.events = POLLRDNORM;
+    auto const poll_result = WSAPoll(&descriptor, 1, static_cast<INT>(timeout.count()));
+#else
+    auto descriptor = pollfd{};
+    descriptor.fd = native(m_handle);
+    descriptor.events = POLLIN;
+    auto const poll_result = poll(&descriptor, 1, static_cast<int>(timeout.count()));
+#endif
+    if (poll_result <= 0) {
+        return std::nullopt;
+    }
+
+    auto bytes = std::vector<std::byte>(max_datagram_size);
+    auto sender = sockaddr_in{};
+    auto sender_length = static_cast<socklen_t>(sizeof(sender));
+    auto const num_bytes_received = recvfrom(
+        native(m_handle),
+        reinterpret_cast<char*>(bytes.data()),
+        buffer_length(bytes.size()),
+        0,
+        reinterpret_cast<sockaddr*>(&sender),
+        &sender_length
+    );
+    // On Windows, recvfrom() reports ICMP "port unreachable" messages for previously sent datagrams as errors.
+    // We simply ignore those.
+    if (num_bytes_received <= 0) {
+        return std::nullopt;
+    }
+    bytes.resize(static_cast<usize>(num_bytes_received));
+
+    auto buffer = c2k::MessageBuffer{};
+    buffer << bytes;
+    return Datagram{ from_sockaddr(sender), std::move(buffer) };
+}
@@ -0,0 +1,69 @@
+#include <obpf/async.h>
+#include <spdlog/spdlog.h>
+#include "async_operation.hpp"
+
+ObpfAsyncStatus obpf_async_operation_status(ObpfAsyncOperation* const operation) try {
+    return reinterpret_cast<AsyncOperation*>(operation)->status();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to get status of asynchronous operation: {}", e.what());
+    return OBPF_ASYNC_FAILED;
+} catch (...) {
+    spdlog::error("Failed to get status of asynchronous operation: unknown error");
+    return OBPF_ASYNC_FAILED;
+}
+
+void obpf_async_operation_set_callback(
+    ObpfAsyncOperation* const operation,
+    ObpfAsyncCallback const callback,
+    void* const user_data
+) try {
+    reinterpret_cast<AsyncOperation*>(operation)->set_callback(callback, user_data);
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to set callback of asynchronous operation: {}", e.what());
+} catch (...) {
+    spdlog::error("Failed to set callback of asynchronous operation: unknown error");
+}
+
+void* obpf_async_operation_take_result(ObpfAsyncOperation* const operation) try {
+    return reinterpret_cast<AsyncOperation*>(operation)->take_result();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to take result of asynchronous operation: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to take result of asynchronous operation: unknown error");
+    return nullptr;
+}
+
+uint16_t obpf_async_operation_port(ObpfAsyncOperation* const operation) try {
+    return reinterpret_cast<AsyncOperation*>(operation)->port();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to get port of asynchronous operation: {}", e.what());
+    return 0;
+} catch (...) {
+    spdlog::error("Failed to get port of asynchronous operation: unknown error");
+    return 0;
+}
+
+void obpf_async_operation_cancel(ObpfAsyncOperation* const operation) try {
+    reinterpret_cast<AsyncOperation*>(operation)->cancel();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to cancel asynchronous operation: {}", e.what());
+} catch (...) {
+    spdlog::error("Failed to cancel asynchronous operation: unknown error");
+}
+
+void obpf_destroy_async_operation(ObpfAsyncOperation* const operation) try {
+    auto const async_operation = reinterpret_cast<AsyncOperation*>(operation);
+    async_operation->cancel();
+    async_operation->release();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to destroy asynchronous operation: {}", e.what());
+} catch (...) {
+    spdlog::error("Failed to destroy asynchronous operation: unknown error");
+}
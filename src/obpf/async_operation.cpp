@@ -0,0 +1,133 @@
+#include <spdlog/spdlog.h>
+#include "async_operation.hpp"
+
+IoThread::IoThread() : m_thread{ [this](std::stop_token const& stop_token) { run(stop_token); } } { }
+
+void IoThread::post(Task task) {
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void IoThread::run(std::stop_token const& stop_token) {
+    while (true) {
+        auto task = Task{};
+        {
+            auto lock = std::unique_lock{ m_mutex };
+            if (not m_condition.wait(lock, stop_token, [this] { return not m_tasks.empty(); })) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task(stop_token);
+    }
+}
+
+[[nodiscard]] IoThread& lobby_io_thread() {
+    static auto thread = IoThread{};
+    return thread;
+}
+
+[[nodiscard]] IoThread& match_io_thread() {
+    static auto thread = IoThread{};
+    return thread;
+}
+
+AsyncOperation::~AsyncOperation() {
+    if (m_result != nullptr) {
+        m_result_deleter(m_result);
+    }
+}
+
+[[nodiscard]] AsyncOperation* AsyncOperation::start(IoThread& thread, Work work) {
+    auto const operation = new AsyncOperation{};
+    thread.post([operation, work = std::move(work)](std::stop_token const& thread_stop_token) {
+        // Shutting down the I/O thread cancels the operation as well.
+        auto const forward_stop = std::stop_callback{ thread_stop_token, [operation] { operation->cancel(); } };
+        auto const stop_token = operation->m_stop_source.get_token();
+        auto status = OBPF_ASYNC_CANCELLED;
+        if (not stop_token.stop_requested()) {
+            try {
+                status = work(*operation, stop_token) ? OBPF_ASYNC_SUCCEEDED : OBPF_ASYNC_FAILED;
+            } catch (std::exception const& e) {
+
+                spdlog::error("Asynchronous operation failed: {}", e.what());
+                status = OBPF_ASYNC_FAILED;
+            } catch (...) {
+                spdlog::error("Asynchronous operation failed: unknown error");
+                status = OBPF_ASYNC_FAILED;
+            }
+        }
+        // Operations that have been interrupted report this as a failure.
+        if (status == OBPF_ASYNC_FAILED and stop_token.stop_requested()) {
+            status = OBPF_ASYNC_CANCELLED;
+        }
+        operation->finish(status);
+        operation->release();
+    });
+    return operation;
+}
+
+[[nodiscard]] ObpfAsyncStatus AsyncOperation::status() {
+    auto const lock = std::scoped_lock{ m_mutex };
+    return m_status;
+}
+
+void AsyncOperation::set_callback(ObpfAsyncCallback const callback, void* const user_data) {
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        if (m_status == OBPF_ASYNC_PENDING) {
+            m_callback = callback;
+            m_user_data = user_data;
+            return;
+        }
+    }
+    if (callback != nullptr) {
+        callback(reinterpret_cast<ObpfAsyncOperation*>(this), user_data);
+    }
+}
+
+[[nodiscard]] void* AsyncOperation::take_result() {
+    auto const lock = std::scoped_lock{ m_mutex };
+    if (m_status != OBPF_ASYNC_SUCCEEDED) {
+        return nullptr;
+    }
+    return std::exchange(m_result, nullptr);
+}
+
+[[nodiscard]] u16 AsyncOperation::port() {
+    auto const lock = std::scoped_lock{ m_mutex };
+    return m_port;
+}
+
+void AsyncOperation::cancel() {
+    m_stop_source.request_stop();
+}
+
+void AsyncOperation::release() {
+    if (m_num_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+void AsyncOperation::set_port(u16 const port) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    m_port = port;
+}
+
+void AsyncOperation::finish(ObpfAsyncStatus const status) {
+    auto callback = ObpfAsyncCallback{};
+    auto user_data = static_cast<void*>(nullptr);
+    {
+        auto const lock = std::scoped_lock{ m_mutex };
+        m_status = status;
+        callback = m_callback;
+        user_data = m_user_data;
+    }
+    if (callback != nullptr) {
+        callback(reinterpret_cast<ObpfAsyncOperation*>(this), user_data);
+    }
+}
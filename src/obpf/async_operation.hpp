@@ -0,0 +1,89 @@
+#pragma once
+
+#include <obpf/async.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <lib2k/types.hpp>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+// Runs tasks one after another on a background thread. When the thread is destroyed, the running task is asked to
+// stop via the token it receives and the remaining tasks are dropped.
+class IoThread final {
+public:
+    using Task = std::function<void(std::stop_token const&)>;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<Task> m_tasks;
+    std::jthread m_thread;  // Declared last, so that it is joined before the other members are destroyed.
+
+public:
+    IoThread();
+
+    void post(Task task);
+
+private:
+    void run(std::stop_token const& stop_token);
+};
+
+// Shared by all lobby server connections, since the lobby server handles one request per connection at a time anyway.
+[[nodiscard]] IoThread& lobby_io_thread();
+
+// Connecting to a match blocks until the match starts, so it must not hold up lobby requests.
+[[nodiscard]] IoThread& match_io_thread();
+
+// The state of an operation that has been started via the C API. It is shared by the host and the I/O thread, and
+// destroyed once both have released it.
+class AsyncOperation final {
+public:
+    // Returns whether the operation succeeded. The result (if any) has to be set before returning.
+    using Work = std::function<bool(AsyncOperation& operation, std::stop_token const& stop_token)>;
+
+private:
+    std::mutex m_mutex;
+    ObpfAsyncStatus m_status = OBPF_ASYNC_PENDING;
+    void* m_result = nullptr;
+    void (*m_result_deleter)(void*) = nullptr;
+    u16 m_port = 0;
+    ObpfAsyncCallback m_callback = nullptr;
+    void* m_user_data = nullptr;
+    std::stop_source m_stop_source;
+    std::atomic<int> m_num_references = 2;  // The host and the I/O thread.
+
+    AsyncOperation() = default;
+
+public:
+    AsyncOperation(AsyncOperation const& other) = delete;
+    AsyncOperation(AsyncOperation&& other) noexcept = delete;
+    AsyncOperation& operator=(AsyncOperation const& other) = delete;
+    AsyncOperation& operator=(AsyncOperation&& other) noexcept = delete;
+    ~AsyncOperation();
+
+    // The returned operation is owned by the host, which has to release it.
+    [[nodiscard]] static AsyncOperation* start(IoThread& thread, Work work);
+
+    [[nodiscard]] ObpfAsyncStatus status();
+    void set_callback(ObpfAsyncCallback callback, void* user_data);
+    [[nodiscard]] void* take_result();
+    [[nodiscard]] u16 port();
+    void cancel();
+    void release();
+
+    template<typename T>
+    void set_result(std::unique_ptr<T> result) {
+        auto const lock = std::scoped_lock{ m_mutex };
+        m_result = result.release();
+        m_result_deleter = [](void* const pointer) { delete static_cast<T*>(pointer); };
+    }
+
+    void set_port(u16 port);
+
+private:
+    void finish(ObpfAsyncStatus status);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <obpf_export.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+    // Operations that talk to a server (see the *_async functions in lobby.h and simulator.h) run on a background
+    // thread of the library and return immediately. The host can either poll the status (e.g. once per frame) or
+    // register a callback. Lobby requests run one after another, connecting to a match runs on a thread of its own,
+    // since it waits until the match starts.
+    typedef enum {
+        OBPF_ASYNC_PENDING = 0,
+        OBPF_ASYNC_SUCCEEDED,
+        OBPF_ASYNC_FAILED,
+        OBPF_ASYNC_CANCELLED,
+    } ObpfAsyncStatus;
+
+    struct ObpfAsyncOperation;
+
+    // Called on the background thread once the operation has finished. The operation must not be destroyed from
+    // within the callback.
+    typedef void (*ObpfAsyncCallback)(struct ObpfAsyncOperation* operation, void* user_data);
+
+    // clang-format off
+
+OBPF_EXPORT ObpfAsyncStatus obpf_async_operation_status(struct ObpfAsyncOperation* operation);
+
+// If the operation has already finished, the callback is called immediately (on the calling thread).
+OBPF_EXPORT void obpf_async_operation_set_callback(
+    struct ObpfAsyncOperation* operation,
+    ObpfAsyncCallback callback,
+    void* user_data
+);
+
+// Transfers the ownership of the result to the caller. The type of the result is documented at the function that
+// started the operation. Returns NULL if the operation has not succeeded (yet) or the result has already been taken.
+OBPF_EXPORT void* obpf_async_operation_take_result(struct ObpfAsyncOperation* operation);
+
+// Returns the port of the game server for operations that result in one, 0 otherwise.
+OBPF_EXPORT uint16_t obpf_async_operation_port(struct ObpfAsyncOperation* operation);
+
+// Operations that have not been started yet are skipped. Lobby requests that are already in flight are not
+// interrupted, but connecting to a match stops waiting for the match to start.
+OBPF_EXPORT void obpf_async_operation_cancel(struct ObpfAsyncOperation* operation);
+
+// Cancels the operation if it is still pending. A result that has not been taken is destroyed as well.
+OBPF_EXPORT void obpf_destroy_async_operation(struct ObpfAsyncOperation* operation);
+
+// clang-format on
+
+#ifdef __cplusplus
+}
+#endif
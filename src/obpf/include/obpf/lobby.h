@@ -9,11 +9,13 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "async.h"
 
     // clang-format off
 
 // lobby-server-related functions
 OBPF_EXPORT struct ObpfLobbyServerConnection* obpf_create_lobby_server_connection(char const* host, uint16_t port);
+// Pending asynchronous operations on the connection are finished before it is destroyed.
 OBPF_EXPORT void obpf_destroy_lobby_server_connection(struct ObpfLobbyServerConnection const* lobby_server_connection);
 
 // user-related functions
@@ -52,6 +54,8 @@ OBPF_EXPORT bool obpf_lobby_connection_start_lobby(
     uint16_t* out_server_port
 );
 
+// The connection keeps the last list, so that polling only transfers the changes (or nothing if the server reports that
+// the list has not been modified).
 OBPF_EXPORT struct ObpfLobbyList const* obpf_get_lobby_list(
     struct ObpfLobbyServerConnection* lobby_server_connection
 );
@@ -154,6 +158,62 @@ OBPF_EXPORT char const * obpf_lobby_details_host_name(
     struct ObpfLobbyDetails const* lobby_details
 );
 
+// Asynchronous variants of the functions above (see async.h). The arguments are copied, so only the connection has
+// to outlive the operation. The comments name the result of the operation.
+
+// Result: struct ObpfLobbyUser*
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_connection_register_user_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    char const* username,
+    char const* password
+);
+// Result: struct ObpfLobbyUser*
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_connection_authenticate_user_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    char const* username,
+    char const* password
+);
+// No result. Unlike obpf_lobby_unregister_user(), the user is not destroyed.
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_unregister_user_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    struct ObpfLobbyUser const* user
+);
+// Result: struct ObpfLobby*
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_connection_create_lobby_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    struct ObpfLobbyUser const* user,
+    char const* lobby_name,
+    uint16_t lobby_size
+);
+// No result, the port of the game server can be queried via obpf_async_operation_port().
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_connection_start_lobby_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    struct ObpfLobbyUser const* lobby_user,
+    struct ObpfLobby const* obpf_lobby
+);
+// Result: struct ObpfLobbyList const*
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_get_lobby_list_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection
+);
+// Result: struct ObpfLobby*
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_connection_join_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    struct ObpfLobbyInfo const* lobby_info,
+    struct ObpfLobbyUser const* lobby_user
+);
+// No result, the port of the game server can be queried via obpf_async_operation_port().
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_set_ready_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    struct ObpfLobbyUser const* lobby_user,
+    struct ObpfLobby const* obpf_lobby
+);
+// Result: struct ObpfLobbyDetails const*
+OBPF_EXPORT struct ObpfAsyncOperation* obpf_lobby_connection_get_lobby_details_async(
+    struct ObpfLobbyServerConnection* lobby_server_connection,
+    struct ObpfLobbyInfo const* lobby_info,
+    struct ObpfLobbyUser const* lobby_user
+);
+
 // clang-format on
 
 #ifdef __cplusplus
@@ -10,6 +10,7 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "async.h"
 #include "input.h"
 #include "rotation.h"
 #include "stats.h"
@@ -36,6 +37,26 @@ extern "C" {
         uint8_t bitmask;
     } ObpfKeyState;
 
+    typedef struct {
+        uint64_t frame;
+        ObpfAction action;
+        ObpfTetrominoType piece;  // OBPF_TETROMINO_TYPE_EMPTY for all clears.
+        uint8_t num_lines;        // Only set for line clears and all clears.
+    } ObpfActionEvent;
+
+    typedef enum {
+        OBPF_GAMEPLAY_TRANSPORT_TCP = 0,
+        OBPF_GAMEPLAY_TRANSPORT_UDP,
+    } ObpfGameplayTransport;
+
+    typedef struct {
+        ObpfGameplayTransport transport;
+        double simulated_packet_loss;  // Fraction of outgoing datagrams to drop (for testing only, 0.0 disables it).
+        uint64_t packet_loss_seed;
+        uint8_t board_snapshot_interval;  // If not 0, opponents are not simulated, but updated by server snapshots.
+        char const* replay_path;  // If not NULL, the match is recorded into this file.
+    } ObpfMultiplayerOptions;
+
     // clang-format off
 
     // Tetrion
@@ -60,55 +81,141 @@ extern "C" {
         uint64_t remaining_frames;
     };
 
+#define OBPF_MATRIX_WIDTH 10
+#define OBPF_MATRIX_HEIGHT 22
+#define OBPF_RENDER_STATE_MAX_GARBAGE_EVENTS 16
+
+    // Everything that is needed to render a tetrion.
+    typedef struct {
+        uint64_t next_frame;
+        uint64_t frames_until_game_start;
+        bool is_game_over;
+        uint8_t matrix[OBPF_MATRIX_HEIGHT * OBPF_MATRIX_WIDTH];  // ObpfTetrominoType values, row by row from the top.
+        bool has_active_tetromino;
+        struct ObpfTetromino active_tetromino;
+        bool has_ghost_tetromino;
+        struct ObpfTetromino ghost_tetromino;
+        ObpfPreviewPieces preview_pieces;
+        ObpfTetrominoType hold_piece;  // OBPF_TETROMINO_TYPE_EMPTY if there is none.
+        uint32_t garbage_queue_length;  // Total number of lines (including the events that don't fit below).
+        uint32_t num_garbage_events;    // At most OBPF_RENDER_STATE_MAX_GARBAGE_EVENTS.
+        struct ObpfGarbageEvent garbage_events[OBPF_RENDER_STATE_MAX_GARBAGE_EVENTS];
+        ObpfStats stats;
+        ObpfLineClearDelayState line_clear_delay_state;
+    } ObpfRenderState;
+
     OBPF_EXPORT struct ObpfTetrion* obpf_create_tetrion(uint64_t seed);
     OBPF_EXPORT struct ObpfTetrion* obpf_create_multiplayer_tetrion(
         const char* host,
         uint16_t port,
         const char* player_name
     );
+    OBPF_EXPORT struct ObpfTetrion* obpf_create_multiplayer_tetrion_with_options(
+        const char* host,
+        uint16_t port,
+        const char* player_name,
+        ObpfMultiplayerOptions options
+    );
+    // Rejoins a running match after the connection was lost. The client id can be obtained from the previous
+    // tetrion via obpf_tetrion_client_id(). Returns NULL if the server rejects the reconnection.
+    OBPF_EXPORT struct ObpfTetrion* obpf_reconnect_multiplayer_tetrion(
+        const char* host,
+        uint16_t port,
+        uint8_t client_id,
+        const char* player_name,
+        ObpfMultiplayerOptions options
+    );
+    // Asynchronous variants of the functions above (see async.h), so that the game thread keeps running while
+    // waiting for the match to start. Cancelling the operation closes the connection. Result: struct ObpfTetrion*
+    OBPF_EXPORT struct ObpfAsyncOperation* obpf_create_multiplayer_tetrion_async(
+        const char* host,
+        uint16_t port,
+        const char* player_name,
+        ObpfMultiplayerOptions options
+    );
+    // Result: struct ObpfTetrion*
+    OBPF_EXPORT struct ObpfAsyncOperation* obpf_reconnect_multiplayer_tetrion_async(
+        const char* host,
+        uint16_t port,
+        uint8_t client_id,
+        const char* player_name,
+        ObpfMultiplayerOptions options
+    );
     OBPF_EXPORT struct ObpfObserverList obpf_tetrion_get_observers(struct ObpfTetrion const* tetrion);
     OBPF_EXPORT void obpf_destroy_observers(struct ObpfObserverList observers);
-    OBPF_EXPORT struct ObpfTetrion* obpf_clone_tetrion(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT void obpf_tetrion_set_action_handler(
+    // Observers are only simulated when their state is read, which is why the functions that read the state of a
+    // tetrion take a non-const pointer.
+    OBPF_EXPORT struct ObpfTetrion* obpf_clone_tetrion(struct ObpfTetrion* tetrion);
+    // Serializes the simulation state and returns the size of the snapshot in bytes (0 on failure). Nothing is
+    // written if the buffer is too small, so the required size can be queried by passing NULL and 0.
+    OBPF_EXPORT size_t obpf_tetrion_save_snapshot(
         struct ObpfTetrion* tetrion,
-        ObpfActionHandler handler,
-        void* user_data
+        uint8_t* buffer,
+        size_t buffer_size
     );
+    // Returns NULL if the data is not a valid snapshot. Event recording is disabled for the loaded tetrion.
+    OBPF_EXPORT struct ObpfTetrion* obpf_tetrion_load_snapshot(uint8_t const* data, size_t size);
+    // Hash of the simulation state. Tetrions that have been simulated identically have the same hash.
+    OBPF_EXPORT uint64_t obpf_tetrion_state_hash(struct ObpfTetrion* tetrion);
+    // Events are recorded into a buffer of obpf_event_buffer_capacity() entries (disabled by default). If the buffer
+    // is not drained in time, the oldest events are lost.
+    OBPF_EXPORT void obpf_tetrion_set_event_recording(struct ObpfTetrion* tetrion, bool enabled);
+    // Moves up to `capacity` of the recorded events into `out_events` (oldest first) and returns how many have been
+    // moved.
+    OBPF_EXPORT size_t obpf_tetrion_drain_events(
+        struct ObpfTetrion* tetrion,
+        ObpfActionEvent* out_events,
+        size_t capacity
+    );
+    OBPF_EXPORT size_t obpf_event_buffer_capacity(void);
     OBPF_EXPORT bool obpf_tetrion_is_connected(struct ObpfTetrion const* tetrion);
     OBPF_EXPORT char const* obpf_tetrion_player_name(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT uint64_t obpf_tetrion_frames_until_game_start(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT ObpfStats obpf_tetrion_get_stats(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT bool obpf_tetrion_is_game_over(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT ObpfLineClearDelayState obpf_tetrion_get_line_clear_delay_state(struct ObpfTetrion const* tetrion);
+    OBPF_EXPORT uint8_t obpf_tetrion_client_id(struct ObpfTetrion const* tetrion);
+    OBPF_EXPORT uint64_t obpf_tetrion_frames_until_game_start(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT ObpfStats obpf_tetrion_get_stats(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT bool obpf_tetrion_is_game_over(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT ObpfLineClearDelayState obpf_tetrion_get_line_clear_delay_state(struct ObpfTetrion* tetrion);
     OBPF_EXPORT bool obpf_tetrion_try_get_active_tetromino(
-        struct ObpfTetrion const* tetrion,
+        struct ObpfTetrion* tetrion,
         struct ObpfTetromino* out_tetromino
     );
     OBPF_EXPORT bool obpf_tetrion_try_get_active_tetromino_transform(
-        struct ObpfTetrion const* tetrion,
+        struct ObpfTetrion* tetrion,
         ObpfTetrominoType* out_type,
         ObpfRotation* out_rotation,
         ObpfVec2i* out_position
     );
     OBPF_EXPORT bool obpf_tetrion_try_get_ghost_tetromino(
-        struct ObpfTetrion const* tetrion,
+        struct ObpfTetrion* tetrion,
         struct ObpfTetromino* out_tetromino
     );
-    OBPF_EXPORT ObpfPreviewPieces obpf_tetrion_get_preview_pieces(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT ObpfTetrominoType obpf_tetrion_get_hold_piece(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT uint64_t obpf_tetrion_get_next_frame(struct ObpfTetrion const* tetrion);
+    OBPF_EXPORT ObpfPreviewPieces obpf_tetrion_get_preview_pieces(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT ObpfTetrominoType obpf_tetrion_get_hold_piece(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT uint64_t obpf_tetrion_get_next_frame(struct ObpfTetrion* tetrion);
     OBPF_EXPORT void obpf_tetrion_simulate_next_frame(struct ObpfTetrion* tetrion, ObpfKeyState key_state);
     OBPF_EXPORT void obpf_destroy_tetrion(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT uint32_t obpf_garbage_queue_length(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT uint32_t obpf_garbage_queue_num_events(struct ObpfTetrion const* tetrion);
-    OBPF_EXPORT struct ObpfGarbageEvent obpf_garbage_queue_event(struct ObpfTetrion const* tetrion, uint32_t index);
+    OBPF_EXPORT uint32_t obpf_garbage_queue_length(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT uint32_t obpf_garbage_queue_num_events(struct ObpfTetrion* tetrion);
+    OBPF_EXPORT struct ObpfGarbageEvent obpf_garbage_queue_event(struct ObpfTetrion* tetrion, uint32_t index);
     OBPF_EXPORT uint64_t obpf_garbage_delay_frames(void);
     OBPF_EXPORT uint8_t obpf_tetrion_width(void);
     OBPF_EXPORT uint8_t obpf_tetrion_height(void);
     OBPF_EXPORT uint8_t obpf_tetrion_num_invisible_lines(void);
+    // Fills the given struct with the complete state that is needed to render a frame. This is much cheaper than
+    // querying the pieces and every cell of the matrix separately. Returns false on failure.
+    OBPF_EXPORT bool obpf_tetrion_get_render_state(struct ObpfTetrion* tetrion, ObpfRenderState* out_state);
+
+    // Writes the spans recorded on the hot paths in the Chrome trace event format (e.g. to be opened with Perfetto).
+    // Returns false if the library has been built without tracing or if the file could not be written.
+    OBPF_EXPORT bool obpf_write_trace(char const* path);
 
     // Matrix
-    OBPF_EXPORT ObpfTetrominoType obpf_tetrion_matrix_get(const struct ObpfTetrion* tetrion, ObpfVec2 position);
+    OBPF_EXPORT ObpfTetrominoType obpf_tetrion_matrix_get(struct ObpfTetrion* tetrion, ObpfVec2 position);
+    // Bitmask of the rows that have changed since the mask has been cleared (bit 0 is the top row).
+    OBPF_EXPORT uint32_t obpf_tetrion_matrix_dirty_rows(struct ObpfTetrion* tetrion);
+    // Copies the dirty rows into `out_matrix` (with the layout of ObpfRenderState::matrix, other rows are left
+    // untouched), clears the mask and returns it.
+    OBPF_EXPORT uint32_t obpf_tetrion_matrix_fetch_dirty_rows(struct ObpfTetrion* tetrion, uint8_t* out_matrix);
 
     // clang-format on
 
@@ -2,6 +2,7 @@
 #include <spdlog/spdlog.h>
 #include <iostream>
 #include <network/lobby_server.hpp>
+#include "async_operation.hpp"
 
 ObpfLobbyServerConnection* obpf_create_lobby_server_connection(char const* const host, uint16_t const port) try {
     return reinterpret_cast<ObpfLobbyServerConnection*>(new LobbyServerConnection{ host, port });
@@ -15,7 +16,10 @@ ObpfLobbyServerConnection* obpf_create_lobby_server_connection(char const* const
 }
 
 void obpf_destroy_lobby_server_connection(ObpfLobbyServerConnection const* lobby_server_connection) try {
-    delete reinterpret_cast<LobbyServerConnection const*>(lobby_server_connection);
+    // The lobby requests are processed in order, so this runs after all operations that use the connection.
+    lobby_io_thread().post([lobby_server_connection](std::stop_token const&) {
+        delete reinterpret_cast<LobbyServerConnection const*>(lobby_server_connection);
+    });
 } catch (std::exception const& e) {
 
     spdlog::error("Failed to destroy lobby server connection: {}", e.what());
@@ -456,3 +460,241 @@ char const* obpf_lobby_details_host_name(ObpfLobbyDetails const* lobby_details)
     spdlog::error("Failed to get lobby details host name: unknown error");
     return nullptr;
 }
+
+[[nodiscard]] static ObpfAsyncOperation* start_lobby_operation(AsyncOperation::Work work) {
+    return reinterpret_cast<ObpfAsyncOperation*>(AsyncOperation::start(lobby_io_thread(), std::move(work)));
+}
+
+// clang-format off
+ObpfAsyncOperation* obpf_lobby_connection_register_user_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    char const* const username,
+    char const* const password
+) try {  // clang-format on
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection, username = std::string{ username }, password = std::string{ password }](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto user = connection.register_user(username, password);
+        if (not user.has_value()) {
+            return false;
+        }
+        operation.set_result(std::make_unique<User>(std::move(user).value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to register user asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to register user asynchronously: unknown error");
+    return nullptr;
+}
+
+// clang-format off
+ObpfAsyncOperation* obpf_lobby_connection_authenticate_user_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    char const* const username,
+    char const* const password
+) try {  // clang-format on
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection, username = std::string{ username }, password = std::string{ password }](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto user = connection.authenticate(username, password);
+        if (not user.has_value()) {
+            return false;
+        }
+        operation.set_result(std::make_unique<User>(std::move(user).value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to authenticate user asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to authenticate user asynchronously: unknown error");
+    return nullptr;
+}
+
+// clang-format off
+ObpfAsyncOperation* obpf_lobby_unregister_user_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    ObpfLobbyUser const* const user
+) try {  // clang-format on
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection, user = *reinterpret_cast<User const*>(user)](
+                                     AsyncOperation&,
+                                     std::stop_token const&
+                                 ) mutable {
+        connection.unregister(user);
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to unregister user asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to unregister user asynchronously: unknown error");
+    return nullptr;
+}
+
+ObpfAsyncOperation* obpf_lobby_connection_create_lobby_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    ObpfLobbyUser const* const user,
+    char const* const lobby_name,
+    uint16_t const lobby_size
+) try {
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection,
+                                  user = *reinterpret_cast<User const*>(user),
+                                  settings = LobbySettings{ lobby_name, lobby_size }](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto lobby = connection.create_lobby(user, settings);
+        if (not lobby.has_value()) {
+            return false;
+        }
+        operation.set_result(std::make_unique<Lobby>(std::move(lobby).value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to create lobby asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to create lobby asynchronously: unknown error");
+    return nullptr;
+}
+
+ObpfAsyncOperation* obpf_lobby_connection_start_lobby_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    ObpfLobbyUser const* const lobby_user,
+    ObpfLobby const* const obpf_lobby
+) try {
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection,
+                                  user = *reinterpret_cast<User const*>(lobby_user),
+                                  lobby = *reinterpret_cast<Lobby const*>(obpf_lobby)](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto const result = connection.start(user, lobby);
+        if (not result.has_value()) {
+            return false;
+        }
+        operation.set_port(std::to_underlying(result.value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to start lobby asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to start lobby asynchronously: unknown error");
+    return nullptr;
+}
+
+ObpfAsyncOperation* obpf_get_lobby_list_async(ObpfLobbyServerConnection* const lobby_server_connection) try {
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection](AsyncOperation& operation, std::stop_token const&) {
+        operation.set_result(std::make_unique<LobbyList>(connection.lobbies()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to get lobby list asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to get lobby list asynchronously: unknown error");
+    return nullptr;
+}
+
+// clang-format off
+ObpfAsyncOperation* obpf_lobby_connection_join_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    ObpfLobbyInfo const* const lobby_info,
+    ObpfLobbyUser const* const lobby_user
+) try {  // clang-format on
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection,
+                                  info = *reinterpret_cast<LobbyInfo const*>(lobby_info),
+                                  user = *reinterpret_cast<User const*>(lobby_user)](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto lobby = connection.join(user, info);
+        if (not lobby.has_value()) {
+            return false;
+        }
+        operation.set_result(std::make_unique<Lobby>(std::move(lobby).value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to join lobby asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to join lobby asynchronously: unknown error");
+    return nullptr;
+}
+
+// clang-format off
+ObpfAsyncOperation* obpf_lobby_set_ready_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    ObpfLobbyUser const* const lobby_user,
+    ObpfLobby const* const obpf_lobby
+) try {  // clang-format on
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection,
+                                  user = *reinterpret_cast<User const*>(lobby_user),
+                                  lobby = *reinterpret_cast<Lobby const*>(obpf_lobby)](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto const result = connection.set_ready(user, lobby);
+        if (not result.has_value()) {
+            return false;
+        }
+        operation.set_port(std::to_underlying(result.value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to set ready asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to set ready asynchronously: unknown error");
+    return nullptr;
+}
+
+ObpfAsyncOperation* obpf_lobby_connection_get_lobby_details_async(
+    ObpfLobbyServerConnection* const lobby_server_connection,
+    ObpfLobbyInfo const* const lobby_info,
+    ObpfLobbyUser const* const lobby_user
+) try {
+    auto& connection = *reinterpret_cast<LobbyServerConnection*>(lobby_server_connection);
+    return start_lobby_operation([&connection,
+                                  info = *reinterpret_cast<LobbyInfo const*>(lobby_info),
+                                  user = *reinterpret_cast<User const*>(lobby_user)](
+                                     AsyncOperation& operation,
+                                     std::stop_token const&
+                                 ) {
+        auto details = connection.lobby_details(user, info);
+        if (not details.has_value()) {
+            return false;
+        }
+        operation.set_result(std::make_unique<LobbyDetails>(std::move(details).value()));
+        return true;
+    });
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to get lobby details asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to get lobby details asynchronously: unknown error");
+    return nullptr;
+}
@@ -1,11 +1,80 @@
 #include <obpf/simulator.h>
 #include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <fstream>
 #include <gsl/gsl>
 #include <memory>
 #include <simulator/matrix.hpp>
 #include <simulator/multiplayer_tetrion.hpp>
 #include <simulator/tetrion.hpp>
 #include <simulator/tetromino.hpp>
+#include <simulator/trace.hpp>
+#include <span>
+#include <vector>
+#include "async_operation.hpp"
+
+static_assert(OBPF_MATRIX_WIDTH == Matrix::width and OBPF_MATRIX_HEIGHT == Matrix::height);
+
+[[nodiscard]] static ObpfTetromino to_obpf_tetromino(Tetromino const& tetromino) {
+    auto const& mino_positions = get_mino_positions(tetromino);
+    return ObpfTetromino{
+        .mino_positions = {
+            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(0).x), gsl::narrow<std::uint8_t>(mino_positions.at(0).y), },
+            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(1).x), gsl::narrow<std::uint8_t>(mino_positions.at(1).y), },
+            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(2).x), gsl::narrow<std::uint8_t>(mino_positions.at(2).y), },
+            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(3).x), gsl::narrow<std::uint8_t>(mino_positions.at(3).y), },
+        },
+        .type = static_cast<ObpfTetrominoType>(tetromino.type),
+    };
+}
+
+[[nodiscard]] static ObpfLineClearDelayState to_obpf_line_clear_delay_state(LineClearDelay::State state) {
+    auto& [lines, countdown] = state;
+    auto const original_size = lines.size();
+    while (lines.size() < decltype(lines)::capacity()) {
+        lines.push_back(0);
+    }
+    return ObpfLineClearDelayState{
+        .count = gsl::narrow<u8>(original_size),
+        .lines{
+               lines.at(0),
+               lines.at(1),
+               lines.at(2),
+               lines.at(3),
+               },
+        .countdown = countdown,
+        .delay = LineClearDelay::delay,
+    };
+}
+
+[[nodiscard]] static ObpfGarbageEvent to_obpf_garbage_event(ObpfTetrion const& tetrion, GarbageSendEvent const& event) {
+    // we do the calculation with signed numbers to simplify the implementation
+    auto const remaining_frames = static_cast<u64>(std::max(
+        i64{ 0 },
+        static_cast<i64>(event.frame + ObpfTetrion::garbage_delay_frames) - static_cast<i64>(tetrion.next_frame())
+    ));
+    return ObpfGarbageEvent{
+        .num_lines = event.num_lines,
+        .remaining_frames = remaining_frames,
+    };
+}
+
+[[nodiscard]] static ObpfPreviewPieces to_obpf_preview_pieces(std::array<TetrominoType, 6> const& preview_tetrominos) {
+    ObpfPreviewPieces result{};
+    for (usize i = 0; i < preview_tetrominos.size(); ++i) {
+        result.types[i] = static_cast<ObpfTetrominoType>(preview_tetrominos.at(i));
+    }
+    return result;
+}
+
+[[nodiscard]] static ObpfStats to_obpf_stats(ObpfTetrion const& tetrion) {
+    return ObpfStats{
+        .score = tetrion.score(),
+        .lines_cleared = tetrion.num_lines_cleared(),
+        .level = tetrion.level(),
+    };
+}
 
 enum class TetrominoSelection {
     ActiveTetromino,
@@ -13,27 +82,19 @@ enum class TetrominoSelection {
 };
 
 [[nodiscard]] static bool try_get_tetromino(
-    ObpfTetrion const* const tetrion,
+    ObpfTetrion* const tetrion,
     ObpfTetromino* const out_tetromino,
     TetrominoSelection const selection
 ) {
+    // Observers are simulated lazily, so they have to catch up before their state can be read.
+    tetrion->catch_up();
     auto const tetromino =
         (selection == TetrominoSelection::ActiveTetromino ? tetrion->active_tetromino() : tetrion->ghost_tetromino());
 
     if (not tetromino.has_value()) {
         return false;
     }
-    auto const& mino_positions = get_mino_positions(tetromino.value());
-    auto const result = ObpfTetromino{
-        .mino_positions = {
-            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(0).x), gsl::narrow<std::uint8_t>(mino_positions.at(0).y), },
-            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(1).x), gsl::narrow<std::uint8_t>(mino_positions.at(1).y), },
-            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(2).x), gsl::narrow<std::uint8_t>(mino_positions.at(2).y), },
-            ObpfVec2{ gsl::narrow<std::uint8_t>(mino_positions.at(3).x), gsl::narrow<std::uint8_t>(mino_positions.at(3).y), },
-        },
-        .type = static_cast<ObpfTetrominoType>(tetromino->type),
-    };
-    *out_tetromino = result;
+    *out_tetromino = to_obpf_tetromino(tetromino.value());
     return true;
 }
 
@@ -48,6 +109,16 @@ ObpfTetrion* obpf_create_tetrion(uint64_t const seed) try {
     return nullptr;
 }
 
+[[nodiscard]] static MultiplayerOptions to_multiplayer_options(ObpfMultiplayerOptions const& options) {
+    return MultiplayerOptions{
+        .transport = (options.transport == OBPF_GAMEPLAY_TRANSPORT_UDP ? GameplayTransport::Udp : GameplayTransport::Tcp),
+        .simulated_packet_loss = options.simulated_packet_loss,
+        .packet_loss_seed = options.packet_loss_seed,
+        .board_snapshot_interval = options.board_snapshot_interval,
+        .replay_path = (options.replay_path == nullptr ? std::string{} : std::string{ options.replay_path }),
+    };
+}
+
 ObpfTetrion* obpf_create_multiplayer_tetrion(char const* const host, uint16_t const port, char const* const player_name) try {
     auto tetrion = MultiplayerTetrion::create(host, port, player_name);
     if (tetrion == nullptr) {
@@ -63,6 +134,112 @@ ObpfTetrion* obpf_create_multiplayer_tetrion(char const* const host, uint16_t co
     return nullptr;
 }
 
+ObpfTetrion* obpf_create_multiplayer_tetrion_with_options(
+    char const* const host,
+    uint16_t const port,
+    char const* const player_name,
+    ObpfMultiplayerOptions const options
+) try {
+    auto const multiplayer_options = to_multiplayer_options(options);
+    auto tetrion = MultiplayerTetrion::create(host, port, player_name, multiplayer_options);
+    if (tetrion == nullptr) {
+        return nullptr;
+    }
+    return tetrion.release();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to create multiplayer tetrion: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to create multiplayer tetrion: Unknown error");
+    return nullptr;
+}
+
+ObpfTetrion* obpf_reconnect_multiplayer_tetrion(
+    char const* const host,
+    uint16_t const port,
+    uint8_t const client_id,
+    char const* const player_name,
+    ObpfMultiplayerOptions const options
+) try {
+    auto const multiplayer_options = to_multiplayer_options(options);
+    auto tetrion = MultiplayerTetrion::reconnect(host, port, client_id, player_name, multiplayer_options);
+    if (tetrion == nullptr) {
+        return nullptr;
+    }
+    return tetrion.release();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to reconnect multiplayer tetrion: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to reconnect multiplayer tetrion: Unknown error");
+    return nullptr;
+}
+
+ObpfAsyncOperation* obpf_create_multiplayer_tetrion_async(
+    char const* const host,
+    uint16_t const port,
+    char const* const player_name,
+    ObpfMultiplayerOptions const options
+) try {
+    auto work = [host = std::string{ host },
+                 port,
+                 player_name = std::string{ player_name },
+                 multiplayer_options = to_multiplayer_options(options)](
+                    AsyncOperation& operation,
+                    std::stop_token const& stop_token
+                ) {
+        auto tetrion = MultiplayerTetrion::create(host, port, player_name, multiplayer_options, stop_token);
+        if (tetrion == nullptr) {
+            return false;
+        }
+        operation.set_result(std::unique_ptr<ObpfTetrion>{ std::move(tetrion) });
+        return true;
+    };
+    return reinterpret_cast<ObpfAsyncOperation*>(AsyncOperation::start(match_io_thread(), std::move(work)));
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to create multiplayer tetrion asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to create multiplayer tetrion asynchronously: Unknown error");
+    return nullptr;
+}
+
+ObpfAsyncOperation* obpf_reconnect_multiplayer_tetrion_async(
+    char const* const host,
+    uint16_t const port,
+    uint8_t const client_id,
+    char const* const player_name,
+    ObpfMultiplayerOptions const options
+) try {
+    auto work = [host = std::string{ host },
+                 port,
+                 client_id,
+                 player_name = std::string{ player_name },
+                 multiplayer_options = to_multiplayer_options(options)](
+                    AsyncOperation& operation,
+                    std::stop_token const& stop_token
+                ) {
+        auto tetrion =
+            MultiplayerTetrion::reconnect(host, port, client_id, player_name, multiplayer_options, stop_token);
+        if (tetrion == nullptr) {
+            return false;
+        }
+        operation.set_result(std::unique_ptr<ObpfTetrion>{ std::move(tetrion) });
+        return true;
+    };
+    return reinterpret_cast<ObpfAsyncOperation*>(AsyncOperation::start(match_io_thread(), std::move(work)));
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to reconnect multiplayer tetrion asynchronously: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to reconnect multiplayer tetrion asynchronously: Unknown error");
+    return nullptr;
+}
+
 ObpfObserverList obpf_tetrion_get_observers(struct ObpfTetrion const* tetrion) try {
     auto const observers = tetrion->get_observers();
     if (observers.empty()) {
@@ -101,9 +278,10 @@ void obpf_destroy_observers(ObpfObserverList const observers) try {
     spdlog::error("Failed to destroy observers: Unknown error");
 }
 
-ObpfTetrion* obpf_clone_tetrion(ObpfTetrion const* const tetrion) try {
+ObpfTetrion* obpf_clone_tetrion(ObpfTetrion* const tetrion) try {
+    tetrion->catch_up();
     auto result = new ObpfTetrion{ *tetrion };
-    result->set_action_handler(nullptr, nullptr);
+    result->set_event_recording(false);
     return result;
 } catch (std::exception const& e) {
 
@@ -114,23 +292,54 @@ ObpfTetrion* obpf_clone_tetrion(ObpfTetrion const* const tetrion) try {
     return nullptr;
 }
 
-ObpfLineClearDelayState obpf_tetrion_get_line_clear_delay_state(ObpfTetrion const* tetrion) try {
-    auto [lines, countdown] = tetrion->line_clear_delay_state();
-    auto const original_size = lines.size();
-    while (lines.size() < decltype(lines)::capacity()) {
-        lines.push_back(0);
+size_t obpf_tetrion_save_snapshot(
+    ObpfTetrion* const tetrion,
+    uint8_t* const buffer,
+    size_t const buffer_size
+) try {
+    tetrion->catch_up();
+    // Reused across calls to avoid allocating for every snapshot.
+    thread_local auto snapshot = std::vector<u8>{};
+    tetrion->save_snapshot(snapshot);
+    if (buffer != nullptr and snapshot.size() <= buffer_size) {
+        std::ranges::copy(snapshot, buffer);
     }
-    return ObpfLineClearDelayState{
-        .count = gsl::narrow<u8>(original_size),
-        .lines{
-               lines.at(0),
-               lines.at(1),
-               lines.at(2),
-               lines.at(3),
-               },
-        .countdown = countdown,
-        .delay = LineClearDelay::delay,
-    };
+    return snapshot.size();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to save snapshot: {}", e.what());
+    return 0;
+} catch (...) {
+    spdlog::error("Failed to save snapshot: Unknown error");
+    return 0;
+}
+
+ObpfTetrion* obpf_tetrion_load_snapshot(uint8_t const* const data, size_t const size) try {
+    return new ObpfTetrion{ ObpfTetrion::load_snapshot(std::span{ data, size }) };
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to load snapshot: {}", e.what());
+    return nullptr;
+} catch (...) {
+    spdlog::error("Failed to load snapshot: Unknown error");
+    return nullptr;
+}
+
+uint64_t obpf_tetrion_state_hash(ObpfTetrion* const tetrion) try {
+    tetrion->catch_up();
+    return tetrion->state_hash();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to compute state hash: {}", e.what());
+    return 0;
+} catch (...) {
+    spdlog::error("Failed to compute state hash: Unknown error");
+    return 0;
+}
+
+ObpfLineClearDelayState obpf_tetrion_get_line_clear_delay_state(ObpfTetrion* tetrion) try {
+    tetrion->catch_up();
+    return to_obpf_line_clear_delay_state(tetrion->line_clear_delay_state());
 } catch (std::exception const& e) {
 
     spdlog::error("Failed to get line clear delay state: {}", e.what());
@@ -150,7 +359,7 @@ ObpfLineClearDelayState obpf_tetrion_get_line_clear_delay_state(ObpfTetrion cons
     };
 }
 
-bool obpf_tetrion_try_get_active_tetromino(ObpfTetrion const* const tetrion, ObpfTetromino* const out_tetromino) try {
+bool obpf_tetrion_try_get_active_tetromino(ObpfTetrion* const tetrion, ObpfTetromino* const out_tetromino) try {
     return try_get_tetromino(tetrion, out_tetromino, TetrominoSelection::ActiveTetromino);
 } catch (std::exception const& e) {
 
@@ -162,11 +371,12 @@ bool obpf_tetrion_try_get_active_tetromino(ObpfTetrion const* const tetrion, Obp
 }
 
 bool obpf_tetrion_try_get_active_tetromino_transform(
-    struct ObpfTetrion const* const tetrion,
+    struct ObpfTetrion* const tetrion,
     ObpfTetrominoType* const out_type,
     ObpfRotation* const out_rotation,
     ObpfVec2i* const out_position
 ) try {
+    tetrion->catch_up();
     auto const tetromino = tetrion->active_tetromino();
     if (not tetromino.has_value()) {
         return false;
@@ -193,7 +403,7 @@ bool obpf_tetrion_try_get_active_tetromino_transform(
     return false;
 }
 
-bool obpf_tetrion_try_get_ghost_tetromino(ObpfTetrion const* tetrion, ObpfTetromino* out_tetromino) try {
+bool obpf_tetrion_try_get_ghost_tetromino(ObpfTetrion* tetrion, ObpfTetromino* out_tetromino) try {
     return try_get_tetromino(tetrion, out_tetromino, TetrominoSelection::GhostTetromino);
 } catch (std::exception const& e) {
 
@@ -204,7 +414,8 @@ bool obpf_tetrion_try_get_ghost_tetromino(ObpfTetrion const* tetrion, ObpfTetrom
     return false;
 }
 
-uint64_t obpf_tetrion_get_next_frame(ObpfTetrion const* const tetrion) try {
+uint64_t obpf_tetrion_get_next_frame(ObpfTetrion* const tetrion) try {
+    tetrion->catch_up();
     return tetrion->next_frame();
 } catch (std::exception const& e) {
 
@@ -239,25 +450,19 @@ void obpf_destroy_tetrion(ObpfTetrion const* const tetrion) try {
     spdlog::error("Failed to destroy tetrion: Unknown error");
 }
 
-std::uint32_t obpf_garbage_queue_length(ObpfTetrion const* const tetrion) {
+std::uint32_t obpf_garbage_queue_length(ObpfTetrion* const tetrion) {
+    tetrion->catch_up();
     return tetrion->garbage_queue_length();
 }
 
-std::uint32_t obpf_garbage_queue_num_events(ObpfTetrion const* const tetrion) {
+std::uint32_t obpf_garbage_queue_num_events(ObpfTetrion* const tetrion) {
+    tetrion->catch_up();
     return static_cast<std::uint32_t>(tetrion->garbage_queue_num_events());
 }
 
-ObpfGarbageEvent obpf_garbage_queue_event(ObpfTetrion const* const tetrion, uint32_t const index) try {
-    auto const event = tetrion->garbage_queue_event(static_cast<std::size_t>(index));
-    // we do the calculation with signed numbers to simplify the implementation
-    auto const remaining_frames = static_cast<u64>(std::max(
-        i64{ 0 },
-        static_cast<i64>(event.frame + ObpfTetrion::garbage_delay_frames) - static_cast<i64>(tetrion->next_frame())
-    ));
-    return ObpfGarbageEvent{
-        .num_lines = event.num_lines,
-        .remaining_frames = remaining_frames,
-    };
+ObpfGarbageEvent obpf_garbage_queue_event(ObpfTetrion* const tetrion, uint32_t const index) try {
+    tetrion->catch_up();
+    return to_obpf_garbage_event(*tetrion, tetrion->garbage_queue_event(static_cast<std::size_t>(index)));
 } catch (std::exception const& e) {
 
     spdlog::error("Failed to fetch garbage queue event: {}", e.what());
@@ -279,7 +484,8 @@ std::uint8_t obpf_tetrion_num_invisible_lines() {
     return uint8_t{ Matrix::num_invisible_lines };
 }
 
-ObpfTetrominoType obpf_tetrion_matrix_get(ObpfTetrion const* const tetrion, ObpfVec2 const position) try {
+ObpfTetrominoType obpf_tetrion_matrix_get(ObpfTetrion* const tetrion, ObpfVec2 const position) try {
+    tetrion->catch_up();
     auto const pos = Vec2{ position.x, position.y };
     return static_cast<ObpfTetrominoType>(tetrion->matrix()[pos]);
 } catch (std::exception const& e) {
@@ -291,13 +497,84 @@ ObpfTetrominoType obpf_tetrion_matrix_get(ObpfTetrion const* const tetrion, Obpf
     return OBPF_TETROMINO_TYPE_EMPTY;
 }
 
-ObpfPreviewPieces obpf_tetrion_get_preview_pieces(ObpfTetrion const* tetrion) try {
-    auto const preview_tetrominos = tetrion->get_preview_tetrominos();
-    ObpfPreviewPieces result{};
-    for (usize i = 0; i < preview_tetrominos.size(); ++i) {
-        result.types[i] = static_cast<ObpfTetrominoType>(preview_tetrominos.at(i));
+bool obpf_tetrion_get_render_state(ObpfTetrion* const tetrion, ObpfRenderState* const out_state) try {
+    tetrion->catch_up();
+    auto state = ObpfRenderState{};
+    state.next_frame = tetrion->next_frame();
+    state.frames_until_game_start = tetrion->frames_until_game_start();
+    state.is_game_over = tetrion->game_over_since_frame().has_value();
+    std::ranges::transform(tetrion->matrix().minos(), std::begin(state.matrix), [](TetrominoType const type) {
+        return static_cast<u8>(std::to_underlying(type));
+    });
+    if (auto const active_tetromino = tetrion->active_tetromino(); active_tetromino.has_value()) {
+        state.has_active_tetromino = true;
+        state.active_tetromino = to_obpf_tetromino(active_tetromino.value());
     }
-    return result;
+    if (auto const ghost_tetromino = tetrion->ghost_tetromino(); ghost_tetromino.has_value()) {
+        state.has_ghost_tetromino = true;
+        state.ghost_tetromino = to_obpf_tetromino(ghost_tetromino.value());
+    }
+    state.preview_pieces = to_obpf_preview_pieces(tetrion->get_preview_tetrominos());
+    state.hold_piece = static_cast<ObpfTetrominoType>(tetrion->hold_piece().value_or(TetrominoType::Empty));
+    state.garbage_queue_length = tetrion->garbage_queue_length();
+    auto const num_garbage_events =
+        std::min(tetrion->garbage_queue_num_events(), usize{ OBPF_RENDER_STATE_MAX_GARBAGE_EVENTS });
+    for (auto i = usize{ 0 }; i < num_garbage_events; ++i) {
+        state.garbage_events[i] = to_obpf_garbage_event(*tetrion, tetrion->garbage_queue_event(i));
+    }
+    state.num_garbage_events = gsl::narrow<u32>(num_garbage_events);
+    state.stats = to_obpf_stats(*tetrion);
+    state.line_clear_delay_state = to_obpf_line_clear_delay_state(tetrion->line_clear_delay_state());
+    *out_state = state;
+    return true;
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to get render state: {}", e.what());
+    return false;
+} catch (...) {
+    spdlog::error("Failed to get render state: Unknown error");
+    return false;
+}
+
+std::uint32_t obpf_tetrion_matrix_dirty_rows(ObpfTetrion* const tetrion) try {
+    tetrion->catch_up();
+    return tetrion->matrix().dirty_rows();
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to get dirty rows: {}", e.what());
+    return 0;
+} catch (...) {
+    spdlog::error("Failed to get dirty rows: Unknown error");
+    return 0;
+}
+
+std::uint32_t obpf_tetrion_matrix_fetch_dirty_rows(ObpfTetrion* const tetrion, std::uint8_t* const out_matrix) try {
+    tetrion->catch_up();
+    auto& matrix = tetrion->matrix();
+    auto const dirty_rows = matrix.dirty_rows();
+    auto const minos = matrix.minos();
+    for (auto row = usize{ 0 }; row < Matrix::height; ++row) {
+        if ((dirty_rows & (u32{ 1 } << row)) == 0) {
+            continue;
+        }
+        for (auto i = row * Matrix::width; i < (row + 1) * Matrix::width; ++i) {
+            out_matrix[i] = static_cast<u8>(std::to_underlying(minos[i]));
+        }
+    }
+    matrix.clear_dirty_rows();
+    return dirty_rows;
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to fetch dirty rows: {}", e.what());
+    return 0;
+} catch (...) {
+    spdlog::error("Failed to fetch dirty rows: Unknown error");
+    return 0;
+}
+
+ObpfPreviewPieces obpf_tetrion_get_preview_pieces(ObpfTetrion* tetrion) try {
+    tetrion->catch_up();
+    return to_obpf_preview_pieces(tetrion->get_preview_tetrominos());
 } catch (std::exception const& e) {
 
     spdlog::error("Failed to get preview pieces: {}", e.what());
@@ -331,7 +608,8 @@ ObpfMinoPositions obpf_tetromino_get_mino_positions(ObpfTetrominoType const type
     return ObpfMinoPositions{};
 }
 
-ObpfTetrominoType obpf_tetrion_get_hold_piece(ObpfTetrion const* const tetrion) try {
+ObpfTetrominoType obpf_tetrion_get_hold_piece(ObpfTetrion* const tetrion) try {
+    tetrion->catch_up();
     if (auto const hold_piece = tetrion->hold_piece(); hold_piece.has_value()) {
         return static_cast<ObpfTetrominoType>(hold_piece.value());
     }
@@ -360,12 +638,9 @@ ObpfKeyState obpf_key_state_create(
     };
 }
 
-ObpfStats obpf_tetrion_get_stats(ObpfTetrion const* tetrion) try {
-    return ObpfStats{
-        .score = tetrion->score(),
-        .lines_cleared = tetrion->num_lines_cleared(),
-        .level = tetrion->level(),
-    };
+ObpfStats obpf_tetrion_get_stats(ObpfTetrion* tetrion) try {
+    tetrion->catch_up();
+    return to_obpf_stats(*tetrion);
 } catch (std::exception const& e) {
 
     spdlog::error("Failed to get stats: {}", e.what());
@@ -375,7 +650,8 @@ ObpfStats obpf_tetrion_get_stats(ObpfTetrion const* tetrion) try {
     return ObpfStats{};
 }
 
-bool obpf_tetrion_is_game_over(ObpfTetrion const* const tetrion) try {
+bool obpf_tetrion_is_game_over(ObpfTetrion* const tetrion) try {
+    tetrion->catch_up();
     return tetrion->game_over_since_frame().has_value();
 } catch (std::exception const& e) {
 
@@ -386,13 +662,44 @@ bool obpf_tetrion_is_game_over(ObpfTetrion const* const tetrion) try {
     return false;
 }
 
-void obpf_tetrion_set_action_handler(ObpfTetrion* const tetrion, ObpfActionHandler const handler, void* const user_data) try {
-    tetrion->set_action_handler(handler, user_data);
+void obpf_tetrion_set_event_recording(ObpfTetrion* const tetrion, bool const enabled) try {
+    tetrion->set_event_recording(enabled);
+} catch (std::exception const& e) {
+
+    spdlog::error("Failed to set event recording: {}", e.what());
+} catch (...) {
+    spdlog::error("Failed to set event recording: Unknown error");
+}
+
+std::size_t obpf_tetrion_drain_events(
+    ObpfTetrion* const tetrion,
+    ObpfActionEvent* const out_events,
+    std::size_t const capacity
+) try {
+    tetrion->catch_up();
+    auto events = std::array<Event, EventBuffer::capacity>{};
+    auto const count = tetrion->events().drain(std::span{ events }.first(std::min(capacity, events.size())));
+    for (auto i = usize{ 0 }; i < count; ++i) {
+        auto const& event = events.at(i);
+        out_events[i] = ObpfActionEvent{
+            .frame = event.frame,
+            .action = static_cast<ObpfAction>(event.action),
+            .piece = static_cast<ObpfTetrominoType>(event.piece),
+            .num_lines = event.num_lines,
+        };
+    }
+    return count;
 } catch (std::exception const& e) {
 
-    spdlog::error("Failed to set action handler: {}", e.what());
+    spdlog::error("Failed to drain events: {}", e.what());
+    return 0;
 } catch (...) {
-    spdlog::error("Failed to set action handler: Unknown error");
+    spdlog::error("Failed to drain events: Unknown error");
+    return 0;
+}
+
+std::size_t obpf_event_buffer_capacity() {
+    return EventBuffer::capacity;
 }
 
 bool obpf_tetrion_is_connected(ObpfTetrion const* tetrion) {
@@ -403,10 +710,30 @@ char const* obpf_tetrion_player_name(ObpfTetrion const* const tetrion) {
     return tetrion->player_name().c_str();
 }
 
-std::uint64_t obpf_tetrion_frames_until_game_start(ObpfTetrion const* tetrion) {
+uint8_t obpf_tetrion_client_id(ObpfTetrion const* const tetrion) {
+    return tetrion->id();
+}
+
+std::uint64_t obpf_tetrion_frames_until_game_start(ObpfTetrion* tetrion) {
+    tetrion->catch_up();
     return tetrion->frames_until_game_start();
 }
 
 std::uint64_t obpf_garbage_delay_frames() {
     return ObpfTetrion::garbage_delay_frames;
 }
+
+bool obpf_write_trace(char const* const path) try {
+    if (not is_tracing_enabled()) {
+        return false;
+    }
+    auto file = std::ofstream{ path };
+    write_chrome_trace(file);
+    return static_cast<bool>(file);
+} catch (std::exception const& e) {
+    spdlog::error("Failed to write trace: {}", e.what());
+    return false;
+} catch (...) {
+    spdlog::error("Failed to write trace: Unknown error");
+    return false;
+}
@@ -0,0 +1,95 @@
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <simulator/replay_verifier.hpp>
+#include <string_view>
+#include <vector>
+
+[[nodiscard]] static std::optional<usize> parse_thread_count(std::string_view const chars) {
+    auto value = usize{};
+    auto const end = chars.data() + chars.length();
+    auto const result = std::from_chars(chars.data(), end, value);
+    if (result.ptr != end or result.ec != std::errc{} or value == 0) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+static constexpr auto threads_flag = std::string_view{ "--threads=" };
+static constexpr auto threads_per_replay_flag = std::string_view{ "--threads-per-replay=" };
+
+static void print_usage(char const* const program_name) {
+    std::cout << std::format(
+        "Usage: {} [{}<count>] [{}<count>] <replay>...\n",
+        program_name,
+        threads_flag,
+        threads_per_replay_flag
+    );
+}
+
+int main(int const argc, char const* const* const argv) {
+    auto paths = std::vector<std::filesystem::path>{};
+    auto options = ReplayVerificationOptions{};
+    for (auto i = 1; i < argc; ++i) {
+        auto const argument = std::string_view{ argv[i] };
+        if (argument.starts_with(threads_flag) or argument.starts_with(threads_per_replay_flag)) {
+            auto const is_per_replay = argument.starts_with(threads_per_replay_flag);
+            auto const flag = (is_per_replay ? threads_per_replay_flag : threads_flag);
+            auto const value = argument.substr(flag.length());
+            auto const count = parse_thread_count(value);
+            if (not count.has_value()) {
+                std::cout << std::format("'{}' is not a valid number of threads\n", value);
+                return EXIT_FAILURE;
+            }
+            (is_per_replay ? options.threads_per_replay : options.num_threads) = count.value();
+        } else if (argument.starts_with("--")) {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            paths.emplace_back(argument);
+        }
+    }
+    if (paths.empty()) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto const start_time = std::chrono::steady_clock::now();
+    auto const results = verify_replays(paths, options);
+    auto const duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time);
+
+    auto num_failed = usize{ 0 };
+    auto num_frames = u64{ 0 };
+    for (auto const& result : results) {
+        if (result.error.has_value()) {
+            std::cout << std::format("{}: error: {}\n", result.path.string(), result.error.value());
+            ++num_failed;
+            continue;
+        }
+        num_frames += result.num_frames * result.players.size();
+        std::cout << std::format("{}: {} frames\n", result.path.string(), result.num_frames);
+        for (auto const& player : result.players) {
+            auto const game_over = player.game_over_since_frame.has_value()
+                                       ? std::format("game over at frame {}", player.game_over_since_frame.value())
+                                       : std::string{ "survived" };
+            std::cout << std::format(
+                "  {} '{}': score {}, {} lines, {}\n",
+                player.client_id,
+                player.name,
+                player.score,
+                player.num_lines_cleared,
+                game_over
+            );
+        }
+    }
+    std::cout << std::format(
+        "verified {} of {} replays in {:.2f} s ({:.0f} tetrion frames per second)\n",
+        results.size() - num_failed,
+        results.size(),
+        duration.count(),
+        static_cast<double>(num_frames) / duration.count()
+    );
+    return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
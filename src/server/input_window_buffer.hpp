@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <lib2k/types.hpp>
+#include <network/constants.hpp>
+#include <simulator/key_state.hpp>
+
+// Fixed-capacity queue of the input windows of a single client that have not been simulated yet. Windows are
+// identified by their last frame (just like in Heartbeat messages) and can only be appended in order and without
+// gaps. This bounds both the memory used per client and the number of frames the server has to simulate at once.
+class InputWindowBuffer final {
+public:
+    using Window = std::array<KeyState, heartbeat_interval>;
+
+    // 16 windows correspond to 4 seconds of gameplay.
+    static constexpr auto capacity = usize{ 16 };
+
+    enum class AppendResult {
+        Appended,
+        Full,          // The window is valid, but has to be delayed until there's enough space.
+        Outdated,      // The window has already been received (or filled in by the server).
+        TooFarAhead,   // There would be a gap between the already received windows and this one.
+        Misaligned,    // The frame does not mark the end of a window.
+    };
+
+private:
+    std::array<Window, capacity> m_windows{};
+    usize m_first_index = 0;
+    usize m_size = 0;
+    u64 m_num_received_key_states = 0;
+
+public:
+    InputWindowBuffer() = default;
+
+    // Used for clients that join an already running match. `first_frame` has to be the first frame of a window.
+    explicit InputWindowBuffer(u64 const first_frame)
+        : m_num_received_key_states{ first_frame } {
+        assert(first_frame % heartbeat_interval == 0);
+    }
+
+    [[nodiscard]] AppendResult try_append(u64 const window_frame, Window const& window) {
+        if ((window_frame + 1) % heartbeat_interval != 0) {
+            return AppendResult::Misaligned;
+        }
+        auto const window_start = window_frame + 1 - heartbeat_interval;
+        if (window_start < m_num_received_key_states) {
+            return AppendResult::Outdated;
+        }
+        if (window_start > m_num_received_key_states) {
+            return AppendResult::TooFarAhead;
+        }
+        if (is_full()) {
+            return AppendResult::Full;
+        }
+        m_windows.at((m_first_index + m_size) % capacity) = window;
+        ++m_size;
+        m_num_received_key_states += heartbeat_interval;
+        return AppendResult::Appended;
+    }
+
+    [[nodiscard]] Window const& front() const {
+        assert(not empty());
+        return m_windows.at(m_first_index);
+    }
+
+    void pop_front() {
+        assert(not empty());
+        m_first_index = (m_first_index + 1) % capacity;
+        --m_size;
+    }
+
+    [[nodiscard]] usize size() const {
+        return m_size;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return m_size == 0;
+    }
+
+    [[nodiscard]] bool is_full() const {
+        return m_size == capacity;
+    }
+
+    // Total number of key states that have ever been appended, i.e. the first frame of the next window.
+    [[nodiscard]] u64 num_received_key_states() const {
+        return m_num_received_key_states;
+    }
+};
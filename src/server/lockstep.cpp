@@ -0,0 +1,165 @@
+#include "lockstep.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <map>
+#include <ranges>
+#include <simulator/log_rate_limiter.hpp>
+#include <simulator/trace.hpp>
+
+[[nodiscard]] InputWindowBuffer::AppendResult append_heartbeat(ClientInfo& client_info, Heartbeat const& heartbeat) {
+    check_state_hash(client_info, heartbeat.state_hash);
+    return client_info.input_windows.try_append(heartbeat.frame, heartbeat.key_states);
+}
+
+// Clients report the hash of their own tetrion as simulated using the broadcasts. These contain exactly the key states
+// the server used, so a different hash means that the simulations diverged (e.g. because of a determinism bug).
+void check_state_hash(ClientInfo& client_info, StateHash const& reported_hash) {
+    if (reported_hash.frame <= client_info.last_checked_state_hash_frame) {
+        // Either there is no hash yet, or it has already been checked (heartbeats may be sent multiple times).
+        return;
+    }
+    auto const own_hash = std::ranges::find(client_info.state_hashes, reported_hash.frame, &StateHash::frame);
+    if (own_hash == client_info.state_hashes.cend()) {
+        static auto log_limiter = LogRateLimiter{};
+        log_rate_limited(
+            log_limiter,
+            spdlog::level::warn,
+            "unable to check state hash of client {} for frame {}",
+            client_info.id,
+            reported_hash.frame
+        );
+        return;
+    }
+    client_info.last_checked_state_hash_frame = reported_hash.frame;
+    if (own_hash->hash == reported_hash.hash or client_info.desynchronized_since_frame.has_value()) {
+        return;
+    }
+    // Once diverged, the simulations never converge again, so this is only reported once.
+    client_info.desynchronized_since_frame = reported_hash.frame;
+    spdlog::error(
+        "desync detected: state of client {} differs from the one simulated by the server (frame {})",
+        client_info.id,
+        reported_hash.frame
+    );
+}
+
+// Clients that are more than `lag_budget` frames behind the most advanced client get neutral key states, one
+// window at a time, so that the other clients don't have to wait for them. The filled in key states are
+// provisional in the sense that they are not the real inputs of the client, but they are final: the real key
+// states for these windows are rejected when they arrive later on, and the client has to reconcile its own
+// simulation with the broadcast key states.
+void fill_in_for_stragglers(std::vector<ClientInfo>& client_infos, u64 const lag_budget) {
+    auto connected_clients = client_infos | std::views::filter([](ClientInfo const& client_info) {
+                                 return client_info.is_connected();
+                             });
+    auto const most_advanced = std::ranges::max(connected_clients | std::views::transform([](ClientInfo const& info) {
+                                                    return info.input_windows.num_received_key_states();
+                                                }));
+    for (auto& client_info : connected_clients) {
+        while (client_info.input_windows.num_received_key_states() + lag_budget < most_advanced) {
+            auto const window_frame = client_info.input_windows.num_received_key_states() + heartbeat_interval - 1;
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(
+                log_limiter,
+                spdlog::level::warn,
+                "client {} exceeds the lag budget, using provisional key states for window ending at frame {}",
+                client_info.id,
+                window_frame
+            );
+            // This client is behind the most advanced one, so there's enough space in its buffer.
+            [[maybe_unused]] auto const result = client_info.input_windows.try_append(window_frame, {});
+            assert(result == InputWindowBuffer::AppendResult::Appended);
+            client_info.num_provisional_key_states += heartbeat_interval;
+        }
+    }
+}
+
+[[nodiscard]] bool is_next_window_complete(std::vector<ClientInfo> const& client_infos) {
+    return std::ranges::none_of(client_infos, [](ClientInfo const& client_info) {
+        return client_info.is_connected() and client_info.input_windows.empty();
+    });
+}
+
+// clang-format off
+[[nodiscard]] static StateBroadcast create_broadcast_message(
+    std::vector<ClientInfo> & client_infos,
+    std::uint64_t const frame
+) {  // clang-format on
+    SPDLOG_DEBUG("creating broadcast message for frame {}", frame);
+
+    auto client_states = std::vector<StateBroadcast::ClientStates>{};
+    for (auto& client_info : client_infos) {
+        if (not client_info.is_connected()) {
+            // The server simulated neutral key states for this client.
+            client_states.emplace_back(client_info.id, InputWindowBuffer::Window{});
+            continue;
+        }
+        client_states.emplace_back(client_info.id, client_info.input_windows.front());
+        client_info.input_windows.pop_front();
+    }
+
+    return StateBroadcast{ frame, std::move(client_states) };
+}
+
+[[nodiscard]] StateBroadcast simulate_window(std::vector<ClientInfo>& client_infos) {
+    OBPF_TRACE_SCOPE("simulate_window");
+    for (auto i = usize{ 0 }; i < heartbeat_interval; ++i) {
+        auto garbage_send_events = std::map<u8, GarbageSendEvent>{};
+        for (auto& client_info : client_infos) {
+            if (not client_info.is_connected()) {
+                continue;
+            }
+            auto const key_state = client_info.input_windows.front().at(i);
+            auto& tetrion = client_info.tetrion;
+            // clang-format off
+            if (
+                auto const garbage_send_event = tetrion.simulate_next_frame(key_state);
+                garbage_send_event.has_value()
+            ) {  // clang-format on
+                garbage_send_events.emplace(client_info.id, garbage_send_event.value());
+            }
+        }
+        auto const tetrions = client_infos
+                              | std::views::transform([](auto& client_info) -> ObpfTetrion* {
+                                    return &client_info.tetrion;
+                                })
+                              | std::ranges::to<std::vector>();
+        for (auto const& [receiver, garbage_send_event] : deliver_garbage(tetrions, garbage_send_events)) {
+            auto const target = std::ranges::find_if(client_infos, [receiver](ClientInfo const& client_info) {
+                return &client_info.tetrion == receiver;
+            });
+            if (target != client_infos.end() and target->board_snapshot_interval > 0) {
+                target->received_garbage.push_back(garbage_send_event);
+            }
+        }
+    }
+
+    // first we need to find the minimum number of frames simulated by any client that is connected
+    auto const min_num_frames_simulated = std::ranges::min(
+        client_infos | std::views::filter([](auto const& client_info) { return client_info.is_connected(); })
+        | std::views::transform([](auto const& client_info) { return client_info.tetrion.next_frame(); })
+    );
+
+    // to not block the broadcasting, we will create empty key states for all clients that are not connected
+    for (auto& client_info : client_infos) {
+        if (not client_info.is_connected()) {
+            while (client_info.tetrion.next_frame() < min_num_frames_simulated) {
+                static constexpr auto key_state = KeyState{};
+                // We simulate the frame here, because we won't receive any key states from the client.
+                // We ignore the return value because this client is not allowed to send any garbage since
+                // it is not connected anymore.
+                std::ignore = client_info.tetrion.simulate_next_frame(key_state);
+            }
+        }
+    }
+
+    for (auto& client_info : client_infos) {
+        auto& state_hashes = client_info.state_hashes;
+        state_hashes.push_back(StateHash{ client_info.tetrion.next_frame(), client_info.tetrion.state_hash() });
+        if (state_hashes.size() > max_num_state_hashes) {
+            state_hashes.pop_front();
+        }
+    }
+
+    return create_broadcast_message(client_infos, min_num_frames_simulated - 1);
+}
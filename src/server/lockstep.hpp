@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <lib2k/types.hpp>
+#include <network/messages.hpp>
+#include <network/udp_socket.hpp>
+#include <optional>
+#include <simulator/player_tetrion.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "input_window_buffer.hpp"
+
+// The lockstep simulation of a match as done by the server, independent of how the messages get to and from the
+// clients. Used by the Server and by SimulatedMatch.
+
+enum class ClientState {
+    Connected,
+    Identified,
+    Disconnected,
+};
+
+struct ClientInfo final {
+    u8 id;
+    PlayerTetrion tetrion;
+    InputWindowBuffer input_windows;
+    ClientState state = ClientState::Connected;
+    std::string player_name;  // Not filled by constructor, because the name is transferred later.
+    u64 num_provisional_key_states = 0;  // Filled in by the server because the client exceeded the lag budget.
+
+    // Only used if the client sends its heartbeats via UDP. Datagrams are only accepted from the host of the TCP
+    // connection, so that nobody else can take over the endpoint of a client by guessing its id.
+    std::optional<std::array<u8, 4>> peer_address;
+    std::optional<UdpEndpoint> datagram_endpoint;
+    std::deque<StateBroadcast> unacknowledged_broadcasts;
+
+    // Only used if the client subscribed to board snapshots (0 means it simulates the other tetrions itself).
+    u8 board_snapshot_interval = 0;
+    std::vector<GarbageSendEvent> received_garbage;  // Received during the window that is currently simulated.
+
+    bool is_recorded_as_connected = true;  // Only used if the match is recorded.
+
+    // Hashes of the tetrion state at the end of the most recent windows, to be compared with the ones reported by
+    // the client.
+    std::deque<StateHash> state_hashes;
+    u64 last_checked_state_hash_frame = 0;
+    std::optional<u64> desynchronized_since_frame;
+
+    explicit ClientInfo(u8 const id, u64 const seed, u64 const start_frame)
+        : id{ id }, tetrion{ seed, start_frame, id, {} } {}
+
+    [[nodiscard]] bool is_connected() const {
+        switch (state) {
+            using enum ClientState;
+            case Connected:
+            case Identified:
+                return true;
+            case Disconnected:
+                return false;
+        }
+        throw std::logic_error{ "unreachable" };
+    }
+};
+
+// 32 windows correspond to 8 seconds, which is plenty of time for a client to answer a broadcast.
+inline constexpr auto max_num_state_hashes = usize{ 32 };
+
+// Checks the state hash reported by the client and queues its key states. Returns Full if the client is too far
+// ahead, in which case the heartbeat has to be appended again later on.
+[[nodiscard]] InputWindowBuffer::AppendResult append_heartbeat(ClientInfo& client_info, Heartbeat const& heartbeat);
+
+void check_state_hash(ClientInfo& client_info, StateHash const& reported_hash);
+
+void fill_in_for_stragglers(std::vector<ClientInfo>& client_infos, u64 lag_budget);
+
+// True if the key states of all connected clients are available for the next window. At least one client has to be
+// connected.
+[[nodiscard]] bool is_next_window_complete(std::vector<ClientInfo> const& client_infos);
+
+// Simulates the next window of all tetrions (neutral key states for disconnected clients) and returns the broadcast
+// for it. Garbage for clients with board snapshots is collected in their `received_garbage`.
+[[nodiscard]] StateBroadcast simulate_window(std::vector<ClientInfo>& client_infos);
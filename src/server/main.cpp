@@ -1,10 +1,20 @@
+#include <spdlog/async.h>
+#include <spdlog/cfg/env.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 #include <concepts>
 #include <iostream>
+#include <lib2k/defer.hpp>
+#include <memory>
+#include <network/http_server.hpp>
 #include <optional>
+#include <simulator/trace.hpp>
 #include <sockets/sockets.hpp>
 #include <string_view>
+#include <vector>
+#include "metrics.hpp"
 #include "server.hpp"
+#include "supervisor.hpp"
 
 template<std::integral Integer>
 [[nodiscard]] constexpr std::optional<Integer> parse_integer(std::string_view const chars, int const base = 10) {
@@ -22,38 +32,240 @@ template<std::integral Integer>
     return std::nullopt;
 }
 
+template<std::floating_point Float>
+[[nodiscard]] std::optional<Float> parse_floating_point(std::string_view const chars) {
+    if (chars.empty()) {
+        return std::nullopt;
+    }
+    auto value = Float{};
+    auto const begin = chars.data();
+    auto const end = chars.data() + chars.length();
+    auto const result = std::from_chars(begin, end, value);
+    auto const successful = (result.ptr == end and result.ec == std::errc{});
+    if (successful) {
+        return value;
+    }
+    return std::nullopt;
+}
+
+struct Options final {
+    double simulated_packet_loss = 0.0;
+    u64 lag_budget = 0;
+    std::optional<std::string_view> replay_path;
+    bool supervise = false;
+    usize pool_size = 2;
+    std::optional<std::uint16_t> metrics_port;
+};
+
+static constexpr auto simulated_packet_loss_flag = std::string_view{ "--simulated-packet-loss=" };
+static constexpr auto lag_budget_flag = std::string_view{ "--lag-budget=" };
+static constexpr auto replay_flag = std::string_view{ "--replay=" };
+static constexpr auto supervise_flag = std::string_view{ "--supervise" };
+static constexpr auto pool_size_flag = std::string_view{ "--pool-size=" };
+static constexpr auto metrics_port_flag = std::string_view{ "--metrics-port=" };
+
+// The console is written to by a thread of its own, so that the threads of the matches never wait for it. If messages
+// are logged faster than they can be written, the oldest ones are dropped. The levels can be set via the environment
+// variable SPDLOG_LEVEL (e.g. SPDLOG_LEVEL=debug), but only levels that have not been compiled out (see
+// `obpf_simulator_active_log_level`) have an effect.
+static void use_async_logging() {
+    static constexpr auto queue_size = usize{ 8192 };
+    spdlog::init_thread_pool(queue_size, 1);
+    auto logger = std::make_shared<spdlog::async_logger>(
+        "server",
+        std::make_shared<spdlog::sinks::stdout_color_sink_mt>(),
+        spdlog::thread_pool(),
+        spdlog::async_overflow_policy::overrun_oldest
+    );
+    spdlog::set_default_logger(std::move(logger));
+    spdlog::cfg::load_env_levels();
+}
+
+// Serves the spans recorded so far, to be opened with Perfetto or chrome://tracing.
+[[nodiscard]] static HttpResponse serve_trace(HttpRequest const& request) {
+    if (not is_tracing_enabled()) {
+        return HttpResponse{ .status = HttpStatus::NotFound, .headers = {}, .body = {} };
+    }
+    if (request.method != "GET") {
+        return HttpResponse{ .status = HttpStatus::BadRequest, .headers = {}, .body = {} };
+    }
+    return HttpResponse{
+        .status = HttpStatus::Ok,
+        .headers = { { "Content-Type", "application/json" } },
+        .body = chrome_trace(),
+    };
+}
+
+static void print_usage(char const* const program_name) {
+    std::cout << std::format(
+        "Usage: {} [<lobby-port>|<gameserver_port> <num_players>] [{}<probability>] [{}<frames>] [{}<path>] "
+        "[{}<port>]\n"
+        "       {} {} <lobby-port> [{}<num_idle_slots>] [{}<probability>] [{}<frames>] [{}<path>] [{}<port>]\n"
+        "Metrics are served in the Prometheus text format at http://<host>:<port>/metrics.\n"
+        "If built with tracing enabled, a trace of the hot paths is served at http://<host>:<port>/trace.\n",
+        program_name,
+        simulated_packet_loss_flag,
+        lag_budget_flag,
+        replay_flag,
+        metrics_port_flag,
+        program_name,
+        supervise_flag,
+        pool_size_flag,
+        simulated_packet_loss_flag,
+        lag_budget_flag,
+        replay_flag,
+        metrics_port_flag
+    );
+}
+
 int main(int const argc, char const* const* const argv) {
-    switch (argc) {
-        case 2: {
-            auto const lobby_port = parse_integer<std::uint16_t>(argv[1]);
+    use_async_logging();
+    // Flushes the queued messages after everything else has been destroyed.
+    auto const shutdown_logging = c2k::Defer{ [] { spdlog::shutdown(); } };
+
+    auto positional_arguments = std::vector<std::string_view>{};
+    auto options = Options{};
+    for (auto i = 1; i < argc; ++i) {
+        auto const argument = std::string_view{ argv[i] };
+        if (argument.starts_with(simulated_packet_loss_flag)) {
+            auto const value = argument.substr(simulated_packet_loss_flag.length());
+            auto const probability = parse_floating_point<double>(value);
+            if (not probability.has_value() or probability.value() < 0.0 or probability.value() > 1.0) {
+                std::cout << std::format("'{}' is not a valid probability\n", value);
+                return EXIT_FAILURE;
+            }
+            options.simulated_packet_loss = probability.value();
+        } else if (argument.starts_with(lag_budget_flag)) {
+            auto const value = argument.substr(lag_budget_flag.length());
+            auto const lag_budget = parse_integer<u64>(value);
+            if (not lag_budget.has_value()) {
+                std::cout << std::format("'{}' is not a valid number of frames\n", value);
+                return EXIT_FAILURE;
+            }
+            options.lag_budget = lag_budget.value();
+        } else if (argument.starts_with(replay_flag)) {
+            auto const value = argument.substr(replay_flag.length());
+            if (value.empty()) {
+                std::cout << "the replay path must not be empty\n";
+                return EXIT_FAILURE;
+            }
+            options.replay_path = value;
+        } else if (argument == supervise_flag) {
+            options.supervise = true;
+        } else if (argument.starts_with(pool_size_flag)) {
+            auto const value = argument.substr(pool_size_flag.length());
+            auto const pool_size = parse_integer<usize>(value);
+            if (not pool_size.has_value() or pool_size.value() < 1) {
+                std::cout << std::format("'{}' is not a valid number of idle slots\n", value);
+                return EXIT_FAILURE;
+            }
+            options.pool_size = pool_size.value();
+        } else if (argument.starts_with(metrics_port_flag)) {
+            auto const value = argument.substr(metrics_port_flag.length());
+            auto const port = parse_integer<std::uint16_t>(value);
+            if (not port.has_value()) {
+                std::cout << std::format("'{}' is not a valid port number\n", value);
+                return EXIT_FAILURE;
+            }
+            options.metrics_port = port.value();
+        } else if (argument.starts_with("--")) {
+            std::cout << std::format("unknown option '{}'\n", argument);
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            positional_arguments.push_back(argument);
+        }
+    }
+
+    // Declared before the servers, since their destructors wait for the matches to end.
+    auto metrics_registry = std::shared_ptr<MetricsRegistry>{};
+    auto metrics_server = std::optional<HttpServer>{};
+    if (options.metrics_port.has_value()) {
+        metrics_registry = std::make_shared<MetricsRegistry>();
+        metrics_server.emplace(options.metrics_port.value(), [metrics_registry](HttpRequest const& request) {
+            if (request.path == "/trace") {
+                return serve_trace(request);
+            }
+            return metrics_registry->handle(request);
+        });
+        spdlog::info("serving metrics on port {}", metrics_server->port());
+    }
+
+    if (options.supervise) {
+        if (positional_arguments.size() != 1) {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        auto const lobby_port = parse_integer<std::uint16_t>(positional_arguments.at(0));
+        if (not lobby_port.has_value()) {
+            std::cout << std::format("'{}' is not a valid port number\n", positional_arguments.at(0));
+            return EXIT_FAILURE;
+        }
+        spdlog::info("lobby port = {}", lobby_port.value());
+        spdlog::info("starting supervisor with {} idle match slots", options.pool_size);
+        auto supervisor = Supervisor{
+            lobby_port.value(),
+            options.pool_size,
+            MatchSettings{
+                .simulated_packet_loss = options.simulated_packet_loss,
+                .lag_budget = options.lag_budget,
+                .replay_path = options.replay_path.transform([](std::string_view const path) {
+                    return std::filesystem::path{ path };
+                }),
+                .metrics_registry = metrics_registry,
+            },
+        };
+        supervisor.run();
+        return EXIT_SUCCESS;
+    }
+
+    switch (positional_arguments.size()) {
+        case 1: {
+            auto const lobby_port = parse_integer<std::uint16_t>(positional_arguments.at(0));
             if (not lobby_port.has_value()) {
-                std::cout << std::format("'{}' is not a valid port number\n", argv[1]);
+                std::cout << std::format("'{}' is not a valid port number\n", positional_arguments.at(0));
                 return EXIT_FAILURE;
             }
             spdlog::info("lobby port = {}", lobby_port.value());
             spdlog::info("starting gameserver");
-            auto const server = Server{ lobby_port.value() };
+            auto server = Server{ lobby_port.value() };
+            server.simulate_packet_loss(options.simulated_packet_loss, 0);
+            server.set_lag_budget(options.lag_budget);
+            if (options.replay_path.has_value()) {
+                server.set_replay_path(options.replay_path.value());
+            }
+            if (metrics_registry != nullptr) {
+                metrics_registry->add(std::format("port=\"{}\"", server.port()), server.metrics());
+            }
             break;
         }
-        case 3: {
-            auto const game_server_port = parse_integer<std::uint16_t>(argv[1]);
+        case 2: {
+            auto const game_server_port = parse_integer<std::uint16_t>(positional_arguments.at(0));
             if (not game_server_port.has_value()) {
-                std::cout << std::format("'{}' is not a valid port number\n", argv[1]);
+                std::cout << std::format("'{}' is not a valid port number\n", positional_arguments.at(0));
                 return EXIT_FAILURE;
             }
             spdlog::info("game server port = {}", game_server_port.value());
-            auto const num_players = parse_integer<std::uint8_t>(argv[2]);
+            auto const num_players = parse_integer<std::uint8_t>(positional_arguments.at(1));
             if (not num_players.has_value() or num_players.value() < 1) {
-                std::cout << std::format("'{}' is not a valid number of players\n", argv[2]);
+                std::cout << std::format("'{}' is not a valid number of players\n", positional_arguments.at(1));
                 return EXIT_FAILURE;
             }
             spdlog::info("number of players = {}", num_players.value());
             spdlog::info("starting game server");
-            auto const server = Server{ game_server_port.value(), num_players.value() };
+            auto server = Server{ game_server_port.value(), num_players.value() };
+            server.simulate_packet_loss(options.simulated_packet_loss, 0);
+            server.set_lag_budget(options.lag_budget);
+            if (options.replay_path.has_value()) {
+                server.set_replay_path(options.replay_path.value());
+            }
+            if (metrics_registry != nullptr) {
+                metrics_registry->add(std::format("port=\"{}\"", server.port()), server.metrics());
+            }
             break;
         }
         default:
-            std::cout << std::format("Usage: {} [<lobby-port>|<gameserver_port> <num_players>]\n", argv[0]);
+            print_usage(argv[0]);
             return EXIT_FAILURE;
     }
 }
@@ -0,0 +1,217 @@
+#include "metrics.hpp"
+#include <algorithm>
+#include <cassert>
+#include <format>
+#include <ranges>
+
+Histogram::Histogram(std::vector<double> upper_bounds)
+    : m_upper_bounds{ std::move(upper_bounds) }, m_bucket_counts(m_upper_bounds.size() + 1) {
+    assert(std::ranges::is_sorted(m_upper_bounds));
+}
+
+void Histogram::observe(double const value) {
+    auto const bucket = std::ranges::lower_bound(m_upper_bounds, value) - m_upper_bounds.cbegin();
+    m_bucket_counts.at(static_cast<usize>(bucket)).fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+[[nodiscard]] u64 Histogram::cumulative_count(usize const bucket) const {
+    auto result = u64{ 0 };
+    for (auto i = usize{ 0 }; i <= bucket; ++i) {
+        result += m_bucket_counts.at(i).load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+[[nodiscard]] static std::string join_labels(std::string_view const first, std::string_view const second) {
+    if (first.empty() or second.empty()) {
+        return std::format("{}{}", first, second);
+    }
+    return std::format("{},{}", first, second);
+}
+
+[[nodiscard]] static std::string sample(std::string_view const name, std::string_view const labels, auto const value) {
+    if (labels.empty()) {
+        return std::format("{} {}\n", name, value);
+    }
+    return std::format("{}{{{}}} {}\n", name, labels, value);
+}
+
+void MetricsWriter::counter(
+    std::string_view const name,
+    std::string_view const help,
+    std::string_view const labels,
+    u64 const value
+) {
+    samples_of(name, help, "counter") += sample(name, labels, value);
+}
+
+void MetricsWriter::gauge(
+    std::string_view const name,
+    std::string_view const help,
+    std::string_view const labels,
+    double const value
+) {
+    samples_of(name, help, "gauge") += sample(name, labels, value);
+}
+
+void MetricsWriter::histogram(
+    std::string_view const name,
+    std::string_view const help,
+    std::string_view const labels,
+    Histogram const& histogram
+) {
+    auto& samples = samples_of(name, help, "histogram");
+    auto const bucket_name = std::format("{}_bucket", name);
+    for (auto const& [i, upper_bound] : std::views::enumerate(histogram.upper_bounds())) {
+        auto const bucket_labels = join_labels(labels, std::format("le=\"{}\"", upper_bound));
+        samples += sample(bucket_name, bucket_labels, histogram.cumulative_count(static_cast<usize>(i)));
+    }
+    auto const num_buckets = histogram.upper_bounds().size() + 1;
+    samples += sample(bucket_name, join_labels(labels, "le=\"+Inf\""), histogram.cumulative_count(num_buckets - 1));
+    samples += sample(std::format("{}_sum", name), labels, histogram.sum());
+    samples += sample(std::format("{}_count", name), labels, histogram.count());
+}
+
+[[nodiscard]] std::string MetricsWriter::text() const {
+    auto result = std::string{};
+    for (auto const& family : m_families) {
+        result += std::format("# HELP {} {}\n# TYPE {} {}\n", family.name, family.help, family.name, family.type);
+        result += family.samples;
+    }
+    return result;
+}
+
+[[nodiscard]] std::string& MetricsWriter::samples_of(
+    std::string_view const name,
+    std::string_view const help,
+    std::string_view const type
+) {
+    auto const find_iterator = std::ranges::find(m_families, name, &Family::name);
+    if (find_iterator != m_families.end()) {
+        assert(find_iterator->type == type);
+        return find_iterator->samples;
+    }
+    return m_families.emplace_back(std::string{ name }, std::string{ help }, type, std::string{}).samples;
+}
+
+[[nodiscard]] static std::vector<double> duration_bounds() {
+    return { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5 };
+}
+
+ServerMetrics::ServerMetrics()
+    : tick_duration{ duration_bounds() },
+      // The broadcasting thread wakes up every 100 ms, so usually a single window (15 frames) is complete.
+      frames_simulated_per_tick{ { 0, 15, 30, 45, 60, 90, 120, 180, 240 } },
+      broadcast_size{ { 32, 64, 128, 256, 512, 1024, 2048, 4096 } },
+      broadcast_fan_out_duration{ duration_bounds() },
+      client_infos_lock_wait_duration{ duration_bounds() } { }
+
+void ServerMetrics::set_input_queue_depths(std::vector<std::pair<u8, usize>> depths) {
+    m_input_queue_depths.apply([&depths](std::vector<std::pair<u8, usize>>& input_queue_depths) {
+        input_queue_depths = std::move(depths);
+    });
+}
+
+void ServerMetrics::write(MetricsWriter& writer, std::string_view const labels) const {
+    writer.histogram(
+        "obpf_server_tick_duration_seconds",
+        "Time spent simulating and broadcasting per tick of the broadcasting thread.",
+        labels,
+        tick_duration
+    );
+    writer.histogram(
+        "obpf_server_frames_simulated_per_tick",
+        "Number of frames simulated per tick of the broadcasting thread.",
+        labels,
+        frames_simulated_per_tick
+    );
+    writer.histogram(
+        "obpf_server_broadcast_size_bytes",
+        "Size of a serialized StateBroadcast.",
+        labels,
+        broadcast_size
+    );
+    writer.histogram(
+        "obpf_server_broadcast_fan_out_duration_seconds",
+        "Time spent sending a broadcast to all clients.",
+        labels,
+        broadcast_fan_out_duration
+    );
+    writer.histogram(
+        "obpf_server_client_infos_lock_wait_seconds",
+        "Time spent waiting for the lock of the client states.",
+        labels,
+        client_infos_lock_wait_duration
+    );
+    writer.counter(
+        "obpf_server_windows_simulated_total",
+        "Number of windows that have been simulated and broadcast. Stops increasing if the match stalls.",
+        labels,
+        m_num_windows_simulated.load(std::memory_order_relaxed)
+    );
+    writer.counter(
+        "obpf_server_rejected_handshakes_total",
+        "Number of connections that have been closed right away because too many handshakes were pending.",
+        labels,
+        num_rejected_handshakes()
+    );
+    for (auto const type : magic_enum::enum_values<MessageType>()) {
+        auto const type_labels = join_labels(labels, std::format("type=\"{}\"", magic_enum::enum_name(type)));
+        writer.counter(
+            "obpf_server_received_bytes_total",
+            "Number of bytes received per message type, including the header.",
+            type_labels,
+            m_num_bytes_received.at(std::to_underlying(type)).load(std::memory_order_relaxed)
+        );
+        writer.counter(
+            "obpf_server_sent_bytes_total",
+            "Number of bytes sent per message type, including the header.",
+            type_labels,
+            m_num_bytes_sent.at(std::to_underlying(type)).load(std::memory_order_relaxed)
+        );
+    }
+    auto const depths = m_input_queue_depths.apply([](std::vector<std::pair<u8, usize>> const& input_queue_depths) {
+        return input_queue_depths;
+    });
+    for (auto const& [client_id, depth] : depths) {
+        writer.gauge(
+            "obpf_server_input_queue_depth_windows",
+            "Number of windows that have been received from a client, but not yet simulated.",
+            join_labels(labels, std::format("client=\"{}\"", client_id)),
+            static_cast<double>(depth)
+        );
+    }
+}
+
+void MetricsRegistry::add(std::string labels, std::weak_ptr<ServerMetrics const> metrics) {
+    auto const lock = std::scoped_lock{ m_mutex };
+    m_entries.emplace_back(std::move(labels), std::move(metrics));
+}
+
+[[nodiscard]] std::string MetricsRegistry::text() {
+    auto writer = MetricsWriter{};
+    auto const lock = std::scoped_lock{ m_mutex };
+    std::erase_if(m_entries, [](Entry const& entry) { return entry.metrics.expired(); });
+    for (auto const& entry : m_entries) {
+        if (auto const metrics = entry.metrics.lock(); metrics != nullptr) {
+            metrics->write(writer, entry.labels);
+        }
+    }
+    return writer.text();
+}
+
+[[nodiscard]] HttpResponse MetricsRegistry::handle(HttpRequest const& request) {
+    if (request.path != "/metrics") {
+        return HttpResponse{ .status = HttpStatus::NotFound, .headers = {}, .body = {} };
+    }
+    if (request.method != "GET") {
+        return HttpResponse{ .status = HttpStatus::BadRequest, .headers = {}, .body = {} };
+    }
+    return HttpResponse{
+        .status = HttpStatus::Ok,
+        .headers = { { "Content-Type", "text/plain; version=0.0.4" } },
+        .body = text(),
+    };
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <lib2k/types.hpp>
+#include <magic_enum.hpp>
+#include <memory>
+#include <mutex>
+#include <network/http_connection.hpp>
+#include <network/message_types.hpp>
+#include <sockets/sockets.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Counts observed values in buckets with fixed upper bounds, just like a Prometheus histogram. Values can be observed
+// from any thread without locking.
+class Histogram final {
+private:
+    std::vector<double> m_upper_bounds;
+    std::vector<std::atomic<u64>> m_bucket_counts;  // Not cumulative. The last bucket has no upper bound.
+    std::atomic<u64> m_count = 0;
+    std::atomic<double> m_sum = 0.0;
+
+public:
+    // The bounds have to be sorted in ascending order.
+    explicit Histogram(std::vector<double> upper_bounds);
+
+    void observe(double value);
+
+    // Durations are observed in seconds.
+    template<typename Rep, typename Period>
+    void observe(std::chrono::duration<Rep, Period> const duration) {
+        observe(std::chrono::duration<double>{ duration }.count());
+    }
+
+    [[nodiscard]] std::vector<double> const& upper_bounds() const {
+        return m_upper_bounds;
+    }
+
+    // Number of observed values that are less than or equal to the upper bound of the given bucket. The bucket after
+    // the last upper bound counts all values.
+    [[nodiscard]] u64 cumulative_count(usize bucket) const;
+
+    [[nodiscard]] u64 count() const {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] double sum() const {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+};
+
+// Collects the samples of any number of sources and renders them in the Prometheus text format. Samples of the same
+// metric are grouped, no matter in which order they have been added. Labels are given as e.g. `port="1234"`.
+class MetricsWriter final {
+private:
+    struct Family final {
+        std::string name;
+        std::string help;
+        std::string_view type;
+        std::string samples;
+    };
+
+    std::vector<Family> m_families;
+
+public:
+    void counter(std::string_view name, std::string_view help, std::string_view labels, u64 value);
+    void gauge(std::string_view name, std::string_view help, std::string_view labels, double value);
+    void histogram(std::string_view name, std::string_view help, std::string_view labels, Histogram const& histogram);
+
+    [[nodiscard]] std::string text() const;
+
+private:
+    [[nodiscard]] std::string& samples_of(std::string_view name, std::string_view help, std::string_view type);
+};
+
+// Updated by the threads of a single Server, can be read concurrently.
+class ServerMetrics final {
+public:
+    static constexpr auto num_message_types = magic_enum::enum_count<MessageType>();
+
+    // A tick is one pass of the broadcasting thread, which simulates all windows that are complete.
+    Histogram tick_duration;
+    Histogram frames_simulated_per_tick;
+    Histogram broadcast_size;
+    Histogram broadcast_fan_out_duration;  // Time it takes to hand a broadcast to the sockets of all clients.
+    Histogram client_infos_lock_wait_duration;
+
+private:
+    std::atomic<u64> m_num_windows_simulated = 0;
+    std::atomic<u64> m_num_rejected_handshakes = 0;
+    std::array<std::atomic<u64>, num_message_types> m_num_bytes_received{};
+    std::array<std::atomic<u64>, num_message_types> m_num_bytes_sent{};
+    // Number of windows that have been received, but not yet simulated. By client id, updated every tick.
+    mutable c2k::Synchronized<std::vector<std::pair<u8, usize>>> m_input_queue_depths{ {} };
+
+public:
+    ServerMetrics();
+
+    void on_window_simulated() {
+        m_num_windows_simulated.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void on_handshake_rejected() {
+        m_num_rejected_handshakes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] u64 num_rejected_handshakes() const {
+        return m_num_rejected_handshakes.load(std::memory_order_relaxed);
+    }
+
+    void on_message_received(MessageType const type, usize const num_bytes) {
+        m_num_bytes_received.at(std::to_underlying(type)).fetch_add(num_bytes, std::memory_order_relaxed);
+    }
+
+    void on_message_sent(MessageType const type, usize const num_bytes) {
+        m_num_bytes_sent.at(std::to_underlying(type)).fetch_add(num_bytes, std::memory_order_relaxed);
+    }
+
+    void set_input_queue_depths(std::vector<std::pair<u8, usize>> depths);
+
+    // All samples get the given labels.
+    void write(MetricsWriter& writer, std::string_view labels) const;
+};
+
+// The metrics of all matches of this process, e.g. to be served via HTTP. Matches are only exported as long as their
+// metrics are alive.
+class MetricsRegistry final {
+private:
+    struct Entry final {
+        std::string labels;
+        std::weak_ptr<ServerMetrics const> metrics;
+    };
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+
+public:
+    void add(std::string labels, std::weak_ptr<ServerMetrics const> metrics);
+
+    // In the Prometheus text format.
+    [[nodiscard]] std::string text();
+
+    // Serves GET /metrics, e.g. via an HttpServer.
+    [[nodiscard]] HttpResponse handle(HttpRequest const& request);
+};
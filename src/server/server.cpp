@@ -2,20 +2,63 @@
 #include <spdlog/spdlog.h>
 #include <algorithm>
 #include <chrono>
+#include <format>
 #include <gsl/gsl>
 #include <lib2k/types.hpp>
+#include <magic_enum.hpp>
 #include <numeric>
 #include <ranges>
+#include <simulator/log_rate_limiter.hpp>
+#include <simulator/trace.hpp>
 #include "network/messages.hpp"
 
+void Server::start_datagram_transport() {
+    // Clients send their datagrams to the same port number that is used for the TCP connection.
+    auto const port = m_server_socket.local_address().port;
+    try {
+        m_datagram_socket = std::make_unique<UdpSocket>(port);
+    } catch (UdpSocketError const& exception) {
+        spdlog::warn("UDP transport is not available: {}", exception.what());
+        return;
+    }
+    m_datagram_receiving_thread = std::jthread{ keep_receiving_datagrams, std::ref(*this) };
+}
+
+// Including the header.
+[[nodiscard]] static usize serialized_size(AbstractMessage const& message) {
+    return sizeof(std::underlying_type_t<MessageType>) + sizeof(MessageHeader::payload_size) + message.payload_size();
+}
+
+[[nodiscard]] std::optional<std::array<u8, 4>> Server::peer_address_of(c2k::ClientSocket const& socket) {
+    try {
+        return UdpEndpoint::resolve(socket.remote_address().address, 0).address;
+    } catch (UdpSocketError const& exception) {
+        spdlog::warn("datagrams of client {} will be ignored: {}", socket.remote_address().address, exception.what());
+        return std::nullopt;
+    }
+}
+
+void Server::send_message(c2k::ClientSocket& socket, AbstractMessage const& message) {
+    send_message(socket, message.type(), message.serialize());
+}
+
+void Server::send_message(c2k::ClientSocket& socket, MessageType const type, c2k::MessageBuffer const& buffer) {
+    m_metrics->on_message_sent(type, buffer.size());
+    // don't wait blocking for the send to complete
+    std::ignore = socket.send(buffer);
+}
+
 void Server::broadcast_client_disconnected_message(u8 const client_id) {
     auto const message = ClientDisconnected{ client_id };
-    for (auto& socket : m_client_sockets) {
-        if (socket.is_connected()) {
-            spdlog::info("broadcasting disconnected client to socket");
-            std::ignore = socket.send(message.serialize());
+    // Reconnecting clients replace their socket while holding this lock.
+    lock_client_infos([&](std::vector<ClientInfo> const&) {
+        for (auto& socket : m_client_sockets) {
+            if (socket.is_connected()) {
+                SPDLOG_DEBUG("broadcasting disconnected client to socket");
+                send_message(socket, message);
+            }
         }
-    }
+    });
 }
 
 void Server::process_client(std::stop_token const& stop_token, Server& self, std::size_t const index) {
@@ -27,8 +70,10 @@ void Server::process_client(std::stop_token const& stop_token, Server& self, std
         auto message = std::unique_ptr<AbstractMessage>{};
         try {
             message = AbstractMessage::from_socket(socket);
+            self.m_metrics->on_message_received(message->type(), serialized_size(*message));
         } catch (c2k::TimeoutError const&) {
-            spdlog::error("Waiting for Connect message from client {}...", index);
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(log_limiter, spdlog::level::err, "Waiting for Connect message from client {}...", index);
             continue;
         } catch (c2k::ReadError const& exception) {
             spdlog::error("error while reading from socket: {}", exception.what());
@@ -39,12 +84,15 @@ void Server::process_client(std::stop_token const& stop_token, Server& self, std
             auto& connect_message = dynamic_cast<Connect&>(*message);
             spdlog::info("Client identified itself as '{}'.", connect_message.player_name);
             // clang-format off
-            self.m_client_infos.apply(
-                [index, name = std::move(connect_message.player_name)]
+            self.lock_client_infos(
+                [index, seed = self.m_seed, name = std::move(connect_message.player_name)]
                 (std::vector<ClientInfo>& client_infos) mutable {
-                    client_infos.at(index).player_name = std::move(name);
-                    assert(client_infos.at(index).state == ClientState::Connected);
-                    client_infos.at(index).state = ClientState::Identified;
+                    auto& client_info = client_infos.at(index);
+                    client_info.player_name = std::move(name);
+                    // The match has not started yet, so the tetrion can be re-created to include the name in snapshots.
+                    client_info.tetrion = PlayerTetrion{ seed, start_frame, client_info.id, client_info.player_name };
+                    assert(client_info.state == ClientState::Connected);
+                    client_info.state = ClientState::Identified;
                 }
             );
             // clang-format on
@@ -54,37 +102,76 @@ void Server::process_client(std::stop_token const& stop_token, Server& self, std
         // todo: This client sent an unexpected message. It should be disconnected.
     }
 
+    keep_receiving_messages(stop_token, self, index);
+}
+
+void Server::keep_receiving_messages(std::stop_token const& stop_token, Server& self, std::size_t const index) {
+    using namespace std::chrono_literals;
+    OBPF_TRACE_THREAD_NAME(std::format("client {}", index));
+    auto& socket = self.m_client_sockets.at(index);
+
     while (not stop_token.stop_requested() and socket.is_connected()) {
         auto message = std::unique_ptr<AbstractMessage>{};
         try {
             message = AbstractMessage::from_socket(socket);
+            self.m_metrics->on_message_received(message->type(), serialized_size(*message));
         } catch (c2k::TimeoutError const& exception) {
-            spdlog::error("timeout error while waiting for next client message: {}", exception.what());
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(
+                log_limiter,
+                spdlog::level::err,
+                "timeout error while waiting for next client message: {}",
+                exception.what()
+            );
             continue;  // todo: require clients to send heartbeats even before the game starts
         } catch (c2k::ReadError const& exception) {
             spdlog::error("error while reading from socket: {}", exception.what());
             break;
         }
+        if (message->type() == MessageType::SnapshotSubscription) {
+            auto const interval = dynamic_cast<SnapshotSubscription const&>(*message).interval;
+            spdlog::info("client {} subscribed to board snapshots every {} windows", index, interval);
+            self.lock_client_infos([index, interval](std::vector<ClientInfo>& client_infos) {
+                client_infos.at(index).board_snapshot_interval = interval;
+            });
+            continue;
+        }
         if (message->type() == MessageType::Heartbeat) {
-            spdlog::info("received heartbeat message");
+            OBPF_TRACE_SCOPE("Server::process_heartbeat");
             auto const& heartbeat_message = dynamic_cast<Heartbeat const&>(*message);
-            // todo: check whether data is valid
-
-            spdlog::info("heartbeat message frame: {}", heartbeat_message.frame);
+            SPDLOG_TRACE("received heartbeat message of client {} for frame {}", index, heartbeat_message.frame);
 
-            self.m_client_infos.apply([&heartbeat_message, index](std::vector<ClientInfo>& client_infos) {
-                for (auto const key_state : heartbeat_message.key_states) {
-                    // Queue all the key states and simulate the frames on the main thread when
-                    // the states of all clients have arrived. We cannot simulate the tetrions right
-                    // here because they can influence each other via sent garbage. This has to
-                    // be synchronized.
-                    client_infos.at(index).key_states.push_back(key_state);
+            // Queue all the key states and simulate the frames on the main thread when
+            // the states of all clients have arrived. We cannot simulate the tetrions right
+            // here because they can influence each other via sent garbage. This has to
+            // be synchronized.
+            auto result = InputWindowBuffer::AppendResult::Full;
+            while (not stop_token.stop_requested() and socket.is_connected()) {
+                result = self.lock_client_infos([&heartbeat_message, index](std::vector<ClientInfo>& client_infos) {
+                    return append_heartbeat(client_infos.at(index), heartbeat_message);
+                });
+                if (result != InputWindowBuffer::AppendResult::Full) {
+                    break;
                 }
-            });
+                // The client is too far ahead. We stop reading from its socket until the other clients have
+                // caught up, so that the data piles up in the socket buffers instead of in our memory.
+                std::this_thread::sleep_for(10ms);
+            }
+            if (result != InputWindowBuffer::AppendResult::Appended) {
+                static auto log_limiter = LogRateLimiter{};
+                log_rate_limited(
+                    log_limiter,
+                    spdlog::level::warn,
+                    "rejecting key states of client {} for window ending at frame {} ({})",
+                    index,
+                    heartbeat_message.frame,
+                    magic_enum::enum_name(result)
+                );
+            }
         }
     }
     spdlog::info("client {}:{} disconnected", socket.remote_address().address, socket.remote_address().port);
-    auto const client_id = self.m_client_infos.apply([index](std::vector<ClientInfo>& client_infos) {
+    auto const client_id = self.lock_client_infos([index](std::vector<ClientInfo>& client_infos) {
         auto& client_info = client_infos.at(index);
         client_info.state = ClientState::Disconnected;
         return client_info.id;
@@ -92,37 +179,309 @@ void Server::process_client(std::stop_token const& stop_token, Server& self, std
     self.broadcast_client_disconnected_message(client_id);
 }
 
-// clang-format off
-[[nodiscard]] static c2k::MessageBuffer create_broadcast_message(
-    std::vector<ClientInfo> & client_infos,
-    std::uint64_t const frame
-) {  // clang-format on
-    spdlog::info("creating broadcast message for frame {}", frame);
-
-    auto client_states = std::vector<StateBroadcast::ClientStates>{};
-    for (auto& client_info : client_infos) {
-        assert(client_info.key_states.size() >= heartbeat_interval);
-        auto states = std::array<KeyState, heartbeat_interval>{};
-        std::copy_n(client_info.key_states.cbegin(), heartbeat_interval, states.begin());
-        client_info.key_states.erase(client_info.key_states.begin(), client_info.key_states.begin() + heartbeat_interval);
-        client_states.emplace_back(client_info.id, states);
+void Server::accept_client_connection(c2k::ClientSocket client) {
+    lock_client_infos([this, client = std::move(client)](std::vector<ClientInfo>& client_infos) mutable {
+        if (client_infos.size() >= m_expected_player_count) {
+            // All slots are taken, but this could be a player that lost its connection during the match. The
+            // handshake blocks, so it cannot happen on this thread.
+            // Nothing else joins the threads of finished handshakes.
+            std::erase_if(m_handshakes, [](Handshake const& handshake) { return handshake.is_done->load(); });
+            if (m_handshakes.size() >= max_pending_handshakes) {
+                m_metrics->on_handshake_rejected();
+                static auto log_limiter = LogRateLimiter{};
+                log_rate_limited(log_limiter, spdlog::level::warn, "rejecting client: too many pending handshakes");
+                return;
+            }
+            auto& handshake = m_handshakes.emplace_back();
+            auto& is_done = *handshake.is_done;
+            handshake.thread = std::jthread{
+                [this, &is_done, client = std::move(client)](std::stop_token const& stop_token) mutable {
+                    process_reconnecting_client(stop_token, *this, std::move(client));
+                    is_done = true;
+                }
+            };
+            return;
+        }
+        auto const index = m_client_sockets.size();
+        m_client_sockets.push_back(std::move(client));
+
+        assert(client_infos.size() == index);
+        auto const client_id = m_next_client_id++;
+        client_infos.emplace_back(client_id, m_seed, start_frame).peer_address =
+            peer_address_of(m_client_sockets.back());
+
+        assert(m_client_threads.size() == index);
+        m_client_threads.emplace_back(process_client, std::ref(*this), index);
+    });
+}
+
+void Server::process_reconnecting_client(std::stop_token const& stop_token, Server& self, c2k::ClientSocket socket) {
+    auto message = std::unique_ptr<AbstractMessage>{};
+    try {
+        message = AbstractMessage::from_socket(socket);
+        self.m_metrics->on_message_received(message->type(), serialized_size(*message));
+    } catch (c2k::TimeoutError const&) {
+        spdlog::warn("rejecting client: match is full and client did not try to reconnect in time");
+        return;
+    } catch (c2k::ReadError const& exception) {
+        spdlog::error("error while reading from socket: {}", exception.what());
+        return;
+    } catch (MessageDeserializationError const& exception) {
+        spdlog::warn("rejecting client: {}", exception.what());
+        return;
+    }
+    if (stop_token.stop_requested()) {
+        return;
+    }
+    if (message->type() != MessageType::Reconnect) {
+        spdlog::warn("rejecting client: match is full");
+        return;
+    }
+    if (not self.m_has_match_started) {
+        spdlog::warn("rejecting reconnecting client: match has not started yet");
+        return;
+    }
+
+    auto const& reconnect_message = dynamic_cast<Reconnect const&>(*message);
+    auto const lock = std::scoped_lock{ self.m_reconnect_mutex };
+    if (not self.try_restore_client(socket, reconnect_message)) {
+        spdlog::warn(
+            "rejecting reconnecting client: there is no disconnected client with id {} and name '{}'",
+            reconnect_message.client_id,
+            reconnect_message.player_name
+        );
+    }
+}
+
+// Has to be called while holding m_reconnect_mutex.
+[[nodiscard]] bool Server::try_restore_client(c2k::ClientSocket& socket, Reconnect const& reconnect_message) {
+    auto const index = lock_client_infos([&](std::vector<ClientInfo> const& client_infos) -> std::optional<usize> {
+        auto const find_iterator = std::ranges::find_if(client_infos, [&](ClientInfo const& client_info) {
+            return client_info.id == reconnect_message.client_id and client_info.state == ClientState::Disconnected
+                   and client_info.player_name == reconnect_message.player_name;
+        });
+        if (find_iterator == client_infos.cend()) {
+            return std::nullopt;
+        }
+        return gsl::narrow<usize>(std::distance(client_infos.cbegin(), find_iterator));
+    });
+    if (not index.has_value()) {
+        return false;
+    }
+
+    // The thread of the previous connection has already marked the client as disconnected, but it might
+    // still be broadcasting that. It must be done using the old socket before we can replace it.
+    if (auto& thread = m_client_threads.at(index.value()); thread.joinable()) {
+        thread.join();
+    }
+
+    lock_client_infos([&](std::vector<ClientInfo>& client_infos) {
+        auto& client_info = client_infos.at(index.value());
+        // While the client was disconnected, its tetrion has been simulated with neutral key states in lockstep
+        // with the others. Therefore, the next frame is always the first frame of a window.
+        auto const frame = client_info.tetrion.next_frame();
+        spdlog::info("client {} reconnected at frame {}", client_info.id, frame);
+
+        client_info.state = ClientState::Identified;
+        client_info.input_windows = InputWindowBuffer{ frame };
+        client_info.peer_address = peer_address_of(socket);
+        client_info.datagram_endpoint.reset();
+        client_info.unacknowledged_broadcasts.clear();
+        client_info.board_snapshot_interval = 0;
+        client_info.received_garbage.clear();
+
+        send_message(socket, MatchSnapshot{ client_info.id, frame, gsl::narrow<u8>(client_infos.size()) });
+        for (auto const& other : client_infos) {
+            auto const snapshot_message =
+                TetrionSnapshot{ other.id, other.is_connected(), other.tetrion.save_snapshot() };
+            send_message(socket, snapshot_message);
+        }
+
+        auto const reconnected_message = ClientReconnected{ client_info.id }.serialize();
+        for (auto& other_socket : m_client_sockets) {
+            if (other_socket.is_connected()) {
+                send_message(other_socket, MessageType::ClientReconnected, reconnected_message);
+            }
+        }
+
+        m_client_sockets.at(index.value()) = std::move(socket);
+        m_client_threads.at(index.value()) = std::jthread{ keep_receiving_messages, std::ref(*this), index.value() };
+    });
+    return true;
+}
+
+void Server::send_redundant_state_broadcast(ClientInfo& client_info) {
+    assert(m_datagram_socket != nullptr and client_info.datagram_endpoint.has_value());
+    // clang-format off
+    auto broadcasts = client_info.unacknowledged_broadcasts
+                      | std::views::take(max_redundant_windows)
+                      | std::ranges::to<std::vector>();
+    // clang-format on
+    // clang-format off
+    auto const message = RedundantStateBroadcast{
+        client_info.input_windows.num_received_key_states(),
+        std::move(broadcasts),
+    };
+    // clang-format on
+    auto const buffer = message.serialize();
+    m_metrics->on_message_sent(message.type(), buffer.size());
+    m_datagram_socket->send_to(client_info.datagram_endpoint.value(), buffer);
+}
+
+void Server::start_recording(std::vector<ClientIdentity> const& client_identities) {
+    if (not m_replay_path.has_value()) {
+        return;
+    }
+    auto header = ReplayHeader{ m_seed, start_frame, {} };
+    for (auto const& [client_id, player_name] : client_identities) {
+        header.players.push_back({ client_id, player_name });
+    }
+    try {
+        m_replay_writer = std::make_unique<ReplayWriter>(m_replay_path.value(), header);
+        spdlog::info("recording match to '{}'", m_replay_path->string());
+    } catch (ReplayError const& exception) {
+        spdlog::error("unable to record match: {}", exception.what());
+    }
+}
+
+// Connection changes only take effect at window boundaries, since the whole window is simulated while holding the
+// lock.
+void Server::record_connection_changes(std::vector<ClientInfo>& client_infos) {
+    for (auto const& [i, client_info] : std::views::enumerate(client_infos)) {
+        if (client_info.is_connected() == client_info.is_recorded_as_connected) {
+            continue;
+        }
+        client_info.is_recorded_as_connected = client_info.is_connected();
+        m_replay_writer->append_event(
+            gsl::narrow<u8>(i),
+            client_info.is_connected() ? ReplayEventType::Reconnected : ReplayEventType::Disconnected
+        );
+    }
+}
+
+void Server::record_window(StateBroadcast const& broadcast_message, std::vector<ClientInfo> const& client_infos) {
+    // The broadcast contains the key states of all clients in the order of the replay header.
+    auto key_states = std::vector<KeyState>(broadcast_message.states_per_client.size());
+    for (auto frame = usize{ 0 }; frame < heartbeat_interval; ++frame) {
+        for (auto const& [i, client_states] : std::views::enumerate(broadcast_message.states_per_client)) {
+            key_states.at(gsl::narrow<usize>(i)) = client_states.states.at(frame);
+        }
+        m_replay_writer->append_frame(key_states);
+    }
+
+    // All tetrions have been simulated up to the end of the window, and the connection changes of the next window
+    // have not been recorded yet.
+    if (m_replay_writer->wants_keyframe()) {
+        auto const tetrions = client_infos | std::views::transform([](ClientInfo const& client_info) {
+                                  return ReplayKeyframeTetrion{
+                                      &client_info.tetrion,
+                                      client_info.is_recorded_as_connected,
+                                  };
+                              })
+                              | std::ranges::to<std::vector>();
+        m_replay_writer->append_keyframe(tetrions);
+    }
+}
+
+void Server::simulate_and_broadcast_window(std::vector<ClientInfo>& client_infos) {
+    OBPF_TRACE_SCOPE("Server::simulate_and_broadcast_window");
+    if (m_replay_writer != nullptr) {
+        record_connection_changes(client_infos);
+    }
+    auto const broadcast_message = simulate_window(client_infos);
+    if (m_replay_writer != nullptr) {
+        record_window(broadcast_message, client_infos);
+    }
+    m_metrics->on_window_simulated();
+    auto const serialized_broadcast_message = broadcast_message.serialize();
+    m_metrics->broadcast_size.observe(static_cast<double>(serialized_broadcast_message.size()));
+    auto const fan_out_start = std::chrono::steady_clock::now();
+    for (auto i = usize{ 0 }; i < client_infos.size(); ++i) {
+        auto& client_info = client_infos.at(i);
+        auto& socket = m_client_sockets.at(i);
+        if (client_info.board_snapshot_interval > 0) {
+            send_snapshot_broadcast(client_infos, i, broadcast_message);
+            continue;
+        }
+        if (client_info.datagram_endpoint.has_value()) {
+            if (client_info.unacknowledged_broadcasts.size() >= max_unacknowledged_broadcasts) {
+                spdlog::warn("disconnecting client {}: it does not acknowledge its broadcasts", client_info.id);
+                // The receiving thread of the client notices this and takes care of the disconnect, so that the
+                // client can reconnect.
+                client_info.datagram_endpoint.reset();
+                client_info.unacknowledged_broadcasts.clear();
+                socket.close();
+                continue;
+            }
+            if (client_info.is_connected()) {
+                client_info.unacknowledged_broadcasts.push_back(broadcast_message);
+                send_redundant_state_broadcast(client_info);
+            }
+            continue;
+        }
+        if (socket.is_connected()) {
+            SPDLOG_TRACE("sending broadcast message to socket with descriptor {}", socket.os_socket_handle().value());
+            send_message(socket, MessageType::StateBroadcast, serialized_broadcast_message);
+        }
+    }
+    m_metrics->broadcast_fan_out_duration.observe(std::chrono::steady_clock::now() - fan_out_start);
+}
+
+void Server::send_snapshot_broadcast(
+    std::vector<ClientInfo>& client_infos,
+    std::size_t const index,
+    StateBroadcast const& broadcast_message
+) {
+    OBPF_TRACE_SCOPE("Server::send_snapshot_broadcast");
+    auto& client_info = client_infos.at(index);
+    auto received_garbage = std::exchange(client_info.received_garbage, {});
+    auto& socket = m_client_sockets.at(index);
+    if (not socket.is_connected()) {
+        return;
+    }
+
+    auto const own_states = std::ranges::find_if(broadcast_message.states_per_client, [&](auto const& client_states) {
+        return client_states.client_id == client_info.id;
+    });
+    assert(own_states != broadcast_message.states_per_client.cend());
+
+    auto boards = std::vector<SnapshotBroadcast::BoardSnapshot>{};
+    auto const window_index = (broadcast_message.frame + 1) / heartbeat_interval;
+    if (window_index % client_info.board_snapshot_interval == 0) {
+        boards.reserve(client_infos.size() - 1);
+        for (auto const& other : client_infos) {
+            if (other.id == client_info.id) {
+                continue;
+            }
+            boards.push_back({ other.id, other.tetrion.game_over_since_frame().has_value(), other.tetrion.matrix() });
+        }
     }
 
-    auto const broadcast_message = StateBroadcast{ frame, std::move(client_states) };
-    return broadcast_message.serialize();
+    auto const message = SnapshotBroadcast{
+        broadcast_message.frame,
+        own_states->states,
+        std::move(received_garbage),
+        std::move(boards),
+    };
+    send_message(socket, message);
 }
 
 void Server::keep_broadcasting(std::stop_token const& stop_token, Server& self) {
     using namespace std::chrono_literals;
+    OBPF_TRACE_THREAD_NAME("broadcasting");
 
+    // Idle slots of the supervisor wait here until their match is started (or they are shut down).
     while (self.m_expected_player_count == 0) {
+        if (stop_token.stop_requested()) {
+            return;
+        }
         std::this_thread::sleep_for(10ms);
     }
 
     // Wait for all clients to connect and identify.
     while (not stop_token.stop_requested()) {
         // clang-format off
-        auto const num_identified_clients = self.m_client_infos.apply(
+        auto const num_identified_clients = self.lock_client_infos(
             [](std::vector<ClientInfo> const& client_infos) {
                 return gsl::narrow<usize>(
                     std::ranges::count_if(
@@ -146,8 +505,11 @@ void Server::keep_broadcasting(std::stop_token const& stop_token, Server& self)
         // todo: replace sleep with condition variable
         std::this_thread::sleep_for(100ms);
     }
+    if (stop_token.stop_requested()) {
+        return;
+    }
 
-    auto const client_identities = self.m_client_infos.apply([](std::vector<ClientInfo>& client_infos) {
+    auto const client_identities = self.lock_client_infos([](std::vector<ClientInfo>& client_infos) {
         auto identities = std::vector<ClientIdentity>{};
         identities.reserve(client_infos.size());
         for (auto const& [i, client_info] : std::views::enumerate(client_infos)) {
@@ -164,99 +526,51 @@ void Server::keep_broadcasting(std::stop_token const& stop_token, Server& self)
             self.m_seed,
             client_identities,
         };
-        socket.send(message.serialize()).wait();
+        auto const buffer = message.serialize();
+        self.m_metrics->on_message_sent(message.type(), buffer.size());
+        socket.send(buffer).wait();
     }
-
-    auto last_min_num_frames_simulated = std::optional<std::uint64_t>{ std::nullopt };
+    self.m_has_match_started = true;
+    self.lock_client_infos([&](std::vector<ClientInfo> const&) { self.start_recording(client_identities); });
 
     while (not stop_token.stop_requested()) {
-        auto const num_clients_connected =
-            self.m_client_infos.apply([&self, &last_min_num_frames_simulated](std::vector<ClientInfo>& client_infos) {
-                auto const num_clients_connected =
-                    std::ranges::count_if(client_infos, [](ClientInfo const& client_info) {
-                        return client_info.is_connected();
-                    });
-
-                if (num_clients_connected == 0) {
-                    return num_clients_connected;
-                }
-
-                // go through all the connected clients and determine the minimum number of key states
-                // that have been queued up for all clients
-                auto const min_num_key_states_queued = std::ranges::min(
-                    client_infos | std::views::filter([](auto const& client_info) { return client_info.is_connected(); })
-                    | std::views::transform([](auto const& client_info) { return client_info.key_states.size(); })
-                );
-
-                for (auto i = usize{ 0 }; i < min_num_key_states_queued; ++i) {
-                    auto garbage_send_events = std::unordered_map<u8, GarbageSendEvent>{};
-                    for (auto& client_info : client_infos) {
-                        if (not client_info.is_connected()) {
-                            continue;
-                        }
-                        auto const key_state = client_info.key_states.at(i);
-                        auto& tetrion = client_info.tetrion;
-                        // clang-format off
-                        if (
-                            auto const garbage_send_event = tetrion.simulate_next_frame(key_state);
-                            garbage_send_event.has_value()
-                        ) {  // clang-format on
-                            garbage_send_events.emplace(client_info.id, garbage_send_event.value());
-                        }
-                    }
-                    auto const tetrions =
-                        client_infos | std::views::transform([](auto& client_info) { return &client_info.tetrion; })
-                        | std::ranges::to<std::vector>();
-                    for (auto const [sender_client_id, garbage_send_event] : garbage_send_events) {
-                        auto target_tetrion =
-                            determine_garbage_target(tetrions, sender_client_id, garbage_send_event.frame);
-                        if (target_tetrion.has_value()) {
-                            target_tetrion.value().receive_garbage(garbage_send_event);
-                        }
-                    }
-                }
-
-                // first we need to find the minimum number of frames simulated by any client that is connected
-                auto const min_num_frames_simulated = std::ranges::min(
-                    client_infos | std::views::filter([](auto const& client_info) { return client_info.is_connected(); })
-                    | std::views::transform([](auto const& client_info) { return client_info.tetrion.next_frame(); })
-                );
+        auto const num_clients_connected = self.lock_client_infos([&self](std::vector<ClientInfo>& client_infos) {
+            OBPF_TRACE_SCOPE("Server::tick");
+            auto connected_clients = client_infos | std::views::filter([](ClientInfo const& client_info) {
+                                         return client_info.is_connected();
+                                     });
+            auto const num_clients_connected = std::ranges::distance(connected_clients);
+            if (num_clients_connected == 0) {
+                return num_clients_connected;
+            }
 
-                // to not block the broadcasting, we will create empty key states for all clients that are not connected
-                for (auto& client_info : client_infos) {
-                    if (not client_info.is_connected()) {
-                        while (client_info.tetrion.next_frame() < min_num_frames_simulated) {
-                            static constexpr auto key_state = KeyState{};
-                            client_info.key_states.push_back(key_state);
-                            // We simulate the frame here, because we won't receive any key states from the client.
-                            // We ignore the return value because this client is not allowed to send any garbage since
-                            // it is not connected anymore.
-                            std::ignore = client_info.tetrion.simulate_next_frame(key_state);
-                        }
-                    }
-                }
-                auto const frame = min_num_frames_simulated;
-                if (frame == 0) {
-                    return num_clients_connected;
-                }
+            if (auto const lag_budget = self.m_lag_budget.load(); lag_budget > 0) {
+                fill_in_for_stragglers(client_infos, lag_budget);
+            }
 
-                if (not last_min_num_frames_simulated.has_value() or frame != last_min_num_frames_simulated.value()) {
-                    auto const broadcast_message = create_broadcast_message(client_infos, frame - 1);
-                    for (auto& socket : self.m_client_sockets) {
-                        if (socket.is_connected()) {
-                            spdlog::info(
-                                "sending broadcast message to socket with descriptor {}",
-                                socket.os_socket_handle().value()
-                            );
-                            std::ignore = socket.send(broadcast_message);
-                        }
-                    }
-                    last_min_num_frames_simulated = frame;
-                }
-                return num_clients_connected;
-            });
+            // Simulate and broadcast every window for which the key states of all connected clients are available.
+            // Since the input buffers have a fixed capacity, this is bounded.
+            auto const tick_start = std::chrono::steady_clock::now();
+            auto num_windows_simulated = usize{ 0 };
+            while (is_next_window_complete(client_infos)) {
+                self.simulate_and_broadcast_window(client_infos);
+                ++num_windows_simulated;
+            }
+            auto& metrics = *self.m_metrics;
+            metrics.tick_duration.observe(std::chrono::steady_clock::now() - tick_start);
+            metrics.frames_simulated_per_tick.observe(static_cast<double>(num_windows_simulated * heartbeat_interval));
+            metrics.set_input_queue_depths(
+                client_infos | std::views::transform([](ClientInfo const& client_info) {
+                    return std::pair{ client_info.id, client_info.input_windows.size() };
+                })
+                | std::ranges::to<std::vector>()
+            );
+            return num_clients_connected;
+        });
 
         if (num_clients_connected == 0) {
+            // Finishes writing the replay.
+            self.lock_client_infos([&self](std::vector<ClientInfo> const&) { self.m_replay_writer.reset(); });
             spdlog::info("stopping server");
             self.stop();
             break;
@@ -266,3 +580,75 @@ void Server::keep_broadcasting(std::stop_token const& stop_token, Server& self)
         std::this_thread::sleep_for(100ms);
     }
 }
+
+void Server::keep_receiving_datagrams(std::stop_token const& stop_token, Server& self) {
+    using namespace std::chrono_literals;
+    OBPF_TRACE_THREAD_NAME("datagrams");
+    while (not stop_token.stop_requested()) {
+        auto datagram = self.m_datagram_socket->receive(100ms);
+        if (not datagram.has_value()) {
+            continue;
+        }
+
+        auto const datagram_size = datagram->buffer.size();
+        auto message = std::unique_ptr<AbstractMessage>{};
+        try {
+            message = AbstractMessage::from_datagram(datagram->buffer);
+        } catch (MessageDeserializationError const& exception) {
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(log_limiter, spdlog::level::warn, "received invalid datagram: {}", exception.what());
+            continue;
+        }
+        self.m_metrics->on_message_received(message->type(), datagram_size);
+        if (message->type() != MessageType::RedundantHeartbeat) {
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(
+                log_limiter,
+                spdlog::level::warn,
+                "received datagram of unexpected type: {}",
+                magic_enum::enum_name(message->type())
+            );
+            continue;
+        }
+        auto const& heartbeat_message = dynamic_cast<RedundantHeartbeat const&>(*message);
+
+        self.lock_client_infos([&](std::vector<ClientInfo>& client_infos) {
+            auto const find_iterator = std::ranges::find_if(client_infos, [&](ClientInfo const& client_info) {
+                return client_info.id == heartbeat_message.client_id;
+            });
+            if (find_iterator == client_infos.end() or find_iterator->state != ClientState::Identified) {
+                return;
+            }
+            auto& client_info = *find_iterator;
+            if (client_info.peer_address != datagram->sender.address) {
+                static auto log_limiter = LogRateLimiter{};
+                log_rate_limited(
+                    log_limiter,
+                    spdlog::level::warn,
+                    "ignoring datagram of client {}: it has not been sent by the host of its TCP connection",
+                    client_info.id
+                );
+                return;
+            }
+            // From now on, this client will only receive broadcasts via UDP.
+            client_info.datagram_endpoint = datagram->sender;
+
+            while (not client_info.unacknowledged_broadcasts.empty()
+                   and client_info.unacknowledged_broadcasts.front().frame
+                           < heartbeat_message.acknowledged_until_frame) {
+                client_info.unacknowledged_broadcasts.pop_front();
+            }
+
+            // Windows that we already have are duplicates (or have been filled in because the client exceeded
+            // the lag budget). Windows after a gap are dropped since the client will resend them anyway until
+            // they are acknowledged.
+            // If the buffer is full, the remaining windows are dropped as well.
+            for (auto const& heartbeat : heartbeat_message.heartbeats) {
+                std::ignore = append_heartbeat(client_info, heartbeat);
+            }
+
+            // Always answer, so that the client gets the acknowledgement as soon as possible.
+            self.send_redundant_state_broadcast(client_info);
+        });
+    }
+}
@@ -2,56 +2,73 @@
 
 #include <spdlog/spdlog.h>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
 #include <lib2k/random.hpp>
-#include <simulator/tetrion.hpp>
+#include <mutex>
+#include <network/messages.hpp>
+#include <network/udp_socket.hpp>
+#include <simulator/player_tetrion.hpp>
+#include <simulator/replay.hpp>
 #include <sockets/sockets.hpp>
 #include <vector>
-
-enum class ClientState {
-    Connected,
-    Identified,
-    Disconnected,
-};
-
-struct ClientInfo final {
-    u8 id;
-    ObpfTetrion tetrion;
-    std::vector<KeyState> key_states;
-    ClientState state = ClientState::Connected;
-    std::string player_name;  // Not filled by constructor, because the name is transferred later.
-
-    explicit ClientInfo(u8 const id, u64 const seed, u64 const start_frame)
-        : id{ id }, tetrion{ seed, start_frame } {}
-
-    [[nodiscard]] bool is_connected() const {
-        switch (state) {
-            using enum ClientState;
-            case Connected:
-            case Identified:
-                return true;
-            case Disconnected:
-                return false;
-        }
-        throw std::logic_error{ "unreachable" };
-    }
-};
+#include "input_window_buffer.hpp"
+#include "lockstep.hpp"
+#include "metrics.hpp"
 
 class Server final {
+public:
+    // Connections above this limit are closed right away, so that connecting repeatedly cannot exhaust the threads.
+    static constexpr auto max_pending_handshakes = usize{ 8 };
+    // Clients that receive their broadcasts via UDP, but do not acknowledge this many of them (about 16 seconds), are
+    // disconnected. Otherwise, the broadcasts would pile up for the rest of the match.
+    static constexpr auto max_unacknowledged_broadcasts = usize{ 64 };
+
 private:
+    struct Handshake final {
+        std::unique_ptr<std::atomic_bool> is_done = std::make_unique<std::atomic_bool>(false);
+        std::jthread thread;
+    };
+
+    // Declared first, since it's used by all threads (including the one accepting connections).
+    std::shared_ptr<ServerMetrics> m_metrics = std::make_shared<ServerMetrics>();
     std::optional<c2k::ClientSocket> m_lobby_socket;
     c2k::ServerSocket m_server_socket;
     std::vector<c2k::ClientSocket> m_client_sockets;
     c2k::Synchronized<std::vector<ClientInfo>> m_client_infos;
+    // Both are guarded by the lock of m_client_infos.
+    std::optional<std::filesystem::path> m_replay_path;
+    std::unique_ptr<ReplayWriter> m_replay_writer;
     std::atomic_size_t m_expected_player_count = 0;
     std::vector<std::jthread> m_client_threads;
     std::jthread m_broadcasting_thread;
+    std::atomic_bool m_has_match_started = false;
+    std::mutex m_reconnect_mutex;  // Only one client can reconnect at a time.
+    // Handshakes of connections that arrive while all slots are taken. Only accessed by the accepting thread.
+    std::vector<Handshake> m_handshakes;
     std::uint8_t m_next_client_id = 0;
     std::atomic_flag m_should_stop;
     c2k::Random::Seed m_seed;
+    std::atomic<u64> m_lag_budget = 0;  // In frames. 0 means that the server waits for every client.
+    std::unique_ptr<UdpSocket> m_datagram_socket;
+    std::jthread m_datagram_receiving_thread;  // Must be the last member since it accesses the others.
 
     static constexpr auto start_frame = u64{ 180 };
 
+    // Like m_client_infos.apply(), but records how long it takes to acquire the lock. Defined ahead of its uses, since
+    // the return type is deduced.
+    template<std::invocable<std::vector<ClientInfo>&> Function>
+    decltype(auto) lock_client_infos(Function&& function) {
+        auto const start = std::chrono::steady_clock::now();
+        return m_client_infos.apply([&](std::vector<ClientInfo>& client_infos) -> decltype(auto) {
+            m_metrics->client_infos_lock_wait_duration.observe(std::chrono::steady_clock::now() - start);
+            return std::invoke(std::forward<Function>(function), client_infos);
+        });
+    }
+
 public:
     explicit Server(std::uint16_t const lobby_port)
         : m_lobby_socket{ c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, "127.0.0.1", lobby_port) },
@@ -63,15 +80,10 @@ public:
           m_client_infos{ {} },
           m_broadcasting_thread{ keep_broadcasting, std::ref(*this) },
           m_seed{ c2k::Random{}.next_integral<c2k::Random::Seed>() } {
+        // This has to happen before setting the expected player count since that unblocks the broadcasting thread.
+        start_datagram_transport();
         // todo: timeout
-        m_expected_player_count = static_cast<std::size_t>(m_lobby_socket.value().receive<std::uint16_t>().get());
-        spdlog::info("expected player count: {}", m_expected_player_count.load());
-
-        m_client_sockets.reserve(m_expected_player_count);
-        m_client_infos.apply([this](std::vector<ClientInfo>& client_infos) {
-            client_infos.reserve(m_expected_player_count);
-        });
-        m_client_threads.reserve(m_expected_player_count);
+        expect_players(static_cast<std::size_t>(m_lobby_socket.value().receive<std::uint16_t>().get()));
 
         if (m_lobby_socket.value().send(m_server_socket.local_address().port).get() != sizeof(std::uint16_t)) {
             throw std::runtime_error{ "unable to send port to lobby server" };
@@ -87,15 +99,23 @@ public:
           m_client_infos{ {} },
           m_broadcasting_thread{ keep_broadcasting, std::ref(*this) },
           m_seed{ c2k::Random{}.next_integral<c2k::Random::Seed>() } {
-        // todo: timeout
-        m_expected_player_count = num_expected_players;
-        spdlog::info("expected player count: {}", m_expected_player_count.load());
+        // This has to happen before setting the expected player count since that unblocks the broadcasting thread.
+        start_datagram_transport();
+        expect_players(num_expected_players);
+    }
 
-        m_client_sockets.reserve(m_expected_player_count);
-        m_client_infos.apply([this](std::vector<ClientInfo>& client_infos) {
-            client_infos.reserve(m_expected_player_count);
-        });
-        m_client_threads.reserve(m_expected_player_count);
+    // Creates an idle match slot on an ephemeral port. The match does not start before start_match() has been called,
+    // all connecting clients are rejected until then. Used by the supervisor to keep slots ready ahead of time.
+    Server()
+        : m_server_socket{ c2k::Sockets::create_server(
+              c2k::AddressFamily::Ipv4,
+              0,
+              [this](c2k::ClientSocket client) { accept_client_connection(std::move(client)); }
+          ) },
+          m_client_infos{ {} },
+          m_broadcasting_thread{ keep_broadcasting, std::ref(*this) },
+          m_seed{ c2k::Random{}.next_integral<c2k::Random::Seed>() } {
+        start_datagram_transport();
     }
 
     Server(Server const&) = delete;
@@ -113,28 +133,78 @@ public:
         }
     }
 
+    [[nodiscard]] bool has_stopped() const {
+        return m_should_stop.test();
+    }
+
+    [[nodiscard]] std::uint16_t port() const {
+        return m_server_socket.local_address().port;
+    }
+
+    // Stays valid after the server has been destroyed.
+    [[nodiscard]] std::shared_ptr<ServerMetrics const> metrics() const {
+        return m_metrics;
+    }
+
+    // Starts the match of an idle slot, i.e. waits for the given number of players to connect.
+    void start_match(std::uint8_t const num_players) {
+        expect_players(num_players);
+    }
+
+    // Clients that are more than the given number of frames behind the most advanced client receive neutral
+    // key states, so that they cannot stall the match for everyone. Since no client can be more than
+    // InputWindowBuffer::capacity windows ahead, bigger values have no effect.
+    void set_lag_budget(u64 const num_frames) {
+        m_lag_budget = num_frames;
+    }
+
+    // Records the match into the given file. Has to be called before the match starts.
+    void set_replay_path(std::filesystem::path path) {
+        lock_client_infos([this, &path](std::vector<ClientInfo> const&) { m_replay_path = std::move(path); });
+    }
+
+    // Only affects outgoing datagrams. Meant for testing the UDP transport.
+    void simulate_packet_loss(double const probability, u64 const seed) {
+        if (m_datagram_socket != nullptr) {
+            m_datagram_socket->simulate_packet_loss(probability, seed);
+        }
+    }
+
 private:
-    void accept_client_connection(c2k::ClientSocket client) {
-        m_client_infos.apply([this, client = std::move(client)](std::vector<ClientInfo>& client_infos) mutable {
-            if (client_infos.size() >= m_expected_player_count) {
-                // reject client
-                return;
-            }
-            auto const index = m_client_sockets.size();
-            m_client_sockets.push_back(std::move(client));
-
-            assert(client_infos.size() == index);
-            auto const client_id = m_next_client_id++;
-            client_infos.emplace_back(client_id, m_seed, start_frame);
-
-            assert(m_client_threads.size() == index);
-            m_client_threads.emplace_back(process_client, std::ref(*this), index);
+    void expect_players(std::size_t const num_players) {
+        spdlog::info("expected player count: {}", num_players);
+        m_client_sockets.reserve(num_players);
+        lock_client_infos([num_players](std::vector<ClientInfo>& client_infos) {
+            client_infos.reserve(num_players);
         });
+        m_client_threads.reserve(num_players);
+        // This unblocks the broadcasting thread, so it has to happen last.
+        m_expected_player_count = num_players;
     }
 
+    void accept_client_connection(c2k::ClientSocket client);
+    void start_datagram_transport();
+    [[nodiscard]] static std::optional<std::array<u8, 4>> peer_address_of(c2k::ClientSocket const& socket);
+    void send_message(c2k::ClientSocket& socket, AbstractMessage const& message);
+    void send_message(c2k::ClientSocket& socket, MessageType type, c2k::MessageBuffer const& buffer);
     void broadcast_client_disconnected_message(u8 client_id);
+    void send_redundant_state_broadcast(ClientInfo& client_info);
+    void start_recording(std::vector<ClientIdentity> const& client_identities);
+    void record_connection_changes(std::vector<ClientInfo>& client_infos);
+    void record_window(StateBroadcast const& broadcast_message, std::vector<ClientInfo> const& client_infos);
+    void simulate_and_broadcast_window(std::vector<ClientInfo>& client_infos);
+    void send_snapshot_broadcast(
+        std::vector<ClientInfo>& client_infos,
+        std::size_t index,
+        StateBroadcast const& broadcast_message
+    );
 
     static void process_client(std::stop_token const& stop_token, Server& self, std::size_t index);
+    static void keep_receiving_messages(std::stop_token const& stop_token, Server& self, std::size_t index);
+    static void process_reconnecting_client(std::stop_token const& stop_token, Server& self, c2k::ClientSocket socket);
+    [[nodiscard]] bool try_restore_client(c2k::ClientSocket& socket, Reconnect const& reconnect_message);
 
     static void keep_broadcasting(std::stop_token const& stop_token, Server& self);
+
+    static void keep_receiving_datagrams(std::stop_token const& stop_token, Server& self);
 };
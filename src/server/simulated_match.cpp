@@ -0,0 +1,219 @@
+#include "simulated_match.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cassert>
+#include <format>
+#include <gsl/gsl>
+#include <magic_enum.hpp>
+#include <map>
+#include <ranges>
+
+// Forwards to the connection of a client and measures how long it takes until the key states sent in a heartbeat
+// come back as part of a broadcast.
+class ObservedConnection final : public MessageTransport {
+private:
+    std::unique_ptr<SimulatedConnection> m_connection;
+    SimulatedNetwork const* m_network;
+    std::vector<std::chrono::nanoseconds>* m_confirmation_latencies;
+    std::map<u64, std::chrono::nanoseconds> m_heartbeat_send_times;  // By the last frame of the window.
+
+public:
+    ObservedConnection(
+        std::unique_ptr<SimulatedConnection> connection,
+        SimulatedNetwork const& network,
+        std::vector<std::chrono::nanoseconds>& confirmation_latencies
+    )
+        : m_connection{ std::move(connection) },
+          m_network{ &network },
+          m_confirmation_latencies{ &confirmation_latencies } { }
+
+    void send(c2k::MessageBuffer const& buffer) override {
+        auto copy = buffer;
+        if (auto const message = AbstractMessage::from_buffer(copy); message->type() == MessageType::Heartbeat) {
+            m_heartbeat_send_times.emplace(dynamic_cast<Heartbeat const&>(*message).frame, m_network->now());
+        }
+        m_connection->send(buffer);
+    }
+
+    [[nodiscard]] std::deque<std::unique_ptr<AbstractMessage>> take_received_messages() override {
+        auto messages = m_connection->take_received_messages();
+        for (auto const& message : messages) {
+            if (message->type() != MessageType::StateBroadcast) {
+                continue;
+            }
+            auto const frame = dynamic_cast<StateBroadcast const&>(*message).frame;
+            if (auto const node = m_heartbeat_send_times.extract(frame); not node.empty()) {
+                m_confirmation_latencies->push_back(m_network->now() - node.mapped());
+            }
+        }
+        return messages;
+    }
+};
+
+SimulatedMatch::SimulatedMatch(SimulatedMatchOptions const& options)
+    : m_options{ options }, m_network{ options.seed }, m_pending_heartbeats(options.num_players) {
+    m_clients.reserve(options.num_players);
+    m_server_connections.reserve(options.num_players);
+    m_client_infos.reserve(options.num_players);
+    for (auto i = u8{ 0 }; i < options.num_players; ++i) {
+        auto [client_end, server_end] = m_network.connect(options.uplink, options.downlink);
+        auto const uplink = client_end.get();
+        auto connection = std::make_unique<ObservedConnection>(
+            std::move(client_end),
+            m_network,
+            m_statistics.confirmation_latencies
+        );
+        connection->send(Connect{ std::format("player {}", i) }.serialize());
+        m_clients.push_back(Client{ uplink, std::move(connection), nullptr, std::mt19937_64{ options.seed + i }, {} });
+        m_server_connections.push_back(std::move(server_end));
+        m_client_infos.emplace_back(i, options.seed, start_frame);
+    }
+}
+
+void SimulatedMatch::run(u64 const num_frames) {
+    for (auto i = u64{ 0 }; i < num_frames; ++i) {
+        step();
+    }
+}
+
+[[nodiscard]] SimulatedMatchStatistics SimulatedMatch::statistics() const {
+    auto result = m_statistics;
+    for (auto const& client : m_clients) {
+        auto const& uplink = client.uplink->outgoing_statistics();
+        result.num_uplink_bytes += uplink.num_bytes;
+        result.num_uplink_messages += uplink.num_messages;
+        result.num_retransmissions += uplink.num_retransmissions;
+    }
+    for (auto const& connection : m_server_connections) {
+        auto const& downlink = connection->outgoing_statistics();
+        result.num_downlink_bytes += downlink.num_bytes;
+        result.num_downlink_messages += downlink.num_messages;
+        result.num_retransmissions += downlink.num_retransmissions;
+    }
+    result.last_checked_state_hash_frame = std::ranges::min(
+        m_client_infos | std::views::transform(&ClientInfo::last_checked_state_hash_frame)
+    );
+    for (auto const& client_info : m_client_infos) {
+        result.num_provisional_key_states += client_info.num_provisional_key_states;
+        if (client_info.desynchronized_since_frame.has_value()) {
+            ++result.num_desynchronized_clients;
+        }
+        result.final_state_hashes.push_back(client_info.tetrion.state_hash());
+    }
+    return result;
+}
+
+void SimulatedMatch::step() {
+    m_network.advance(frame_duration);
+    update_server();
+    for (auto i = usize{ 0 }; i < m_clients.size(); ++i) {
+        update_client(i);
+    }
+}
+
+// Does what the threads of the Server do, but the broadcasts are sent as soon as possible instead of being polled.
+void SimulatedMatch::update_server() {
+    for (auto i = usize{ 0 }; i < m_server_connections.size(); ++i) {
+        auto& client_info = m_client_infos.at(i);
+        for (auto const& message : m_server_connections.at(i)->take_received_messages()) {
+            switch (message->type()) {
+                case MessageType::Connect: {
+                    auto const& name = dynamic_cast<Connect const&>(*message).player_name;
+                    client_info.player_name = name;
+                    client_info.tetrion = PlayerTetrion{ m_options.seed, start_frame, client_info.id, name };
+                    client_info.state = ClientState::Identified;
+                    break;
+                }
+                case MessageType::Heartbeat:
+                    m_pending_heartbeats.at(i).push_back(dynamic_cast<Heartbeat const&>(*message));
+                    break;
+                default:
+                    spdlog::warn("received message of unexpected type: {}", magic_enum::enum_name(message->type()));
+                    break;
+            }
+        }
+
+        auto& pending = m_pending_heartbeats.at(i);
+        while (not pending.empty()) {
+            auto const result = append_heartbeat(client_info, pending.front());
+            if (result == InputWindowBuffer::AppendResult::Full) {
+                break;
+            }
+            if (result != InputWindowBuffer::AppendResult::Appended) {
+                spdlog::warn(
+                    "rejecting key states of client {} for window ending at frame {} ({})",
+                    i,
+                    pending.front().frame,
+                    magic_enum::enum_name(result)
+                );
+            }
+            pending.pop_front();
+        }
+    }
+
+    if (not m_has_started) {
+        if (std::ranges::all_of(m_client_infos, [](ClientInfo const& info) {
+                return info.state == ClientState::Identified;
+            })) {
+            start_game();
+        }
+        return;
+    }
+
+    if (m_options.lag_budget > 0) {
+        fill_in_for_stragglers(m_client_infos, m_options.lag_budget);
+    }
+    while (is_next_window_complete(m_client_infos)) {
+        auto const serialized_broadcast_message = simulate_window(m_client_infos).serialize();
+        for (auto const& connection : m_server_connections) {
+            connection->send(serialized_broadcast_message);
+        }
+    }
+}
+
+void SimulatedMatch::start_game() {
+    auto identities = std::vector<ClientIdentity>{};
+    identities.reserve(m_client_infos.size());
+    for (auto const& client_info : m_client_infos) {
+        identities.emplace_back(client_info.id, client_info.player_name);
+    }
+    for (auto const& [i, connection] : std::views::enumerate(m_server_connections)) {
+        connection->send(GameStart{ gsl::narrow<u8>(i), start_frame, m_options.seed, identities }.serialize());
+    }
+    m_has_started = true;
+}
+
+void SimulatedMatch::update_client(usize const index) {
+    auto& client = m_clients.at(index);
+    if (client.tetrion != nullptr) {
+        std::ignore = client.tetrion->simulate_next_frame(next_key_state(client));
+        return;
+    }
+
+    auto messages = client.connection->take_received_messages();
+    auto const game_start = std::ranges::find(messages, MessageType::GameStart, [](auto const& message) {
+        return message->type();
+    });
+    if (game_start == messages.end()) {
+        return;
+    }
+    // Nothing else is sent before the game starts.
+    assert(messages.size() == 1);
+    client.tetrion = MultiplayerTetrion::start(
+        std::move(client.connection),
+        dynamic_cast<GameStart const&>(**game_start),
+        m_client_infos.at(index).player_name
+    );
+}
+
+// Presses one random key (or none) for a random number of frames, similar to the load generator.
+[[nodiscard]] KeyState SimulatedMatch::next_key_state(Client& client) {
+    if (client.remaining_frames == 0) {
+        static constexpr auto keys = magic_enum::enum_values<Key>();
+        auto const choice = std::uniform_int_distribution<usize>{ 0, keys.size() }(client.random);
+        client.key_state = (choice == keys.size() ? KeyState{} : KeyState{}.set(keys.at(choice)));
+        client.remaining_frames = std::uniform_int_distribution<u64>{ 1, 20 }(client.random);
+    }
+    --client.remaining_frames;
+    return client.key_state;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <lib2k/types.hpp>
+#include <memory>
+#include <network/simulated_network.hpp>
+#include <random>
+#include <simulator/multiplayer_tetrion.hpp>
+#include <vector>
+#include "lockstep.hpp"
+
+struct SimulatedMatchOptions final {
+    u8 num_players = 2;
+    u64 seed = 0;         // Determines the match, the inputs of the players and the behavior of the network.
+    LinkModel uplink;     // From each client to the server.
+    LinkModel downlink;   // From the server to each client.
+    u64 lag_budget = 0;   // See Server::set_lag_budget().
+};
+
+struct SimulatedMatchStatistics final {
+    // Time from sending the key states of a window until receiving the broadcast that confirms them, one sample per
+    // client and window.
+    std::vector<std::chrono::nanoseconds> confirmation_latencies;
+    u64 num_uplink_bytes = 0;
+    u64 num_downlink_bytes = 0;
+    u64 num_uplink_messages = 0;
+    u64 num_downlink_messages = 0;
+    u64 num_retransmissions = 0;
+    u64 num_provisional_key_states = 0;
+    u64 num_desynchronized_clients = 0;
+    u64 last_checked_state_hash_frame = 0;  // Minimum over all clients.
+    std::vector<u64> final_state_hashes;    // Of the tetrions as simulated by the server, in the order of the clients.
+};
+
+// Runs a whole match (clients and the lockstep core of the server) on a SimulatedNetwork within a single thread. The
+// clients are regular MultiplayerTetrions that simulate 60 frames per second of virtual time. Since nothing depends on
+// real time or thread scheduling, the same options always lead to the same match.
+class SimulatedMatch final {
+public:
+    static constexpr auto frame_duration = std::chrono::nanoseconds{ 1'000'000'000 / 60 };
+
+private:
+    struct Client final {
+        SimulatedConnection const* uplink;
+        std::unique_ptr<MessageTransport> connection;  // Handed over to the tetrion when the game starts.
+        std::unique_ptr<MultiplayerTetrion> tetrion;
+        std::mt19937_64 random;
+        KeyState key_state;
+        u64 remaining_frames = 0;  // Until the key state changes.
+    };
+
+    SimulatedMatchOptions m_options;
+    SimulatedNetwork m_network;
+    SimulatedMatchStatistics m_statistics;  // Latencies are recorded by the connections of the clients.
+    std::vector<Client> m_clients;
+    std::vector<std::unique_ptr<SimulatedConnection>> m_server_connections;
+    std::vector<ClientInfo> m_client_infos;
+    std::vector<std::deque<Heartbeat>> m_pending_heartbeats;  // Per client, waiting for space in its input buffer.
+    bool m_has_started = false;
+
+    static constexpr auto start_frame = u64{ 180 };
+
+public:
+    explicit SimulatedMatch(SimulatedMatchOptions const& options);
+
+    // The connections refer to the members.
+    SimulatedMatch(SimulatedMatch const& other) = delete;
+    SimulatedMatch(SimulatedMatch&& other) noexcept = delete;
+    SimulatedMatch& operator=(SimulatedMatch const& other) = delete;
+    SimulatedMatch& operator=(SimulatedMatch&& other) noexcept = delete;
+    ~SimulatedMatch() = default;
+
+    // Advances the match by the given number of frames of virtual time.
+    void run(u64 num_frames);
+
+    [[nodiscard]] bool has_started() const {
+        return m_has_started;
+    }
+
+    [[nodiscard]] SimulatedNetwork const& network() const {
+        return m_network;
+    }
+
+    [[nodiscard]] SimulatedMatchStatistics statistics() const;
+
+private:
+    void step();
+    void update_server();
+    void start_game();
+    void update_client(usize index);
+    [[nodiscard]] KeyState next_key_state(Client& client);
+};
@@ -0,0 +1,84 @@
+#include "supervisor.hpp"
+#include <spdlog/spdlog.h>
+#include <format>
+#include <limits>
+#include <gsl/gsl>
+
+Supervisor::Supervisor(std::uint16_t const lobby_port, usize const pool_size, MatchSettings settings)
+    : m_lobby_socket{ c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, "127.0.0.1", lobby_port) },
+      m_pool_size{ std::max(pool_size, usize{ 1 }) },
+      m_settings{ std::move(settings) } {
+    fill_pool();
+}
+
+Supervisor::~Supervisor() {
+    for (auto const& slot : m_idle_slots) {
+        slot->stop();
+    }
+}
+
+void Supervisor::run() {
+    while (true) {
+        auto num_players = std::uint16_t{};
+        try {
+            num_players = m_lobby_socket.receive<std::uint16_t>().get();
+        } catch (c2k::TimeoutError const&) {
+            remove_finished_matches();
+            continue;
+        } catch (c2k::ReadError const& exception) {
+            spdlog::info("lobby server closed the control connection: {}", exception.what());
+            return;
+        }
+        start_match(num_players);
+        // Everything that is not needed to answer the lobby happens after the answer has been sent.
+        remove_finished_matches();
+        fill_pool();
+    }
+}
+
+void Supervisor::fill_pool() {
+    while (m_idle_slots.size() < m_pool_size) {
+        auto slot = std::make_unique<Server>();
+        slot->simulate_packet_loss(m_settings.simulated_packet_loss, 0);
+        slot->set_lag_budget(m_settings.lag_budget);
+        spdlog::info("created idle match slot on port {}", slot->port());
+        m_idle_slots.push_back(std::move(slot));
+    }
+}
+
+void Supervisor::start_match(std::uint16_t const num_players) {
+    if (num_players == 0 or num_players > std::numeric_limits<std::uint8_t>::max()) {
+        // Port 0 tells the lobby server that no match has been started.
+        spdlog::error("lobby server requested a match for an invalid number of players ({})", num_players);
+        std::ignore = m_lobby_socket.send(std::uint16_t{ 0 }).get();
+        return;
+    }
+    if (m_idle_slots.empty()) {
+        fill_pool();
+    }
+    auto slot = std::move(m_idle_slots.front());
+    m_idle_slots.pop_front();
+    ++m_num_started_matches;
+
+    if (m_settings.replay_path.has_value()) {
+        auto path = m_settings.replay_path.value();
+        path.replace_filename(
+            std::format("{}_{}{}", path.stem().string(), m_num_started_matches, path.extension().string())
+        );
+        slot->set_replay_path(std::move(path));
+    }
+    if (m_settings.metrics_registry != nullptr) {
+        m_settings.metrics_registry->add(std::format("port=\"{}\"", slot->port()), slot->metrics());
+    }
+    slot->start_match(gsl::narrow<std::uint8_t>(num_players));
+    spdlog::info("starting match {} for {} players on port {}", m_num_started_matches, num_players, slot->port());
+    if (m_lobby_socket.send(slot->port()).get() != sizeof(std::uint16_t)) {
+        throw std::runtime_error{ "unable to send port to lobby server" };
+    }
+    m_running_matches.push_back(std::move(slot));
+}
+
+void Supervisor::remove_finished_matches() {
+    // Destroying a server joins its threads, which only takes long if the match is still running.
+    std::erase_if(m_running_matches, [](std::unique_ptr<Server> const& match) { return match->has_stopped(); });
+}
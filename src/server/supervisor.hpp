@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <lib2k/types.hpp>
+#include <memory>
+#include <optional>
+#include <sockets/sockets.hpp>
+#include <vector>
+#include "metrics.hpp"
+#include "server.hpp"
+
+struct MatchSettings final {
+    double simulated_packet_loss = 0.0;
+    u64 lag_budget = 0;
+    // The number of the match is appended to the file name, e.g. "match.replay" becomes "match_3.replay".
+    std::optional<std::filesystem::path> replay_path;
+    std::shared_ptr<MetricsRegistry> metrics_registry;  // If set, the metrics of every match are exported.
+};
+
+// Serves any number of matches for the lobby server. Instead of spawning a server process per match, the lobby keeps
+// a single control connection to the supervisor and sends it the number of players whenever a match starts. The
+// supervisor answers with the port of an idle match slot that has been created ahead of time, so starting a match
+// does not have to wait for binding sockets and starting threads.
+class Supervisor final {
+private:
+    c2k::ClientSocket m_lobby_socket;
+    usize m_pool_size;
+    MatchSettings m_settings;
+    std::deque<std::unique_ptr<Server>> m_idle_slots;
+    std::vector<std::unique_ptr<Server>> m_running_matches;
+    usize m_num_started_matches = 0;
+
+public:
+    Supervisor(std::uint16_t lobby_port, usize pool_size, MatchSettings settings);
+    Supervisor(Supervisor const&) = delete;
+    Supervisor(Supervisor&&) noexcept = delete;
+    Supervisor& operator=(Supervisor const&) = delete;
+    Supervisor& operator=(Supervisor&&) = delete;
+    // Waits for the running matches to end.
+    ~Supervisor();
+
+    // Serves requests until the lobby server closes the control connection.
+    void run();
+
+private:
+    void fill_pool();
+    void start_match(std::uint16_t num_players);
+    void remove_finished_matches();
+};
@@ -38,3 +38,19 @@
     assert(alive_tetrions.begin()->first != sender_tetrion_id);
     return *(alive_tetrions.begin()->second);
 }
+
+[[nodiscard]] std::vector<GarbageDelivery> deliver_garbage(
+    std::vector<ObpfTetrion*> const& tetrions,
+    std::map<u8, GarbageSendEvent> const& garbage_send_events
+) {
+    auto result = std::vector<GarbageDelivery>{};
+    for (auto const& [sender_tetrion_id, garbage_send_event] : garbage_send_events) {
+        auto target = determine_garbage_target(tetrions, sender_tetrion_id, garbage_send_event.frame);
+        if (not target.has_value()) {
+            continue;
+        }
+        target.value().receive_garbage(garbage_send_event);
+        result.push_back(GarbageDelivery{ &target.value(), garbage_send_event });
+    }
+    return result;
+}
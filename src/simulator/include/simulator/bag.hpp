@@ -1,13 +1,13 @@
 #pragma once
 
 #include <array>
-#include <lib2k/random.hpp>
+#include "replayable_random.hpp"
 #include "tetromino_type.hpp"
 
 struct Bag final {
     std::array<TetrominoType, 7> tetrominos{};
 
-    explicit Bag(std::mt19937_64& random) {
+    explicit Bag(ReplayableRandom& random) {
         using enum TetrominoType;
         tetrominos = std::array{
             I, J, L, O, S, T, Z,
@@ -19,7 +19,7 @@ struct Bag final {
     }
 
 private:
-    static void shuffle(decltype(tetrominos)& tetrominos, std::mt19937_64& engine) {
+    static void shuffle(decltype(tetrominos)& tetrominos, ReplayableRandom& engine) {
         for (auto i = tetrominos.end() - tetrominos.begin() - 1; i > 0; --i) {
             using std::swap;
             // Using operator% won't result in a uniform distribution, but that's fine for our purposes.
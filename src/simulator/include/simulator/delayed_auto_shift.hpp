@@ -74,6 +74,18 @@ public:
         }
     }
 
+    // See ObpfTetrion::visit_state().
+    template<typename Self, typename Visitor>
+    static void visit_state(Self& self, Visitor&& visitor) {
+        visitor(
+            self.m_left_is_held_down,
+            self.m_right_is_held_down,
+            self.m_direction,
+            self.m_counter,
+            self.m_frame_delay_index
+        );
+    }
+
 private:
     void start_movement(AutoShiftDirection const direction) {
         m_frame_delay_index = 0;
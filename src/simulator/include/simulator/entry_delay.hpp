@@ -33,4 +33,10 @@ public:
     void spawn_next_frame() {
         m_countdown = 1;
     }
+
+    // See ObpfTetrion::visit_state().
+    template<typename Self, typename Visitor>
+    static void visit_state(Self& self, Visitor&& visitor) {
+        visitor(self.m_countdown);
+    }
 };
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <lib2k/types.hpp>
+#include <span>
+#include <tuple>
+#include <vector>
+#include "action.hpp"
+#include "tetromino_type.hpp"
+
+struct Event final {
+    u64 frame;
+    Action action;
+    TetrominoType piece;  // The piece that caused the event (Empty for all clears).
+    u8 num_lines;         // Only set for line clears and all clears.
+
+    [[nodiscard]] bool operator==(Event const& other) const = default;
+};
+
+// Collects the events of a tetrion until the host drains them, e.g. once per frame or after simulating a batch of
+// frames. The capacity is fixed, so if the host falls behind, the oldest events are overwritten. Recording is
+// disabled by default, in which case nothing is allocated and pushing an event is a no-op.
+class EventBuffer final {
+public:
+    static constexpr auto capacity = usize{ 64 };
+
+private:
+    std::vector<Event> m_events;  // Ring buffer with `capacity` elements while recording is enabled, empty otherwise.
+    usize m_first = 0;
+    usize m_size = 0;
+
+public:
+    [[nodiscard]] bool is_recording() const {
+        return not m_events.empty();
+    }
+
+    // Disabling the recording discards all events that have not been drained yet.
+    void set_recording(bool const enabled) {
+        if (enabled == is_recording()) {
+            return;
+        }
+        m_events = enabled ? std::vector<Event>(capacity) : std::vector<Event>{};
+        m_first = 0;
+        m_size = 0;
+    }
+
+    [[nodiscard]] usize size() const {
+        return m_size;
+    }
+
+    void push(Event const& event) {
+        if (not is_recording()) {
+            return;
+        }
+        m_events.at((m_first + m_size) % capacity) = event;
+        if (m_size == capacity) {
+            m_first = (m_first + 1) % capacity;
+        } else {
+            ++m_size;
+        }
+    }
+
+    // Moves the oldest events into `out` (as many as fit) and returns how many have been moved.
+    [[nodiscard]] usize drain(std::span<Event> const out) {
+        auto const count = std::min(out.size(), m_size);
+        for (auto i = usize{ 0 }; i < count; ++i) {
+            out[i] = m_events.at((m_first + i) % capacity);
+        }
+        m_first = m_size == count ? 0 : (m_first + count) % capacity;
+        m_size -= count;
+        return count;
+    }
+
+    // Convenience for C++ hosts.
+    [[nodiscard]] std::vector<Event> drain() {
+        auto result = std::vector<Event>(m_size);
+        std::ignore = drain(result);
+        return result;
+    }
+};
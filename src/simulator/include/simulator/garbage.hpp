@@ -1,6 +1,7 @@
 #pragma once
 
 #include <lib2k/types.hpp>
+#include <map>
 #include <tl/optional.hpp>
 #include <vector>
 
@@ -19,3 +20,16 @@ struct ObpfTetrion;
     u8 sender_tetrion_id,
     u64 frame
 );
+
+struct GarbageDelivery final {
+    ObpfTetrion* receiver;
+    GarbageSendEvent event;
+};
+
+// Routes the garbage that has been sent during a single frame (keyed by the id of the sender). The garbage is
+// delivered in the order of the sender ids, so that the server and all clients end up with the same garbage queues,
+// regardless of the order in which they simulated the tetrions.
+[[nodiscard]] std::vector<GarbageDelivery> deliver_garbage(
+    std::vector<ObpfTetrion*> const& tetrions,
+    std::map<u8, GarbageSendEvent> const& garbage_send_events
+);
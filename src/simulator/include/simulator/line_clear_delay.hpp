@@ -48,6 +48,12 @@ public:
         m_countdown = delay;
     }
 
+    // See ObpfTetrion::visit_state().
+    template<typename Self, typename Visitor>
+    static void visit_state(Self& self, Visitor&& visitor) {
+        visitor(self.m_countdown, self.m_lines_to_clear);
+    }
+
     [[nodiscard]] State state() const {
         return State{ .lines = m_lines_to_clear.value_or(c2k::StaticVector<u8, 4>{}), .countdown = m_countdown };
     }
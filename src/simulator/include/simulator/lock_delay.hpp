@@ -120,6 +120,12 @@ public:
         return ShouldNotLock;
     }
 
+    // See ObpfTetrion::visit_state().
+    template<typename Self, typename Visitor>
+    static void visit_state(Self& self, Visitor&& visitor) {
+        visitor(self.m_delay_active, self.m_delay_counter, self.m_num_lock_delays_executed, self.m_can_lock);
+    }
+
     void clear() {
         *this = {};
     }
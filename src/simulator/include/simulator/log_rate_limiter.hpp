@@ -0,0 +1,53 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <lib2k/types.hpp>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Limits how often a repetitive message is logged, e.g. a warning that is triggered by every packet of a misbehaving
+// client. Usually declared as a static local variable next to the log statement, so that the limit applies to all
+// threads (and matches) that reach it.
+class LogRateLimiter final {
+private:
+    std::chrono::steady_clock::duration m_interval;
+    u32 m_max_messages_per_interval;
+    std::mutex m_mutex;
+    std::chrono::steady_clock::time_point m_interval_start;
+    u32 m_num_messages_in_interval = 0;
+    u64 m_num_suppressed = 0;
+
+public:
+    explicit LogRateLimiter(
+        std::chrono::steady_clock::duration const interval = std::chrono::seconds{ 1 },
+        u32 const max_messages_per_interval = 5
+    )
+        : m_interval{ interval }, m_max_messages_per_interval{ max_messages_per_interval } { }
+
+    // Returns the number of messages that have been suppressed since the last one that passed, or std::nullopt if
+    // this message has to be suppressed.
+    [[nodiscard]] std::optional<u64> try_acquire();
+};
+
+// The message is only formatted if neither the log level nor the rate limiter filter it out.
+template<typename... Args>
+void log_rate_limited(
+    LogRateLimiter& limiter,
+    spdlog::level::level_enum const level,
+    spdlog::format_string_t<Args...> const format,
+    Args&&... args
+) {
+    if (not spdlog::should_log(level)) {
+        return;
+    }
+    auto const num_suppressed = limiter.try_acquire();
+    if (not num_suppressed.has_value()) {
+        return;
+    }
+    if (num_suppressed.value() > 0) {
+        spdlog::log(level, "suppressed {} similar messages", num_suppressed.value());
+    }
+    spdlog::log(level, format, std::forward<Args>(args)...);
+}
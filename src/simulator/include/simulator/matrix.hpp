@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <gsl/gsl>
 #include <lib2k/types.hpp>
+#include <span>
+#include <utility>
 #include "tetromino_type.hpp"
 #include "vec2.hpp"
 
@@ -13,7 +16,27 @@ public:
     static constexpr auto num_invisible_lines = std::size_t{ 2 };
 
 private:
+    static constexpr auto num_mino_types = static_cast<usize>(std::to_underlying(TetrominoType::Last)) + 1;
+
+    // One random key per position and mino type (generated by SplitMix64). The hash of the matrix is the XOR of the
+    // keys of all minos. Empty cells don't contribute, so that an empty matrix has a hash of 0.
+    static constexpr auto zobrist_keys = [] {
+        auto result = std::array<u64, width * height * num_mino_types>{};
+        auto state = u64{ 0 };
+        for (auto& key : result) {
+            state += 0x9E3779B97F4A7C15;
+            auto value = state;
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+            key = value ^ (value >> 31);
+        }
+        return result;
+    }();
+
     std::array<TetrominoType, width * height> m_minos{};
+    u64 m_hash = 0;        // Updated on every write.
+    u32 m_dirty_rows = 0;  // One bit per row (bit 0 is the top row) that has changed since the mask was cleared.
+    static_assert(height <= 32);
 
 public:
     void copy_line(std::size_t const destination, std::size_t const source) {
@@ -26,7 +49,7 @@ public:
                 gsl::narrow<decltype(Vec2::x)>(column),
                 gsl::narrow<decltype(Vec2::y)>(source),
             };
-            (*this)[destination_vec] = (*this)[source_vec];
+            set(destination_vec, (*this)[source_vec]);
         }
     }
 
@@ -36,7 +59,7 @@ public:
                 gsl::narrow<decltype(Vec2::x)>(column),
                 gsl::narrow<decltype(Vec2::y)>(line),
             };
-            (*this)[position] = type;
+            set(position, type);
         }
     }
 
@@ -68,11 +91,72 @@ public:
         return true;
     }
 
+    // Only compares the contents (the hash is derived from them and the dirty rows are not part of the state).
+    [[nodiscard]] bool operator==(Matrix const& other) const {
+        return m_minos == other.m_minos;
+    }
+
+    // All minos row by row, starting at the top.
+    [[nodiscard]] std::span<TetrominoType const, width * height> minos() const {
+        return m_minos;
+    }
+
+    [[nodiscard]] u64 hash() const {
+        return m_hash;
+    }
+
+    // Allows renderers to only update the rows that have changed since they last cleared the mask.
+    [[nodiscard]] u32 dirty_rows() const {
+        return m_dirty_rows;
+    }
+
+    void clear_dirty_rows() {
+        m_dirty_rows = 0;
+    }
+
+    // Copies the contents of the other matrix, but in contrast to the assignment operator, the dirty rows are kept
+    // and only the rows that actually differ are added.
+    void assign(Matrix const& other) {
+        for (auto row = usize{ 0 }; row < height; ++row) {
+            auto const begin = row * width;
+            if (not std::equal(
+                    m_minos.begin() + begin, m_minos.begin() + begin + width, other.m_minos.begin() + begin
+                )) {
+                m_dirty_rows |= row_bit(row);
+            }
+        }
+        m_minos = other.m_minos;
+        m_hash = other.m_hash;
+    }
+
     [[nodiscard]] TetrominoType operator[](Vec2 const index) const {
-        return m_minos.at(gsl::narrow<usize>(index.y) * width + gsl::narrow<usize>(index.x));
+        return m_minos.at(to_index(index));
+    }
+
+    void set(Vec2 const index, TetrominoType const type) {
+        auto const i = to_index(index);
+        auto& mino = m_minos.at(i);
+        if (mino == type) {
+            return;
+        }
+        m_hash ^= zobrist_key(i, mino) ^ zobrist_key(i, type);
+        m_dirty_rows |= row_bit(gsl::narrow<usize>(index.y));
+        mino = type;
     }
 
-    [[nodiscard]] TetrominoType& operator[](Vec2 const index) {
-        return m_minos.at(gsl::narrow<usize>(index.y) * width + gsl::narrow<usize>(index.x));
+private:
+    [[nodiscard]] static usize to_index(Vec2 const index) {
+        return gsl::narrow<usize>(index.y) * width + gsl::narrow<usize>(index.x);
+    }
+
+    [[nodiscard]] static u32 row_bit(usize const row) {
+        return u32{ 1 } << row;
+    }
+
+    [[nodiscard]] static u64 zobrist_key(usize const index, TetrominoType const type) {
+        if (type == TetrominoType::Empty) {
+            return 0;
+        }
+        return zobrist_keys.at(index * num_mino_types + static_cast<usize>(std::to_underlying(type)));
     }
 };
@@ -1,34 +1,110 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
 #include <lib2k/static_vector.hpp>
 #include <network/constants.hpp>
+#include <network/message_transport.hpp>
 #include <network/messages.hpp>
+#include <network/udp_socket.hpp>
 #include <sockets/sockets.hpp>
+#include <stop_token>
 #include <string>
 #include "observer_tetrion.hpp"
+#include "replay.hpp"
 #include "tetrion.hpp"
 
 template<typename T>
 using NullableUniquePointer = std::unique_ptr<T>;
 
+// Determines how Heartbeat and StateBroadcast messages are exchanged with the server. All other messages
+// are always sent via TCP.
+enum class GameplayTransport {
+    Tcp,
+    Udp,
+};
+
+struct MultiplayerOptions final {
+    GameplayTransport transport = GameplayTransport::Tcp;
+    double simulated_packet_loss = 0.0;  // Only applies to outgoing datagrams. Meant for testing.
+    u64 packet_loss_seed = 0;
+    // If not 0, the other tetrions are not simulated locally. Instead, the server sends snapshots of their boards
+    // every given number of windows. Only supported by the TCP transport.
+    u8 board_snapshot_interval = 0;
+    // If not empty, the match is recorded into this file. Only the key states are recorded (and only if the client
+    // simulates the other tetrions itself), connection changes are only known to the server.
+    std::string replay_path;
+};
+
 struct MultiplayerTetrion final : ObpfTetrion {
 private:
-    c2k::ClientSocket m_socket;
+    std::unique_ptr<MessageTransport> m_transport;
     u8 m_client_id;
     c2k::StaticVector<KeyState, heartbeat_interval> m_key_state_buffer;
-    std::jthread m_receiving_thread;
+    // Only advanced by broadcasts. Unlike the predicted observers, these are simulated eagerly: where garbage is sent
+    // depends on which opponents send garbage in which frame and which of them are game over, so every broadcast has
+    // to be simulated for all of them, whether they are displayed or not.
     std::vector<std::unique_ptr<ObserverTetrion>> m_observers;
+
+    // Observers are displayed at the local frame by predicting that each opponent keeps pressing the same keys as in
+    // the last confirmed frame. When the actual key states arrive, the confirmed observer serves as the snapshot we
+    // roll back to. Since we never need to roll back further than to the last broadcast, one snapshot per observer is
+    // enough. The predicted observers are only simulated when their state is queried (see ObserverTetrion::catch_up).
+    // The order matches the one of m_observers.
+    std::vector<std::unique_ptr<ObserverTetrion>> m_predicted_observers;
+    bool m_uses_board_snapshots;  // If set, the predicted observers only show the snapshots sent by the server.
+
+    // Broadcasts received via UDP. Everything else arrives via the transport.
     c2k::Synchronized<std::deque<std::unique_ptr<AbstractMessage>>> m_message_queue{ {} };
-    c2k::Synchronized<std::deque<GarbageSendEvent>> m_outgoing_garbage_queue{ {} };
+
+    // The state of this tetrion as simulated by the server, i.e. using the key states from the broadcasts. It is
+    // used for routing garbage and to reconcile the local simulation if the server did not use our own key
+    // states (e.g. because we exceeded the lag budget).
+    ObserverTetrion m_confirmed_state;
+    std::deque<KeyState> m_unconfirmed_key_states;  // Simulated locally, but not yet part of a broadcast.
+
+    // Only used for the UDP transport.
+    NullableUniquePointer<UdpSocket> m_datagram_socket;
+    UdpEndpoint m_server_endpoint;
+    c2k::Synchronized<std::deque<Heartbeat>> m_unacknowledged_heartbeats{ {} };
+    std::atomic<u64> m_broadcasts_received_until_frame = 0;
+    std::jthread m_datagram_receiving_thread;
+
+    std::unique_ptr<ReplayWriter> m_replay_writer;
+    std::vector<u8> m_replay_client_ids;  // In the order of the replay header.
 
     struct Key {};
 
 public:
+    // Blocks until the match starts. Returns nullptr if the connection fails or if a stop is requested via the given
+    // token (which is checked between the timeouts of the socket).
     static NullableUniquePointer<MultiplayerTetrion> create(
         std::string const& server,
         std::uint16_t port,
-        std::string player_name
+        std::string player_name,
+        MultiplayerOptions const& options = {},
+        std::stop_token const& stop_token = {}
+    );
+
+    // Rejoins a running match after the connection was lost. The server only accepts this if the client with the
+    // given id is currently disconnected and has the given name. The state of all tetrions is restored from the
+    // snapshots sent by the server, so this also works after a restart of the client.
+    static NullableUniquePointer<MultiplayerTetrion> reconnect(
+        std::string const& server,
+        std::uint16_t port,
+        u8 client_id,
+        std::string player_name,
+        MultiplayerOptions const& options = {},
+        std::stop_token const& stop_token = {}
+    );
+
+    // Starts the match on a connection that has already delivered the given GameStart message (e.g. a connection of
+    // a SimulatedNetwork). Only the TCP transport is supported here.
+    static std::unique_ptr<MultiplayerTetrion> start(
+        std::unique_ptr<MessageTransport> transport,
+        GameStart const& game_start_message,
+        std::string player_name,
+        MultiplayerOptions const& options = {}
     );
 
     // we need address stability of the members here
@@ -38,19 +114,33 @@ public:
     MultiplayerTetrion& operator=(MultiplayerTetrion&& other) noexcept = delete;
 
     explicit MultiplayerTetrion(
-        c2k::ClientSocket socket,
+        std::unique_ptr<MessageTransport> transport,
         u8 const client_id,
         u64 const start_frame,
         u64 const seed,
         std::vector<std::unique_ptr<ObserverTetrion>> observers,
         std::string player_name,
+        NullableUniquePointer<UdpSocket> datagram_socket,
+        UdpEndpoint const& server_endpoint,
+        bool const uses_board_snapshots,
         Key
     )
         : ObpfTetrion{ seed, start_frame, std::move(player_name) },
-          m_socket{ std::move(socket) },
+          m_transport{ std::move(transport) },
           m_client_id{ client_id },
-          m_receiving_thread{ keep_receiving, std::ref(m_socket), std::ref(m_message_queue) },
-          m_observers{ std::move(observers) } {}
+          m_observers{ std::move(observers) },
+          m_uses_board_snapshots{ uses_board_snapshots },
+          m_confirmed_state{ seed, start_frame, client_id, ObpfTetrion::player_name(), ObserverTetrion::Key{} },
+          m_datagram_socket{ std::move(datagram_socket) },
+          m_server_endpoint{ server_endpoint } {
+        m_predicted_observers.reserve(m_observers.size());
+        for (auto const& observer : m_observers) {
+            m_predicted_observers.push_back(std::make_unique<ObserverTetrion>(*observer));
+        }
+        if (m_datagram_socket != nullptr) {
+            m_datagram_receiving_thread = std::jthread{ keep_receiving_datagrams, std::ref(*this) };
+        }
+    }
 
     [[nodiscard]] std::optional<GarbageSendEvent> simulate_next_frame(KeyState key_state) override;
     [[nodiscard]] std::vector<ObserverTetrion*> get_observers() const override;
@@ -62,11 +152,26 @@ public:
 
 private:
     void send_heartbeat_message();
+    void send_redundant_heartbeat_message(Heartbeat heartbeat);
     void process_state_broadcast_message(StateBroadcast const& message);
+    void process_snapshot_broadcast_message(SnapshotBroadcast const& message);
+    void reconcile(std::array<KeyState, heartbeat_interval> const& confirmed_key_states, bool received_garbage);
+    void update_predictions(StateBroadcast const& message, std::vector<u8> const& garbage_receivers);
+    void advance_predictions();
+    void restore(ObpfTetrion const& own_state);
+    void start_recording(std::string const& path, GameStart const& game_start_message);
+    void record_window(StateBroadcast const& message);
+    void set_is_connected(u8 client_id, bool is_connected);
 
-    static void keep_receiving(
-        std::stop_token const& stop_token,
-        c2k::ClientSocket& socket,
-        c2k::Synchronized<std::deque<std::unique_ptr<AbstractMessage>>>& queue
+    static std::unique_ptr<MultiplayerTetrion> start(
+        std::unique_ptr<MessageTransport> transport,
+        GameStart const& game_start_message,
+        std::string player_name,
+        MultiplayerOptions const& options,
+        NullableUniquePointer<UdpSocket> datagram_socket,
+        UdpEndpoint const& server_endpoint
     );
+    void process_message(AbstractMessage const& message);
+
+    static void keep_receiving_datagrams(std::stop_token const& stop_token, MultiplayerTetrion& self);
 };
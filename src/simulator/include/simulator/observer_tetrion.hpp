@@ -11,6 +11,11 @@ private:
     u8 m_client_id;
     bool m_is_connected = true;
 
+    // Only used by observers that are displayed ahead of their confirmed state (see MultiplayerTetrion). These
+    // are simulated lazily up to the given frame, assuming that the opponent keeps pressing the same keys.
+    KeyState m_predicted_key_state;
+    u64 m_predicted_until_frame = 0;
+
 public:
     ObserverTetrion(u64 const seed, u64 const start_frame, u8 const m_client_id, std::string player_name, Key)
         : ObpfTetrion{ seed, start_frame, std::move(player_name) }, m_client_id{ m_client_id } {}
@@ -31,6 +36,8 @@ public:
         return m_is_connected;
     }
 
+    void catch_up() override;
+
 private:
     [[nodiscard]] std::optional<GarbageSendEvent> process_key_state(KeyState key_state);
 };
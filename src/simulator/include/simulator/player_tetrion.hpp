@@ -0,0 +1,22 @@
+#pragma once
+
+#include "tetrion.hpp"
+
+// A tetrion that is simulated on behalf of a player of a multiplayer match, e.g. by the server or when re-simulating
+// a replay. In contrast to the base class, it knows the client id of the player, which is needed to route garbage.
+struct PlayerTetrion final : ObpfTetrion {
+private:
+    u8 m_client_id;
+
+public:
+    PlayerTetrion(u64 const seed, u64 const start_frame, u8 const client_id, std::string player_name)
+        : ObpfTetrion{ seed, start_frame, std::move(player_name) }, m_client_id{ client_id } {}
+
+    // Used for states that have been restored from a snapshot.
+    PlayerTetrion(ObpfTetrion state, u8 const client_id)
+        : ObpfTetrion{ std::move(state) }, m_client_id{ client_id } {}
+
+    [[nodiscard]] u8 id() const override {
+        return m_client_id;
+    }
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <lib2k/types.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "key_state.hpp"
+#include "tetrion.hpp"
+
+class ReplayError final : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+struct ReplayPlayer final {
+    u8 client_id;
+    std::string name;
+};
+
+// Everything that is needed to re-create the tetrions of a match (besides the key states).
+struct ReplayHeader final {
+    u64 seed;
+    u64 start_frame;
+    std::vector<ReplayPlayer> players;
+};
+
+enum class ReplayEventType : u8 {
+    Disconnected,
+    Reconnected,
+};
+
+struct ReplayEvent final {
+    u64 frame;  // The event takes effect before this frame is simulated.
+    u8 player_index;
+    ReplayEventType type;
+
+    [[nodiscard]] bool operator==(ReplayEvent const& other) const = default;
+};
+
+struct ReplayKeyframeTetrion final {
+    ObpfTetrion const* tetrion;
+    bool is_connected;
+};
+
+// State of all tetrions at the start of a frame, used to start a playback in the middle of a replay.
+struct ReplayKeyframe final {
+    u64 frame;
+    std::vector<ObpfTetrion> tetrions;  // In the order of the header.
+    std::vector<bool> is_connected;
+};
+
+// Records the key states of all players frame by frame. Frames are collected into blocks that are encoded on the
+// calling thread (which is cheap), while the file is written by a background thread, so that appending never waits
+// for the disk. The file can be read even if the writer did not finish properly, only the last block is lost.
+// Additionally, snapshots of all tetrions (keyframes) can be stored at block boundaries. An index of the keyframes is
+// appended when the writer is destroyed. Appending is not thread-safe.
+class ReplayWriter final {
+public:
+    static constexpr auto frames_per_block = u64{ 600 };  // 10 seconds
+
+private:
+    struct KeyframePosition final {
+        u64 frame;
+        u64 position;  // Within the file.
+    };
+
+    struct RunEncoder final {
+        std::vector<u8> bytes;
+        KeyState previous;  // Key state of the last encoded run.
+        KeyState current;
+        u64 length = 0;
+    };
+
+    usize m_num_players;
+    u64 m_next_frame = 0;
+    u64 m_block_first_frame = 0;
+    std::vector<RunEncoder> m_encoders;
+    std::vector<ReplayEvent> m_block_events;
+    u64 m_num_bytes_written = 0;  // Including the pending records.
+    std::vector<KeyframePosition> m_keyframe_positions;
+
+    std::mutex m_pending_records_mutex;
+    std::condition_variable_any m_pending_records_condition;
+    std::deque<std::vector<u8>> m_pending_records;
+    std::ofstream m_file;
+    std::jthread m_writing_thread;  // Must be the last member since it accesses the others.
+
+public:
+    // Throws a ReplayError if the file cannot be created.
+    ReplayWriter(std::filesystem::path const& path, ReplayHeader const& header);
+    ReplayWriter(ReplayWriter const& other) = delete;
+    ReplayWriter(ReplayWriter&& other) noexcept = delete;
+    ReplayWriter& operator=(ReplayWriter const& other) = delete;
+    ReplayWriter& operator=(ReplayWriter&& other) noexcept = delete;
+    ~ReplayWriter();
+
+    [[nodiscard]] u64 next_frame() const {
+        return m_next_frame;
+    }
+
+    // Expects exactly one key state per player (in the order of the header).
+    void append_frame(std::span<KeyState const> key_states);
+
+    // The event takes effect before the next appended frame.
+    void append_event(u8 player_index, ReplayEventType type);
+
+    // Keyframes are stored at the start of every block (except for the first one, since the initial state can be
+    // re-created from the header).
+    [[nodiscard]] bool wants_keyframe() const {
+        return m_next_frame > 0 and m_next_frame % frames_per_block == 0
+               and (m_keyframe_positions.empty() or m_keyframe_positions.back().frame != m_next_frame);
+    }
+
+    // Expects one tetrion per player (in the order of the header), all of them at the next frame to be appended.
+    // The connection states are the ones before the events of that frame take effect.
+    void append_keyframe(std::span<ReplayKeyframeTetrion const> tetrions);
+
+    // Hands the frames of the current (incomplete) block over to the writing thread.
+    void flush();
+
+private:
+    void enqueue_record(std::vector<u8> record);
+    void keep_writing(std::stop_token const& stop_token);
+};
+
+class MappedFile;
+
+// Plays back the key states of a replay frame by frame. The key states are decoded directly from the mapped file.
+class ReplayPlayback final {
+private:
+    std::span<u8 const> m_data;
+    usize m_num_players;
+    usize m_next_record_position;
+    u64 m_next_frame = 0;
+    u64 m_block_end_frame = 0;
+    std::vector<usize> m_run_positions;  // Position of the next run of each player within the current block.
+    std::vector<usize> m_run_end_positions;
+    std::vector<u64> m_remaining_run_lengths;
+    std::vector<KeyState> m_key_states;
+    std::vector<ReplayEvent> m_block_events;
+    usize m_next_event_index = 0;
+    std::vector<ReplayEvent> m_frame_events;
+
+public:
+    ReplayPlayback(std::span<u8 const> data, usize num_players, usize first_record_position, u64 first_frame = 0);
+
+    // Moves on to the next frame. Returns false if the replay has ended. Throws a ReplayError if the replay is
+    // corrupted.
+    [[nodiscard]] bool advance();
+
+    // The frame whose key states are currently available.
+    [[nodiscard]] u64 frame() const {
+        return m_next_frame - 1;
+    }
+
+    // One key state per player (in the order of the header).
+    [[nodiscard]] std::span<KeyState const> key_states() const {
+        return m_key_states;
+    }
+
+    // Events that take effect before the current frame is simulated.
+    [[nodiscard]] std::span<ReplayEvent const> events() const {
+        return m_frame_events;
+    }
+
+private:
+    [[nodiscard]] bool enter_next_block();
+    void decode_run(usize player_index);
+};
+
+// Memory-maps a replay file.
+class ReplayReader final {
+public:
+    struct KeyframePosition final {
+        u64 frame;
+        usize position;  // Within the file.
+    };
+
+private:
+    std::unique_ptr<MappedFile> m_file;
+    ReplayHeader m_header;
+    usize m_first_record_position = 0;
+    std::vector<KeyframePosition> m_keyframe_positions;  // Sorted by frame.
+
+public:
+    // Throws a ReplayError if the file cannot be opened or does not start with a valid replay header.
+    explicit ReplayReader(std::filesystem::path const& path);
+    ReplayReader(ReplayReader const& other) = delete;
+    ReplayReader(ReplayReader&& other) noexcept;
+    ReplayReader& operator=(ReplayReader const& other) = delete;
+    ReplayReader& operator=(ReplayReader&& other) noexcept;
+    ~ReplayReader();
+
+    [[nodiscard]] ReplayHeader const& header() const {
+        return m_header;
+    }
+
+    [[nodiscard]] std::span<u8 const> data() const;
+
+    [[nodiscard]] std::span<KeyframePosition const> keyframe_positions() const {
+        return m_keyframe_positions;
+    }
+
+    // Returns the last keyframe at or before the given frame (if any).
+    [[nodiscard]] std::optional<KeyframePosition> find_keyframe(u64 frame) const;
+
+    [[nodiscard]] ReplayKeyframe load_keyframe(KeyframePosition const& position) const;
+
+    // The playback references the mapped file, so it must not outlive the reader.
+    [[nodiscard]] ReplayPlayback playback() const;
+
+    // Starts right after the given keyframe.
+    [[nodiscard]] ReplayPlayback playback(KeyframePosition const& keyframe) const;
+
+private:
+    void read_keyframe_index();
+    void scan_for_keyframes();
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <lib2k/types.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+#include "player_tetrion.hpp"
+#include "replay.hpp"
+
+// Re-simulates a recorded match exactly like the clients simulate the broadcast key states: every tetrion processes
+// its recorded key state each frame and the garbage is routed between all of them.
+class ReplaySimulation final {
+private:
+    ReplayPlayback m_playback;
+    std::vector<PlayerTetrion> m_tetrions;  // In the order of the header.
+    std::vector<bool> m_is_connected;
+    std::vector<std::optional<GarbageSendEvent>> m_sent_garbage;  // During the current frame, one entry per tetrion.
+
+public:
+    // Starts at the beginning of the match. The simulation references the mapped file, so it must not outlive the
+    // reader.
+    explicit ReplaySimulation(ReplayReader const& reader);
+
+    // Restores the last keyframe at or before the given frame and simulates the remaining frames, so that the next
+    // frame to be simulated is the given one (or the end of the replay, whatever comes first).
+    ReplaySimulation(ReplayReader const& reader, u64 frame);
+
+    [[nodiscard]] u64 next_frame() const {
+        return m_tetrions.empty() ? 0 : m_tetrions.front().next_frame();
+    }
+
+    [[nodiscard]] std::span<PlayerTetrion const> tetrions() const {
+        return m_tetrions;
+    }
+
+    [[nodiscard]] bool is_connected(usize const player_index) const {
+        return m_is_connected.at(player_index);
+    }
+
+    // Returns false if the replay has ended. Throws a ReplayError if the replay is corrupted.
+    [[nodiscard]] bool simulate_next_frame();
+
+    // The following functions split up simulate_next_frame() into its phases, so that the tetrions can be simulated
+    // in parallel: begin_frame() (with the same return value as above), simulate_tetrions() for all tetrions
+    // (concurrent calls have to use disjoint ranges) and end_frame(), which delivers the garbage.
+    [[nodiscard]] bool begin_frame();
+    void simulate_tetrions(usize begin, usize end);
+    void end_frame();
+
+private:
+    ReplaySimulation(ReplayReader const& reader, ReplayKeyframe keyframe, ReplayPlayback playback);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <lib2k/types.hpp>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PlayerVerification final {
+    u8 client_id;
+    std::string name;
+    u64 score;
+    u32 num_lines_cleared;
+    std::optional<u64> game_over_since_frame;
+};
+
+struct ReplayVerification final {
+    std::filesystem::path path;
+    u64 num_frames = 0;
+    std::vector<PlayerVerification> players;  // In the order of the replay header.
+    std::optional<std::string> error;  // Set if the replay could not be re-simulated.
+};
+
+struct ReplayVerificationOptions final {
+    // Number of replays that are re-simulated at the same time.
+    usize num_threads = std::max(usize{ std::thread::hardware_concurrency() }, usize{ 1 });
+
+    // The tetrions of a single replay can be simulated by multiple threads, which synchronize after every frame.
+    // This only pays off for matches with lots of players.
+    usize threads_per_replay = 1;
+};
+
+// Re-simulates a replay from start to end and reports the final state of all tetrions. Does not throw.
+[[nodiscard]] ReplayVerification verify_replay(std::filesystem::path const& path, usize num_threads = 1);
+
+// Re-simulates all given replays using a pool of threads. The results are in the order of the paths.
+[[nodiscard]] std::vector<ReplayVerification> verify_replays(
+    std::span<std::filesystem::path const> paths,
+    ReplayVerificationOptions const& options = {}
+);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <lib2k/types.hpp>
+#include <random>
+
+// Random number engine whose state is fully determined by its seed and the number of values drawn so far.
+// This allows to store the state in a few bytes instead of the ~2.5 KiB of the underlying Mersenne Twister.
+class ReplayableRandom final {
+public:
+    using result_type = std::mt19937_64::result_type;
+
+private:
+    std::mt19937_64 m_engine;
+    u64 m_seed;
+    u64 m_num_draws = 0;
+
+public:
+    explicit ReplayableRandom(u64 const seed)
+        : m_engine{ seed }, m_seed{ seed } {}
+
+    // Restoring the state takes time linear in the number of draws. Since we only draw a few values per
+    // tetromino, this is negligible even for long games.
+    [[nodiscard]] static ReplayableRandom restore(u64 const seed, u64 const num_draws) {
+        auto result = ReplayableRandom{ seed };
+        result.m_engine.discard(num_draws);
+        result.m_num_draws = num_draws;
+        return result;
+    }
+
+    [[nodiscard]] static constexpr result_type min() {
+        return std::mt19937_64::min();
+    }
+
+    [[nodiscard]] static constexpr result_type max() {
+        return std::mt19937_64::max();
+    }
+
+    result_type operator()() {
+        ++m_num_draws;
+        return m_engine();
+    }
+
+    [[nodiscard]] u64 seed() const {
+        return m_seed;
+    }
+
+    [[nodiscard]] u64 num_draws() const {
+        return m_num_draws;
+    }
+};
@@ -10,21 +10,30 @@
 #include <numeric>
 #include <optional>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include "action.hpp"
 #include "bag.hpp"
 #include "delayed_auto_shift.hpp"
 #include "entry_delay.hpp"
+#include "event.hpp"
 #include "garbage.hpp"
 #include "input.hpp"
 #include "key_state.hpp"
 #include "line_clear_delay.hpp"
 #include "lock_delay.hpp"
 #include "matrix.hpp"
+#include "replayable_random.hpp"
 #include "tetromino.hpp"
 
 struct ObserverTetrion;
 
+class SnapshotError final : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
 struct ObpfTetrion {
     static constexpr auto garbage_delay_frames = u64{ 10 * 60 };
 
@@ -32,8 +41,7 @@ private:
     static constexpr auto spawn_position = Vec2{ 3, 0 };
     static constexpr auto spawn_rotation = Rotation::North;
 
-    ObpfActionHandler m_action_handler = nullptr;
-    void* m_action_handler_user_data = nullptr;
+    EventBuffer m_events;  // Not part of the simulation state.
     Matrix m_matrix;
     std::optional<Tetromino> m_active_tetromino;
     std::optional<Tetromino> m_ghost_tetromino;
@@ -43,9 +51,9 @@ private:
     u64 m_start_frame;
     u64 m_next_frame = 0;
     KeyState m_last_key_state;
-    std::mt19937_64 m_bags_rng;
+    ReplayableRandom m_bags_rng;
     std::array<Bag, 2> m_bags;
-    std::mt19937_64 m_garbage_rng;
+    ReplayableRandom m_garbage_rng;
     usize m_bag_index = 0;
     DelayedAutoShiftState m_auto_shift_state;
     LockDelayState m_lock_delay_state;
@@ -87,9 +95,14 @@ public:
     ObpfTetrion& operator=(ObpfTetrion&& other) noexcept = default;
     virtual ~ObpfTetrion() = default;
 
-    void set_action_handler(ObpfActionHandler const handler, void* const user_data) {
-        m_action_handler = handler;
-        m_action_handler_user_data = user_data;
+    // Events are only recorded for tetrions that have been enabled explicitly. Frames that are re-simulated during a
+    // rollback never record events.
+    void set_event_recording(bool const enabled) {
+        m_events.set_recording(enabled);
+    }
+
+    [[nodiscard]] EventBuffer& events() {
+        return m_events;
     }
 
     [[nodiscard]] virtual u8 id() const {
@@ -116,6 +129,10 @@ public:
     [[nodiscard]] virtual std::optional<GarbageSendEvent> simulate_next_frame(KeyState key_state);
     [[nodiscard]] virtual std::vector<ObserverTetrion*> get_observers() const;
     virtual void on_client_disconnected(u8 client_id);
+
+    // Some tetrions are only simulated when their state is actually needed. This brings them up to date.
+    virtual void catch_up() {}
+
     [[nodiscard]] LineClearDelay::State line_clear_delay_state() const;
     [[nodiscard]] std::array<TetrominoType, 6> get_preview_tetrominos() const;
     [[nodiscard]] std::optional<TetrominoType> hold_piece() const;
@@ -173,6 +190,27 @@ public:
         return m_player_name;
     }
 
+    // Serializes the simulation state (i.e. everything except for the recorded events) into a compact binary format.
+    [[nodiscard]] std::vector<u8> save_snapshot() const;
+
+    // Same as above, but replaces the contents of the given buffer, so that its capacity can be reused.
+    void save_snapshot(std::vector<u8>& out) const;
+
+    // Throws a SnapshotError if the data does not contain a valid snapshot.
+    [[nodiscard]] static ObpfTetrion load_snapshot(std::span<u8 const> data);
+
+    // Hash of the simulation state (the same state that is stored in snapshots), used to detect simulations that
+    // diverged. The matrix is hashed incrementally, so this is cheap enough to be called for every window.
+    [[nodiscard]] u64 state_hash() const;
+
+protected:
+    // Replaces the simulation state with the given one and fast-forwards it using the given key states. The
+    // recorded events are kept, but the re-simulated frames don't record any.
+    void rollback_and_resimulate(ObpfTetrion const& state, std::deque<KeyState> const& key_states);
+
+    // Displays the given board instead of simulating it, e.g. because the server already did the simulation.
+    void apply_board_snapshot(u64 next_frame, Matrix const& matrix, bool is_game_over);
+
 private:
     void freeze_and_destroy_active_tetromino();
     [[nodiscard]] bool is_tetromino_completely_invisible(Tetromino const& tetromino) const;
@@ -191,15 +229,47 @@ private:
     void rotate_counter_clockwise();
     void hard_drop();
     void hold();
-    [[nodiscard]] bool determine_lines_to_clear();
+    [[nodiscard]] bool determine_lines_to_clear(TetrominoType locked_piece);
     [[nodiscard]] u64 score_for_num_lines_cleared(std::size_t num_lines_cleared) const;
     void clear_lines(c2k::StaticVector<u8, 4> lines);
     void refresh_ghost_tetromino();
-    void on_touch_event() const;
+    void on_touch_event();
 
     [[nodiscard]] bool is_game_over() const {
         return m_game_over_since_frame.has_value();
     }
 
-    [[nodiscard]] static std::array<Bag, 2> create_two_bags(std::mt19937_64& random);
+    [[nodiscard]] static std::array<Bag, 2> create_two_bags(ReplayableRandom& random);
+
+    // Visits all members that make up the simulation state in a fixed order. This defines the snapshot format (see
+    // tetrion_snapshot.cpp), so new members have to be added here as well.
+    template<typename Self, typename Visitor>
+    static void visit_state(Self& self, Visitor&& visitor) {
+        visitor(
+            self.m_matrix,
+            self.m_active_tetromino,
+            self.m_ghost_tetromino,
+            self.m_hold_piece,
+            self.m_old_hold_piece,
+            self.m_is_hold_possible,
+            self.m_start_frame,
+            self.m_next_frame,
+            self.m_last_key_state,
+            self.m_bags_rng,
+            self.m_bags,
+            self.m_garbage_rng,
+            self.m_bag_index,
+            self.m_auto_shift_state,
+            self.m_lock_delay_state,
+            self.m_entry_delay,
+            self.m_line_clear_delay,
+            self.m_num_lines_cleared,
+            self.m_score,
+            self.m_next_gravity_frame,
+            self.m_is_soft_dropping,
+            self.m_game_over_since_frame,
+            self.m_garbage_receive_queue,
+            self.m_player_name
+        );
+    }
 };
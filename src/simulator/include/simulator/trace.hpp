@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <lib2k/types.hpp>
+#include <ostream>
+#include <string>
+
+// Scoped spans of the hot paths of the server and the clients. Every thread records its spans into a ring buffer of
+// its own without locking, so only the most recent spans of each thread are kept. They can be exported in the trace
+// event format of Chrome, which Perfetto (https://ui.perfetto.dev) opens as well.
+//
+// Spans are only recorded if the project has been configured with `obpf_simulator_enable_tracing`. Otherwise,
+// OBPF_TRACE_SCOPE() expands to nothing and exported traces are empty.
+
+#ifdef OBPF_ENABLE_TRACING
+#define OBPF_TRACE_CONCAT_IMPL(a, b) a##b
+#define OBPF_TRACE_CONCAT(a, b) OBPF_TRACE_CONCAT_IMPL(a, b)
+// The name has to be a string literal (or live as long as the process).
+#define OBPF_TRACE_SCOPE(name) TraceSpan const OBPF_TRACE_CONCAT(obpf_trace_span_, __LINE__){ name }
+#define OBPF_TRACE_THREAD_NAME(name) set_trace_thread_name(name)
+#else
+#define OBPF_TRACE_SCOPE(name) static_cast<void>(0)
+#define OBPF_TRACE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+
+// Number of spans that are kept per thread.
+inline constexpr auto trace_buffer_capacity = usize{ 16384 };
+
+[[nodiscard]] constexpr bool is_tracing_enabled() {
+#ifdef OBPF_ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void record_trace_span(
+    char const* name,
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end
+) noexcept;
+
+// Records the lifetime of the span. Use OBPF_TRACE_SCOPE() instead to be able to compile it out.
+class TraceSpan final {
+private:
+    char const* m_name;
+    std::chrono::steady_clock::time_point m_start;
+
+public:
+    explicit TraceSpan(char const* const name) : m_name{ name }, m_start{ std::chrono::steady_clock::now() } { }
+
+    TraceSpan(TraceSpan const& other) = delete;
+    TraceSpan(TraceSpan&& other) noexcept = delete;
+    TraceSpan& operator=(TraceSpan const& other) = delete;
+    TraceSpan& operator=(TraceSpan&& other) noexcept = delete;
+
+    ~TraceSpan() {
+        record_trace_span(m_name, m_start, std::chrono::steady_clock::now());
+    }
+};
+
+// Names the calling thread in exported traces.
+void set_trace_thread_name(std::string name);
+
+// Exports the spans of all threads, including threads that have already finished (up to a limit). Recording goes on
+// while exporting, but spans that are overwritten during the export are left out.
+void write_chrome_trace(std::ostream& stream);
+[[nodiscard]] std::string chrome_trace();
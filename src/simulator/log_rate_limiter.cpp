@@ -0,0 +1,16 @@
+#include <simulator/log_rate_limiter.hpp>
+
+[[nodiscard]] std::optional<u64> LogRateLimiter::try_acquire() {
+    auto const now = std::chrono::steady_clock::now();
+    auto const lock = std::scoped_lock{ m_mutex };
+    if (now - m_interval_start >= m_interval) {
+        m_interval_start = now;
+        m_num_messages_in_interval = 0;
+    }
+    if (m_num_messages_in_interval >= m_max_messages_per_interval) {
+        ++m_num_suppressed;
+        return std::nullopt;
+    }
+    ++m_num_messages_in_interval;
+    return std::exchange(m_num_suppressed, 0);
+}
@@ -2,18 +2,51 @@
 #include <magic_enum.hpp>
 #include <memory>
 #include <ranges>
+#include <simulator/log_rate_limiter.hpp>
 #include <simulator/multiplayer_tetrion.hpp>
+#include <simulator/trace.hpp>
+
+struct DatagramTransport final {
+    NullableUniquePointer<UdpSocket> socket;
+    UdpEndpoint server_endpoint;
+};
+
+[[nodiscard]] static DatagramTransport create_datagram_transport(
+    std::string const& server,
+    std::uint16_t const port,
+    MultiplayerOptions const& options
+) {
+    if (options.transport != GameplayTransport::Udp) {
+        return {};
+    }
+    if (options.board_snapshot_interval > 0) {
+        spdlog::warn("board snapshots are not supported by the UDP transport, falling back to TCP");
+        return {};
+    }
+    // The server listens for datagrams on the same port number as for the TCP connection.
+    auto socket = std::make_unique<UdpSocket>();
+    socket->simulate_packet_loss(options.simulated_packet_loss, options.packet_loss_seed);
+    return DatagramTransport{ std::move(socket), UdpEndpoint::resolve(server, port) };
+}
 
 NullableUniquePointer<MultiplayerTetrion> MultiplayerTetrion::create(
     std::string const& server,
     std::uint16_t const port,
-    std::string player_name
+    std::string player_name,
+    MultiplayerOptions const& options,
+    std::stop_token const& stop_token
 ) {
     auto socket = c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, server, port);
     auto message = std::unique_ptr<AbstractMessage>{};
 
+    auto [datagram_socket, server_endpoint] = create_datagram_transport(server, port, options);
+    auto const uses_board_snapshots = (options.board_snapshot_interval > 0);
+
     // Identify this client...
     socket.send(Connect{ player_name }.serialize()).wait();
+    if (uses_board_snapshots) {
+        socket.send(SnapshotSubscription{ options.board_snapshot_interval }.serialize()).wait();
+    }
 
     // Wait for the GameStart message coming from the server...
     while (true) {
@@ -21,6 +54,10 @@ NullableUniquePointer<MultiplayerTetrion> MultiplayerTetrion::create(
             message = AbstractMessage::from_socket(socket);
             break;
         } catch (c2k::TimeoutError const&) {
+            if (stop_token.stop_requested()) {
+                spdlog::info("stopped waiting for the game to start");
+                return nullptr;
+            }
             spdlog::info("waiting for the game to start...");
         } catch (c2k::ReadError const& exception) {
             spdlog::error("error while reading from socket: {}", exception.what());
@@ -35,8 +72,37 @@ NullableUniquePointer<MultiplayerTetrion> MultiplayerTetrion::create(
         return nullptr;
     }
     spdlog::info("received game start message");
-    auto const& game_start_message = dynamic_cast<GameStart const&>(*message);
+    return start(
+        std::make_unique<SocketTransport>(std::move(socket)),
+        dynamic_cast<GameStart const&>(*message),
+        std::move(player_name),
+        options,
+        std::move(datagram_socket),
+        server_endpoint
+    );
+}
+
+std::unique_ptr<MultiplayerTetrion> MultiplayerTetrion::start(
+    std::unique_ptr<MessageTransport> transport,
+    GameStart const& game_start_message,
+    std::string player_name,
+    MultiplayerOptions const& options
+) {
+    if (options.transport != GameplayTransport::Tcp) {
+        spdlog::warn("only the TCP transport is supported for this connection, falling back to TCP");
+    }
+    return start(std::move(transport), game_start_message, std::move(player_name), options, nullptr, UdpEndpoint{});
+}
 
+std::unique_ptr<MultiplayerTetrion> MultiplayerTetrion::start(
+    std::unique_ptr<MessageTransport> transport,
+    GameStart const& game_start_message,
+    std::string player_name,
+    MultiplayerOptions const& options,
+    NullableUniquePointer<UdpSocket> datagram_socket,
+    UdpEndpoint const& server_endpoint
+) {
+    auto const uses_board_snapshots = (options.board_snapshot_interval > 0);
     auto const num_observers = static_cast<usize>(game_start_message.num_players() - 1);
     auto observers = std::vector<std::unique_ptr<ObserverTetrion>>{};
     observers.reserve(num_observers);
@@ -83,15 +149,132 @@ NullableUniquePointer<MultiplayerTetrion> MultiplayerTetrion::create(
     );
     // clang-format on
 
-    return std::make_unique<MultiplayerTetrion>(
-        std::move(socket),
+    auto result = std::make_unique<MultiplayerTetrion>(
+        std::move(transport),
         game_start_message.client_id,
         game_start_message.start_frame,
         game_start_message.random_seed,
         std::move(observers),
         std::move(this_player_name),
+        std::move(datagram_socket),
+        server_endpoint,
+        uses_board_snapshots,
         Key{}
     );
+    if (not options.replay_path.empty()) {
+        result->start_recording(options.replay_path, game_start_message);
+    }
+    return result;
+}
+
+NullableUniquePointer<MultiplayerTetrion> MultiplayerTetrion::reconnect(
+    std::string const& server,
+    std::uint16_t const port,
+    u8 const client_id,
+    std::string player_name,
+    MultiplayerOptions const& options,
+    std::stop_token const& stop_token
+) {
+    auto socket = c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, server, port);
+    auto [datagram_socket, server_endpoint] = create_datagram_transport(server, port, options);
+    auto const uses_board_snapshots = (options.board_snapshot_interval > 0);
+
+    socket.send(Reconnect{ client_id, player_name }.serialize()).wait();
+    if (uses_board_snapshots) {
+        socket.send(SnapshotSubscription{ options.board_snapshot_interval }.serialize()).wait();
+    }
+
+    // If the server rejects us, it closes the connection.
+    auto const receive_message = [&socket, &stop_token]() -> std::unique_ptr<AbstractMessage> {
+        while (true) {
+            try {
+                return AbstractMessage::from_socket(socket);
+            } catch (c2k::TimeoutError const&) {
+                if (stop_token.stop_requested()) {
+                    spdlog::info("stopped waiting for the server to accept the reconnection");
+                    return nullptr;
+                }
+                spdlog::info("waiting for the server to accept the reconnection...");
+            } catch (c2k::ReadError const& exception) {
+                spdlog::error("error while reading from socket: {}", exception.what());
+                return nullptr;
+            }
+        }
+    };
+
+    auto const message = receive_message();
+    if (message == nullptr) {
+        return nullptr;
+    }
+    if (message->type() != MessageType::MatchSnapshot) {
+        spdlog::error(
+            "expected match snapshot message, but received message of type {}",
+            magic_enum::enum_name(message->type())
+        );
+        return nullptr;
+    }
+    auto const& match_snapshot = dynamic_cast<MatchSnapshot const&>(*message);
+    spdlog::info("reconnected as client {} at frame {}", match_snapshot.client_id, match_snapshot.frame);
+
+    auto own_state = std::optional<ObpfTetrion>{};
+    auto observers = std::vector<std::unique_ptr<ObserverTetrion>>{};
+    observers.reserve(match_snapshot.num_players);
+    for (auto i = usize{ 0 }; i < match_snapshot.num_players; ++i) {
+        auto const snapshot_message = receive_message();
+        if (snapshot_message == nullptr) {
+            return nullptr;
+        }
+        if (snapshot_message->type() != MessageType::TetrionSnapshot) {
+            spdlog::error(
+                "expected tetrion snapshot message, but received message of type {}",
+                magic_enum::enum_name(snapshot_message->type())
+            );
+            return nullptr;
+        }
+        auto const& tetrion_snapshot = dynamic_cast<TetrionSnapshot const&>(*snapshot_message);
+        auto state = ObpfTetrion::load_snapshot(tetrion_snapshot.snapshot);
+        if (state.next_frame() != match_snapshot.frame) {
+            spdlog::error("snapshot of client {} is not at frame {}", tetrion_snapshot.client_id, match_snapshot.frame);
+            return nullptr;
+        }
+        if (tetrion_snapshot.client_id == match_snapshot.client_id) {
+            own_state = std::move(state);
+            continue;
+        }
+        // Seed and start frame are part of the snapshot.
+        auto observer = std::make_unique<ObserverTetrion>(
+            0,
+            0,
+            tetrion_snapshot.client_id,
+            state.player_name(),
+            ObserverTetrion::Key{}
+        );
+        observer->rollback_and_resimulate(state, {});
+        observer->m_is_connected = tetrion_snapshot.is_connected;
+        observers.push_back(std::move(observer));
+    }
+    if (not own_state.has_value()) {
+        spdlog::error("server did not send a snapshot of our own tetrion");
+        return nullptr;
+    }
+
+    auto result = std::make_unique<MultiplayerTetrion>(
+        std::make_unique<SocketTransport>(std::move(socket)),
+        match_snapshot.client_id,
+        0,
+        0,
+        std::move(observers),
+        own_state->player_name(),
+        std::move(datagram_socket),
+        server_endpoint,
+        uses_board_snapshots,
+        Key{}
+    );
+    result->restore(own_state.value());
+    if (not options.replay_path.empty()) {
+        spdlog::warn("matches cannot be recorded after reconnecting");
+    }
+    return result;
 }
 
 [[nodiscard]] std::optional<GarbageSendEvent> MultiplayerTetrion::simulate_next_frame(KeyState const key_state) {
@@ -100,170 +283,393 @@ NullableUniquePointer<MultiplayerTetrion> MultiplayerTetrion::create(
         send_heartbeat_message();
         m_key_state_buffer = {};
     }
+    m_unconfirmed_key_states.push_back(key_state);
+    // Outgoing garbage is routed when the confirmed state reaches the corresponding frame.
     auto const outgoing_garbage = ObpfTetrion::simulate_next_frame(key_state);
-    if (outgoing_garbage.has_value()) {
-        // clang-format off
-        m_outgoing_garbage_queue.apply(
-            [outgoing_garbage = outgoing_garbage.value()](std::deque<GarbageSendEvent>& queue) {
-                queue.push_back(outgoing_garbage);
-            }
-        );
-        // clang-format on
-    }
 
-    m_message_queue.apply([this](std::deque<std::unique_ptr<AbstractMessage>>& queue) {
-        while (not queue.empty()) {
-            auto const message = std::move(queue.front());
-            queue.pop_front();
-            switch (message->type()) {
-                case MessageType::StateBroadcast:
-                    process_state_broadcast_message(dynamic_cast<StateBroadcast const&>(*message));
-                    break;
-                case MessageType::ClientDisconnected:
-                    on_client_disconnected(dynamic_cast<ClientDisconnected const&>(*message).client_id);
-                    break;
-                default:
-                    spdlog::error("cannot handle message of type {}", magic_enum::enum_name(message->type()));
-                    break;
-            }
-        }
+    for (auto const& message : m_transport->take_received_messages()) {
+        process_message(*message);
+    }
+    auto const datagram_messages = m_message_queue.apply([](std::deque<std::unique_ptr<AbstractMessage>>& queue) {
+        return std::exchange(queue, {});
     });
+    for (auto const& message : datagram_messages) {
+        process_message(*message);
+    }
+    advance_predictions();
     return outgoing_garbage;
 }
 
+void MultiplayerTetrion::process_message(AbstractMessage const& message) {
+    switch (message.type()) {
+        case MessageType::StateBroadcast:
+            process_state_broadcast_message(dynamic_cast<StateBroadcast const&>(message));
+            break;
+        case MessageType::SnapshotBroadcast:
+            process_snapshot_broadcast_message(dynamic_cast<SnapshotBroadcast const&>(message));
+            break;
+        case MessageType::ClientDisconnected:
+            on_client_disconnected(dynamic_cast<ClientDisconnected const&>(message).client_id);
+            break;
+        case MessageType::ClientReconnected:
+            set_is_connected(dynamic_cast<ClientReconnected const&>(message).client_id, true);
+            break;
+        default:
+            spdlog::error("cannot handle message of type {}", magic_enum::enum_name(message.type()));
+            break;
+    }
+}
+
 [[nodiscard]] std::vector<ObserverTetrion*> MultiplayerTetrion::get_observers() const {
     auto result = std::vector<ObserverTetrion*>{};
-    result.reserve(m_observers.size());
-    for (auto const& observer : m_observers) {
+    result.reserve(m_predicted_observers.size());
+    for (auto const& observer : m_predicted_observers) {
         result.push_back(observer.get());
     }
     return result;
 }
 
 void MultiplayerTetrion::on_client_disconnected(u8 const client_id) {
+    set_is_connected(client_id, false);
+    // todo: set the observer to be game over
+}
+
+void MultiplayerTetrion::set_is_connected(u8 const client_id, bool const is_connected) {
     auto const find_iterator = std::ranges::find_if(m_observers, [client_id](auto const& observer) -> bool {
         return observer->id() == client_id;
     });
     if (find_iterator == m_observers.end()) {
-        spdlog::error("client {} disconnected, but no observer found", client_id);
+        spdlog::error("no observer found for client {}", client_id);
         return;
     }
-    (*find_iterator)->m_is_connected = false;
-    // todo: set the observer to be game over
+    (*find_iterator)->m_is_connected = is_connected;
+    auto const index = static_cast<usize>(std::distance(m_observers.begin(), find_iterator));
+    m_predicted_observers.at(index)->m_is_connected = is_connected;
+}
+
+void MultiplayerTetrion::start_recording(std::string const& path, GameStart const& game_start_message) {
+    if (m_uses_board_snapshots) {
+        spdlog::warn("matches cannot be recorded when using board snapshots");
+        return;
+    }
+    auto header = ReplayHeader{ game_start_message.random_seed, game_start_message.start_frame, {} };
+    for (auto const& [client_id, player_name] : game_start_message.client_identities) {
+        header.players.push_back({ client_id, player_name });
+        m_replay_client_ids.push_back(client_id);
+    }
+    try {
+        m_replay_writer = std::make_unique<ReplayWriter>(path, header);
+    } catch (ReplayError const& exception) {
+        spdlog::error("unable to record match: {}", exception.what());
+    }
+}
+
+void MultiplayerTetrion::record_window(StateBroadcast const& message) {
+    OBPF_TRACE_SCOPE("MultiplayerTetrion::record_window");
+    // Clients that are missing in the broadcast are recorded with neutral key states.
+    static constexpr auto neutral_key_states = std::array<KeyState, heartbeat_interval>{};
+    auto states_per_player = std::vector<std::array<KeyState, heartbeat_interval> const*>{};
+    states_per_player.reserve(m_replay_client_ids.size());
+    for (auto const client_id : m_replay_client_ids) {
+        auto const client_states = std::ranges::find_if(message.states_per_client, [client_id](auto const& states) {
+            return states.client_id == client_id;
+        });
+        states_per_player.push_back(
+            client_states == message.states_per_client.cend() ? &neutral_key_states : &client_states->states
+        );
+    }
+
+    auto key_states = std::vector<KeyState>(m_replay_client_ids.size());
+    for (auto frame = usize{ 0 }; frame < heartbeat_interval; ++frame) {
+        for (auto i = usize{ 0 }; i < states_per_player.size(); ++i) {
+            key_states.at(i) = states_per_player.at(i)->at(frame);
+        }
+        m_replay_writer->append_frame(key_states);
+    }
+
+    if (not m_replay_writer->wants_keyframe()) {
+        return;
+    }
+    // The confirmed states are exactly the ones a replay re-simulates.
+    auto tetrions = std::vector<ReplayKeyframeTetrion>{};
+    tetrions.reserve(m_replay_client_ids.size());
+    for (auto const client_id : m_replay_client_ids) {
+        if (client_id == id()) {
+            tetrions.push_back({ &m_confirmed_state, true });
+            continue;
+        }
+        auto const observer = std::ranges::find_if(m_observers, [client_id](auto const& observer) {
+            return observer->id() == client_id;
+        });
+        if (observer == m_observers.cend()) {
+            return;
+        }
+        tetrions.push_back({ observer->get(), (*observer)->is_connected() });
+    }
+    try {
+        m_replay_writer->append_keyframe(tetrions);
+    } catch (ReplayError const& exception) {
+        spdlog::warn("unable to record keyframe: {}", exception.what());
+    }
+}
+
+// Used after reconnecting. Nothing has been simulated locally yet, so there is nothing to reconcile.
+void MultiplayerTetrion::restore(ObpfTetrion const& own_state) {
+    rollback_and_resimulate(own_state, {});
+    m_confirmed_state.rollback_and_resimulate(own_state, {});
+    m_broadcasts_received_until_frame = own_state.next_frame();
 }
 
 void MultiplayerTetrion::send_heartbeat_message() {
+    OBPF_TRACE_SCOPE("MultiplayerTetrion::send_heartbeat_message");
     auto key_states = std::array<KeyState, heartbeat_interval>{};
     std::copy_n(m_key_state_buffer.cbegin(), heartbeat_interval, key_states.begin());
-    auto const message = Heartbeat{ next_frame(), key_states };
-    // don't wait blocking for the send to complete
-    std::ignore = m_socket.send(message.serialize());
+    // The confirmed state has been simulated exactly like the server simulates our tetrion, so the server can use its
+    // hash to detect desyncs.
+    auto const state_hash = StateHash{ m_confirmed_state.next_frame(), m_confirmed_state.state_hash() };
+    auto message = Heartbeat{ next_frame(), key_states, state_hash };
+    if (m_datagram_socket != nullptr) {
+        send_redundant_heartbeat_message(std::move(message));
+        return;
+    }
+    m_transport->send(message.serialize());
+}
+
+void MultiplayerTetrion::send_redundant_heartbeat_message(Heartbeat heartbeat) {
+    // We always send the oldest windows that have not been acknowledged yet. The server can only use
+    // windows without gaps between them, so sending newer windows first would be pointless.
+    auto heartbeats = m_unacknowledged_heartbeats.apply([&heartbeat](std::deque<Heartbeat>& unacknowledged) {
+        unacknowledged.push_back(std::move(heartbeat));
+        return unacknowledged | std::views::take(max_redundant_windows) | std::ranges::to<std::vector>();
+    });
+    auto const message = RedundantHeartbeat{ m_client_id, m_broadcasts_received_until_frame, std::move(heartbeats) };
+    m_datagram_socket->send_to(m_server_endpoint, message.serialize());
 }
 
 void MultiplayerTetrion::process_state_broadcast_message(StateBroadcast const& message) {
-    auto tetrions = std::vector<ObpfTetrion*>{};
-    tetrions.reserve(m_observers.size() + 1);
-    tetrions.push_back(this);
+    OBPF_TRACE_SCOPE("MultiplayerTetrion::process_state_broadcast_message");
+    // The server sends broadcasts via TCP until it receives our first datagram, so the datagram thread has to know
+    // about these as well. It can already be ahead of us, since it advances the counter when queueing a broadcast.
+    auto received_until_frame = m_broadcasts_received_until_frame.load();
+    while (received_until_frame < message.frame + 1
+           and not m_broadcasts_received_until_frame.compare_exchange_weak(received_until_frame, message.frame + 1)) {}
+    auto const own_states = std::ranges::find_if(message.states_per_client, [this](auto const& client_states) {
+        return client_states.client_id == id();
+    });
+    if (own_states == message.states_per_client.cend()) {
+        spdlog::error("broadcast for frame {} does not contain our own key states", message.frame);
+        return;
+    }
+
+    // The confirmed state of this tetrion is simulated exactly like the observers, so that garbage gets routed
+    // the same way as on the server.
+    auto simulated_tetrions = std::vector<ObserverTetrion*>{};
+    simulated_tetrions.reserve(m_observers.size() + 1);
+    simulated_tetrions.push_back(&m_confirmed_state);
     for (auto const& observer : m_observers) {
-        tetrions.push_back(observer.get());
+        simulated_tetrions.push_back(observer.get());
     }
+    auto const tetrions = simulated_tetrions
+                          | std::views::transform([](ObserverTetrion* tetrion) -> ObpfTetrion* { return tetrion; })
+                          | std::ranges::to<std::vector>();
 
+    auto garbage_receivers = std::vector<u8>{};
     for (auto i = usize{ 0 }; i < std::tuple_size_v<decltype(StateBroadcast::ClientStates::states)>; ++i) {
-        if (m_observers.empty()) {
-            break;
-        }
         assert(
             std::ranges::all_of(
-                m_observers,
-                [&](auto const& observer) { return observer->next_frame() == m_observers.front()->next_frame(); }
+                simulated_tetrions,
+                [this](auto const& tetrion) { return tetrion->next_frame() == m_confirmed_state.next_frame(); }
             )
             and "not all observers are synchronized"
         );
-        auto const observers_frame = m_observers.front()->next_frame();
 
-        auto garbage_send_events = std::unordered_map<u8, GarbageSendEvent>{};
+        auto garbage_send_events = std::map<u8, GarbageSendEvent>{};
         for (auto const& client_states : message.states_per_client) {
             auto const& [id, states] = client_states;
-            auto observer_it =
-                std::ranges::find_if(m_observers, [id](auto const& observer) -> bool { return observer->id() == id; });
-            if (observer_it == m_observers.end()) {
+            auto tetrion_it = std::ranges::find_if(simulated_tetrions, [id](auto const& tetrion) -> bool {
+                return tetrion->id() == id;
+            });
+            if (tetrion_it == simulated_tetrions.end()) {
                 continue;
             }
-            if (auto const garbage_send_event = (*observer_it)->process_key_state(states.at(i));
+            if (auto const garbage_send_event = (*tetrion_it)->process_key_state(states.at(i));
                 garbage_send_event.has_value()) {
                 garbage_send_events.emplace(id, garbage_send_event.value());
             }
         }
 
-        // apply garbage coming from ourselves
-        while (true) {
-            auto const garbage = m_outgoing_garbage_queue.apply(
-                [observers_frame](std::deque<GarbageSendEvent>& queue) -> std::optional<GarbageSendEvent> {
-                    if (queue.empty()) {
-                        return std::nullopt;
-                    }
-                    auto const garbage = queue.front();
-                    if (garbage.frame < observers_frame) {
-                        return std::nullopt;
-                    }
-                    queue.pop_front();
-                    return garbage;
-                }
-            );
-            if (not garbage.has_value()) {
-                break;
-            }
-            auto target_tetrion = determine_garbage_target(tetrions, id(), garbage.value().frame);
-            if (not target_tetrion.has_value()) {
-                continue;
-            }
-            target_tetrion.value().receive_garbage(garbage.value());
+        for (auto const& delivery : deliver_garbage(tetrions, garbage_send_events)) {
+            garbage_receivers.push_back(delivery.receiver->id());
         }
+    }
 
-        // apply garbage between observers
-        for (auto const [sender_client_id, garbage_send_event] : garbage_send_events) {
-            auto target_tetrion = determine_garbage_target(tetrions, sender_client_id, garbage_send_event.frame);
-            if (not target_tetrion.has_value()) {
-                continue;
-            }
-            if (target_tetrion.value().id() == id()) {
-                receive_garbage(garbage_send_event);
-                continue;
+    update_predictions(message, garbage_receivers);
+    reconcile(own_states->states, std::ranges::find(garbage_receivers, id()) != garbage_receivers.cend());
+    if (m_replay_writer != nullptr) {
+        record_window(message);
+    }
+}
+
+void MultiplayerTetrion::process_snapshot_broadcast_message(SnapshotBroadcast const& message) {
+    OBPF_TRACE_SCOPE("MultiplayerTetrion::process_snapshot_broadcast_message");
+    // The server already routed the garbage, so we only have to deliver it at the same frame as the server did.
+    for (auto const key_state : message.key_states) {
+        std::ignore = m_confirmed_state.process_key_state(key_state);
+        for (auto const& garbage : message.received_garbage) {
+            if (garbage.frame == m_confirmed_state.next_frame()) {
+                m_confirmed_state.receive_garbage(garbage);
             }
-            target_tetrion.value().receive_garbage(garbage_send_event);
         }
     }
+
+    for (auto const& [client_id, is_game_over, matrix] : message.boards) {
+        auto const find_iterator = std::ranges::find_if(m_predicted_observers, [client_id](auto const& observer) {
+            return observer->id() == client_id;
+        });
+        if (find_iterator == m_predicted_observers.end()) {
+            continue;
+        }
+        (*find_iterator)->apply_board_snapshot(message.frame + 1, matrix, is_game_over);
+    }
+
+    reconcile(message.key_states, not message.received_garbage.empty());
 }
 
-void MultiplayerTetrion::keep_receiving(
-    std::stop_token const& stop_token,
-    c2k::ClientSocket& socket,
-    c2k::Synchronized<std::deque<std::unique_ptr<AbstractMessage>>>& queue
+void MultiplayerTetrion::reconcile(
+    std::array<KeyState, heartbeat_interval> const& confirmed_key_states,
+    bool const received_garbage
 ) {
+    OBPF_TRACE_SCOPE("MultiplayerTetrion::reconcile");
+    auto const were_predictions_correct =
+        m_unconfirmed_key_states.size() >= heartbeat_interval
+        and std::ranges::equal(confirmed_key_states, m_unconfirmed_key_states | std::views::take(heartbeat_interval));
+
+    if (m_unconfirmed_key_states.size() >= heartbeat_interval) {
+        m_unconfirmed_key_states.erase(
+            m_unconfirmed_key_states.begin(),
+            m_unconfirmed_key_states.begin() + static_cast<std::ptrdiff_t>(heartbeat_interval)
+        );
+    } else {
+        // The server has already simulated frames that we didn't even simulate locally. We skip those frames
+        // and start over with the next window.
+        m_unconfirmed_key_states.clear();
+        m_key_state_buffer = {};
+    }
+
+    // Garbage has to be received at the right frame to be able to counter it by clearing lines. Therefore, we also
+    // re-simulate after receiving garbage.
+    if (were_predictions_correct and not received_garbage) {
+        return;
+    }
+    if (not were_predictions_correct) {
+        static auto log_limiter = LogRateLimiter{};
+        log_rate_limited(
+            log_limiter,
+            spdlog::level::warn,
+            "server did not use our key states, rolling back to frame {}",
+            m_confirmed_state.next_frame()
+        );
+    }
+    rollback_and_resimulate(m_confirmed_state, m_unconfirmed_key_states);
+}
+
+void MultiplayerTetrion::update_predictions(StateBroadcast const& message, std::vector<u8> const& garbage_receivers) {
+    OBPF_TRACE_SCOPE("MultiplayerTetrion::update_predictions");
+    for (auto i = usize{ 0 }; i < m_observers.size(); ++i) {
+        auto const& confirmed = *m_observers.at(i);
+        auto& predicted = *m_predicted_observers.at(i);
+        auto const client_states = std::ranges::find_if(message.states_per_client, [&](auto const& states) {
+            return states.client_id == confirmed.id();
+        });
+        if (client_states == message.states_per_client.cend()) {
+            continue;
+        }
+
+        // If the opponent kept pressing the predicted keys and did not receive garbage, the prediction is still valid
+        // and we can avoid re-simulating. If the predicted observer has not been queried for a while and is still
+        // behind the confirmed one, starting over from the confirmed state is cheaper than catching up.
+        auto const were_predictions_correct =
+            predicted.next_frame() >= confirmed.next_frame()
+            and std::ranges::find(garbage_receivers, confirmed.id()) == garbage_receivers.cend()
+            and std::ranges::all_of(client_states->states, [&](KeyState const key_state) {
+                    return key_state == predicted.m_predicted_key_state;
+                });
+        if (were_predictions_correct) {
+            continue;
+        }
+        // Going through a rollback instead of copying keeps the dirty rows of the displayed matrix, so that the rows
+        // changed by the discarded prediction are redrawn.
+        predicted.rollback_and_resimulate(confirmed, {});
+        predicted.m_predicted_key_state = client_states->states.back();
+    }
+}
+
+void MultiplayerTetrion::advance_predictions() {
+    if (m_uses_board_snapshots) {
+        return;
+    }
+    // The actual simulation happens lazily when the observers are queried.
+    for (auto const& predicted : m_predicted_observers) {
+        predicted->m_predicted_until_frame = next_frame();
+    }
+}
+
+void MultiplayerTetrion::keep_receiving_datagrams(std::stop_token const& stop_token, MultiplayerTetrion& self) {
+    using namespace std::chrono_literals;
+    OBPF_TRACE_THREAD_NAME("datagrams");
     while (not stop_token.stop_requested()) {
+        auto datagram = self.m_datagram_socket->receive(100ms);
+        if (not datagram.has_value()) {
+            continue;
+        }
+        if (datagram->sender != self.m_server_endpoint) {
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(log_limiter, spdlog::level::warn, "ignoring datagram from unknown sender");
+            continue;
+        }
+
+        auto message = std::unique_ptr<AbstractMessage>{};
         try {
-            auto message = AbstractMessage::from_socket(socket);
-            switch (message->type()) {
-                case MessageType::StateBroadcast:
-                case MessageType::ClientDisconnected:
-                    spdlog::info("queueing message of type {}", magic_enum::enum_name(message->type()));
-                    // clang-format off
-                    queue.apply(
-                        [message = std::move(message)](std::deque<std::unique_ptr<AbstractMessage>>& queue) mutable {
-                            queue.push_back(std::move(message));
-                        }
-                    );
-                    // clang-format on
-                    break;
-                default:
-                    spdlog::warn("received message of unexpected type: {}", magic_enum::enum_name(message->type()));
-                    break;
+            message = AbstractMessage::from_datagram(datagram->buffer);
+        } catch (MessageDeserializationError const& exception) {
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(log_limiter, spdlog::level::warn, "received invalid datagram: {}", exception.what());
+            continue;
+        }
+        if (message->type() != MessageType::RedundantStateBroadcast) {
+            static auto log_limiter = LogRateLimiter{};
+            log_rate_limited(
+                log_limiter,
+                spdlog::level::warn,
+                "received datagram of unexpected type: {}",
+                magic_enum::enum_name(message->type())
+            );
+            continue;
+        }
+        auto& redundant_broadcast = dynamic_cast<RedundantStateBroadcast&>(*message);
+
+        self.m_unacknowledged_heartbeats.apply([&redundant_broadcast](std::deque<Heartbeat>& unacknowledged) {
+            while (not unacknowledged.empty()
+                   and unacknowledged.front().frame < redundant_broadcast.acknowledged_until_frame) {
+                unacknowledged.pop_front();
             }
-        } catch (c2k::TimeoutError const&) {
-            // swallow exception because this is expected
-        } catch (c2k::ReadError const& exception) {
-            spdlog::error("error while reading from socket: {}", exception.what());
-            break;
+        });
+
+        // Broadcasts can arrive multiple times and out of order. Only the next expected one gets queued, so that
+        // the processing of the message queue is identical to the TCP transport.
+        for (auto& broadcast : redundant_broadcast.broadcasts) {
+            auto const window_start = broadcast.frame + 1 - heartbeat_interval;
+            if (window_start != self.m_broadcasts_received_until_frame) {
+                continue;
+            }
+            self.m_broadcasts_received_until_frame = broadcast.frame + 1;
+            // clang-format off
+            self.m_message_queue.apply(
+                [&broadcast](std::deque<std::unique_ptr<AbstractMessage>>& queue) {
+                    queue.push_back(std::make_unique<StateBroadcast>(std::move(broadcast)));
+                }
+            );
+            // clang-format on
         }
     }
 }
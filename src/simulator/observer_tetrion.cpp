@@ -3,3 +3,10 @@
 [[nodiscard]] std::optional<GarbageSendEvent> ObserverTetrion::process_key_state(KeyState const key_state) {
     return ObpfTetrion::simulate_next_frame(key_state);
 }
+
+void ObserverTetrion::catch_up() {
+    while (next_frame() < m_predicted_until_frame) {
+        // Garbage is only routed between confirmed states.
+        std::ignore = process_key_state(m_predicted_key_state);
+    }
+}
@@ -0,0 +1,640 @@
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <format>
+#include <gsl/gsl>
+#include <limits>
+#include <simulator/replay.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A replay file starts with this header:
+// - magic "OBPFRPLY", followed by the version byte
+// - seed and start frame (8 bytes each, little endian)
+// - number of players, followed by the client id, the name length and the name of each player
+//
+// The rest of the file is a sequence of records, each consisting of a type byte, the payload size (LEB128) and the
+// payload. Unknown record types are skipped. A key states record contains a block of consecutive frames:
+// - first frame, number of frames and number of events (LEB128)
+// - the events, each consisting of the frame offset within the block (LEB128), the player index and the event type
+// - the number of bytes used by the runs of each player (LEB128)
+// - the runs of each player, each encoded as LEB128 value (run length - 1) << 3 | code: codes 0 to 6 mean that
+//   the key with this index toggled compared to the previous run (or to the neutral key state for the first run of
+//   a block), while 7 means that the key state follows as a separate byte
+//
+// A keyframe record contains the frame (LEB128), followed by the connection state (one byte), the snapshot size
+// (LEB128) and the snapshot of each player's tetrion. It is always followed by the block starting at that frame.
+// When the writer finishes properly, it appends an index record (number of keyframes, followed by frame and record
+// position of each keyframe, all LEB128) and a fixed-size record containing the position of the index record (8
+// bytes, little endian). Without these, readers have to scan the whole file for keyframes.
+static constexpr auto magic = std::string_view{ "OBPFRPLY" };
+static constexpr auto replay_version = u8{ 1 };
+static constexpr auto literal_key_state_code = u8{ 7 };
+
+enum class RecordType : u8 {
+    KeyStates = 1,
+    Keyframe = 2,
+    KeyframeIndex = 3,
+    IndexPosition = 4,
+};
+
+// Type byte, payload size and payload.
+static constexpr auto index_position_record_size = usize{ 10 };
+
+static void append_varint(std::vector<u8>& bytes, u64 value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<u8>(value));
+}
+
+static void append_fixed(std::vector<u8>& bytes, u64 const value) {
+    for (auto i = 0; i < 8; ++i) {
+        bytes.push_back(static_cast<u8>(value >> (8 * i)));
+    }
+}
+
+[[nodiscard]] static u8 read_byte(std::span<u8 const> const data, usize& position, usize const end) {
+    if (position >= end) {
+        throw ReplayError{ "unexpected end of replay data" };
+    }
+    return data[position++];
+}
+
+[[nodiscard]] static u64 read_varint(std::span<u8 const> const data, usize& position, usize const end) {
+    auto result = u64{ 0 };
+    for (auto shift = 0; shift < 64; shift += 7) {
+        auto const byte = read_byte(data, position, end);
+        result |= static_cast<u64>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return result;
+        }
+    }
+    throw ReplayError{ "integer value in replay is too big" };
+}
+
+[[nodiscard]] static u64 read_fixed(std::span<u8 const> const data, usize& position, usize const end) {
+    auto result = u64{ 0 };
+    for (auto i = 0; i < 8; ++i) {
+        result |= static_cast<u64>(read_byte(data, position, end)) << (8 * i);
+    }
+    return result;
+}
+
+struct RecordHeader final {
+    u8 type;
+    usize payload_position;
+    usize end;
+};
+
+// Returns std::nullopt if the record is incomplete (i.e. the writer did not finish it).
+[[nodiscard]] static std::optional<RecordHeader> read_record_header(std::span<u8 const> const data, usize position) {
+    auto type = u8{};
+    auto payload_size = u64{};
+    try {
+        type = read_byte(data, position, data.size());
+        payload_size = read_varint(data, position, data.size());
+    } catch (ReplayError const&) {
+        return std::nullopt;
+    }
+    if (payload_size > data.size() - position) {
+        return std::nullopt;
+    }
+    return RecordHeader{ type, position, position + gsl::narrow<usize>(payload_size) };
+}
+
+[[nodiscard]] static std::vector<u8> create_record(RecordType const type, std::vector<u8> const& payload) {
+    auto record = std::vector<u8>{};
+    record.reserve(payload.size() + 11);
+    record.push_back(std::to_underlying(type));
+    append_varint(record, payload.size());
+    record.insert(record.end(), payload.cbegin(), payload.cend());
+    return record;
+}
+
+[[nodiscard]] static KeyState to_key_state(u8 const bitmask) {
+    auto const result = KeyState::from_bitmask(bitmask);
+    if (not result.has_value()) {
+        throw ReplayError{ std::format("invalid key state bitmask {} in replay", bitmask) };
+    }
+    return result.value();
+}
+
+ReplayWriter::ReplayWriter(std::filesystem::path const& path, ReplayHeader const& header)
+    : m_num_players{ header.players.size() },
+      m_encoders(header.players.size()),
+      m_file{ path, std::ios::binary | std::ios::trunc } {
+    if (not m_file) {
+        throw ReplayError{ std::format("unable to create replay file '{}'", path.string()) };
+    }
+    if (header.players.size() > std::numeric_limits<u8>::max()) {
+        throw ReplayError{ std::format("too many players for a replay ({})", header.players.size()) };
+    }
+
+    auto bytes = std::vector<u8>{ magic.cbegin(), magic.cend() };
+    bytes.push_back(replay_version);
+    append_fixed(bytes, header.seed);
+    append_fixed(bytes, header.start_frame);
+    bytes.push_back(static_cast<u8>(header.players.size()));
+    for (auto const& [client_id, name] : header.players) {
+        auto const length = std::min(name.length(), usize{ std::numeric_limits<u8>::max() });
+        bytes.push_back(client_id);
+        bytes.push_back(static_cast<u8>(length));
+        bytes.insert(bytes.end(), name.cbegin(), name.cbegin() + static_cast<std::ptrdiff_t>(length));
+    }
+    // The header is written synchronously since the writing thread has not been started yet.
+    m_file.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    m_file.flush();
+    if (not m_file) {
+        throw ReplayError{ std::format("unable to write to replay file '{}'", path.string()) };
+    }
+    m_num_bytes_written = bytes.size();
+
+    m_writing_thread = std::jthread{ [this](std::stop_token const& stop_token) { keep_writing(stop_token); } };
+}
+
+ReplayWriter::~ReplayWriter() {
+    flush();
+
+    auto index = std::vector<u8>{};
+    append_varint(index, m_keyframe_positions.size());
+    for (auto const& [frame, position] : m_keyframe_positions) {
+        append_varint(index, frame);
+        append_varint(index, position);
+    }
+    auto index_position = std::vector<u8>{};
+    append_fixed(index_position, m_num_bytes_written);
+    enqueue_record(create_record(RecordType::KeyframeIndex, index));
+    enqueue_record(create_record(RecordType::IndexPosition, index_position));
+    // The writing thread writes all pending records before it stops.
+}
+
+static void encode_run(std::vector<u8>& bytes, KeyState const previous, KeyState const current, u64 const length) {
+    // Most of the time, only a single key is pressed or released.
+    auto const toggled = static_cast<u8>(previous.get_bitmask() ^ current.get_bitmask());
+    auto const code =
+        (std::popcount(toggled) == 1 ? static_cast<u8>(std::countr_zero(toggled)) : literal_key_state_code);
+    append_varint(bytes, (length - 1) << 3 | code);
+    if (code == literal_key_state_code) {
+        bytes.push_back(current.get_bitmask());
+    }
+}
+
+void ReplayWriter::append_frame(std::span<KeyState const> const key_states) {
+    if (key_states.size() != m_num_players) {
+        throw ReplayError{ std::format("expected {} key states, got {}", m_num_players, key_states.size()) };
+    }
+    for (auto i = usize{ 0 }; i < m_num_players; ++i) {
+        auto& encoder = m_encoders.at(i);
+        if (encoder.length > 0 and encoder.current == key_states[i]) {
+            ++encoder.length;
+            continue;
+        }
+        if (encoder.length > 0) {
+            encode_run(encoder.bytes, encoder.previous, encoder.current, encoder.length);
+            encoder.previous = encoder.current;
+        }
+        encoder.current = key_states[i];
+        encoder.length = 1;
+    }
+    ++m_next_frame;
+    // Blocks are aligned to multiples of their size (even after flushing manually), so that keyframes can be placed
+    // at regular intervals.
+    if (m_next_frame % frames_per_block == 0) {
+        flush();
+    }
+}
+
+void ReplayWriter::append_event(u8 const player_index, ReplayEventType const type) {
+    assert(player_index < m_num_players);
+    m_block_events.push_back(ReplayEvent{ m_next_frame, player_index, type });
+}
+
+void ReplayWriter::append_keyframe(std::span<ReplayKeyframeTetrion const> const tetrions) {
+    if (tetrions.size() != m_num_players) {
+        throw ReplayError{ std::format("expected {} tetrions, got {}", m_num_players, tetrions.size()) };
+    }
+    // The playback of the following frames has to start with a new block.
+    flush();
+
+    auto payload = std::vector<u8>{};
+    append_varint(payload, m_next_frame);
+    auto snapshot = std::vector<u8>{};
+    for (auto const& [tetrion, is_connected] : tetrions) {
+        if (tetrion->next_frame() != m_next_frame) {
+            throw ReplayError{
+                std::format("expected tetrion at frame {}, got {}", m_next_frame, tetrion->next_frame()),
+            };
+        }
+        tetrion->save_snapshot(snapshot);
+        payload.push_back(is_connected ? 1 : 0);
+        append_varint(payload, snapshot.size());
+        payload.insert(payload.end(), snapshot.cbegin(), snapshot.cend());
+    }
+    m_keyframe_positions.push_back(KeyframePosition{ m_next_frame, m_num_bytes_written });
+    enqueue_record(create_record(RecordType::Keyframe, payload));
+}
+
+void ReplayWriter::flush() {
+    if (m_next_frame == m_block_first_frame) {
+        return;
+    }
+
+    auto payload = std::vector<u8>{};
+    append_varint(payload, m_block_first_frame);
+    append_varint(payload, m_next_frame - m_block_first_frame);
+    append_varint(payload, m_block_events.size());
+    for (auto const& event : m_block_events) {
+        append_varint(payload, event.frame - m_block_first_frame);
+        payload.push_back(event.player_index);
+        payload.push_back(std::to_underlying(event.type));
+    }
+    for (auto& encoder : m_encoders) {
+        encode_run(encoder.bytes, encoder.previous, encoder.current, encoder.length);
+        append_varint(payload, encoder.bytes.size());
+    }
+    for (auto& encoder : m_encoders) {
+        payload.insert(payload.end(), encoder.bytes.cbegin(), encoder.bytes.cend());
+        // The next block has to be decodable on its own.
+        encoder.bytes.clear();
+        encoder.previous = KeyState{};
+        encoder.length = 0;
+    }
+
+    enqueue_record(create_record(RecordType::KeyStates, payload));
+
+    m_block_events.clear();
+    m_block_first_frame = m_next_frame;
+}
+
+void ReplayWriter::enqueue_record(std::vector<u8> record) {
+    m_num_bytes_written += record.size();
+    {
+        auto const lock = std::scoped_lock{ m_pending_records_mutex };
+        m_pending_records.push_back(std::move(record));
+    }
+    m_pending_records_condition.notify_one();
+}
+
+void ReplayWriter::keep_writing(std::stop_token const& stop_token) {
+    while (true) {
+        auto lock = std::unique_lock{ m_pending_records_mutex };
+        // Returns false only if stopping was requested and there's nothing left to write.
+        if (not m_pending_records_condition.wait(lock, stop_token, [this] { return not m_pending_records.empty(); })) {
+            return;
+        }
+        auto const record = std::move(m_pending_records.front());
+        m_pending_records.pop_front();
+        lock.unlock();
+
+        m_file.write(reinterpret_cast<char const*>(record.data()), static_cast<std::streamsize>(record.size()));
+        m_file.flush();
+        if (not m_file) {
+            spdlog::error("failed to write to replay file");
+            return;
+        }
+    }
+}
+
+class MappedFile final {
+private:
+    std::span<u8 const> m_data;
+
+public:
+    explicit MappedFile(std::filesystem::path const& path) {
+#ifdef _WIN32
+        auto const file = CreateFileW(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE) {
+            throw ReplayError{ std::format("unable to open replay file '{}'", path.string()) };
+        }
+        auto size = LARGE_INTEGER{};
+        if (not GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw ReplayError{ std::format("unable to determine size of replay file '{}'", path.string()) };
+        }
+        if (size.QuadPart == 0) {
+            CloseHandle(file);
+            return;
+        }
+        auto const mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr) {
+            throw ReplayError{ std::format("unable to map replay file '{}'", path.string()) };
+        }
+        auto const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr) {
+            throw ReplayError{ std::format("unable to map replay file '{}'", path.string()) };
+        }
+        m_data = std::span{ static_cast<u8 const*>(view), static_cast<usize>(size.QuadPart) };
+#else
+        auto const file = open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw ReplayError{ std::format("unable to open replay file '{}'", path.string()) };
+        }
+        struct stat status {};
+        if (fstat(file, &status) != 0) {
+            close(file);
+            throw ReplayError{ std::format("unable to determine size of replay file '{}'", path.string()) };
+        }
+        auto const size = static_cast<usize>(status.st_size);
+        if (size == 0) {
+            close(file);
+            return;
+        }
+        auto const address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping stays valid after closing the file descriptor.
+        close(file);
+        if (address == MAP_FAILED) {
+            throw ReplayError{ std::format("unable to map replay file '{}'", path.string()) };
+        }
+        m_data = std::span{ static_cast<u8 const*>(address), size };
+#endif
+    }
+
+    MappedFile(MappedFile const& other) = delete;
+    MappedFile(MappedFile&& other) noexcept = delete;
+    MappedFile& operator=(MappedFile const& other) = delete;
+    MappedFile& operator=(MappedFile&& other) noexcept = delete;
+
+    ~MappedFile() {
+        if (m_data.empty()) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(m_data.data());
+#else
+        munmap(const_cast<u8*>(m_data.data()), m_data.size());
+#endif
+    }
+
+    [[nodiscard]] std::span<u8 const> data() const {
+        return m_data;
+    }
+};
+
+ReplayReader::ReplayReader(std::filesystem::path const& path)
+    : m_file{ std::make_unique<MappedFile>(path) } {
+    auto const data = m_file->data();
+    auto position = usize{ 0 };
+    if (data.size() < magic.length() or not std::ranges::equal(data.first(magic.length()), magic)) {
+        throw ReplayError{ std::format("'{}' is not a replay file", path.string()) };
+    }
+    position += magic.length();
+    if (auto const version = read_byte(data, position, data.size()); version != replay_version) {
+        throw ReplayError{ std::format("unsupported replay version {}", version) };
+    }
+    m_header.seed = read_fixed(data, position, data.size());
+    m_header.start_frame = read_fixed(data, position, data.size());
+    auto const num_players = read_byte(data, position, data.size());
+    m_header.players.reserve(num_players);
+    for (auto i = 0; i < num_players; ++i) {
+        auto const client_id = read_byte(data, position, data.size());
+        auto const name_length = read_byte(data, position, data.size());
+        if (position + name_length > data.size()) {
+            throw ReplayError{ "unexpected end of replay data" };
+        }
+        auto const name = data.subspan(position, name_length);
+        m_header.players.push_back(ReplayPlayer{ client_id, std::string{ name.begin(), name.end() } });
+        position += name_length;
+    }
+    m_first_record_position = position;
+    read_keyframe_index();
+}
+
+ReplayReader::ReplayReader(ReplayReader&& other) noexcept = default;
+ReplayReader& ReplayReader::operator=(ReplayReader&& other) noexcept = default;
+ReplayReader::~ReplayReader() = default;
+
+[[nodiscard]] std::span<u8 const> ReplayReader::data() const {
+    return m_file->data();
+}
+
+[[nodiscard]] std::optional<ReplayReader::KeyframePosition> ReplayReader::find_keyframe(u64 const frame) const {
+    auto const next = std::ranges::upper_bound(m_keyframe_positions, frame, {}, &KeyframePosition::frame);
+    if (next == m_keyframe_positions.cbegin()) {
+        return std::nullopt;
+    }
+    return *std::prev(next);
+}
+
+[[nodiscard]] ReplayKeyframe ReplayReader::load_keyframe(KeyframePosition const& keyframe) const {
+    auto const data = this->data();
+    auto const record = read_record_header(data, keyframe.position);
+    if (not record.has_value() or record->type != std::to_underlying(RecordType::Keyframe)) {
+        throw ReplayError{ std::format("there is no keyframe at position {} of the replay", keyframe.position) };
+    }
+    auto position = record->payload_position;
+    auto const end = record->end;
+    auto result = ReplayKeyframe{ read_varint(data, position, end), {}, {} };
+    if (result.frame != keyframe.frame) {
+        throw ReplayError{ std::format("expected keyframe for frame {}, got {}", keyframe.frame, result.frame) };
+    }
+    result.tetrions.reserve(m_header.players.size());
+    for (auto i = usize{ 0 }; i < m_header.players.size(); ++i) {
+        result.is_connected.push_back(read_byte(data, position, end) != 0);
+        auto const snapshot_size = read_varint(data, position, end);
+        if (snapshot_size > end - position) {
+            throw ReplayError{ "invalid snapshot size in replay" };
+        }
+        try {
+            result.tetrions.push_back(ObpfTetrion::load_snapshot(data.subspan(position, snapshot_size)));
+        } catch (SnapshotError const& exception) {
+            throw ReplayError{ std::format("invalid snapshot in replay: {}", exception.what()) };
+        }
+        if (result.tetrions.back().next_frame() != result.frame) {
+            throw ReplayError{ std::format("snapshot in keyframe for frame {} has the wrong frame", result.frame) };
+        }
+        position += gsl::narrow<usize>(snapshot_size);
+    }
+    return result;
+}
+
+[[nodiscard]] ReplayPlayback ReplayReader::playback() const {
+    return ReplayPlayback{ data(), m_header.players.size(), m_first_record_position };
+}
+
+[[nodiscard]] ReplayPlayback ReplayReader::playback(KeyframePosition const& keyframe) const {
+    return ReplayPlayback{ data(), m_header.players.size(), keyframe.position, keyframe.frame };
+}
+
+void ReplayReader::read_keyframe_index() {
+    auto const data = this->data();
+    if (data.size() < m_first_record_position + index_position_record_size) {
+        scan_for_keyframes();
+        return;
+    }
+    try {
+        auto const index_position_record = read_record_header(data, data.size() - index_position_record_size);
+        if (not index_position_record.has_value()
+            or index_position_record->type != std::to_underlying(RecordType::IndexPosition)
+            or index_position_record->end != data.size()) {
+            throw ReplayError{ "replay does not end with the position of the keyframe index" };
+        }
+        auto position = index_position_record->payload_position;
+        auto const index_position = read_fixed(data, position, data.size());
+        if (index_position < m_first_record_position or index_position >= data.size()) {
+            throw ReplayError{ "invalid position of keyframe index" };
+        }
+        auto const index_record = read_record_header(data, gsl::narrow<usize>(index_position));
+        if (not index_record.has_value() or index_record->type != std::to_underlying(RecordType::KeyframeIndex)) {
+            throw ReplayError{ "invalid keyframe index" };
+        }
+        position = index_record->payload_position;
+        auto const num_keyframes = read_varint(data, position, index_record->end);
+        for (auto i = u64{ 0 }; i < num_keyframes; ++i) {
+            auto const frame = read_varint(data, position, index_record->end);
+            auto const keyframe_position = read_varint(data, position, index_record->end);
+            if (keyframe_position >= index_position
+                or (not m_keyframe_positions.empty() and frame <= m_keyframe_positions.back().frame)) {
+                throw ReplayError{ "invalid keyframe index" };
+            }
+            m_keyframe_positions.push_back(KeyframePosition{ frame, gsl::narrow<usize>(keyframe_position) });
+        }
+    } catch (ReplayError const& exception) {
+        spdlog::warn("unable to read keyframe index ({}), scanning replay for keyframes", exception.what());
+        m_keyframe_positions.clear();
+        scan_for_keyframes();
+    }
+}
+
+void ReplayReader::scan_for_keyframes() {
+    auto const data = this->data();
+    auto position = m_first_record_position;
+    while (position < data.size()) {
+        auto const record = read_record_header(data, position);
+        if (not record.has_value()) {
+            return;
+        }
+        if (record->type == std::to_underlying(RecordType::Keyframe)) {
+            auto payload_position = record->payload_position;
+            auto const frame = read_varint(data, payload_position, record->end);
+            m_keyframe_positions.push_back(KeyframePosition{ frame, position });
+        }
+        position = record->end;
+    }
+}
+
+ReplayPlayback::ReplayPlayback(
+    std::span<u8 const> const data,
+    usize const num_players,
+    usize const first_record_position,
+    u64 const first_frame
+)
+    : m_data{ data },
+      m_num_players{ num_players },
+      m_next_record_position{ first_record_position },
+      m_next_frame{ first_frame },
+      m_block_end_frame{ first_frame },
+      m_run_positions(num_players),
+      m_run_end_positions(num_players),
+      m_remaining_run_lengths(num_players),
+      m_key_states(num_players) {}
+
+[[nodiscard]] bool ReplayPlayback::advance() {
+    if (m_next_frame == m_block_end_frame and not enter_next_block()) {
+        return false;
+    }
+
+    m_frame_events.clear();
+    while (m_next_event_index < m_block_events.size() and m_block_events.at(m_next_event_index).frame == m_next_frame) {
+        m_frame_events.push_back(m_block_events.at(m_next_event_index));
+        ++m_next_event_index;
+    }
+
+    for (auto i = usize{ 0 }; i < m_num_players; ++i) {
+        if (m_remaining_run_lengths.at(i) == 0) {
+            decode_run(i);
+        }
+        --m_remaining_run_lengths.at(i);
+    }
+    ++m_next_frame;
+    return true;
+}
+
+[[nodiscard]] bool ReplayPlayback::enter_next_block() {
+    while (m_next_record_position < m_data.size()) {
+        auto const record = read_record_header(m_data, m_next_record_position);
+        if (not record.has_value()) {
+            spdlog::warn("replay ends with an incomplete record");
+            return false;
+        }
+        auto position = record->payload_position;
+        auto const end = record->end;
+        m_next_record_position = end;
+        if (record->type != std::to_underlying(RecordType::KeyStates)) {
+            continue;
+        }
+
+        auto const first_frame = read_varint(m_data, position, end);
+        if (first_frame != m_next_frame) {
+            throw ReplayError{ std::format("expected block starting at frame {}, got {}", m_next_frame, first_frame) };
+        }
+        auto const num_frames = read_varint(m_data, position, end);
+        auto const num_events = read_varint(m_data, position, end);
+        m_block_events.clear();
+        m_next_event_index = 0;
+        for (auto i = u64{ 0 }; i < num_events; ++i) {
+            auto const offset = read_varint(m_data, position, end);
+            auto const player_index = read_byte(m_data, position, end);
+            auto const event_type = read_byte(m_data, position, end);
+            if (offset >= num_frames or player_index >= m_num_players or event_type > 1) {
+                throw ReplayError{ "invalid event in replay" };
+            }
+            m_block_events.push_back({ first_frame + offset, player_index, static_cast<ReplayEventType>(event_type) });
+        }
+
+        auto run_sizes = std::vector<u64>{};
+        run_sizes.reserve(m_num_players);
+        for (auto i = usize{ 0 }; i < m_num_players; ++i) {
+            run_sizes.push_back(read_varint(m_data, position, end));
+        }
+        for (auto i = usize{ 0 }; i < m_num_players; ++i) {
+            if (run_sizes.at(i) > end - position) {
+                throw ReplayError{ "invalid size of key state runs in replay" };
+            }
+            m_run_positions.at(i) = position;
+            position += gsl::narrow<usize>(run_sizes.at(i));
+            m_run_end_positions.at(i) = position;
+            m_remaining_run_lengths.at(i) = 0;
+            m_key_states.at(i) = KeyState{};
+        }
+        if (num_frames == 0) {
+            continue;
+        }
+        m_block_end_frame = first_frame + num_frames;
+        return true;
+    }
+    return false;
+}
+
+void ReplayPlayback::decode_run(usize const player_index) {
+    auto& position = m_run_positions.at(player_index);
+    auto const end = m_run_end_positions.at(player_index);
+    auto const value = read_varint(m_data, position, end);
+    auto const code = static_cast<u8>(value & 0b111);
+    auto& key_state = m_key_states.at(player_index);
+    if (code == literal_key_state_code) {
+        key_state = to_key_state(read_byte(m_data, position, end));
+    } else {
+        key_state = to_key_state(static_cast<u8>(key_state.get_bitmask() ^ (1 << code)));
+    }
+    m_remaining_run_lengths.at(player_index) = (value >> 3) + 1;
+}
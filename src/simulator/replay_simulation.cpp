@@ -0,0 +1,81 @@
+#include <simulator/garbage.hpp>
+#include <simulator/replay_simulation.hpp>
+#include <map>
+
+[[nodiscard]] static std::vector<PlayerTetrion> create_tetrions(ReplayHeader const& header) {
+    auto result = std::vector<PlayerTetrion>{};
+    result.reserve(header.players.size());
+    for (auto const& [client_id, name] : header.players) {
+        result.emplace_back(header.seed, header.start_frame, client_id, name);
+    }
+    return result;
+}
+
+ReplaySimulation::ReplaySimulation(ReplayReader const& reader)
+    : m_playback{ reader.playback() },
+      m_tetrions{ create_tetrions(reader.header()) },
+      m_is_connected(reader.header().players.size(), true),
+      m_sent_garbage(reader.header().players.size()) {}
+
+ReplaySimulation::ReplaySimulation(ReplayReader const& reader, u64 const frame)
+    : ReplaySimulation{ reader } {
+    if (auto const keyframe = reader.find_keyframe(frame); keyframe.has_value()) {
+        *this = ReplaySimulation{ reader, reader.load_keyframe(keyframe.value()), reader.playback(keyframe.value()) };
+    }
+    while (next_frame() < frame and simulate_next_frame()) { }
+}
+
+ReplaySimulation::ReplaySimulation(ReplayReader const& reader, ReplayKeyframe keyframe, ReplayPlayback playback)
+    : m_playback{ std::move(playback) },
+      m_is_connected{ std::move(keyframe.is_connected) },
+      m_sent_garbage(keyframe.tetrions.size()) {
+    m_tetrions.reserve(keyframe.tetrions.size());
+    for (auto i = usize{ 0 }; i < keyframe.tetrions.size(); ++i) {
+        m_tetrions.emplace_back(std::move(keyframe.tetrions.at(i)), reader.header().players.at(i).client_id);
+    }
+}
+
+[[nodiscard]] bool ReplaySimulation::simulate_next_frame() {
+    if (not begin_frame()) {
+        return false;
+    }
+    simulate_tetrions(0, m_tetrions.size());
+    end_frame();
+    return true;
+}
+
+[[nodiscard]] bool ReplaySimulation::begin_frame() {
+    if (not m_playback.advance()) {
+        return false;
+    }
+    for (auto const& event : m_playback.events()) {
+        m_is_connected.at(event.player_index) = (event.type == ReplayEventType::Reconnected);
+    }
+    return true;
+}
+
+void ReplaySimulation::simulate_tetrions(usize const begin, usize const end) {
+    for (auto i = begin; i < end; ++i) {
+        m_sent_garbage.at(i) = m_tetrions.at(i).simulate_next_frame(m_playback.key_states()[i]);
+    }
+}
+
+void ReplaySimulation::end_frame() {
+    auto garbage_send_events = std::map<u8, GarbageSendEvent>{};
+    for (auto i = usize{ 0 }; i < m_tetrions.size(); ++i) {
+        if (auto& sent_garbage = m_sent_garbage.at(i); sent_garbage.has_value()) {
+            garbage_send_events.emplace(m_tetrions.at(i).id(), sent_garbage.value());
+            sent_garbage.reset();
+        }
+    }
+    if (garbage_send_events.empty()) {
+        return;
+    }
+
+    auto tetrions = std::vector<ObpfTetrion*>{};
+    tetrions.reserve(m_tetrions.size());
+    for (auto& tetrion : m_tetrions) {
+        tetrions.push_back(&tetrion);
+    }
+    std::ignore = deliver_garbage(tetrions, garbage_send_events);
+}
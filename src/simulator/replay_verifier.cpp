@@ -0,0 +1,100 @@
+#include <atomic>
+#include <barrier>
+#include <exception>
+#include <gsl/gsl>
+#include <simulator/replay_simulation.hpp>
+#include <simulator/replay_verifier.hpp>
+
+static void simulate_until_end(ReplaySimulation& simulation) {
+    while (simulation.simulate_next_frame()) { }
+}
+
+// Every thread simulates a fixed range of tetrions. The frames are begun and ended by the completion function of the
+// barrier, i.e. while all threads are waiting.
+static void simulate_until_end(ReplaySimulation& simulation, usize const num_threads) {
+    auto const num_tetrions = simulation.tetrions().size();
+    auto has_ended = not simulation.begin_frame();
+    auto exception = std::exception_ptr{};
+    auto const on_frame_simulated = [&]() noexcept {
+        try {
+            simulation.end_frame();
+            has_ended = not simulation.begin_frame();
+        } catch (...) {
+            exception = std::current_exception();
+            has_ended = true;
+        }
+    };
+    auto barrier = std::barrier{ gsl::narrow<std::ptrdiff_t>(num_threads), on_frame_simulated };
+    auto const keep_simulating = [&](usize const thread_index) {
+        auto const begin = num_tetrions * thread_index / num_threads;
+        auto const end = num_tetrions * (thread_index + 1) / num_threads;
+        while (not has_ended) {
+            simulation.simulate_tetrions(begin, end);
+            barrier.arrive_and_wait();
+        }
+    };
+    {
+        auto helpers = std::vector<std::jthread>{};
+        helpers.reserve(num_threads - 1);
+        for (auto i = usize{ 1 }; i < num_threads; ++i) {
+            helpers.emplace_back(keep_simulating, i);
+        }
+        keep_simulating(0);
+    }
+    if (exception != nullptr) {
+        std::rethrow_exception(exception);
+    }
+}
+
+[[nodiscard]] ReplayVerification verify_replay(std::filesystem::path const& path, usize const num_threads) {
+    auto result = ReplayVerification{ path, 0, {}, std::nullopt };
+    try {
+        auto const reader = ReplayReader{ path };
+        auto simulation = ReplaySimulation{ reader };
+        auto const num_tetrions = simulation.tetrions().size();
+        if (num_threads > 1 and num_tetrions > 1) {
+            simulate_until_end(simulation, std::min(num_threads, num_tetrions));
+        } else {
+            simulate_until_end(simulation);
+        }
+
+        result.num_frames = simulation.next_frame();
+        for (auto i = usize{ 0 }; i < num_tetrions; ++i) {
+            auto const& tetrion = simulation.tetrions()[i];
+            result.players.push_back(PlayerVerification{
+                reader.header().players.at(i).client_id,
+                reader.header().players.at(i).name,
+                tetrion.score(),
+                tetrion.num_lines_cleared(),
+                tetrion.game_over_since_frame(),
+            });
+        }
+    } catch (std::exception const& exception) {
+        result.error = exception.what();
+    }
+    return result;
+}
+
+[[nodiscard]] std::vector<ReplayVerification> verify_replays(
+    std::span<std::filesystem::path const> const paths,
+    ReplayVerificationOptions const& options
+) {
+    // The replays are independent of each other, so every thread just picks the next one that has not been started.
+    auto results = std::vector<ReplayVerification>(paths.size());
+    auto next_index = std::atomic<usize>{ 0 };
+    auto const keep_verifying = [&] {
+        for (auto i = next_index++; i < paths.size(); i = next_index++) {
+            results.at(i) = verify_replay(paths[i], options.threads_per_replay);
+        }
+    };
+    {
+        auto const num_threads = std::clamp(options.num_threads, usize{ 1 }, std::max(paths.size(), usize{ 1 }));
+        auto threads = std::vector<std::jthread>{};
+        threads.reserve(num_threads - 1);
+        for (auto i = usize{ 1 }; i < num_threads; ++i) {
+            threads.emplace_back(keep_verifying);
+        }
+        keep_verifying();
+    }
+    return results;
+}
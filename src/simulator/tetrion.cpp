@@ -6,6 +6,7 @@
 #include <magic_enum.hpp>
 #include <ranges>
 #include <simulator/tetrion.hpp>
+#include <simulator/trace.hpp>
 #include <simulator/wallkicks.hpp>
 
 [[nodiscard]] static auto determine_pressed_keys(KeyState const previous_state, KeyState const current_state) {
@@ -23,13 +24,14 @@
         auto const key_index = gsl::narrow<usize>(std::to_underlying(key));
         result.at(key_index) = not current_state.get(key) and previous_state.get(key);
         if (result.at(key_index)) {
-            spdlog::info("key {} released", magic_enum::enum_name(key));
+            SPDLOG_TRACE("key {} released", magic_enum::enum_name(key));
         }
     }
     return result;
 }
 
 void ObpfTetrion::apply_expired_garbage() {
+    OBPF_TRACE_SCOPE("ObpfTetrion::apply_expired_garbage");
     static constexpr auto is_expired = [](GarbageSendEvent const& garbage, u64 const current_frame) {
         return current_frame >= garbage.frame + garbage_delay_frames;
     };
@@ -46,12 +48,13 @@ void ObpfTetrion::apply_expired_garbage() {
                 m_matrix.copy_line(y, y + 1);
             }
             m_matrix.fill(Matrix::height - 1, TetrominoType::Garbage);
-            m_matrix.operator[](Vec2{ gap_position, Matrix::height - 1 }) = TetrominoType::Empty;
+            m_matrix.set(Vec2{ gap_position, Matrix::height - 1 }, TetrominoType::Empty);
         }
     }
 }
 
 std::optional<GarbageSendEvent> ObpfTetrion::simulate_next_frame(KeyState const key_state) {
+    OBPF_TRACE_SCOPE("ObpfTetrion::simulate_next_frame");
     auto garbage_lines_to_send = u8{ 0 };
     if (is_game_over() or m_next_frame < m_start_frame) {
         ++m_next_frame;
@@ -117,8 +120,12 @@ std::optional<GarbageSendEvent> ObpfTetrion::simulate_next_frame(KeyState const
     }
 
     auto did_freeze = false;
+    auto locked_piece = TetrominoType::Empty;
     switch (m_lock_delay_state.poll()) {
         case LockDelayPollResult::ShouldLock:
+            if (m_active_tetromino.has_value()) {
+                locked_piece = m_active_tetromino->type;
+            }
             freeze_and_destroy_active_tetromino();  // we could lose the game here due to "Lock Out"
             did_freeze = true;
             m_is_hold_possible = true;
@@ -141,11 +148,11 @@ std::optional<GarbageSendEvent> ObpfTetrion::simulate_next_frame(KeyState const
         case None:
             break;
     }
-    auto const are_there_lines_to_clear = determine_lines_to_clear();
+    auto const are_there_lines_to_clear = determine_lines_to_clear(locked_piece);
 
     auto const can_apply_garbage = did_freeze and not are_there_lines_to_clear;
     if (can_apply_garbage and not m_garbage_receive_queue.empty()) {
-        spdlog::info("trying to apply garbage");
+        SPDLOG_DEBUG("trying to apply garbage");
         apply_expired_garbage();
     }
 
@@ -202,6 +209,34 @@ void ObpfTetrion::on_client_disconnected(u8) {}
     return m_hold_piece;
 }
 
+void ObpfTetrion::rollback_and_resimulate(ObpfTetrion const& state, std::deque<KeyState> const& key_states) {
+    OBPF_TRACE_SCOPE("ObpfTetrion::rollback_and_resimulate");
+    auto events = std::move(m_events);
+    // Renderers have to be told about the rows that differ after the rollback, not about the ones that have changed
+    // during the re-simulation.
+    auto matrix = m_matrix;
+    *this = state;
+    m_events = EventBuffer{};
+    for (auto const key_state : key_states) {
+        // Outgoing garbage is determined from the confirmed state, so we can ignore it here.
+        std::ignore = ObpfTetrion::simulate_next_frame(key_state);
+    }
+    m_events = std::move(events);
+    matrix.assign(m_matrix);
+    m_matrix = matrix;
+}
+
+void ObpfTetrion::apply_board_snapshot(u64 const next_frame, Matrix const& matrix, bool const is_game_over) {
+    m_next_frame = next_frame;
+    m_matrix.assign(matrix);
+    // The snapshot only contains the frozen minos.
+    m_active_tetromino = std::nullopt;
+    m_ghost_tetromino = std::nullopt;
+    if (is_game_over and not m_game_over_since_frame.has_value()) {
+        m_game_over_since_frame = next_frame;
+    }
+}
+
 void ObpfTetrion::receive_garbage(GarbageSendEvent const garbage) {
     m_garbage_receive_queue.push_back(garbage);
 }
@@ -219,7 +254,7 @@ void ObpfTetrion::freeze_and_destroy_active_tetromino() {
         m_game_over_since_frame = m_next_frame;
     }
     for (auto const position : mino_positions) {
-        m_matrix[position] = active_tetromino().value().type;
+        m_matrix.set(position, active_tetromino().value().type);
     }
     m_active_tetromino = std::nullopt;
 }
@@ -257,6 +292,7 @@ bool ObpfTetrion::is_tetromino_completely_invisible(Tetromino const& tetromino)
 }
 
 void ObpfTetrion::spawn_next_tetromino() {
+    OBPF_TRACE_SCOPE("ObpfTetrion::spawn_next_tetromino");
     if (m_old_hold_piece.has_value()) {
         m_active_tetromino = Tetromino{ spawn_position, spawn_rotation, m_old_hold_piece.value() };
         m_old_hold_piece.reset();
@@ -296,6 +332,7 @@ void ObpfTetrion::spawn_next_tetromino() {
 }
 
 void ObpfTetrion::process_keys(KeyState const key_state) {
+    OBPF_TRACE_SCOPE("ObpfTetrion::process_keys");
     using std::ranges::views::enumerate;
     using std::ranges::views::filter;
 
@@ -473,14 +510,12 @@ void ObpfTetrion::rotate(RotationDirection const direction) {
             if (m_lock_delay_state.on_tetromino_moved(NotMovedDown) == HasTouched) {
                 on_touch_event();
             }
-            if (m_action_handler != nullptr) {
-                m_action_handler(
-                    static_cast<ObpfAction>(
-                        direction == RotationDirection::Clockwise ? Action::RotateCW : Action::RotateCCW
-                    ),
-                    m_action_handler_user_data
-                );
-            }
+            m_events.push(Event{
+                .frame = m_next_frame,
+                .action = direction == RotationDirection::Clockwise ? Action::RotateCW : Action::RotateCCW,
+                .piece = m_active_tetromino->type,
+                .num_lines = 0,
+            });
             return;
         }
         m_active_tetromino->position -= translation;
@@ -514,9 +549,12 @@ void ObpfTetrion::hard_drop() {
         on_touch_event();
     }
 
-    if (m_action_handler != nullptr) {
-        m_action_handler(static_cast<ObpfAction>(Action::HardDrop), m_action_handler_user_data);
-    }
+    m_events.push(Event{
+        .frame = m_next_frame,
+        .action = Action::HardDrop,
+        .piece = m_active_tetromino->type,
+        .num_lines = 0,
+    });
 }
 
 void ObpfTetrion::hold() {
@@ -533,7 +571,8 @@ void ObpfTetrion::hold() {
     m_is_hold_possible = false;
 }
 
-[[nodiscard]] bool ObpfTetrion::determine_lines_to_clear() {
+[[nodiscard]] bool ObpfTetrion::determine_lines_to_clear(TetrominoType const locked_piece) {
+    OBPF_TRACE_SCOPE("ObpfTetrion::determine_lines_to_clear");
     auto lines_to_clear = c2k::StaticVector<u8, 4>{};
     for (auto i = std::size_t{ 0 }; i < Matrix::height; ++i) {
         auto const line = Matrix::height - i - 1;
@@ -546,12 +585,12 @@ void ObpfTetrion::hold() {
 
     if (not lines_to_clear.empty()) {
         m_line_clear_delay.start(lines_to_clear);
-        if (m_action_handler) {
-            m_action_handler(
-                static_cast<ObpfAction>(std::to_underlying(Action::Clear1) + lines_to_clear.size() - 1),
-                m_action_handler_user_data
-            );
-        }
+        m_events.push(Event{
+            .frame = m_next_frame,
+            .action = static_cast<Action>(std::to_underlying(Action::Clear1) + lines_to_clear.size() - 1),
+            .piece = locked_piece,
+            .num_lines = gsl::narrow<u8>(lines_to_clear.size()),
+        });
         return true;
     }
     return false;
@@ -563,6 +602,7 @@ void ObpfTetrion::hold() {
 }
 
 void ObpfTetrion::clear_lines(c2k::StaticVector<u8, 4> const lines) {
+    OBPF_TRACE_SCOPE("ObpfTetrion::clear_lines");
     assert(not lines.empty());
     m_score += score_for_num_lines_cleared(lines.size());
     auto num_lines_cleared = decltype(lines.front()){ 0 };
@@ -575,12 +615,18 @@ void ObpfTetrion::clear_lines(c2k::StaticVector<u8, 4> const lines) {
         m_matrix.fill(num_lines_cleared, TetrominoType::Empty);
     }
     m_num_lines_cleared += gsl::narrow<decltype(m_num_lines_cleared)>(lines.size());
-    if (m_matrix.is_empty() and m_action_handler != nullptr) {
-        m_action_handler(static_cast<ObpfAction>(Action::AllClear), m_action_handler_user_data);
+    if (m_events.is_recording() and m_matrix.is_empty()) {
+        m_events.push(Event{
+            .frame = m_next_frame,
+            .action = Action::AllClear,
+            .piece = TetrominoType::Empty,
+            .num_lines = gsl::narrow<u8>(lines.size()),
+        });
     }
 }
 
 void ObpfTetrion::refresh_ghost_tetromino() {
+    OBPF_TRACE_SCOPE("ObpfTetrion::refresh_ghost_tetromino");
     if (not m_active_tetromino.has_value()) {
         m_ghost_tetromino = std::nullopt;
         return;
@@ -596,13 +642,16 @@ void ObpfTetrion::refresh_ghost_tetromino() {
     }
 }
 
-void ObpfTetrion::on_touch_event() const {
-    if (m_action_handler != nullptr) {
-        m_action_handler(static_cast<ObpfAction>(Action::Touch), m_action_handler_user_data);
-    }
+void ObpfTetrion::on_touch_event() {
+    m_events.push(Event{
+        .frame = m_next_frame,
+        .action = Action::Touch,
+        .piece = m_active_tetromino.has_value() ? m_active_tetromino->type : TetrominoType::Empty,
+        .num_lines = 0,
+    });
 }
 
-[[nodiscard]] std::array<Bag, 2> ObpfTetrion::create_two_bags(std::mt19937_64& random) {
+[[nodiscard]] std::array<Bag, 2> ObpfTetrion::create_two_bags(ReplayableRandom& random) {
     auto const bag0 = Bag{ random };
     auto const bag1 = Bag{ random };
     return std::array{ bag0, bag1 };
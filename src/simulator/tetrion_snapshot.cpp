@@ -0,0 +1,402 @@
+#include <concepts>
+#include <limits>
+#include <magic_enum.hpp>
+#include <simulator/tetrion.hpp>
+
+// A snapshot starts with a version byte, followed by the members in the order of ObpfTetrion::visit_state():
+// - unsigned integers are stored as LEB128, signed integers are zigzag-encoded first
+// - booleans, enums and key states take a single byte
+// - the matrix is packed with two minos per byte
+// - random number engines are stored as seed and number of draws
+// - optionals are prefixed by a presence byte, containers by their number of elements
+static constexpr auto snapshot_version = u8{ 1 };
+
+// Limits that prevent malicious snapshots from causing huge allocations or taking ages to load.
+static constexpr auto max_num_draws = u64{ 1 } << 24;
+static constexpr auto max_num_garbage_events = usize{ 1024 };
+static constexpr auto max_player_name_length = usize{ 1024 };
+
+static_assert(Matrix::width * Matrix::height % 2 == 0, "minos are packed in pairs");
+
+template<typename T>
+concept VisitableState = requires(T& state) { T::visit_state(state, [](auto&...) {}); };
+
+// Hashes the bytes of a snapshot (using FNV-1a) instead of storing them.
+class HashingOutput final {
+private:
+    u64 m_hash = 0xCBF29CE484222325;
+
+public:
+    void push_back(u8 const value) {
+        m_hash = (m_hash ^ value) * 0x100000001B3;
+    }
+
+    [[nodiscard]] u64 hash() const {
+        return m_hash;
+    }
+};
+
+template<typename Output>
+class SnapshotWriter final {
+private:
+    Output* m_data;
+
+public:
+    explicit SnapshotWriter(Output& data)
+        : m_data{ &data } {}
+
+    template<typename... Ts>
+    void operator()(Ts const&... values) {
+        (write(values), ...);
+    }
+
+private:
+    void write_byte(u8 const value) {
+        m_data->push_back(value);
+    }
+
+    void write(bool const value) {
+        write_byte(value ? 1 : 0);
+    }
+
+    void write(std::unsigned_integral auto value) {
+        while (value >= 0x80) {
+            write_byte(static_cast<u8>(value | 0x80));
+            value >>= 7;
+        }
+        write_byte(static_cast<u8>(value));
+    }
+
+    void write(std::int32_t const value) {
+        auto const unsigned_value = static_cast<std::uint32_t>(value);
+        write((unsigned_value << 1) ^ static_cast<std::uint32_t>(value >> 31));
+    }
+
+    template<typename T>
+        requires std::is_enum_v<T>
+    void write(T const value) {
+        write_byte(static_cast<u8>(std::to_underlying(value)));
+    }
+
+    void write(Vec2 const value) {
+        write(value.x);
+        write(value.y);
+    }
+
+    void write(Tetromino const& tetromino) {
+        write(tetromino.position);
+        write(tetromino.rotation);
+        write(tetromino.type);
+    }
+
+    void write(KeyState const key_state) {
+        write_byte(key_state.get_bitmask());
+    }
+
+    void write(Matrix const& matrix) {
+        if constexpr (std::same_as<Output, HashingOutput>) {
+            // The matrix makes up most of the snapshot, but it keeps track of its own hash.
+            write(matrix.hash());
+            return;
+        }
+        static_assert(std::to_underlying(TetrominoType::Last) < 16);
+        auto const minos = matrix.minos();
+        for (auto i = usize{ 0 }; i < minos.size(); i += 2) {
+            write_byte(static_cast<u8>(std::to_underlying(minos[i]) << 4 | std::to_underlying(minos[i + 1])));
+        }
+    }
+
+    void write(Bag const& bag) {
+        for (auto const type : bag.tetrominos) {
+            write(type);
+        }
+    }
+
+    void write(ReplayableRandom const& random) {
+        write(random.seed());
+        write(random.num_draws());
+    }
+
+    void write(GarbageSendEvent const& event) {
+        write(event.frame);
+        write(event.num_lines);
+    }
+
+    void write(std::string const& string) {
+        write(string.length());
+        for (auto const c : string) {
+            write_byte(static_cast<u8>(c));
+        }
+    }
+
+    void write(c2k::StaticVector<u8, 4> const& values) {
+        write(values.size());
+        for (auto const value : values) {
+            write(value);
+        }
+    }
+
+    template<typename T>
+    void write(std::optional<T> const& value) {
+        write(value.has_value());
+        if (value.has_value()) {
+            write(value.value());
+        }
+    }
+
+    template<typename T, usize size>
+    void write(std::array<T, size> const& values) {
+        for (auto const& value : values) {
+            write(value);
+        }
+    }
+
+    template<typename T>
+    void write(std::deque<T> const& values) {
+        write(values.size());
+        for (auto const& value : values) {
+            write(value);
+        }
+    }
+
+    template<VisitableState T>
+    void write(T const& state) {
+        T::visit_state(state, *this);
+    }
+};
+
+class SnapshotReader final {
+private:
+    std::span<u8 const> m_data;
+    usize m_position = 0;
+
+public:
+    explicit SnapshotReader(std::span<u8 const> const data)
+        : m_data{ data } {}
+
+    template<typename... Ts>
+    void operator()(Ts&... values) {
+        (read(values), ...);
+    }
+
+    [[nodiscard]] u8 read_byte() {
+        if (m_position >= m_data.size()) {
+            throw SnapshotError{ "unexpected end of snapshot" };
+        }
+        return m_data[m_position++];
+    }
+
+    [[nodiscard]] bool is_at_end() const {
+        return m_position == m_data.size();
+    }
+
+private:
+    void read(bool& value) {
+        auto const byte = read_byte();
+        if (byte > 1) {
+            throw SnapshotError{ std::format("invalid boolean value {}", byte) };
+        }
+        value = (byte == 1);
+    }
+
+    template<std::unsigned_integral T>
+    void read(T& value) {
+        auto result = u64{ 0 };
+        for (auto shift = 0;; shift += 7) {
+            if (shift >= std::numeric_limits<u64>::digits) {
+                throw SnapshotError{ "integer value is too big" };
+            }
+            auto const byte = read_byte();
+            result |= static_cast<u64>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        if (result > std::numeric_limits<T>::max()) {
+            throw SnapshotError{ std::format("integer value {} is out of range", result) };
+        }
+        value = static_cast<T>(result);
+    }
+
+    void read(std::int32_t& value) {
+        auto zigzag = std::uint32_t{};
+        read(zigzag);
+        value = static_cast<std::int32_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+    }
+
+    template<typename T>
+        requires std::is_enum_v<T>
+    void read(T& value) {
+        value = to_enum<T>(read_byte());
+    }
+
+    void read(Vec2& value) {
+        read(value.x);
+        read(value.y);
+    }
+
+    void read(Tetromino& tetromino) {
+        read(tetromino.position);
+        read(tetromino.rotation);
+        read(tetromino.type);
+    }
+
+    void read(KeyState& key_state) {
+        auto const bitmask = read_byte();
+        auto const result = KeyState::from_bitmask(bitmask);
+        if (not result.has_value()) {
+            throw SnapshotError{ std::format("invalid key state bitmask {}", bitmask) };
+        }
+        key_state = result.value();
+    }
+
+    void read(Matrix& matrix) {
+        // Two minos of the same row are packed into a byte, since the width is even.
+        static_assert(Matrix::width % 2 == 0);
+        for (auto row = usize{ 0 }; row < Matrix::height; ++row) {
+            for (auto column = usize{ 0 }; column < Matrix::width; column += 2) {
+                auto const packed = read_byte();
+                auto const position = Vec2{ gsl::narrow<i32>(column), gsl::narrow<i32>(row) };
+                matrix.set(position, to_enum<TetrominoType>(static_cast<u8>(packed >> 4)));
+                matrix.set(position + Vec2{ 1, 0 }, to_enum<TetrominoType>(static_cast<u8>(packed & 0x0F)));
+            }
+        }
+    }
+
+    void read(Bag& bag) {
+        for (auto& type : bag.tetrominos) {
+            read(type);
+            if (type == TetrominoType::Empty or type == TetrominoType::Garbage) {
+                throw SnapshotError{ "invalid tetromino type within bag" };
+            }
+        }
+    }
+
+    void read(ReplayableRandom& random) {
+        auto seed = u64{};
+        auto num_draws = u64{};
+        read(seed);
+        read(num_draws);
+        if (num_draws > max_num_draws) {
+            throw SnapshotError{ std::format("number of random draws ({}) exceeds the maximum", num_draws) };
+        }
+        random = ReplayableRandom::restore(seed, num_draws);
+    }
+
+    void read(std::string& string) {
+        auto const length = read_size(max_player_name_length);
+        string.clear();
+        string.reserve(length);
+        for (auto i = usize{ 0 }; i < length; ++i) {
+            string += static_cast<char>(read_byte());
+        }
+    }
+
+    void read(c2k::StaticVector<u8, 4>& values) {
+        auto const size = read_size(c2k::StaticVector<u8, 4>::capacity());
+        values = {};
+        for (auto i = usize{ 0 }; i < size; ++i) {
+            auto value = u8{};
+            read(value);
+            values.push_back(value);
+        }
+    }
+
+    void read(std::deque<GarbageSendEvent>& events) {
+        auto const size = read_size(max_num_garbage_events);
+        events.clear();
+        for (auto i = usize{ 0 }; i < size; ++i) {
+            auto frame = u64{};
+            auto num_lines = u8{};
+            read(frame);
+            read(num_lines);
+            events.emplace_back(frame, num_lines);
+        }
+    }
+
+    void read(std::optional<Tetromino>& value) {
+        auto has_value = false;
+        read(has_value);
+        value.reset();
+        if (has_value) {
+            auto tetromino = Tetromino{ Vec2{}, Rotation::North, TetrominoType::Empty };
+            read(tetromino);
+            value = tetromino;
+        }
+    }
+
+    template<typename T>
+    void read(std::optional<T>& value) {
+        auto has_value = false;
+        read(has_value);
+        value.reset();
+        if (has_value) {
+            auto contained = T{};
+            read(contained);
+            value = contained;
+        }
+    }
+
+    template<typename T, usize size>
+    void read(std::array<T, size>& values) {
+        for (auto& value : values) {
+            read(value);
+        }
+    }
+
+    template<VisitableState T>
+    void read(T& state) {
+        T::visit_state(state, *this);
+    }
+
+    [[nodiscard]] usize read_size(usize const maximum) {
+        auto size = usize{};
+        read(size);
+        if (size > maximum) {
+            throw SnapshotError{ std::format("{} elements exceed the maximum of {}", size, maximum) };
+        }
+        return size;
+    }
+
+    template<typename T>
+    [[nodiscard]] static T to_enum(u8 const value) {
+        auto const result = magic_enum::enum_cast<T>(static_cast<std::underlying_type_t<T>>(value));
+        if (not result.has_value()) {
+            throw SnapshotError{ std::format("invalid enum value {}", value) };
+        }
+        return result.value();
+    }
+};
+
+[[nodiscard]] std::vector<u8> ObpfTetrion::save_snapshot() const {
+    auto result = std::vector<u8>{};
+    save_snapshot(result);
+    return result;
+}
+
+void ObpfTetrion::save_snapshot(std::vector<u8>& out) const {
+    out.clear();
+    // Typical snapshots are about 150 bytes, so this avoids reallocations.
+    out.reserve(256);
+    out.push_back(snapshot_version);
+    visit_state(*this, SnapshotWriter{ out });
+}
+
+[[nodiscard]] u64 ObpfTetrion::state_hash() const {
+    auto output = HashingOutput{};
+    visit_state(*this, SnapshotWriter{ output });
+    return output.hash();
+}
+
+[[nodiscard]] ObpfTetrion ObpfTetrion::load_snapshot(std::span<u8 const> const data) {
+    auto reader = SnapshotReader{ data };
+    if (auto const version = reader.read_byte(); version != snapshot_version) {
+        throw SnapshotError{ std::format("unsupported snapshot version {}", version) };
+    }
+    auto result = ObpfTetrion{ 0, 0 };
+    visit_state(result, reader);
+    if (not reader.is_at_end()) {
+        throw SnapshotError{ "excess bytes after snapshot" };
+    }
+    return result;
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <format>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <simulator/trace.hpp>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+struct TraceEvent final {
+    std::atomic<char const*> name = nullptr;
+    std::atomic<i64> start = 0;  // Nanoseconds since the epoch of the steady clock.
+    std::atomic<i64> end = 0;
+};
+
+// Written by its thread only. Spans are published by incrementing `num_recorded`. Since a span that is being written
+// can overwrite the oldest one in the buffer, `num_started` is incremented before, so that readers can tell which
+// events may be torn.
+struct TraceBuffer final {
+    u64 thread_id;
+    std::string thread_name;  // Guarded by the mutex of the registry.
+    std::atomic<u64> num_started = 0;
+    std::atomic<u64> num_recorded = 0;
+    std::array<TraceEvent, trace_buffer_capacity> events;
+
+    explicit TraceBuffer(u64 const thread_id) : thread_id{ thread_id } { }
+};
+
+class TraceRegistry final {
+private:
+    // Buffers of finished threads are kept so that e.g. the spans of clients that have disconnected can still be
+    // exported, but the server starts new threads all the time.
+    static constexpr auto max_num_finished_threads = usize{ 64 };
+
+    std::mutex m_mutex;
+    u64 m_next_thread_id = 1;
+    std::vector<std::shared_ptr<TraceBuffer>> m_buffers;
+    std::deque<std::shared_ptr<TraceBuffer>> m_finished_buffers;
+
+public:
+    [[nodiscard]] std::shared_ptr<TraceBuffer> create_buffer() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_buffers.emplace_back(std::make_shared<TraceBuffer>(m_next_thread_id++));
+    }
+
+    void retire(std::shared_ptr<TraceBuffer> const& buffer) {
+        auto const lock = std::scoped_lock{ m_mutex };
+        std::erase(m_buffers, buffer);
+        m_finished_buffers.push_back(buffer);
+        if (m_finished_buffers.size() > max_num_finished_threads) {
+            m_finished_buffers.pop_front();
+        }
+    }
+
+    void set_thread_name(TraceBuffer& buffer, std::string name) {
+        auto const lock = std::scoped_lock{ m_mutex };
+        buffer.thread_name = std::move(name);
+    }
+
+    // Thread names are copied since they can change at any time.
+    [[nodiscard]] std::vector<std::pair<std::shared_ptr<TraceBuffer const>, std::string>> buffers() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        auto result = std::vector<std::pair<std::shared_ptr<TraceBuffer const>, std::string>>{};
+        for (auto const& buffer : m_finished_buffers) {
+            result.emplace_back(buffer, buffer->thread_name);
+        }
+        for (auto const& buffer : m_buffers) {
+            result.emplace_back(buffer, buffer->thread_name);
+        }
+        return result;
+    }
+};
+
+[[nodiscard]] static TraceRegistry& trace_registry() {
+    static auto registry = TraceRegistry{};
+    return registry;
+}
+
+// Registers the buffer of a thread when the thread records its first span.
+class ThreadTraceBuffer final {
+private:
+    std::shared_ptr<TraceBuffer> m_buffer = trace_registry().create_buffer();
+
+public:
+    ThreadTraceBuffer() = default;
+    ThreadTraceBuffer(ThreadTraceBuffer const& other) = delete;
+    ThreadTraceBuffer(ThreadTraceBuffer&& other) noexcept = delete;
+    ThreadTraceBuffer& operator=(ThreadTraceBuffer const& other) = delete;
+    ThreadTraceBuffer& operator=(ThreadTraceBuffer&& other) noexcept = delete;
+
+    ~ThreadTraceBuffer() {
+        trace_registry().retire(m_buffer);
+    }
+
+    [[nodiscard]] TraceBuffer& get() const {
+        return *m_buffer;
+    }
+};
+
+[[nodiscard]] static TraceBuffer& this_thread_trace_buffer() {
+    thread_local auto const buffer = ThreadTraceBuffer{};
+    return buffer.get();
+}
+
+[[nodiscard]] static i64 to_nanoseconds(std::chrono::steady_clock::time_point const time_point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count();
+}
+
+void record_trace_span(
+    char const* const name,
+    std::chrono::steady_clock::time_point const start,
+    std::chrono::steady_clock::time_point const end
+) noexcept {
+    auto& buffer = this_thread_trace_buffer();
+    auto const index = buffer.num_recorded.load(std::memory_order_relaxed);
+    buffer.num_started.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& event = buffer.events.at(index % trace_buffer_capacity);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(to_nanoseconds(start), std::memory_order_relaxed);
+    event.end.store(to_nanoseconds(end), std::memory_order_relaxed);
+    buffer.num_recorded.store(index + 1, std::memory_order_release);
+}
+
+void set_trace_thread_name(std::string name) {
+    trace_registry().set_thread_name(this_thread_trace_buffer(), std::move(name));
+}
+
+struct RecordedSpan final {
+    char const* name;
+    i64 start;
+    i64 end;
+};
+
+[[nodiscard]] static std::vector<RecordedSpan> recorded_spans(TraceBuffer const& buffer) {
+    auto const num_recorded = buffer.num_recorded.load(std::memory_order_acquire);
+    auto const first = (num_recorded > trace_buffer_capacity ? num_recorded - trace_buffer_capacity : 0);
+    auto result = std::vector<RecordedSpan>{};
+    result.reserve(num_recorded - first);
+    for (auto i = first; i < num_recorded; ++i) {
+        auto const& event = buffer.events.at(i % trace_buffer_capacity);
+        result.emplace_back(
+            event.name.load(std::memory_order_relaxed),
+            event.start.load(std::memory_order_relaxed),
+            event.end.load(std::memory_order_relaxed)
+        );
+    }
+    // Every event that has been overwritten while copying has been announced by incrementing `num_started`.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto const num_started = buffer.num_started.load(std::memory_order_relaxed);
+    auto const first_intact = (num_started > trace_buffer_capacity ? num_started - trace_buffer_capacity : 0);
+    if (first_intact > first) {
+        auto const num_torn = std::min(first_intact - first, result.size());
+        result.erase(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(num_torn));
+    }
+    return result;
+}
+
+[[nodiscard]] static std::string json_escaped(std::string_view const text) {
+    auto result = std::string{};
+    result.reserve(text.size());
+    for (auto const c : text) {
+        if (c == '"' or c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            result += std::format("\\u{:04x}", static_cast<int>(c));
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+void write_chrome_trace(std::ostream& stream) {
+    auto const buffers = trace_registry().buffers();
+    auto spans = std::vector<std::vector<RecordedSpan>>{};
+    spans.reserve(buffers.size());
+    auto origin = std::numeric_limits<i64>::max();
+    for (auto const& [buffer, name] : buffers) {
+        for (auto const& span : spans.emplace_back(recorded_spans(*buffer))) {
+            origin = std::min(origin, span.start);
+        }
+    }
+
+    // Timestamps are given in microseconds.
+    auto const microseconds = [](i64 const nanoseconds) { return static_cast<double>(nanoseconds) / 1000.0; };
+    stream << "{\"traceEvents\":[";
+    auto separator = std::string_view{ "\n" };
+    for (auto i = usize{ 0 }; i < buffers.size(); ++i) {
+        auto const& [buffer, name] = buffers.at(i);
+        if (not name.empty()) {
+            stream << std::format(
+                R"({}{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})",
+                std::exchange(separator, ",\n"),
+                buffer->thread_id,
+                json_escaped(name)
+            );
+        }
+        for (auto const& span : spans.at(i)) {
+            stream << std::format(
+                R"({}{{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                std::exchange(separator, ",\n"),
+                json_escaped(span.name),
+                buffer->thread_id,
+                microseconds(span.start - origin),
+                microseconds(span.end - span.start)
+            );
+        }
+    }
+    stream << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+[[nodiscard]] std::string chrome_trace() {
+    auto stream = std::ostringstream{};
+    write_chrome_trace(stream);
+    return std::move(stream).str();
+}
@@ -0,0 +1,289 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <lobby_backend.hpp>
+#include <mutex>
+#include <network/http_server.hpp>
+#include <network/match_starter.hpp>
+#include <obpf/lobby.h>
+#include <obpf/simulator.h>
+#include <sockets/sockets.hpp>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+static void expect_same_tetromino(ObpfTetromino const& actual, ObpfTetromino const& expected) {
+    EXPECT_EQ(actual.type, expected.type);
+    for (auto i = 0; i < 4; ++i) {
+        EXPECT_EQ(actual.mino_positions[i].x, expected.mino_positions[i].x);
+        EXPECT_EQ(actual.mino_positions[i].y, expected.mino_positions[i].y);
+    }
+}
+
+// Compares the render state with the values returned by the single getters.
+static void expect_render_state_matches_getters(ObpfTetrion* const tetrion) {
+    auto state = ObpfRenderState{};
+    ASSERT_TRUE(obpf_tetrion_get_render_state(tetrion, &state));
+
+    EXPECT_EQ(state.next_frame, obpf_tetrion_get_next_frame(tetrion));
+    EXPECT_EQ(state.frames_until_game_start, obpf_tetrion_frames_until_game_start(tetrion));
+    EXPECT_EQ(state.is_game_over, obpf_tetrion_is_game_over(tetrion));
+    ASSERT_EQ(obpf_tetrion_width(), OBPF_MATRIX_WIDTH);
+    ASSERT_EQ(obpf_tetrion_height(), OBPF_MATRIX_HEIGHT);
+    for (auto y = std::uint8_t{ 0 }; y < OBPF_MATRIX_HEIGHT; ++y) {
+        for (auto x = std::uint8_t{ 0 }; x < OBPF_MATRIX_WIDTH; ++x) {
+            EXPECT_EQ(state.matrix[y * OBPF_MATRIX_WIDTH + x], obpf_tetrion_matrix_get(tetrion, ObpfVec2{ x, y }));
+        }
+    }
+
+    auto active_tetromino = ObpfTetromino{};
+    ASSERT_EQ(state.has_active_tetromino, obpf_tetrion_try_get_active_tetromino(tetrion, &active_tetromino));
+    if (state.has_active_tetromino) {
+        expect_same_tetromino(state.active_tetromino, active_tetromino);
+    }
+    auto ghost_tetromino = ObpfTetromino{};
+    ASSERT_EQ(state.has_ghost_tetromino, obpf_tetrion_try_get_ghost_tetromino(tetrion, &ghost_tetromino));
+    if (state.has_ghost_tetromino) {
+        expect_same_tetromino(state.ghost_tetromino, ghost_tetromino);
+    }
+
+    auto const preview_pieces = obpf_tetrion_get_preview_pieces(tetrion);
+    for (auto i = 0; i < 6; ++i) {
+        EXPECT_EQ(state.preview_pieces.types[i], preview_pieces.types[i]);
+    }
+    EXPECT_EQ(state.hold_piece, obpf_tetrion_get_hold_piece(tetrion));
+
+    EXPECT_EQ(state.garbage_queue_length, obpf_garbage_queue_length(tetrion));
+    ASSERT_EQ(state.num_garbage_events, obpf_garbage_queue_num_events(tetrion));
+    for (auto i = std::uint32_t{ 0 }; i < state.num_garbage_events; ++i) {
+        auto const event = obpf_garbage_queue_event(tetrion, i);
+        EXPECT_EQ(state.garbage_events[i].num_lines, event.num_lines);
+        EXPECT_EQ(state.garbage_events[i].remaining_frames, event.remaining_frames);
+    }
+
+    auto const stats = obpf_tetrion_get_stats(tetrion);
+    EXPECT_EQ(state.stats.score, stats.score);
+    EXPECT_EQ(state.stats.lines_cleared, stats.lines_cleared);
+    EXPECT_EQ(state.stats.level, stats.level);
+
+    auto const line_clear_delay_state = obpf_tetrion_get_line_clear_delay_state(tetrion);
+    ASSERT_EQ(state.line_clear_delay_state.count, line_clear_delay_state.count);
+    for (auto i = 0; i < state.line_clear_delay_state.count; ++i) {
+        EXPECT_EQ(state.line_clear_delay_state.lines[i], line_clear_delay_state.lines[i]);
+    }
+    EXPECT_EQ(state.line_clear_delay_state.countdown, line_clear_delay_state.countdown);
+    EXPECT_EQ(state.line_clear_delay_state.delay, line_clear_delay_state.delay);
+}
+
+TEST(CApiTests, RenderStateMatchesGetters) {
+    auto const tetrion = obpf_create_tetrion(42);
+    ASSERT_NE(tetrion, nullptr);
+    expect_render_state_matches_getters(tetrion);
+
+    // Drops a piece every 40 frames, alternately moving it to the left and to the right.
+    for (auto frame = 0; frame < 400; ++frame) {
+        auto const piece = frame / 40;
+        auto const key_state = obpf_key_state_create(
+            piece % 2 == 0 and frame % 40 < 20,
+            piece % 2 == 1 and frame % 40 < 20,
+            false,
+            frame % 40 == 39,
+            frame % 40 == 25,
+            false,
+            frame == 210
+        );
+        obpf_tetrion_simulate_next_frame(tetrion, key_state);
+        if (frame % 50 == 0) {
+            expect_render_state_matches_getters(tetrion);
+        }
+    }
+
+    auto state = ObpfRenderState{};
+    ASSERT_TRUE(obpf_tetrion_get_render_state(tetrion, &state));
+    EXPECT_FALSE(state.is_game_over);
+    EXPECT_NE(state.hold_piece, OBPF_TETROMINO_TYPE_EMPTY);
+    auto num_occupied_cells = 0;
+    for (auto const cell : state.matrix) {
+        num_occupied_cells += (cell != OBPF_TETROMINO_TYPE_EMPTY ? 1 : 0);
+    }
+    EXPECT_GT(num_occupied_cells, 0);
+    expect_render_state_matches_getters(tetrion);
+    obpf_destroy_tetrion(tetrion);
+}
+
+// Polls the status like a game loop would.
+[[nodiscard]] static ObpfAsyncStatus wait_until_finished(ObpfAsyncOperation* const operation) {
+    auto const deadline = std::chrono::steady_clock::now() + 10s;
+    while (obpf_async_operation_status(operation) == OBPF_ASYNC_PENDING
+           and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    return obpf_async_operation_status(operation);
+}
+
+static void count_call(ObpfAsyncOperation*, void* const num_calls) {
+    ++*static_cast<std::atomic_int*>(num_calls);
+}
+
+// Runs the local lobby server for clients of the C API.
+class CApiLobbyServer final {
+private:
+    MatchStarter m_match_starter{ 0 };
+    LobbyBackend m_backend{ m_match_starter };
+    HttpServer m_server{ 0, [this](HttpRequest const& request) { return m_backend.handle(request); } };
+
+public:
+    [[nodiscard]] ObpfLobbyServerConnection* connect() const {
+        return obpf_create_lobby_server_connection("127.0.0.1", m_server.port());
+    }
+};
+
+TEST(CApiTests, AsyncLobbyRequestsCanBePolled) {
+    auto const server = CApiLobbyServer{};
+    auto const connection = server.connect();
+    auto num_calls = std::atomic_int{ 0 };
+    auto const register_user = obpf_lobby_connection_register_user_async(connection, "player", "password");
+    ASSERT_NE(register_user, nullptr);
+    obpf_async_operation_set_callback(register_user, count_call, &num_calls);
+    auto const lobby_list = obpf_get_lobby_list_async(connection);
+    ASSERT_NE(lobby_list, nullptr);
+
+    // Requests on the same connection are handled in order.
+    ASSERT_EQ(wait_until_finished(lobby_list), OBPF_ASYNC_SUCCEEDED);
+    EXPECT_EQ(obpf_async_operation_status(register_user), OBPF_ASYNC_SUCCEEDED);
+    EXPECT_EQ(num_calls, 1);
+    EXPECT_EQ(obpf_async_operation_port(register_user), 0);
+
+    auto const user = static_cast<ObpfLobbyUser*>(obpf_async_operation_take_result(register_user));
+    ASSERT_NE(user, nullptr);
+    EXPECT_EQ(obpf_async_operation_take_result(register_user), nullptr);
+    auto const lobbies = static_cast<ObpfLobbyList const*>(obpf_async_operation_take_result(lobby_list));
+    ASSERT_NE(lobbies, nullptr);
+    EXPECT_EQ(obpf_lobby_list_length(lobbies), 0);
+
+    // A result that is not taken is destroyed together with the operation.
+    auto const login = obpf_lobby_connection_authenticate_user_async(connection, "player", "password");
+    EXPECT_EQ(wait_until_finished(login), OBPF_ASYNC_SUCCEEDED);
+
+    obpf_destroy_async_operation(login);
+    obpf_free_lobby_list(lobbies);
+    obpf_destroy_async_operation(lobby_list);
+    obpf_user_destroy(user);
+    obpf_destroy_async_operation(register_user);
+    obpf_destroy_lobby_server_connection(connection);
+}
+
+TEST(CApiTests, FailedAsyncRequestHasNoResult) {
+    auto const server = CApiLobbyServer{};
+    auto const connection = server.connect();
+    auto const first = obpf_lobby_connection_register_user_async(connection, "player", "password");
+    auto const second = obpf_lobby_connection_register_user_async(connection, "player", "password");
+    EXPECT_EQ(wait_until_finished(first), OBPF_ASYNC_SUCCEEDED);
+    EXPECT_EQ(wait_until_finished(second), OBPF_ASYNC_FAILED);
+    EXPECT_EQ(obpf_async_operation_take_result(second), nullptr);
+    obpf_destroy_async_operation(second);
+    obpf_destroy_async_operation(first);
+    obpf_destroy_lobby_server_connection(connection);
+}
+
+TEST(CApiTests, CallbackOfFinishedOperationIsCalledImmediately) {
+    auto const server = CApiLobbyServer{};
+    auto const connection = server.connect();
+    auto const lobby_list = obpf_get_lobby_list_async(connection);
+    ASSERT_EQ(wait_until_finished(lobby_list), OBPF_ASYNC_SUCCEEDED);
+
+    static auto calling_thread = std::thread::id{};
+    auto num_calls = std::atomic_int{ 0 };
+    obpf_async_operation_set_callback(
+        lobby_list,
+        [](ObpfAsyncOperation* const operation, void* const user_data) {
+            calling_thread = std::this_thread::get_id();
+            count_call(operation, user_data);
+        },
+        &num_calls
+    );
+    EXPECT_EQ(num_calls, 1);
+    EXPECT_EQ(calling_thread, std::this_thread::get_id());
+    obpf_destroy_async_operation(lobby_list);
+    obpf_destroy_lobby_server_connection(connection);
+}
+
+TEST(CApiTests, QueuedAsyncRequestsCanBeCancelled) {
+    auto const server = CApiLobbyServer{};
+    auto const connection = server.connect();
+    // The callback runs on the I/O thread and keeps it busy until the other requests have been queued.
+    auto unblock = std::latch{ 1 };
+    auto const blocking = obpf_get_lobby_list_async(connection);
+    obpf_async_operation_set_callback(
+        blocking,
+        [](ObpfAsyncOperation*, void* const latch) { static_cast<std::latch*>(latch)->wait(); },
+        &unblock
+    );
+    auto const cancelled = obpf_lobby_connection_register_user_async(connection, "player", "password");
+    auto const not_cancelled = obpf_get_lobby_list_async(connection);
+    obpf_async_operation_cancel(cancelled);
+    EXPECT_EQ(obpf_async_operation_status(cancelled), OBPF_ASYNC_PENDING);
+    unblock.count_down();
+
+    EXPECT_EQ(wait_until_finished(blocking), OBPF_ASYNC_SUCCEEDED);
+    EXPECT_EQ(wait_until_finished(cancelled), OBPF_ASYNC_CANCELLED);
+    EXPECT_EQ(obpf_async_operation_take_result(cancelled), nullptr);
+    EXPECT_EQ(wait_until_finished(not_cancelled), OBPF_ASYNC_SUCCEEDED);
+
+    // The cancelled request has not been sent, so the user can still be registered.
+    auto const register_user = obpf_lobby_connection_register_user_async(connection, "player", "password");
+    EXPECT_EQ(wait_until_finished(register_user), OBPF_ASYNC_SUCCEEDED);
+
+    obpf_destroy_async_operation(register_user);
+    obpf_destroy_async_operation(not_cancelled);
+    obpf_destroy_async_operation(cancelled);
+    obpf_destroy_async_operation(blocking);
+    obpf_destroy_lobby_server_connection(connection);
+}
+
+TEST(CApiTests, ConnectingToAMatchCanBeCancelled) {
+    // Accepts connections, but never starts the match.
+    auto mutex = std::mutex{};
+    auto clients = std::vector<c2k::ClientSocket>{};
+    auto const server =
+        c2k::Sockets::create_server(c2k::AddressFamily::Ipv4, 0, [&mutex, &clients](c2k::ClientSocket client) {
+            auto const lock = std::scoped_lock{ mutex };
+            clients.push_back(std::move(client));
+        });
+    auto const num_clients = [&mutex, &clients] {
+        auto const lock = std::scoped_lock{ mutex };
+        return clients.size();
+    };
+    auto const port = server.local_address().port;
+
+    auto const operation = obpf_create_multiplayer_tetrion_async("127.0.0.1", port, "player", ObpfMultiplayerOptions{});
+    ASSERT_NE(operation, nullptr);
+    auto const deadline = std::chrono::steady_clock::now() + 10s;
+    while (num_clients() == 0 and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(num_clients(), 1);
+    EXPECT_EQ(obpf_async_operation_status(operation), OBPF_ASYNC_PENDING);
+
+    obpf_async_operation_cancel(operation);
+    EXPECT_EQ(wait_until_finished(operation), OBPF_ASYNC_CANCELLED);
+    EXPECT_EQ(obpf_async_operation_take_result(operation), nullptr);
+    obpf_destroy_async_operation(operation);
+
+    // Destroying a pending operation does not wait for it.
+    auto const destroyed = obpf_create_multiplayer_tetrion_async("127.0.0.1", port, "player", ObpfMultiplayerOptions{});
+    ASSERT_NE(destroyed, nullptr);
+    auto const start = std::chrono::steady_clock::now();
+    obpf_destroy_async_operation(destroyed);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+
+    // The destroyed operation does not hold up the ones that are started afterwards.
+    auto const next = obpf_create_multiplayer_tetrion_async("127.0.0.1", port, "player", ObpfMultiplayerOptions{});
+    ASSERT_NE(next, nullptr);
+    obpf_async_operation_cancel(next);
+    EXPECT_EQ(wait_until_finished(next), OBPF_ASYNC_CANCELLED);
+    obpf_destroy_async_operation(next);
+}
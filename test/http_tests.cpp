@@ -0,0 +1,332 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <network/http_connection.hpp>
+#include <sockets/sockets.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static void send_text(c2k::ClientSocket& socket, std::string_view const text) {
+    auto bytes = std::vector<std::byte>(text.length());
+    std::ranges::transform(text, bytes.begin(), [](char const c) { return static_cast<std::byte>(c); });
+    auto buffer = c2k::MessageBuffer{};
+    buffer << bytes;
+    std::ignore = socket.send(buffer).get();
+}
+
+// Parses all responses that a server sends before closing the connection.
+[[nodiscard]] static std::vector<HttpResponse> parse_responses(std::string const& bytes) {
+    auto server = c2k::Sockets::create_server(c2k::AddressFamily::Ipv4, 0, [&bytes](c2k::ClientSocket client) {
+        send_text(client, bytes);
+    });
+    auto client = c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, "127.0.0.1", server.local_address().port);
+    auto reader = HttpReader{ client };
+    auto responses = std::vector<HttpResponse>{};
+    while (reader.wait_for_message()) {
+        responses.push_back(reader.receive_response());
+    }
+    return responses;
+}
+
+// Serves every connection with a handler that is given the index of the connection. The connection is closed when
+// the handler returns. All requests that have been received are recorded.
+class TestHttpServer final {
+public:
+    class Connection final {
+    private:
+        TestHttpServer* m_server;
+        c2k::ClientSocket* m_socket;
+        HttpReader m_reader;
+
+    public:
+        Connection(TestHttpServer& server, c2k::ClientSocket& socket)
+            : m_server{ &server }, m_socket{ &socket }, m_reader{ socket } { }
+
+        [[nodiscard]] HttpRequest receive_request() {
+            auto request = m_reader.receive_request();
+            auto const lock = std::scoped_lock{ m_server->m_mutex };
+            m_server->m_requests.push_back(request);
+            return request;
+        }
+
+        // Answers with the path of the request as body.
+        void respond(HttpRequest const& request, bool const close = false) {
+            send_text(
+                *m_socket,
+                std::format(
+                    "HTTP/1.1 200 OK\r\nContent-Length: {}\r\n{}\r\n{}",
+                    request.path.length(),
+                    close ? "Connection: close\r\n" : "",
+                    request.path
+                )
+            );
+        }
+    };
+
+    using Handler = std::function<void(std::size_t connection_index, Connection& connection)>;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_handler_finished;
+    std::vector<HttpRequest> m_requests;
+    std::size_t m_num_connections = 0;
+    std::size_t m_num_running_handlers = 0;
+    Handler m_handler;
+    c2k::ServerSocket m_socket;
+
+public:
+    explicit TestHttpServer(Handler handler)
+        : m_handler{ std::move(handler) },
+          m_socket{ c2k::Sockets::create_server(c2k::AddressFamily::Ipv4, 0, [this](c2k::ClientSocket client) {
+              auto index = std::size_t{};
+              {
+                  auto const lock = std::scoped_lock{ m_mutex };
+                  index = m_num_connections++;
+                  ++m_num_running_handlers;
+              }
+              auto connection = Connection{ *this, client };
+              try {
+                  m_handler(index, connection);
+              } catch (std::exception const&) {
+                  // The client has closed the connection.
+              }
+              client.close();
+              auto const lock = std::scoped_lock{ m_mutex };
+              --m_num_running_handlers;
+              m_handler_finished.notify_all();
+          }) } { }
+
+    TestHttpServer(TestHttpServer const& other) = delete;
+    TestHttpServer(TestHttpServer&& other) noexcept = delete;
+    TestHttpServer& operator=(TestHttpServer const& other) = delete;
+    TestHttpServer& operator=(TestHttpServer&& other) noexcept = delete;
+
+    // Handlers refer to the server, so they have to finish first.
+    ~TestHttpServer() {
+        auto lock = std::unique_lock{ m_mutex };
+        m_handler_finished.wait(lock, [this] { return m_num_running_handlers == 0; });
+    }
+
+    [[nodiscard]] std::uint16_t port() const {
+        return m_socket.local_address().port;
+    }
+
+    [[nodiscard]] std::vector<HttpRequest> requests() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_requests;
+    }
+
+    [[nodiscard]] std::size_t num_connections() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_num_connections;
+    }
+};
+
+TEST(HttpTests, StatusLineAndHeaders) {
+    auto const responses = parse_responses(
+        "HTTP/1.1 404 Not Found\r\n"
+        "Content-Type: text/plain\r\n"
+        "X-Custom-HEADER:   some value  \r\n"
+        "Content-Length: 0\r\n"
+        "\r\n"
+    );
+    ASSERT_EQ(responses.size(), 1);
+    auto const& response = responses.front();
+    EXPECT_EQ(response.status, HttpStatus::NotFound);
+    EXPECT_EQ(response.headers.at(1).first, "x-custom-header");
+    EXPECT_EQ(response.header("x-custom-header"), "some value");
+    EXPECT_EQ(response.header("CONTENT-TYPE"), "text/plain");
+    EXPECT_FALSE(response.header("location").has_value());
+    EXPECT_TRUE(response.body.empty());
+}
+
+TEST(HttpTests, InvalidStatusLineFails) {
+    EXPECT_THROW({ std::ignore = parse_responses("HTP/1.1 200 OK\r\n\r\n"); }, HttpError);
+    EXPECT_THROW({ std::ignore = parse_responses("HTTP/1.1\r\n\r\n"); }, HttpError);
+}
+
+TEST(HttpTests, InvalidHeaderFails) {
+    EXPECT_THROW({ std::ignore = parse_responses("HTTP/1.1 200 OK\r\nno colon\r\n\r\n"); }, HttpError);
+}
+
+TEST(HttpTests, FoldedHeaderIsJoined) {
+    auto const responses = parse_responses(
+        "HTTP/1.1 200 OK\r\n"
+        "X-Long: first\r\n"
+        "  second\r\n"
+        "\tthird\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n"
+    );
+    ASSERT_EQ(responses.size(), 1);
+    EXPECT_EQ(responses.front().header("x-long"), "first second third");
+    EXPECT_EQ(responses.front().header("content-length"), "0");
+}
+
+TEST(HttpTests, ContentLengthBody) {
+    auto const responses = parse_responses(
+        "HTTP/1.1 201 Created\r\n"
+        "Content-Length: 11\r\n"
+        "\r\n"
+        "hello world"
+    );
+    ASSERT_EQ(responses.size(), 1);
+    EXPECT_EQ(responses.front().status, HttpStatus::Created);
+    EXPECT_EQ(responses.front().body, "hello world");
+}
+
+TEST(HttpTests, TruncatedBodyFails) {
+    EXPECT_THROW(
+        { std::ignore = parse_responses("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nhello"); },
+        HttpConnectionClosed
+    );
+}
+
+TEST(HttpTests, ChunkedBodyWithTrailers) {
+    auto const responses = parse_responses(
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "5;name=value\r\n"
+        "hello\r\n"
+        "C\r\n"
+        " world\r\n\r\n!!\r\n"
+        "0\r\n"
+        "X-Trailer: ignored\r\n"
+        "\r\n"
+        "HTTP/1.1 204 No Content\r\n"
+        "\r\n"
+    );
+    ASSERT_EQ(responses.size(), 2);
+    EXPECT_EQ(responses.at(0).body, "hello world\r\n\r\n!!");
+    EXPECT_FALSE(responses.at(0).header("x-trailer").has_value());
+    EXPECT_EQ(responses.at(1).status, HttpStatus::NoContent);
+}
+
+TEST(HttpTests, CloseDelimitedBody) {
+    auto const responses = parse_responses(
+        "HTTP/1.1 200 OK\r\n"
+        "\r\n"
+        "the body ends\r\nwhen the connection is closed"
+    );
+    ASSERT_EQ(responses.size(), 1);
+    EXPECT_EQ(responses.front().body, "the body ends\r\nwhen the connection is closed");
+    EXPECT_EQ(responses.front().header("connection"), "close");
+}
+
+TEST(HttpTests, ResponsesWithoutBodyDontWaitForClose) {
+    auto const responses = parse_responses(
+        "HTTP/1.1 304 Not Modified\r\n"
+        "\r\n"
+        "HTTP/1.1 204 No Content\r\n"
+        "\r\n"
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 2\r\n"
+        "\r\n"
+        "ok"
+    );
+    ASSERT_EQ(responses.size(), 3);
+    EXPECT_EQ(responses.at(0).status, HttpStatus::NotModified);
+    EXPECT_EQ(responses.at(1).status, HttpStatus::NoContent);
+    EXPECT_EQ(responses.at(2).body, "ok");
+}
+
+TEST(HttpTests, PipelinedRequestsAreAnsweredInOrder) {
+    auto server = TestHttpServer{ [](std::size_t, TestHttpServer::Connection& connection) {
+        while (true) {
+            connection.respond(connection.receive_request());
+        }
+    } };
+    auto connection = HttpConnection{ "http://127.0.0.1", server.port() };
+    auto const requests = std::vector{
+        HttpRequest{ "GET", "/first", {}, {} },
+        HttpRequest{ "POST", "/second", {}, "body" },
+        HttpRequest{ "GET", "/third", {}, {} },
+    };
+    auto const responses = connection.send_all(requests);
+    ASSERT_EQ(responses.size(), 3);
+    EXPECT_EQ(responses.at(0).body, "/first");
+    EXPECT_EQ(responses.at(1).body, "/second");
+    EXPECT_EQ(responses.at(2).body, "/third");
+    EXPECT_EQ(connection.send(HttpRequest{ "GET", "/fourth", {}, {} }).body, "/fourth");
+    EXPECT_EQ(server.num_connections(), 1);
+    ASSERT_EQ(server.requests().size(), 4);
+    EXPECT_EQ(server.requests().at(1).body, "body");
+}
+
+TEST(HttpTests, RequestsAfterConnectionCloseAreSentAgain) {
+    // The first connection is closed after the first response, so the server does not handle the other requests.
+    auto server = TestHttpServer{ [](std::size_t const connection_index, TestHttpServer::Connection& connection) {
+        if (connection_index == 0) {
+            auto const first = connection.receive_request();
+            std::ignore = connection.receive_request();
+            std::ignore = connection.receive_request();
+            connection.respond(first, true);
+            return;
+        }
+        while (true) {
+            connection.respond(connection.receive_request());
+        }
+    } };
+    auto connection = HttpConnection{ "127.0.0.1", server.port() };
+    auto const requests = std::vector{
+        HttpRequest{ "POST", "/first", {}, {} },
+        HttpRequest{ "POST", "/second", {}, {} },
+        HttpRequest{ "POST", "/third", {}, {} },
+    };
+    auto const responses = connection.send_all(requests);
+    ASSERT_EQ(responses.size(), 3);
+    EXPECT_EQ(responses.at(0).body, "/first");
+    EXPECT_EQ(responses.at(1).body, "/second");
+    EXPECT_EQ(responses.at(2).body, "/third");
+    EXPECT_EQ(server.num_connections(), 2);
+}
+
+// The first connection is closed after receiving the second request without responding to it.
+static void close_after_second_request(std::size_t const connection_index, TestHttpServer::Connection& connection) {
+    if (connection_index == 0) {
+        connection.respond(connection.receive_request());
+        std::ignore = connection.receive_request();
+        return;
+    }
+    while (true) {
+        connection.respond(connection.receive_request());
+    }
+}
+
+TEST(HttpTests, IdempotentRequestsAreSentAgainOnClosedConnection) {
+    auto server = TestHttpServer{ close_after_second_request };
+    auto connection = HttpConnection{ "127.0.0.1", server.port() };
+    EXPECT_EQ(connection.send(HttpRequest{ "GET", "/first", {}, {} }).body, "/first");
+    EXPECT_EQ(connection.send(HttpRequest{ "GET", "/second", {}, {} }).body, "/second");
+    EXPECT_EQ(server.num_connections(), 2);
+    EXPECT_EQ(server.requests().size(), 3);
+}
+
+TEST(HttpTests, UnsafeRequestsAreNotSentAgainOnClosedConnection) {
+    auto server = TestHttpServer{ close_after_second_request };
+    auto connection = HttpConnection{ "127.0.0.1", server.port() };
+    EXPECT_EQ(connection.send(HttpRequest{ "GET", "/first", {}, {} }).body, "/first");
+    EXPECT_THROW({ std::ignore = connection.send(HttpRequest{ "POST", "/second", {}, "body" }); }, HttpError);
+    auto const requests = server.requests();
+    EXPECT_EQ(std::ranges::count(requests, "/second", &HttpRequest::path), 1);
+
+    // The connection can still be used afterwards.
+    EXPECT_EQ(connection.send(HttpRequest{ "POST", "/third", {}, {} }).body, "/third");
+}
+
+TEST(HttpTests, UnreachableServerFails) {
+    auto port = std::uint16_t{};
+    {
+        auto const server = TestHttpServer{ [](std::size_t, TestHttpServer::Connection&) { } };
+        port = server.port();
+    }
+    auto connection = HttpConnection{ "127.0.0.1", port };
+    EXPECT_THROW({ std::ignore = connection.send(HttpRequest{ "GET", "/", {}, {} }); }, HttpError);
+}
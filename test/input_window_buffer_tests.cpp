@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <input_window_buffer.hpp>
+
+using AppendResult = InputWindowBuffer::AppendResult;
+
+// Last frame of the window with the given index.
+[[nodiscard]] static u64 window_frame(u64 const window_index) {
+    return (window_index + 1) * heartbeat_interval - 1;
+}
+
+// Window whose key states encode the id in binary.
+[[nodiscard]] static InputWindowBuffer::Window window_with_id(u64 const id) {
+    auto window = InputWindowBuffer::Window{};
+    for (auto i = usize{ 0 }; i < window.size(); ++i) {
+        window.at(i).set(Key::Left, ((id >> i) & 1) != 0);
+    }
+    return window;
+}
+
+TEST(InputWindowBufferTests, WindowsAreAppendedInOrder) {
+    auto buffer = InputWindowBuffer{};
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.try_append(window_frame(0), window_with_id(0)), AppendResult::Appended);
+    EXPECT_EQ(buffer.try_append(window_frame(1), window_with_id(1)), AppendResult::Appended);
+    EXPECT_EQ(buffer.size(), 2);
+    EXPECT_EQ(buffer.num_received_key_states(), 2 * heartbeat_interval);
+
+    EXPECT_EQ(buffer.front(), window_with_id(0));
+    buffer.pop_front();
+    EXPECT_EQ(buffer.front(), window_with_id(1));
+    buffer.pop_front();
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.num_received_key_states(), 2 * heartbeat_interval);
+}
+
+TEST(InputWindowBufferTests, MisalignedFramesAreRejected) {
+    auto buffer = InputWindowBuffer{};
+    EXPECT_EQ(buffer.try_append(0, {}), AppendResult::Misaligned);
+    EXPECT_EQ(buffer.try_append(window_frame(0) - 1, {}), AppendResult::Misaligned);
+    EXPECT_EQ(buffer.try_append(window_frame(0) + 1, {}), AppendResult::Misaligned);
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.num_received_key_states(), 0);
+}
+
+TEST(InputWindowBufferTests, OutdatedWindowsAreRejected) {
+    auto buffer = InputWindowBuffer{};
+    ASSERT_EQ(buffer.try_append(window_frame(0), window_with_id(0)), AppendResult::Appended);
+    ASSERT_EQ(buffer.try_append(window_frame(1), window_with_id(1)), AppendResult::Appended);
+    EXPECT_EQ(buffer.try_append(window_frame(0), window_with_id(2)), AppendResult::Outdated);
+    EXPECT_EQ(buffer.try_append(window_frame(1), window_with_id(2)), AppendResult::Outdated);
+
+    // Windows stay outdated after they have been consumed.
+    buffer.pop_front();
+    EXPECT_EQ(buffer.try_append(window_frame(0), window_with_id(2)), AppendResult::Outdated);
+    EXPECT_EQ(buffer.size(), 1);
+    EXPECT_EQ(buffer.front(), window_with_id(1));
+}
+
+TEST(InputWindowBufferTests, WindowsAfterAGapAreRejected) {
+    auto buffer = InputWindowBuffer{};
+    EXPECT_EQ(buffer.try_append(window_frame(1), {}), AppendResult::TooFarAhead);
+    ASSERT_EQ(buffer.try_append(window_frame(0), {}), AppendResult::Appended);
+    EXPECT_EQ(buffer.try_append(window_frame(2), {}), AppendResult::TooFarAhead);
+    EXPECT_EQ(buffer.try_append(window_frame(1), {}), AppendResult::Appended);
+}
+
+TEST(InputWindowBufferTests, FullBufferDelaysWindows) {
+    auto buffer = InputWindowBuffer{};
+    for (auto i = usize{ 0 }; i < InputWindowBuffer::capacity; ++i) {
+        ASSERT_EQ(buffer.try_append(window_frame(i), window_with_id(i)), AppendResult::Appended);
+    }
+    EXPECT_TRUE(buffer.is_full());
+    auto const next_frame = window_frame(InputWindowBuffer::capacity);
+    EXPECT_EQ(buffer.try_append(next_frame, window_with_id(42)), AppendResult::Full);
+
+    // The other checks take precedence.
+    EXPECT_EQ(buffer.try_append(window_frame(0), {}), AppendResult::Outdated);
+    EXPECT_EQ(buffer.try_append(next_frame + heartbeat_interval, {}), AppendResult::TooFarAhead);
+    EXPECT_EQ(buffer.try_append(next_frame + 1, {}), AppendResult::Misaligned);
+    EXPECT_EQ(buffer.num_received_key_states(), InputWindowBuffer::capacity * heartbeat_interval);
+
+    buffer.pop_front();
+    EXPECT_EQ(buffer.try_append(next_frame, window_with_id(42)), AppendResult::Appended);
+    EXPECT_TRUE(buffer.is_full());
+}
+
+TEST(InputWindowBufferTests, WindowsWrapAroundAtCapacity) {
+    static_assert(InputWindowBuffer::capacity == 16);
+    auto buffer = InputWindowBuffer{};
+    auto next_to_append = usize{ 0 };
+    auto next_to_pop = usize{ 0 };
+    // Keeps a varying number of windows in the buffer while its start moves around the ring several times.
+    for (auto round = usize{ 0 }; round < 10; ++round) {
+        auto const num_windows = round % 2 == 0 ? InputWindowBuffer::capacity : round + 1;
+        while (buffer.size() < num_windows) {
+            ASSERT_EQ(
+                buffer.try_append(window_frame(next_to_append), window_with_id(next_to_append)),
+                AppendResult::Appended
+            );
+            ++next_to_append;
+        }
+        while (buffer.size() > num_windows / 2) {
+            ASSERT_EQ(buffer.front(), window_with_id(next_to_pop));
+            buffer.pop_front();
+            ++next_to_pop;
+        }
+    }
+    EXPECT_GT(next_to_pop, 3 * InputWindowBuffer::capacity);
+    while (not buffer.empty()) {
+        EXPECT_EQ(buffer.front(), window_with_id(next_to_pop));
+        buffer.pop_front();
+        ++next_to_pop;
+    }
+    EXPECT_EQ(next_to_pop, next_to_append);
+    EXPECT_EQ(buffer.num_received_key_states(), next_to_append * heartbeat_interval);
+}
+
+TEST(InputWindowBufferTests, BufferCanStartInTheMiddleOfAMatch) {
+    auto buffer = InputWindowBuffer{ 10 * heartbeat_interval };
+    EXPECT_EQ(buffer.try_append(window_frame(9), {}), AppendResult::Outdated);
+    EXPECT_EQ(buffer.try_append(window_frame(11), {}), AppendResult::TooFarAhead);
+    EXPECT_EQ(buffer.try_append(window_frame(10), {}), AppendResult::Appended);
+    EXPECT_EQ(buffer.num_received_key_states(), 11 * heartbeat_interval);
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <input_source.hpp>
+#include <latency_histogram.hpp>
+#include <memory>
+#include <server.hpp>
+#include <string>
+#include <synthetic_client.hpp>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST(LoadGeneratorTests, EmptyHistogramHasNoPercentiles) {
+    auto const histogram = LatencyHistogram{};
+    EXPECT_EQ(histogram.num_samples(), 0);
+    EXPECT_EQ(histogram.percentile(50.0), 0us);
+    EXPECT_EQ(histogram.percentile(100.0), 0us);
+}
+
+TEST(LoadGeneratorTests, SmallLatenciesAreExact) {
+    auto histogram = LatencyHistogram{};
+    for (auto microseconds = 0; microseconds < 16; ++microseconds) {
+        histogram.record(std::chrono::microseconds{ microseconds });
+    }
+    EXPECT_EQ(histogram.num_samples(), 16);
+    EXPECT_EQ(histogram.percentile(0.0), 0us);
+    EXPECT_EQ(histogram.percentile(50.0), 7us);
+    EXPECT_EQ(histogram.percentile(100.0), 15us);
+    EXPECT_EQ(histogram.max(), 15us);
+}
+
+TEST(LoadGeneratorTests, PercentilesStayWithinTheRelativeError) {
+    auto histogram = LatencyHistogram{};
+    auto latencies = std::vector<std::chrono::microseconds>{};
+    // Roughly exponentially distributed, like network latencies.
+    for (auto i = 0; i < 10'000; ++i) {
+        latencies.emplace_back(static_cast<std::chrono::microseconds::rep>(std::exp(i / 1'000.0) * 100.0));
+        histogram.record(latencies.back());
+    }
+    std::ranges::sort(latencies);
+    for (auto const percentile : { 1.0, 50.0, 90.0, 99.0, 99.9 }) {
+        auto const num_latencies = static_cast<double>(latencies.size());
+        auto const rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * num_latencies));
+        auto const exact = latencies.at(rank - 1);
+        auto const estimate = histogram.percentile(percentile);
+        EXPECT_GE(estimate, exact) << "p" << percentile;
+        EXPECT_LE(estimate.count(), exact.count() + exact.count() / 16) << "p" << percentile;
+    }
+    EXPECT_EQ(histogram.percentile(100.0), latencies.back());
+    EXPECT_EQ(histogram.max(), latencies.back());
+}
+
+TEST(LoadGeneratorTests, MergedHistogramMatchesSingleHistogram) {
+    auto combined = LatencyHistogram{};
+    auto first = LatencyHistogram{};
+    auto second = LatencyHistogram{};
+    for (auto i = 0; i < 1'000; ++i) {
+        auto const latency = std::chrono::microseconds{ (i * 7919) % 50'000 };
+        combined.record(latency);
+        (i % 3 == 0 ? first : second).record(latency);
+    }
+    first.merge(second);
+    EXPECT_EQ(first.num_samples(), combined.num_samples());
+    EXPECT_EQ(first.max(), combined.max());
+    for (auto const percentile : { 10.0, 50.0, 99.0, 100.0 }) {
+        EXPECT_EQ(first.percentile(percentile), combined.percentile(percentile)) << "p" << percentile;
+    }
+}
+
+TEST(LoadGeneratorTests, HugeLatenciesAreClampedToTheMaximum) {
+    auto histogram = LatencyHistogram{};
+    histogram.record(1ms);
+    histogram.record(std::chrono::hours{ 2 });
+    histogram.record(-1ms);
+    EXPECT_EQ(histogram.num_samples(), 3);
+    EXPECT_EQ(histogram.percentile(10.0), 0us);
+    EXPECT_EQ(histogram.percentile(100.0), std::chrono::hours{ 2 });
+}
+
+TEST(LoadGeneratorTests, ScriptIsPlayedBackInALoop) {
+    auto script = InputScript{};
+    for (auto const key : { Key::Left, Key::Right, Key::Drop }) {
+        script.push_back(KeyState{}.set(key));
+    }
+    auto inputs = InputSource::scripted(std::make_shared<InputScript const>(script), 1);
+    for (auto i = std::size_t{ 1 }; i < 10; ++i) {
+        EXPECT_EQ(inputs.next(), script.at(i % script.size()));
+    }
+}
+
+TEST(LoadGeneratorTests, RandomInputsDependOnTheSeedOnly) {
+    auto first = InputSource::random(42);
+    auto second = InputSource::random(42);
+    auto other = InputSource::random(43);
+    auto num_differences = 0;
+    auto num_changes = 0;
+    auto previous = KeyState{};
+    for (auto i = 0; i < 1'000; ++i) {
+        auto const key_state = first.next();
+        EXPECT_EQ(key_state, second.next());
+        num_differences += (key_state == other.next() ? 0 : 1);
+        num_changes += (key_state == previous ? 0 : 1);
+        previous = key_state;
+    }
+    EXPECT_GT(num_differences, 0);
+    // Keys are held for several frames.
+    EXPECT_GT(num_changes, 1'000 / 20);
+    EXPECT_LT(num_changes, 1'000 / 2);
+}
+
+TEST(LoadGeneratorTests, SyntheticClientsMeasureTheBroadcastLatency) {
+    static constexpr auto num_windows = u64{ 20 };
+    auto server = Server{};
+    server.start_match(2);
+    auto clients = std::vector<std::unique_ptr<SyntheticClient>>{};
+    for (auto i = u64{ 0 }; i < 2; ++i) {
+        clients.push_back(std::make_unique<SyntheticClient>(
+            "127.0.0.1",
+            server.port(),
+            "player " + std::to_string(i),
+            InputSource::random(i)
+        ));
+    }
+
+    auto const deadline = std::chrono::steady_clock::now() + 10s;
+    auto const has_started = [](std::unique_ptr<SyntheticClient> const& client) { return client->has_started(); };
+    while (not std::ranges::all_of(clients, has_started) and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_TRUE(std::ranges::all_of(clients, has_started));
+
+    for (auto frame = u64{ 0 }; frame < num_windows * heartbeat_interval; ++frame) {
+        for (auto const& client : clients) {
+            client->tick(std::chrono::steady_clock::now());
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    auto const has_received_all = [](std::unique_ptr<SyntheticClient> const& client) {
+        return client->num_broadcasts() >= num_windows;
+    };
+    while (not std::ranges::all_of(clients, has_received_all) and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    for (auto const& client : clients) {
+        EXPECT_TRUE(client->is_connected());
+        EXPECT_GE(client->num_broadcasts(), num_windows);
+        // Every window that has been sent is answered by a broadcast.
+        auto const latencies = client->latencies();
+        EXPECT_EQ(latencies.num_samples(), num_windows);
+        EXPECT_GT(latencies.max(), 0us);
+        EXPECT_LT(latencies.max(), 10s);
+    }
+}
@@ -0,0 +1,347 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <future>
+#include <lobby_backend.hpp>
+#include <mutex>
+#include <network/http_server.hpp>
+#include <network/lobby_protocol.hpp>
+#include <network/lobby_server.hpp>
+#include <network/match_starter.hpp>
+#include <sockets/sockets.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Runs the local lobby server and records how the lobby list requests have been answered.
+class LocalLobbyServer final {
+public:
+    enum class LobbyListResponse {
+        NotModified,
+        Full,
+        Delta,
+    };
+
+private:
+    MatchStarter m_match_starter{ 0 };
+    LobbyBackend m_backend{ m_match_starter };
+    std::mutex m_mutex;
+    std::vector<LobbyListResponse> m_lobby_list_responses;
+    std::atomic_bool m_supports_deltas = true;
+    HttpServer m_server{ 0, [this](HttpRequest const& request) { return handle(request); } };
+
+public:
+    [[nodiscard]] std::uint16_t port() const {
+        return m_server.port();
+    }
+
+    [[nodiscard]] MatchStarter& match_starter() {
+        return m_match_starter;
+    }
+
+    // Emulates a lobby server that ignores the revision of the client's list.
+    void set_supports_deltas(bool const supports_deltas) {
+        m_supports_deltas = supports_deltas;
+    }
+
+    [[nodiscard]] std::vector<LobbyListResponse> lobby_list_responses() {
+        auto const lock = std::scoped_lock{ m_mutex };
+        return m_lobby_list_responses;
+    }
+
+private:
+    [[nodiscard]] HttpResponse handle(HttpRequest request) {
+        auto const is_lobby_list_request = request.method == "GET" and request.path.starts_with("/lobbies")
+                                           and not request.path.starts_with("/lobbies/");
+        if (not is_lobby_list_request) {
+            return m_backend.handle(request);
+        }
+        if (not m_supports_deltas) {
+            request.path = "/lobbies";
+        }
+        auto response = m_backend.handle(request);
+        auto const lock = std::scoped_lock{ m_mutex };
+        if (response.status == HttpStatus::NotModified) {
+            m_lobby_list_responses.push_back(LobbyListResponse::NotModified);
+        } else {
+            auto const update = nlohmann::json::parse(response.body).get<LobbyListUpdate>();
+            m_lobby_list_responses.push_back(update.is_delta ? LobbyListResponse::Delta : LobbyListResponse::Full);
+        }
+        return response;
+    }
+};
+
+using enum LocalLobbyServer::LobbyListResponse;
+
+static void expect_same_lobbies(LobbyList const& actual, LobbyList const& expected) {
+    ASSERT_EQ(actual.lobbies.size(), expected.lobbies.size());
+    for (auto i = std::size_t{ 0 }; i < actual.lobbies.size(); ++i) {
+        auto const& actual_lobby = actual.lobbies.at(i);
+        auto const& expected_lobby = expected.lobbies.at(i);
+        EXPECT_EQ(actual_lobby.id, expected_lobby.id);
+        EXPECT_EQ(actual_lobby.name, expected_lobby.name);
+        EXPECT_EQ(actual_lobby.size, expected_lobby.size);
+        EXPECT_EQ(actual_lobby.num_players_in_lobby, expected_lobby.num_players_in_lobby);
+        EXPECT_EQ(actual_lobby.host_info.id, expected_lobby.host_info.id);
+        EXPECT_EQ(actual_lobby.host_info.name, expected_lobby.host_info.name);
+    }
+}
+
+// Lobby list as it would be fetched by a client that has not cached it yet.
+[[nodiscard]] static LobbyList full_lobby_list(LocalLobbyServer const& server) {
+    auto connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    return connection.lobbies();
+}
+
+[[nodiscard]] static User register_user(LobbyServerConnection& connection, std::string name) {
+    auto user = connection.register_user(std::move(name), "password");
+    if (not user.has_value()) {
+        throw std::runtime_error{ "unable to register user" };
+    }
+    return std::move(user).value();
+}
+
+[[nodiscard]] static Lobby create_lobby(LobbyServerConnection& connection, User const& host, std::string name) {
+    auto lobby = connection.create_lobby(host, LobbySettings{ std::move(name), 4 });
+    if (not lobby.has_value()) {
+        throw std::runtime_error{ "unable to create lobby" };
+    }
+    return std::move(lobby).value();
+}
+
+TEST(LobbyTests, UnchangedLobbyListIsNotSentAgain) {
+    auto server = LocalLobbyServer{};
+    auto connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto const host = register_user(connection, "host");
+    std::ignore = create_lobby(connection, host, "lobby");
+
+    auto const first = connection.lobbies();
+    ASSERT_EQ(first.lobbies.size(), 1);
+    EXPECT_EQ(first.lobbies.front().name, "lobby");
+    EXPECT_EQ(first.lobbies.front().num_players_in_lobby, 1);
+    auto const second = connection.lobbies();
+    expect_same_lobbies(second, first);
+    expect_same_lobbies(connection.lobbies(), first);
+    EXPECT_EQ(server.lobby_list_responses(), (std::vector{ Full, NotModified, NotModified }));
+}
+
+TEST(LobbyTests, EmptyLobbyList) {
+    auto server = LocalLobbyServer{};
+    auto connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    EXPECT_TRUE(connection.lobbies().lobbies.empty());
+    EXPECT_TRUE(connection.lobbies().lobbies.empty());
+    EXPECT_EQ(server.lobby_list_responses(), (std::vector{ Full, NotModified }));
+}
+
+TEST(LobbyTests, DeltasAreMergedIntoTheCachedList) {
+    auto server = LocalLobbyServer{};
+    auto actions = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto const hosts = std::vector{
+        register_user(actions, "host 1"),
+        register_user(actions, "host 2"),
+        register_user(actions, "host 3"),
+    };
+    std::ignore = create_lobby(actions, hosts.at(0), "first");
+    auto second = create_lobby(actions, hosts.at(1), "second");
+    std::ignore = create_lobby(actions, hosts.at(2), "third");
+
+    auto browser = LobbyServerConnection{ "127.0.0.1", server.port() };
+    ASSERT_EQ(browser.lobbies().lobbies.size(), 3);
+
+    // Removes a lobby, changes one and adds another one.
+    ASSERT_TRUE(actions.destroy_lobby(hosts.at(1), std::move(second)).has_value());
+    auto const guest = register_user(actions, "guest");
+    auto const first_info = full_lobby_list(server).lobbies.front();
+    ASSERT_TRUE(actions.join(guest, first_info).has_value());
+    auto const new_host = register_user(actions, "host 4");
+    std::ignore = create_lobby(actions, new_host, "fourth");
+
+    auto const merged = browser.lobbies();
+    ASSERT_EQ(merged.lobbies.size(), 3);
+    // The changed lobby keeps its position.
+    EXPECT_EQ(merged.lobbies.at(0).name, "first");
+    EXPECT_EQ(merged.lobbies.at(0).num_players_in_lobby, 2);
+    EXPECT_EQ(merged.lobbies.at(1).name, "third");
+    EXPECT_EQ(merged.lobbies.at(2).name, "fourth");
+    expect_same_lobbies(merged, full_lobby_list(server));
+
+    expect_same_lobbies(browser.lobbies(), merged);
+    auto const responses = server.lobby_list_responses();
+    ASSERT_GE(responses.size(), 3);
+    EXPECT_EQ(responses.at(responses.size() - 3), Delta);  // The browser's merged list.
+    EXPECT_EQ(responses.back(), NotModified);
+}
+
+TEST(LobbyTests, CachedListMatchesFullListAfterManyChanges) {
+    auto server = LocalLobbyServer{};
+    auto actions = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto browser = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto hosts = std::vector<User>{};
+    auto lobbies = std::vector<Lobby>{};
+    for (auto i = 0; i < 8; ++i) {
+        hosts.push_back(register_user(actions, std::format("host {}", i)));
+        lobbies.push_back(create_lobby(actions, hosts.back(), std::format("lobby {}", i)));
+        if (i % 3 == 2) {
+            // Removes the lobby that has been created first of the remaining ones.
+            auto const index = static_cast<std::size_t>(i - 2);
+            ASSERT_TRUE(actions.destroy_lobby(hosts.at(index), std::move(lobbies.at(index))).has_value());
+        }
+        if (i % 2 == 1) {
+            auto const guest = register_user(actions, std::format("guest {}", i));
+            auto const lobby_info = full_lobby_list(server).lobbies.front();
+            ASSERT_TRUE(actions.join(guest, lobby_info).has_value());
+        }
+        expect_same_lobbies(browser.lobbies(), full_lobby_list(server));
+    }
+    expect_same_lobbies(browser.lobbies(), full_lobby_list(server));
+}
+
+TEST(LobbyTests, FallsBackToFullListIfServerDoesNotSendDeltas) {
+    auto server = LocalLobbyServer{};
+    auto actions = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto const first_host = register_user(actions, "host 1");
+    auto const second_host = register_user(actions, "host 2");
+    auto first = create_lobby(actions, first_host, "first");
+
+    auto browser = LobbyServerConnection{ "127.0.0.1", server.port() };
+    ASSERT_EQ(browser.lobbies().lobbies.size(), 1);
+
+    server.set_supports_deltas(false);
+    ASSERT_TRUE(actions.destroy_lobby(first_host, std::move(first)).has_value());
+    std::ignore = create_lobby(actions, second_host, "second");
+    auto const lobby_list = browser.lobbies();
+    ASSERT_EQ(lobby_list.lobbies.size(), 1);
+    EXPECT_EQ(lobby_list.lobbies.front().name, "second");
+    EXPECT_EQ(server.lobby_list_responses().back(), Full);
+
+    // Deltas are used again once the server supports them.
+    server.set_supports_deltas(true);
+    auto const third_host = register_user(actions, "host 3");
+    std::ignore = create_lobby(actions, third_host, "third");
+    auto const merged = browser.lobbies();
+    EXPECT_EQ(server.lobby_list_responses().back(), Delta);
+    expect_same_lobbies(merged, full_lobby_list(server));
+}
+
+TEST(LobbyTests, UsersCanRegisterLogInAndUnregister) {
+    auto server = LocalLobbyServer{};
+    auto connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto user = register_user(connection, "player");
+    EXPECT_FALSE(connection.register_user("player", "other password").has_value());
+    EXPECT_FALSE(connection.authenticate("player", "wrong password").has_value());
+    EXPECT_FALSE(connection.authenticate("someone else", "password").has_value());
+    auto const second_session = connection.authenticate("player", "password");
+    ASSERT_TRUE(second_session.has_value());
+
+    connection.unregister(user);
+    EXPECT_FALSE(connection.authenticate("player", "password").has_value());
+    // All sessions of the user have ended.
+    EXPECT_FALSE(connection.create_lobby(second_session.value(), LobbySettings{ "lobby", 2 }).has_value());
+    EXPECT_TRUE(full_lobby_list(server).lobbies.empty());
+    // The name can be used again.
+    std::ignore = register_user(connection, "player");
+}
+
+TEST(LobbyTests, LobbiesCanBeJoinedUntilTheyAreFull) {
+    auto server = LocalLobbyServer{};
+    auto connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto const host = register_user(connection, "host");
+    auto const guest = register_user(connection, "guest");
+    auto const latecomer = register_user(connection, "latecomer");
+    auto lobby = connection.create_lobby(host, LobbySettings{ "lobby", 2 });
+    ASSERT_TRUE(lobby.has_value());
+    auto const second_lobby = connection.create_lobby(host, LobbySettings{ "second lobby", 2 });
+    ASSERT_FALSE(second_lobby.has_value());
+    EXPECT_EQ(second_lobby.error(), LobbyCreationError::AlreadyJoined);
+
+    auto const lobby_info = full_lobby_list(server).lobbies.at(0);
+    auto guest_lobby = connection.join(guest, lobby_info);
+    ASSERT_TRUE(guest_lobby.has_value());
+    auto const full = connection.join(latecomer, lobby_info);
+    ASSERT_FALSE(full.has_value());
+    EXPECT_EQ(full.error(), LobbyJoinError::LobbyFullOrAlreadyJoined);
+
+    auto const details = connection.lobby_details(latecomer, lobby_info);
+    ASSERT_TRUE(details.has_value());
+    EXPECT_EQ(details->name, "lobby");
+    EXPECT_EQ(details->size, 2);
+    EXPECT_EQ(details->host_info.name, "host");
+    ASSERT_EQ(details->client_infos.size(), 2);
+    EXPECT_EQ(details->client_infos.at(0).name, "host");
+    EXPECT_TRUE(details->client_infos.at(0).is_ready);
+    EXPECT_EQ(details->client_infos.at(1).name, "guest");
+    EXPECT_FALSE(details->client_infos.at(1).is_ready);
+
+    auto const not_destroyed = connection.destroy_lobby(guest, std::move(guest_lobby).value());
+    ASSERT_FALSE(not_destroyed.has_value());
+    EXPECT_EQ(not_destroyed.error(), LobbyDestructionError::IsNotHost);
+    ASSERT_TRUE(connection.destroy_lobby(host, std::move(lobby).value()).has_value());
+    auto const closed = connection.lobby_details(guest, lobby_info);
+    ASSERT_FALSE(closed.has_value());
+    EXPECT_EQ(closed.error(), LobbyDetailsError::LobbyNotFoundOrClosed);
+    EXPECT_TRUE(full_lobby_list(server).lobbies.empty());
+}
+
+TEST(LobbyTests, ReadyPlayersLearnThePortOnceTheHostStartsTheMatch) {
+    static constexpr auto game_server_port = std::uint16_t{ 4242 };
+    // Declared before the server, which closes the connection to the supervisor if the match is never started.
+    auto requested_num_players = std::future<std::uint16_t>{};
+    auto server = LocalLobbyServer{};
+    // Stands in for a game server supervisor and answers a single request.
+    auto supervisor = c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, "127.0.0.1", server.match_starter().port());
+    requested_num_players = std::async(std::launch::async, [supervisor = std::move(supervisor)]() mutable {
+        auto const num_players = supervisor.receive<std::uint16_t>().get();
+        std::ignore = supervisor.send(game_server_port).get();
+        return num_players;
+    });
+    while (server.match_starter().num_supervisors() == 0) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    auto host_connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto guest_connection = LobbyServerConnection{ "127.0.0.1", server.port() };
+    auto const host = register_user(host_connection, "host");
+    auto const guest = register_user(guest_connection, "guest");
+    auto const lobby = create_lobby(host_connection, host, "lobby");
+    auto const lobby_info = full_lobby_list(server).lobbies.at(0);
+    auto const guest_lobby = guest_connection.join(guest, lobby_info);
+    ASSERT_TRUE(guest_lobby.has_value());
+
+    auto const too_early = host_connection.start(host, lobby);
+    ASSERT_FALSE(too_early.has_value());
+    EXPECT_EQ(too_early.error(), GameStartError::NotAllPlayersReady);
+    auto const not_host = guest_connection.start(guest, guest_lobby.value());
+    ASSERT_FALSE(not_host.has_value());
+    EXPECT_EQ(not_host.error(), GameStartError::IsNotHost);
+
+    // Setting the guest ready only returns once the match has started.
+    auto guest_port = std::async(std::launch::async, [&guest_connection, &guest, &guest_lobby] {
+        return guest_connection.set_ready(guest, guest_lobby.value());
+    });
+    auto const is_guest_ready = [&host_connection, &host, &lobby_info] {
+        auto const details = host_connection.lobby_details(host, lobby_info);
+        return details.has_value() and details->client_infos.at(1).is_ready;
+    };
+    while (not is_guest_ready()) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(guest_port.wait_for(100ms), std::future_status::timeout);
+
+    auto const host_port = host_connection.start(host, lobby);
+    ASSERT_TRUE(host_port.has_value());
+    EXPECT_EQ(std::to_underlying(host_port.value()), game_server_port);
+    auto const port = guest_port.get();
+    ASSERT_TRUE(port.has_value());
+    EXPECT_EQ(std::to_underlying(port.value()), game_server_port);
+    EXPECT_EQ(requested_num_players.get(), 2);
+
+    auto const started_again = host_connection.start(host, lobby);
+    ASSERT_FALSE(started_again.has_value());
+    EXPECT_EQ(started_again.error(), GameStartError::AlreadyRunning);
+}
@@ -0,0 +1,25 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <optional>
+#include <simulator/log_rate_limiter.hpp>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST(LogRateLimiterTests, SuppressesMessagesAboveTheLimit) {
+    auto limiter = LogRateLimiter{ 1h, 2 };
+    EXPECT_EQ(limiter.try_acquire(), std::optional<u64>{ 0 });
+    EXPECT_EQ(limiter.try_acquire(), std::optional<u64>{ 0 });
+    EXPECT_EQ(limiter.try_acquire(), std::nullopt);
+    EXPECT_EQ(limiter.try_acquire(), std::nullopt);
+}
+
+TEST(LogRateLimiterTests, ReportsSuppressedMessagesInTheNextInterval) {
+    auto limiter = LogRateLimiter{ 50ms, 1 };
+    EXPECT_EQ(limiter.try_acquire(), std::optional<u64>{ 0 });
+    EXPECT_EQ(limiter.try_acquire(), std::nullopt);
+    EXPECT_EQ(limiter.try_acquire(), std::nullopt);
+    std::this_thread::sleep_for(60ms);
+    EXPECT_EQ(limiter.try_acquire(), std::optional<u64>{ 2 });
+    EXPECT_EQ(limiter.try_acquire(), std::nullopt);
+}
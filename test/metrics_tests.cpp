@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <metrics.hpp>
+#include <string>
+
+TEST(MetricsTests, HistogramCountsCumulatively) {
+    auto histogram = Histogram{ { 1.0, 2.0, 4.0 } };
+    histogram.observe(0.5);
+    histogram.observe(1.0);  // Upper bounds are inclusive.
+    histogram.observe(3.0);
+    histogram.observe(10.0);
+    histogram.observe(std::chrono::milliseconds{ 1500 });
+
+    EXPECT_EQ(histogram.cumulative_count(0), 2);
+    EXPECT_EQ(histogram.cumulative_count(1), 3);
+    EXPECT_EQ(histogram.cumulative_count(2), 4);
+    EXPECT_EQ(histogram.cumulative_count(3), 5);
+    EXPECT_EQ(histogram.count(), 5);
+    EXPECT_DOUBLE_EQ(histogram.sum(), 16.0);
+}
+
+TEST(MetricsTests, WriterGroupsSamplesByMetric) {
+    auto histogram = Histogram{ { 0.5 } };
+    histogram.observe(0.25);
+
+    auto writer = MetricsWriter{};
+    writer.counter("requests_total", "Number of requests.", R"(port="1")", 3);
+    writer.histogram("latency_seconds", "Latency.", "", histogram);
+    writer.counter("requests_total", "Number of requests.", R"(port="2")", 5);
+
+    auto const expected = std::string{
+        "# HELP requests_total Number of requests.\n"
+        "# TYPE requests_total counter\n"
+        "requests_total{port=\"1\"} 3\n"
+        "requests_total{port=\"2\"} 5\n"
+        "# HELP latency_seconds Latency.\n"
+        "# TYPE latency_seconds histogram\n"
+        "latency_seconds_bucket{le=\"0.5\"} 1\n"
+        "latency_seconds_bucket{le=\"+Inf\"} 1\n"
+        "latency_seconds_sum 0.25\n"
+        "latency_seconds_count 1\n"
+    };
+    EXPECT_EQ(writer.text(), expected);
+}
+
+TEST(MetricsTests, RegistryDropsDestroyedMatches) {
+    auto registry = MetricsRegistry{};
+    auto metrics = std::make_shared<ServerMetrics>();
+    metrics->on_message_sent(MessageType::StateBroadcast, 42);
+    registry.add(R"(port="1234")", metrics);
+
+    auto const text = registry.text();
+    EXPECT_NE(text.find("obpf_server_sent_bytes_total{port=\"1234\",type=\"StateBroadcast\"} 42\n"), std::string::npos);
+    EXPECT_NE(registry.handle(HttpRequest{ "GET", "/metrics", {}, {} }).body.find("port=\"1234\""), std::string::npos);
+
+    metrics.reset();
+    EXPECT_EQ(registry.text().find("port=\"1234\""), std::string::npos);
+    EXPECT_EQ(registry.handle(HttpRequest{ "GET", "/", {}, {} }).status, HttpStatus::NotFound);
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <network/messages.hpp>
+#include <network/simulated_network.hpp>
+#include <simulator/multiplayer_tetrion.hpp>
+#include <simulator/observer_tetrion.hpp>
+#include <simulator/tetrion.hpp>
+#include <span>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using Window = std::array<KeyState, heartbeat_interval>;
+
+static constexpr auto seed = u64{ 42 };
+static constexpr auto start_frame = u64{ 0 };
+static constexpr auto own_name = "player";
+static constexpr auto opponent_name = "opponent";
+
+// A single client playing against one opponent. The test plays the server, i.e. it decides which key states are
+// broadcast for both of them.
+class LocalMatch final {
+private:
+    SimulatedNetwork m_network{ 0 };
+    std::unique_ptr<SimulatedConnection> m_server_connection;
+    std::unique_ptr<MultiplayerTetrion> m_tetrion;
+    u64 m_next_broadcast_frame = heartbeat_interval - 1;
+
+public:
+    LocalMatch() {
+        auto [client_connection, server_connection] = m_network.connect(LinkModel{}, LinkModel{});
+        m_server_connection = std::move(server_connection);
+        auto const game_start = GameStart{
+            0,
+            start_frame,
+            seed,
+            { ClientIdentity{ 0, own_name }, ClientIdentity{ 1, opponent_name } },
+        };
+        m_tetrion = MultiplayerTetrion::start(std::move(client_connection), game_start, own_name);
+    }
+
+    [[nodiscard]] MultiplayerTetrion& tetrion() {
+        return *m_tetrion;
+    }
+
+    [[nodiscard]] ObserverTetrion& opponent() {
+        return *m_tetrion->get_observers().at(0);
+    }
+
+    // The broadcast is processed by the client when it simulates its next frame.
+    void broadcast(Window const& own_key_states, Window const& opponent_key_states) {
+        auto const message = StateBroadcast{
+            m_next_broadcast_frame,
+            { { 0, own_key_states }, { 1, opponent_key_states } },
+        };
+        m_server_connection->send(message.serialize());
+        m_network.advance(1ms);
+        m_next_broadcast_frame += heartbeat_interval;
+    }
+};
+
+// Key states that change within every window, so that predicting the last key state of the previous window is wrong.
+[[nodiscard]] static Window changing_key_states(u64 const window_index) {
+    auto result = Window{};
+    for (auto i = usize{ 0 }; i < result.size(); ++i) {
+        switch ((window_index + i / 5) % 3) {
+            case 0:
+                result.at(i).set(Key::Left);
+                break;
+            case 1:
+                result.at(i).set(Key::Right);
+                break;
+            default:
+                break;
+        }
+        result.at(i).set(Key::RotateClockwise, (window_index + i) % 4 == 0);
+    }
+    return result;
+}
+
+static void simulate(ObpfTetrion& tetrion, std::span<KeyState const> const key_states) {
+    for (auto const key_state : key_states) {
+        std::ignore = tetrion.simulate_next_frame(key_state);
+    }
+}
+
+TEST(MultiplayerTetrionTests, MispredictedObserverMatchesConfirmedInputs) {
+    auto match = LocalMatch{};
+    // Simulated from the confirmed key states of the opponent only.
+    auto confirmed = ObpfTetrion{ seed, start_frame, opponent_name };
+    auto last_confirmed_key_state = KeyState{};
+
+    for (auto window = u64{ 0 }; window < 12; ++window) {
+        // The client is one window ahead of the broadcasts.
+        if (window > 0) {
+            auto const opponent_key_states = changing_key_states(window - 1);
+            match.broadcast(Window{}, opponent_key_states);
+            simulate(confirmed, opponent_key_states);
+            last_confirmed_key_state = opponent_key_states.back();
+        }
+        for (auto frame = usize{ 0 }; frame < heartbeat_interval; ++frame) {
+            std::ignore = match.tetrion().simulate_next_frame(KeyState{});
+        }
+
+        // The displayed observer continues the confirmed state by repeating the last confirmed key state.
+        auto expected = confirmed;
+        while (expected.next_frame() < match.tetrion().next_frame()) {
+            std::ignore = expected.simulate_next_frame(last_confirmed_key_state);
+        }
+        auto& opponent = match.opponent();
+        opponent.catch_up();
+        ASSERT_EQ(opponent.next_frame(), expected.next_frame());
+        EXPECT_EQ(opponent.state_hash(), expected.state_hash()) << "window " << window;
+    }
+    EXPECT_FALSE(confirmed.game_over_since_frame().has_value());
+}
+
+TEST(MultiplayerTetrionTests, OwnMispredictionIsRolledBack) {
+    auto match = LocalMatch{};
+    // Simulated from the key states that the server confirmed for us only.
+    auto confirmed = ObpfTetrion{ seed, start_frame, own_name };
+    auto local_key_states = std::vector<Window>{};
+
+    for (auto window = u64{ 0 }; window < 12; ++window) {
+        if (window > 0) {
+            // In every other window, the server did not get our key states in time and filled in empty ones.
+            auto const& sent = local_key_states.at(window - 1);
+            auto const used_by_server = (window % 2 == 0 ? Window{} : sent);
+            match.broadcast(used_by_server, Window{});
+            simulate(confirmed, used_by_server);
+        }
+        local_key_states.push_back(changing_key_states(window));
+        for (auto const key_state : local_key_states.back()) {
+            std::ignore = match.tetrion().simulate_next_frame(key_state);
+        }
+
+        // The local state continues the confirmed one with the key states that have not been confirmed yet.
+        auto expected = confirmed;
+        simulate(expected, local_key_states.back());
+        ASSERT_EQ(match.tetrion().next_frame(), expected.next_frame());
+        EXPECT_EQ(match.tetrion().state_hash(), expected.state_hash()) << "window " << window;
+    }
+    EXPECT_FALSE(confirmed.game_over_since_frame().has_value());
+}
+
+TEST(MultiplayerTetrionTests, RowsOfADiscardedPredictionAreDirty) {
+    auto match = LocalMatch{};
+    auto soft_drop = Window{};
+    soft_drop.fill(KeyState{}.set(Key::Down));
+    for (auto const& key_states : { Window{}, soft_drop }) {
+        for (auto frame = usize{ 0 }; frame < heartbeat_interval; ++frame) {
+            std::ignore = match.tetrion().simulate_next_frame(KeyState{});
+        }
+        // The opponent is predicted to keep soft dropping and stacks up pieces that will turn out to be wrong.
+        match.broadcast(Window{}, key_states);
+    }
+    for (auto frame = usize{ 0 }; frame < 20 * heartbeat_interval; ++frame) {
+        std::ignore = match.tetrion().simulate_next_frame(KeyState{});
+    }
+    auto& opponent = match.opponent();
+    opponent.catch_up();
+    // Plays a renderer that only redraws the dirty rows.
+    auto const rendered = opponent.matrix();
+    ASSERT_NE(rendered, Matrix{});
+    opponent.matrix().clear_dirty_rows();
+
+    match.broadcast(Window{}, Window{});
+    std::ignore = match.tetrion().simulate_next_frame(KeyState{});
+    opponent.catch_up();
+    auto const& matrix = opponent.matrix();
+    ASSERT_NE(matrix, rendered);
+    for (auto row = usize{ 0 }; row < Matrix::height; ++row) {
+        if ((matrix.dirty_rows() & (u32{ 1 } << row)) != 0) {
+            continue;
+        }
+        for (auto column = usize{ 0 }; column < Matrix::width; ++column) {
+            auto const position = Vec2{ static_cast<i32>(column), static_cast<i32>(row) };
+            EXPECT_EQ(matrix[position], rendered[position]) << "row " << row << " has changed but is not dirty";
+        }
+    }
+}
@@ -1,10 +1,14 @@
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
 #include <spdlog/spdlog.h>
+#include <deque>
 #include <gsl/gsl>
 #include <network/constants.hpp>
 #include <network/messages.hpp>
+#include <network/udp_socket.hpp>
 #include <random>
+#include <ranges>
+#include <simulator/tetrion.hpp>
 #include "utils.hpp"
 
 TEST(NetworkTests, UnknownMessageTypeFails) {
@@ -53,6 +57,16 @@ TEST(NetworkTests, RegularHeartbeatMessage) {
     EXPECT_EQ(*deserialized_heartbeat, message);
 }
 
+TEST(NetworkTests, HeartbeatMessageWithStateHash) {
+    auto const message = Heartbeat{ 44, {}, StateHash{ 30, 0x0123'4567'89AB'CDEF } };
+    auto const deserialized_message = send_receive_and_deserialize(message);
+
+    auto const deserialized_heartbeat = dynamic_cast<Heartbeat const*>(deserialized_message.get());
+    ASSERT_NE(deserialized_heartbeat, nullptr);
+    EXPECT_EQ(*deserialized_heartbeat, message);
+    EXPECT_EQ(deserialized_heartbeat->state_hash.hash, 0x0123'4567'89AB'CDEF);
+}
+
 TEST(NetworkTests, TooBigHeartbeatMessageFails) {
     auto buffer = c2k::MessageBuffer{};
     buffer << static_cast<std::uint8_t>(MessageType::Heartbeat)
@@ -62,7 +76,7 @@ TEST(NetworkTests, TooBigHeartbeatMessageFails) {
         std::ignore = send_receive_buffer_and_deserialize(buffer);
         FAIL() << "expected MessageSerializationError";
     } catch (MessageDeserializationError const& e) {
-        EXPECT_STREQ(e.what(), "message payload size 24 is too big for message type 1 (maximum is 23)");
+        EXPECT_STREQ(e.what(), "message payload size 40 is too big for message type 1 (maximum is 39)");
     } catch (...) {
         FAIL() << "expected MessageSerializationError";
     }
@@ -276,3 +290,136 @@ TEST(NetworkTests, EventBroadcastMessageWithDuplicateClientIdsFails) {
     // clang-format on
     EXPECT_THROW({ std::ignore = send_receive_buffer_and_deserialize(buffer); }, MessageDeserializationError);
 }
+
+[[nodiscard]] static Heartbeat create_heartbeat(std::uint64_t const frame) {
+    auto key_states = std::array<KeyState, heartbeat_interval>{};
+    key_states.at(frame % heartbeat_interval) = KeyState{}.set(Key::Left);
+    key_states.back() = KeyState{}.set(Key::Drop);
+    return Heartbeat{ frame, key_states, StateHash{ frame - heartbeat_interval + 1, frame * 31 } };
+}
+
+TEST(NetworkTests, RedundantHeartbeatMessage) {
+    auto const message = RedundantHeartbeat{
+        3,
+        30,
+        { create_heartbeat(44), create_heartbeat(59), create_heartbeat(74) },
+    };
+    auto const deserialized_message = send_receive_and_deserialize(message);
+    EXPECT_EQ(dynamic_cast<RedundantHeartbeat const&>(*deserialized_message), message);
+}
+
+TEST(NetworkTests, RedundantHeartbeatMessageWithNonConsecutiveWindowsFails) {
+    EXPECT_THROW(
+        (RedundantHeartbeat{ 0, 0, { create_heartbeat(14), create_heartbeat(44) } }),
+        MessageInstantiationError
+    );
+    EXPECT_THROW((RedundantHeartbeat{ 0, 0, { create_heartbeat(15) } }), MessageInstantiationError);
+}
+
+TEST(NetworkTests, RedundantStateBroadcastMessage) {
+    auto const client_states = std::vector<StateBroadcast::ClientStates>{
+        { 0, create_heartbeat(14).key_states },
+        { 1, create_heartbeat(29).key_states },
+    };
+    auto const message = RedundantStateBroadcast{
+        45,
+        { StateBroadcast{ 14, client_states }, StateBroadcast{ 29, client_states } },
+    };
+    auto const deserialized_message = send_receive_and_deserialize(message);
+    EXPECT_EQ(dynamic_cast<RedundantStateBroadcast const&>(*deserialized_message), message);
+}
+
+TEST(NetworkTests, SnapshotSubscriptionMessage) {
+    auto const message = SnapshotSubscription{ 4 };
+    auto const deserialized_message = send_receive_and_deserialize(message);
+    EXPECT_EQ(dynamic_cast<SnapshotSubscription const&>(*deserialized_message), message);
+}
+
+TEST(NetworkTests, SnapshotBroadcastMessage) {
+    auto matrix = Matrix{};
+    matrix.fill(Matrix::height - 1, TetrominoType::Garbage);
+    matrix.set(Vec2{ 3, 20 }, TetrominoType::T);
+    matrix.set(Vec2{ 9, 0 }, TetrominoType::I);
+    auto const message = SnapshotBroadcast{
+        29,
+        create_heartbeat(29).key_states,
+        { GarbageSendEvent{ 20, 2 }, GarbageSendEvent{ 27, 4 } },
+        { { 0, false, matrix }, { 2, true, Matrix{} } },
+    };
+    EXPECT_EQ(message.payload_size(), 25 + 2 * 9 + 2 * 112);
+    auto const deserialized_message = send_receive_and_deserialize(message);
+    EXPECT_EQ(dynamic_cast<SnapshotBroadcast const&>(*deserialized_message), message);
+}
+
+TEST(NetworkTests, ReconnectMessage) {
+    auto const message = Reconnect{ 3, "player 4" };
+    EXPECT_EQ(message.payload_size(), 33);
+    auto const deserialized_message = send_receive_and_deserialize(message);
+    EXPECT_EQ(dynamic_cast<Reconnect const&>(*deserialized_message), message);
+}
+
+TEST(NetworkTests, TetrionSnapshotMessage) {
+    auto tetrion = ObpfTetrion{ 42, 0 };
+    for (auto i = 0; i < 200; ++i) {
+        std::ignore = tetrion.simulate_next_frame(i % 2 == 0 ? KeyState{}.set(Key::Left) : KeyState{});
+    }
+    auto const message = TetrionSnapshot{ 1, true, tetrion.save_snapshot() };
+    auto const deserialized_message = send_receive_and_deserialize(message);
+    auto const& deserialized_snapshot = dynamic_cast<TetrionSnapshot const&>(*deserialized_message);
+    EXPECT_EQ(deserialized_snapshot, message);
+    EXPECT_EQ(ObpfTetrion::load_snapshot(deserialized_snapshot.snapshot).save_snapshot(), message.snapshot);
+}
+
+TEST(NetworkTests, DatagramWithExcessBytesFails) {
+    auto buffer = RedundantHeartbeat{ 0, 0, { create_heartbeat(14) } }.serialize();
+    buffer << std::uint8_t{ 0 };
+    EXPECT_THROW({ std::ignore = AbstractMessage::from_datagram(buffer); }, MessageDeserializationError);
+}
+
+TEST(NetworkTests, DatagramOfTcpOnlyMessageTypeFails) {
+    auto buffer = create_heartbeat(14).serialize();
+    EXPECT_THROW({ std::ignore = AbstractMessage::from_datagram(buffer); }, MessageDeserializationError);
+}
+
+TEST(NetworkTests, RedundantHeartbeatsSurvivePacketLoss) {
+    using namespace std::chrono_literals;
+    static constexpr auto num_windows = usize{ 100 };
+
+    auto sender = UdpSocket{};
+    auto receiver = UdpSocket{};
+    sender.simulate_packet_loss(0.5, 42);
+    auto const receiver_endpoint = UdpEndpoint::resolve("127.0.0.1", receiver.local_port());
+
+    auto unacknowledged = std::deque<Heartbeat>{};
+    auto received = std::vector<Heartbeat>{};
+    auto num_frames_received = std::uint64_t{ 0 };
+
+    for (auto i = usize{ 0 }; i < num_windows * 10 and received.size() < num_windows; ++i) {
+        if (i < num_windows) {
+            unacknowledged.push_back(create_heartbeat(i * heartbeat_interval + heartbeat_interval - 1));
+        }
+        auto heartbeats = unacknowledged | std::views::take(max_redundant_windows) | std::ranges::to<std::vector>();
+        sender.send_to(receiver_endpoint, RedundantHeartbeat{ 0, 0, std::move(heartbeats) }.serialize());
+
+        auto datagram = receiver.receive(10ms);
+        if (not datagram.has_value()) {
+            continue;
+        }
+        auto const message = AbstractMessage::from_datagram(datagram->buffer);
+        for (auto const& heartbeat : dynamic_cast<RedundantHeartbeat const&>(*message).heartbeats) {
+            if (heartbeat.frame + 1 - heartbeat_interval == num_frames_received) {
+                received.push_back(heartbeat);
+                num_frames_received += heartbeat_interval;
+            }
+        }
+        // The acknowledgement is passed directly to keep the test simple.
+        while (not unacknowledged.empty() and unacknowledged.front().frame < num_frames_received) {
+            unacknowledged.pop_front();
+        }
+    }
+
+    ASSERT_EQ(received.size(), num_windows);
+    for (auto i = usize{ 0 }; i < num_windows; ++i) {
+        EXPECT_EQ(received.at(i), create_heartbeat(i * heartbeat_interval + heartbeat_interval - 1));
+    }
+}
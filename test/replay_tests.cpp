@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <simulator/replay.hpp>
+#include <simulator/replay_simulation.hpp>
+#include <simulator/replay_verifier.hpp>
+#include <vector>
+
+[[nodiscard]] static std::filesystem::path temporary_replay_path(std::string_view const name) {
+    return std::filesystem::temp_directory_path() / std::format("obpf_{}.replay", name);
+}
+
+static void remove_replay(std::filesystem::path const& path) {
+    // Ignore errors since this is only cleanup (and mapped files cannot be removed on Windows).
+    auto error = std::error_code{};
+    std::filesystem::remove(path, error);
+}
+
+// Simulates a player that holds keys for a few frames at a time.
+[[nodiscard]] static std::vector<std::vector<KeyState>> create_key_states(
+    usize const num_frames,
+    usize const num_players
+) {
+    auto random = std::mt19937_64{ 42 };
+    auto result = std::vector<std::vector<KeyState>>{};
+    auto current = std::vector<KeyState>(num_players);
+    for (auto frame = usize{ 0 }; frame < num_frames; ++frame) {
+        for (auto& key_state : current) {
+            if (random() % 8 == 0) {
+                auto const key = static_cast<Key>(random() % 7);
+                key_state.set(key, not key_state.get(key));
+            }
+        }
+        result.push_back(current);
+    }
+    return result;
+}
+
+static ReplayHeader const header{
+    .seed = 1234,
+    .start_frame = 180,
+    .players = { { 0, "player 1" }, { 1, "player 2" } },
+};
+
+TEST(ReplayTests, PlaybackMatchesRecording) {
+    auto const path = temporary_replay_path("playback");
+    // 10 minutes of gameplay.
+    auto const key_states = create_key_states(10 * 60 * 60, header.players.size());
+    {
+        auto writer = ReplayWriter{ path, header };
+        for (auto frame = usize{ 0 }; frame < key_states.size(); ++frame) {
+            if (frame == 1000) {
+                writer.append_event(1, ReplayEventType::Disconnected);
+            }
+            if (frame == 1600) {
+                writer.append_event(1, ReplayEventType::Reconnected);
+            }
+            writer.append_frame(key_states.at(frame));
+        }
+    }
+    EXPECT_LT(std::filesystem::file_size(path), 16 * 1024);
+
+    auto const reader = ReplayReader{ path };
+    EXPECT_EQ(reader.header().seed, header.seed);
+    EXPECT_EQ(reader.header().start_frame, header.start_frame);
+    ASSERT_EQ(reader.header().players.size(), 2);
+    EXPECT_EQ(reader.header().players.at(1).name, "player 2");
+
+    auto playback = reader.playback();
+    auto num_frames = usize{ 0 };
+    auto events = std::vector<ReplayEvent>{};
+    while (playback.advance()) {
+        ASSERT_EQ(playback.frame(), num_frames);
+        ASSERT_TRUE(std::ranges::equal(playback.key_states(), key_states.at(num_frames)));
+        events.insert(events.end(), playback.events().begin(), playback.events().end());
+        ++num_frames;
+    }
+    EXPECT_EQ(num_frames, key_states.size());
+    EXPECT_EQ(
+        events,
+        (std::vector{
+            ReplayEvent{ 1000, 1, ReplayEventType::Disconnected },
+            ReplayEvent{ 1600, 1, ReplayEventType::Reconnected },
+        })
+    );
+    remove_replay(path);
+}
+
+TEST(ReplayTests, TruncatedReplayEndsAfterLastCompleteBlock) {
+    auto const path = temporary_replay_path("truncated");
+    auto const key_states = create_key_states(ReplayWriter::frames_per_block * 2, header.players.size());
+    {
+        auto writer = ReplayWriter{ path, header };
+        for (auto const& frame_key_states : key_states) {
+            writer.append_frame(frame_key_states);
+        }
+    }
+    // Cuts off the keyframe index (13 bytes without keyframes) and the end of the last block, as if the writer did not
+    // finish properly.
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 20);
+
+    auto const reader = ReplayReader{ path };
+    auto playback = reader.playback();
+    auto num_frames = usize{ 0 };
+    while (playback.advance()) {
+        ++num_frames;
+    }
+    EXPECT_EQ(num_frames, ReplayWriter::frames_per_block);
+    remove_replay(path);
+}
+
+TEST(ReplayTests, InvalidFileIsRejected) {
+    auto const path = temporary_replay_path("invalid");
+    {
+        auto file = std::ofstream{ path, std::ios::binary };
+        file << "definitely not a replay";
+    }
+    EXPECT_THROW({ std::ignore = ReplayReader{ path }; }, ReplayError);
+    remove_replay(path);
+}
+
+// Records a match with keyframes, taking the states of the tetrions from a re-simulation of the same key states.
+static void record_match_with_keyframes(
+    std::filesystem::path const& path,
+    std::vector<std::vector<KeyState>> const& key_states
+) {
+    auto const key_states_path = temporary_replay_path("key_states_only");
+    {
+        auto writer = ReplayWriter{ key_states_path, header };
+        for (auto const& frame_key_states : key_states) {
+            writer.append_frame(frame_key_states);
+        }
+    }
+    {
+        auto const reader = ReplayReader{ key_states_path };
+        auto simulation = ReplaySimulation{ reader };
+        auto writer = ReplayWriter{ path, header };
+        for (auto const& frame_key_states : key_states) {
+            if (writer.wants_keyframe()) {
+                auto const tetrions = simulation.tetrions() | std::views::transform([](PlayerTetrion const& tetrion) {
+                                          return ReplayKeyframeTetrion{ &tetrion, true };
+                                      })
+                                      | std::ranges::to<std::vector>();
+                writer.append_keyframe(tetrions);
+            }
+            writer.append_frame(frame_key_states);
+            ASSERT_TRUE(simulation.simulate_next_frame());
+        }
+    }
+    remove_replay(key_states_path);
+}
+
+TEST(ReplayTests, SeekingRestoresTheNearestKeyframe) {
+    auto const path = temporary_replay_path("seeking");
+    // 3 minutes of gameplay.
+    auto const key_states = create_key_states(3 * 60 * 60, header.players.size());
+    record_match_with_keyframes(path, key_states);
+
+    auto const reader = ReplayReader{ path };
+    ASSERT_EQ(reader.keyframe_positions().size(), key_states.size() / ReplayWriter::frames_per_block - 1);
+    EXPECT_FALSE(reader.find_keyframe(ReplayWriter::frames_per_block - 1).has_value());
+    EXPECT_EQ(reader.find_keyframe(8000).value().frame, 7800);
+
+    auto from_start = ReplaySimulation{ reader };
+    for (auto const frame : { u64{ 600 }, u64{ 4321 }, u64{ 8000 } }) {
+        while (from_start.next_frame() < frame) {
+            ASSERT_TRUE(from_start.simulate_next_frame());
+        }
+        auto const seeked = ReplaySimulation{ reader, frame };
+        ASSERT_EQ(seeked.next_frame(), frame);
+        for (auto i = usize{ 0 }; i < header.players.size(); ++i) {
+            EXPECT_EQ(seeked.tetrions()[i].save_snapshot(), from_start.tetrions()[i].save_snapshot());
+            EXPECT_EQ(seeked.tetrions()[i].id(), header.players.at(i).client_id);
+        }
+    }
+
+    auto const beyond_end = ReplaySimulation{ reader, key_states.size() + 1000 };
+    EXPECT_EQ(beyond_end.next_frame(), key_states.size());
+    remove_replay(path);
+}
+
+TEST(ReplayTests, KeyframesAreFoundWithoutIndex) {
+    auto const path = temporary_replay_path("without_index");
+    auto const key_states = create_key_states(ReplayWriter::frames_per_block * 3, header.players.size());
+    record_match_with_keyframes(path, key_states);
+    auto const expected_frames = std::vector{ ReplayWriter::frames_per_block, ReplayWriter::frames_per_block * 2 };
+    auto const keyframe_frames = [](ReplayReader const& reader) {
+        return reader.keyframe_positions() | std::views::transform(&ReplayReader::KeyframePosition::frame)
+               | std::ranges::to<std::vector>();
+    };
+    {
+        auto const reader = ReplayReader{ path };
+        EXPECT_EQ(keyframe_frames(reader), expected_frames);
+    }
+
+    // Cuts off the position of the keyframe index, as if the writer did not finish properly.
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    auto const reader = ReplayReader{ path };
+    EXPECT_EQ(keyframe_frames(reader), expected_frames);
+    auto const seeked = ReplaySimulation{ reader, ReplayWriter::frames_per_block * 2 + 10 };
+    EXPECT_EQ(seeked.next_frame(), ReplayWriter::frames_per_block * 2 + 10);
+    remove_replay(path);
+}
+
+TEST(ReplayTests, ParallelVerificationMatchesSequentialSimulation) {
+    auto const many_players_header = ReplayHeader{
+        .seed = 5678,
+        .start_frame = 180,
+        .players = std::views::iota(u8{ 0 }, u8{ 8 }) | std::views::transform([](u8 const client_id) {
+                       return ReplayPlayer{ client_id, std::format("player {}", client_id + 1) };
+                   })
+                   | std::ranges::to<std::vector>(),
+    };
+    auto paths = std::vector<std::filesystem::path>{};
+    for (auto i = 0; i < 3; ++i) {
+        paths.push_back(temporary_replay_path(std::format("verification_{}", i)));
+        auto const key_states = create_key_states(60 * 60 + i * 100, many_players_header.players.size());
+        auto writer = ReplayWriter{ paths.back(), many_players_header };
+        for (auto const& frame_key_states : key_states) {
+            writer.append_frame(frame_key_states);
+        }
+    }
+    paths.push_back(temporary_replay_path("verification_missing"));
+
+    auto const results = verify_replays(paths, { .num_threads = 2, .threads_per_replay = 3 });
+    ASSERT_EQ(results.size(), paths.size());
+    for (auto i = usize{ 0 }; i < 3; ++i) {
+        auto const& result = results.at(i);
+        ASSERT_FALSE(result.error.has_value()) << result.error.value();
+        auto const reader = ReplayReader{ paths.at(i) };
+        auto simulation = ReplaySimulation{ reader };
+        while (simulation.simulate_next_frame()) { }
+        EXPECT_EQ(result.num_frames, simulation.next_frame());
+        ASSERT_EQ(result.players.size(), many_players_header.players.size());
+        for (auto j = usize{ 0 }; j < result.players.size(); ++j) {
+            auto const& player = result.players.at(j);
+            auto const& tetrion = simulation.tetrions()[j];
+            EXPECT_EQ(player.client_id, tetrion.id());
+            EXPECT_EQ(player.name, tetrion.player_name());
+            EXPECT_EQ(player.score, tetrion.score());
+            EXPECT_EQ(player.num_lines_cleared, tetrion.num_lines_cleared());
+            EXPECT_EQ(player.game_over_since_frame, tetrion.game_over_since_frame());
+        }
+    }
+    EXPECT_TRUE(results.back().error.has_value());
+
+    for (auto const& path : paths) {
+        remove_replay(path);
+    }
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <network/messages.hpp>
+#include <network/udp_socket.hpp>
+#include <server.hpp>
+#include <simulator/multiplayer_tetrion.hpp>
+#include <sockets/sockets.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// Waits until the server has rejected the given number of connections.
+[[nodiscard]] static bool wait_for_rejected_handshakes(Server const& server, u64 const num_rejected) {
+    auto const deadline = std::chrono::steady_clock::now() + 10s;
+    while (server.metrics()->num_rejected_handshakes() < num_rejected and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    return server.metrics()->num_rejected_handshakes() == num_rejected;
+}
+
+TEST(ServerTests, PendingHandshakesAreLimited) {
+    // An idle slot treats every connection as a possibly reconnecting client.
+    auto server = Server{};
+    auto const connect = [&server] {
+        return c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, "127.0.0.1", server.port());
+    };
+    auto silent_clients = std::vector<c2k::ClientSocket>{};
+    for (auto i = usize{ 0 }; i < Server::max_pending_handshakes + 2; ++i) {
+        silent_clients.push_back(connect());
+    }
+    // Connections are accepted in order, so the last ones are the rejected ones.
+    EXPECT_TRUE(wait_for_rejected_handshakes(server, 2));
+
+    // Clients that do not reconnect are rejected right after their first message, which ends their handshakes.
+    for (auto& client : silent_clients) {
+        std::ignore = client.send(Connect{ "player" }.serialize()).get();
+    }
+    std::this_thread::sleep_for(200ms);
+
+    // The finished handshakes no longer count towards the limit.
+    auto more_clients = std::vector<c2k::ClientSocket>{};
+    for (auto i = usize{ 0 }; i < Server::max_pending_handshakes + 1; ++i) {
+        more_clients.push_back(connect());
+    }
+    EXPECT_TRUE(wait_for_rejected_handshakes(server, 3));
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(server.metrics()->num_rejected_handshakes(), 3);
+    // Idle slots only shut down when they are told to.
+    server.stop();
+}
+
+// Simulates the given number of windows at roughly the real frame rate, so that the server keeps up.
+static void play(std::vector<MultiplayerTetrion*> const& tetrions, usize const num_windows, bool const press_keys) {
+    for (auto frame = usize{ 0 }; frame < num_windows * heartbeat_interval; ++frame) {
+        auto key_state = KeyState{};
+        key_state.set(Key::Left, press_keys and frame % 40 < 20);
+        key_state.set(Key::Right, press_keys and frame % 40 >= 20);
+        key_state.set(Key::RotateClockwise, press_keys and frame % 7 == 0);
+        for (auto const tetrion : tetrions) {
+            std::ignore = tetrion->simulate_next_frame(key_state);
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+}
+
+TEST(ServerTests, BroadcastsContinueAfterSwitchingToUdp) {
+    auto server = Server{};
+    server.set_lag_budget(heartbeat_interval);
+    server.start_match(2);
+    auto options = MultiplayerOptions{};
+    options.transport = GameplayTransport::Udp;
+    auto const connect = [&server, &options](std::string const& player_name) {
+        return std::async(std::launch::async, [&server, &options, player_name] {
+            return MultiplayerTetrion::create("127.0.0.1", server.port(), player_name, options);
+        });
+    };
+    auto pending_fast = connect("fast");
+    auto pending_slow = connect("slow");
+    auto const fast = pending_fast.get();
+    auto const slow = pending_slow.get();
+    ASSERT_NE(fast, nullptr);
+    ASSERT_NE(slow, nullptr);
+
+    // The slow client exceeds the lag budget before sending its first datagram, so the server fills in its windows
+    // and broadcasts them via TCP. Once it sends datagrams, it only receives broadcasts via UDP.
+    play({ fast.get() }, 20, true);
+    std::this_thread::sleep_for(200ms);
+    // The slow client skips the frames that the server has filled in.
+    while (slow->next_frame() < fast->next_frame()) {
+        std::ignore = slow->simulate_next_frame(KeyState{});
+        std::this_thread::sleep_for(1ms);
+    }
+    play({ fast.get(), slow.get() }, 10, true);
+    play({ fast.get(), slow.get() }, 4, false);
+    std::this_thread::sleep_for(200ms);
+    play({ fast.get(), slow.get() }, 1, false);
+
+    // The displayed opponent is only correct if the slow client received all broadcasts.
+    auto& opponent = *slow->get_observers().at(0);
+    opponent.catch_up();
+    ASSERT_EQ(opponent.next_frame(), fast->next_frame());
+    EXPECT_EQ(opponent.state_hash(), fast->state_hash());
+}
+
+TEST(ServerTests, ClientsThatDoNotAcknowledgeBroadcastsAreDisconnected) {
+    auto server = Server{};
+    server.start_match(1);
+    auto socket = c2k::Sockets::create_client(c2k::AddressFamily::Ipv4, "127.0.0.1", server.port());
+    socket.send(Connect{ "player" }.serialize()).wait();
+    auto const game_start = AbstractMessage::from_socket(socket, 10s);
+    ASSERT_EQ(game_start->type(), MessageType::GameStart);
+    auto const client_id = dynamic_cast<GameStart const&>(*game_start).client_id;
+    auto const window = [](u64 const index) {
+        return Heartbeat{ index * heartbeat_interval + heartbeat_interval - 1, {} };
+    };
+
+    // The first datagram switches the broadcasts to UDP, but none of them is ever acknowledged.
+    auto datagram_socket = UdpSocket{};
+    auto const server_endpoint = UdpEndpoint::resolve("127.0.0.1", server.port());
+    datagram_socket.send_to(server_endpoint, RedundantHeartbeat{ client_id, 0, { window(0) } }.serialize());
+    ASSERT_TRUE(datagram_socket.receive(10s).has_value());
+    for (auto i = u64{ 1 }; i <= Server::max_unacknowledged_broadcasts; ++i) {
+        socket.send(window(i).serialize()).wait();
+    }
+
+    auto const deadline = std::chrono::steady_clock::now() + 10s;
+    auto is_disconnected = false;
+    while (not is_disconnected and std::chrono::steady_clock::now() < deadline) {
+        try {
+            std::ignore = AbstractMessage::from_socket(socket, 100ms);
+        } catch (c2k::TimeoutError const&) {
+            continue;
+        } catch (std::exception const&) {
+            is_disconnected = true;
+        }
+    }
+    EXPECT_TRUE(is_disconnected);
+    // The server stops on its own once all clients have disconnected, unless the test failed.
+    server.stop();
+}
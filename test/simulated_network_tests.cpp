@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <network/messages.hpp>
+#include <network/simulated_network.hpp>
+#include <simulated_match.hpp>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+[[nodiscard]] static std::vector<u64> received_frames(MessageTransport& connection) {
+    auto result = std::vector<u64>{};
+    for (auto const& message : connection.take_received_messages()) {
+        result.push_back(dynamic_cast<Heartbeat const&>(*message).frame);
+    }
+    return result;
+}
+
+TEST(SimulatedNetworkTests, MessagesArriveAfterLatency) {
+    auto network = SimulatedNetwork{ 0 };
+    auto [client, server] = network.connect(LinkModel{ .latency = 50ms }, LinkModel{ .latency = 20ms });
+
+    client->send(Heartbeat{ 14, {} }.serialize());
+    server->send(Heartbeat{ 29, {} }.serialize());
+    network.advance(20ms);
+    EXPECT_TRUE(received_frames(*server).empty());
+    EXPECT_EQ(received_frames(*client), std::vector<u64>{ 29 });
+
+    network.advance(29ms);
+    EXPECT_TRUE(received_frames(*server).empty());
+    network.advance(1ms);
+    EXPECT_EQ(received_frames(*server), std::vector<u64>{ 14 });
+    EXPECT_EQ(network.now(), 50ms);
+    EXPECT_EQ(client->outgoing_statistics().num_messages, 1);
+    EXPECT_EQ(client->outgoing_statistics().max_delay, 50ms);
+}
+
+TEST(SimulatedNetworkTests, JitterAndLossKeepTheOrder) {
+    auto network = SimulatedNetwork{ 42 };
+    auto const model = LinkModel{ .latency = 30ms, .jitter = 40ms, .loss = 0.2, .retransmission_timeout = 100ms };
+    auto [client, server] = network.connect(model, model);
+
+    auto expected = std::vector<u64>{};
+    auto received = std::vector<u64>{};
+    for (auto frame = u64{ 14 }; frame < 100 * heartbeat_interval; frame += heartbeat_interval) {
+        client->send(Heartbeat{ frame, {} }.serialize());
+        expected.push_back(frame);
+        network.advance(5ms);
+        std::ranges::copy(received_frames(*server), std::back_inserter(received));
+    }
+    network.advance(10s);
+    std::ranges::copy(received_frames(*server), std::back_inserter(received));
+
+    EXPECT_EQ(received, expected);
+    auto const& statistics = client->outgoing_statistics();
+    EXPECT_GT(statistics.num_retransmissions, 0);
+    EXPECT_GE(statistics.max_delay, 130ms);
+    EXPECT_LE(statistics.total_delay / statistics.num_messages, 1s);
+}
+
+TEST(SimulatedNetworkTests, BandwidthLimitQueuesMessages) {
+    auto network = SimulatedNetwork{ 0 };
+    auto [client, server] = network.connect(LinkModel{ .bytes_per_second = 1000 }, LinkModel{});
+
+    auto const buffer = Heartbeat{ 14, {} }.serialize();
+    client->send(buffer);
+    client->send(buffer);
+    auto const transmission_time = std::chrono::nanoseconds{ 1s } * buffer.size() / 1000;
+
+    network.advance(transmission_time);
+    EXPECT_EQ(received_frames(*server).size(), 1);
+    network.advance(transmission_time);
+    EXPECT_EQ(received_frames(*server).size(), 1);
+    EXPECT_EQ(client->outgoing_statistics().num_bytes, 2 * buffer.size());
+}
+
+TEST(SimulatedNetworkTests, SameSeedBehavesTheSame) {
+    auto const run = [](u64 const seed) {
+        auto network = SimulatedNetwork{ seed };
+        auto const model = LinkModel{ .latency = 10ms, .jitter = 30ms, .loss = 0.1 };
+        auto [client, server] = network.connect(model, model);
+        for (auto frame = u64{ 14 }; frame < 50 * heartbeat_interval; frame += heartbeat_interval) {
+            client->send(Heartbeat{ frame, {} }.serialize());
+            network.advance(1ms);
+        }
+        network.advance(10s);
+        return client->outgoing_statistics().total_delay;
+    };
+    EXPECT_EQ(run(1), run(1));
+    EXPECT_NE(run(1), run(2));
+}
+
+TEST(SimulatedNetworkTests, MatchStaysInSync) {
+    auto const options = SimulatedMatchOptions{
+        .num_players = 3,
+        .seed = 7,
+        .uplink = LinkModel{ .latency = 40ms, .jitter = 20ms, .loss = 0.02 },
+        .downlink = LinkModel{ .latency = 40ms, .jitter = 20ms, .loss = 0.02 },
+    };
+    auto match = SimulatedMatch{ options };
+    match.run(60 * 60);  // One minute.
+
+    ASSERT_TRUE(match.has_started());
+    auto const statistics = match.statistics();
+    EXPECT_EQ(statistics.num_desynchronized_clients, 0);
+    // Every client reported the hash of a recent window that could be checked by the server.
+    EXPECT_GT(statistics.last_checked_state_hash_frame, 55 * 60);
+    ASSERT_FALSE(statistics.confirmation_latencies.empty());
+    EXPECT_GE(std::ranges::min(statistics.confirmation_latencies), 80ms);
+    EXPECT_GT(statistics.num_downlink_bytes, statistics.num_uplink_bytes);
+}
+
+TEST(SimulatedNetworkTests, MatchIsReproducible) {
+    auto const options = SimulatedMatchOptions{
+        .num_players = 2,
+        .seed = 3,
+        .uplink = LinkModel{ .latency = 30ms, .jitter = 50ms, .loss = 0.05 },
+        .downlink = LinkModel{ .latency = 30ms, .jitter = 50ms, .loss = 0.05 },
+        .lag_budget = 30,
+    };
+    auto first = SimulatedMatch{ options };
+    first.run(30 * 60);
+    auto second = SimulatedMatch{ options };
+    second.run(30 * 60);
+
+    auto const first_statistics = first.statistics();
+    auto const second_statistics = second.statistics();
+    EXPECT_EQ(first_statistics.final_state_hashes, second_statistics.final_state_hashes);
+    EXPECT_EQ(first_statistics.confirmation_latencies, second_statistics.confirmation_latencies);
+    EXPECT_EQ(first_statistics.num_uplink_bytes, second_statistics.num_uplink_bytes);
+    EXPECT_EQ(first_statistics.num_provisional_key_states, second_statistics.num_provisional_key_states);
+    EXPECT_EQ(first_statistics.num_desynchronized_clients, 0);
+}
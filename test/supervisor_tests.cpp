@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <future>
+#include <memory>
+#include <set>
+#include <simulator/multiplayer_tetrion.hpp>
+#include <sockets/sockets.hpp>
+#include <supervisor.hpp>
+#include <thread>
+#include <vector>
+
+// Plays the lobby server, which requests matches from the supervisor via the control connection.
+class LocalLobby final {
+private:
+    std::promise<c2k::ClientSocket> m_control_connection_promise;
+    c2k::ServerSocket m_socket;
+    Supervisor m_supervisor;
+    c2k::ClientSocket m_control_connection;
+    std::jthread m_supervisor_thread;
+
+public:
+    explicit LocalLobby(usize const pool_size)
+        : m_socket{ c2k::Sockets::create_server(
+              c2k::AddressFamily::Ipv4,
+              0,
+              [this](c2k::ClientSocket client) { m_control_connection_promise.set_value(std::move(client)); }
+          ) },
+          m_supervisor{ m_socket.local_address().port, pool_size, MatchSettings{} },
+          m_control_connection{ m_control_connection_promise.get_future().get() },
+          m_supervisor_thread{ [this] { m_supervisor.run(); } } { }
+
+    LocalLobby(LocalLobby const& other) = delete;
+    LocalLobby(LocalLobby&& other) noexcept = delete;
+    LocalLobby& operator=(LocalLobby const& other) = delete;
+    LocalLobby& operator=(LocalLobby&& other) noexcept = delete;
+
+    // The supervisor stops serving once the control connection has been closed. Destroying it waits for the matches
+    // that are still running.
+    ~LocalLobby() {
+        m_control_connection.close();
+        m_supervisor_thread.join();
+    }
+
+    // Returns the port of the game server, 0 if no match has been started.
+    [[nodiscard]] std::uint16_t start_match(std::uint16_t const num_players) {
+        std::ignore = m_control_connection.send(num_players).get();
+        return m_control_connection.receive<std::uint16_t>().get();
+    }
+};
+
+// Connects the given number of players and returns their tetrions once the match has started.
+[[nodiscard]] static std::vector<std::unique_ptr<MultiplayerTetrion>> join_match(
+    std::uint16_t const port,
+    std::size_t const num_players
+) {
+    auto pending = std::vector<std::future<std::unique_ptr<MultiplayerTetrion>>>{};
+    for (auto i = std::size_t{ 0 }; i < num_players; ++i) {
+        pending.push_back(std::async(std::launch::async, [port, i] {
+            return MultiplayerTetrion::create("127.0.0.1", port, std::format("player {}", i));
+        }));
+    }
+    auto tetrions = std::vector<std::unique_ptr<MultiplayerTetrion>>{};
+    for (auto& tetrion : pending) {
+        tetrions.push_back(tetrion.get());
+    }
+    return tetrions;
+}
+
+TEST(SupervisorTests, EveryMatchGetsAnIdleSlotOfItsOwn) {
+    // With a single slot, every match has to use a slot that has been created after the previous match started.
+    auto lobby = LocalLobby{ 1 };
+    auto ports = std::set<std::uint16_t>{};
+    for (auto i = 0; i < 4; ++i) {
+        auto const port = lobby.start_match(1);
+        ASSERT_NE(port, 0);
+        EXPECT_TRUE(ports.insert(port).second) << "port " << port << " has been handed out twice";
+
+        auto const tetrions = join_match(port, 1);
+        ASSERT_NE(tetrions.front(), nullptr);
+        EXPECT_EQ(tetrions.front()->get_observers().size(), 0);
+    }
+}
+
+TEST(SupervisorTests, MatchStartsOnceAllPlayersHaveConnected) {
+    auto lobby = LocalLobby{ 2 };
+    auto const first_port = lobby.start_match(3);
+    auto const second_port = lobby.start_match(2);
+    ASSERT_NE(first_port, 0);
+    ASSERT_NE(second_port, 0);
+    EXPECT_NE(first_port, second_port);
+
+    // The matches do not wait for each other.
+    auto const second_match = join_match(second_port, 2);
+    auto const first_match = join_match(first_port, 3);
+    for (auto const& tetrion : second_match) {
+        ASSERT_NE(tetrion, nullptr);
+        EXPECT_EQ(tetrion->get_observers().size(), 1);
+    }
+    for (auto const& tetrion : first_match) {
+        ASSERT_NE(tetrion, nullptr);
+        EXPECT_EQ(tetrion->get_observers().size(), 2);
+    }
+}
+
+TEST(SupervisorTests, InvalidPlayerCountsAreRejected) {
+    auto lobby = LocalLobby{ 1 };
+    EXPECT_EQ(lobby.start_match(0), 0);
+    EXPECT_EQ(lobby.start_match(256), 0);
+
+    // The control connection can still be used afterwards.
+    auto const port = lobby.start_match(1);
+    ASSERT_NE(port, 0);
+    auto const tetrions = join_match(port, 1);
+    EXPECT_NE(tetrions.front(), nullptr);
+}
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <deque>
+#include <random>
 #include <ranges>
 #include <simulator/tetrion.hpp>
 
@@ -77,18 +80,10 @@ next_column:;  // 👈(ﾟヮﾟ👈)
 
 TEST(TetrionTests, AllClear) {
     auto tetrion = ObpfTetrion{ seed_for_tetromino_type(TetrominoType::I), 0 };
-    auto called_count = usize{ 0 };
-    tetrion.set_action_handler(
-        [](ObpfAction const action, void* user_data) {
-            if (action == static_cast<ObpfAction>(Action::AllClear)) {
-                *static_cast<usize*>(user_data) = true;
-            }
-        },
-        static_cast<void*>(&called_count)
-    );
+    tetrion.set_event_recording(true);
     for (auto row = Matrix::height - 4; row < Matrix::height; ++row) {
         for (auto column = usize{ 0 }; column < Matrix::width - 1; ++column) {
-            tetrion.matrix()[Vec2{ static_cast<i32>(column), static_cast<i32>(row) }] = TetrominoType::I;
+            tetrion.matrix().set(Vec2{ static_cast<i32>(column), static_cast<i32>(row) }, TetrominoType::I);
         }
     }
 
@@ -121,6 +116,274 @@ TEST(TetrionTests, AllClear) {
         std::ignore = tetrion.simulate_next_frame(KeyState{});
     }
 
-    EXPECT_EQ(called_count, 1);
+    auto const events = tetrion.events().drain();
+    EXPECT_EQ(std::ranges::count(events, Action::AllClear, &Event::action), 1);
     EXPECT_TRUE(tetrion.matrix().is_empty());
 }
+
+struct RollbackTetrion final : ObpfTetrion {
+    using ObpfTetrion::ObpfTetrion;
+    using ObpfTetrion::rollback_and_resimulate;
+};
+
+TEST(TetrionTests, RollbackAndResimulateMatchesUninterruptedSimulation) {
+    auto random = std::mt19937_64{ 42 };
+    auto key_states = std::deque<KeyState>{};
+    for (auto i = 0; i < 400; ++i) {
+        key_states.push_back(KeyState{}
+                                 .set(Key::Left, random() % 3 == 0)
+                                 .set(Key::Right, random() % 3 == 0)
+                                 .set(Key::Drop, random() % 20 == 0)
+                                 .set(Key::RotateClockwise, random() % 10 == 0));
+    }
+
+    auto uninterrupted = RollbackTetrion{ 42, 0 };
+    for (auto const key_state : key_states) {
+        std::ignore = uninterrupted.simulate_next_frame(key_state);
+    }
+    // Otherwise, most of the state would not change anymore.
+    ASSERT_FALSE(uninterrupted.game_over_since_frame().has_value());
+
+    auto confirmed = RollbackTetrion{ 42, 0 };
+    for (auto i = usize{ 0 }; i < 200; ++i) {
+        std::ignore = confirmed.simulate_next_frame(key_states.front());
+        key_states.pop_front();
+    }
+
+    // This tetrion has been simulated with completely different key states that have to be discarded.
+    auto rolled_back = RollbackTetrion{ 42, 0 };
+    rolled_back.set_event_recording(true);
+    for (auto i = usize{ 0 }; i < 700; ++i) {
+        std::ignore = rolled_back.simulate_next_frame(KeyState{}.set(Key::Drop, i % 2 == 0));
+    }
+    std::ignore = rolled_back.events().drain();
+    rolled_back.rollback_and_resimulate(confirmed, key_states);
+
+    EXPECT_EQ(rolled_back.events().size(), 0);
+    EXPECT_EQ(rolled_back.next_frame(), uninterrupted.next_frame());
+    EXPECT_EQ(rolled_back.score(), uninterrupted.score());
+    EXPECT_EQ(rolled_back.num_lines_cleared(), uninterrupted.num_lines_cleared());
+    EXPECT_EQ(rolled_back.hold_piece(), uninterrupted.hold_piece());
+    EXPECT_EQ(rolled_back.get_preview_tetrominos(), uninterrupted.get_preview_tetrominos());
+    for (auto row = usize{ 0 }; row < Matrix::height; ++row) {
+        for (auto column = usize{ 0 }; column < Matrix::width; ++column) {
+            auto const position = Vec2{ static_cast<i32>(column), static_cast<i32>(row) };
+            EXPECT_EQ(rolled_back.matrix()[position], uninterrupted.matrix()[position]);
+        }
+    }
+
+    // Events are recorded again afterwards.
+    while (rolled_back.events().size() == 0 and rolled_back.game_over_since_frame() == std::nullopt) {
+        std::ignore = rolled_back.simulate_next_frame(KeyState{}.set(Key::Drop, rolled_back.next_frame() % 2 == 0));
+    }
+    EXPECT_GT(rolled_back.events().size(), 0);
+}
+
+TEST(TetrionTests, LoadedSnapshotContinuesLikeTheOriginal) {
+    auto random = std::mt19937_64{ 13 };
+    auto const random_key_state = [&random] {
+        return KeyState{}
+            .set(Key::Left, random() % 3 == 0)
+            .set(Key::Right, random() % 3 == 0)
+            .set(Key::Drop, random() % 20 == 0)
+            .set(Key::Hold, random() % 50 == 0)
+            .set(Key::RotateCounterClockwise, random() % 10 == 0);
+    };
+
+    auto original = ObpfTetrion{ 42, 0 };
+    for (auto i = 0; i < 200; ++i) {
+        std::ignore = original.simulate_next_frame(random_key_state());
+    }
+    // Otherwise, the snapshot would only be compared to a tetrion whose state does not change anymore.
+    ASSERT_FALSE(original.game_over_since_frame().has_value());
+    original.receive_garbage(GarbageSendEvent{ original.next_frame(), 3 });
+
+    auto const snapshot = original.save_snapshot();
+    auto loaded = ObpfTetrion::load_snapshot(snapshot);
+    EXPECT_EQ(loaded.save_snapshot(), snapshot);
+    EXPECT_EQ(loaded.next_frame(), original.next_frame());
+    EXPECT_EQ(loaded.garbage_queue_length(), 3);
+
+    for (auto i = 0; i < 200; ++i) {
+        auto const key_state = random_key_state();
+        auto const loaded_garbage = loaded.simulate_next_frame(key_state);
+        auto const original_garbage = original.simulate_next_frame(key_state);
+        ASSERT_EQ(loaded_garbage.has_value(), original_garbage.has_value());
+    }
+    ASSERT_FALSE(original.game_over_since_frame().has_value());
+    EXPECT_EQ(loaded.save_snapshot(), original.save_snapshot());
+    EXPECT_EQ(loaded.matrix(), original.matrix());
+    EXPECT_EQ(loaded.score(), original.score());
+}
+
+TEST(TetrionTests, InvalidSnapshotsAreRejected) {
+    auto const snapshot = ObpfTetrion{ 42, 0 }.save_snapshot();
+
+    auto truncated = snapshot;
+    truncated.pop_back();
+    EXPECT_THROW(std::ignore = ObpfTetrion::load_snapshot(truncated), SnapshotError);
+
+    auto too_long = snapshot;
+    too_long.push_back(0);
+    EXPECT_THROW(std::ignore = ObpfTetrion::load_snapshot(too_long), SnapshotError);
+
+    auto wrong_version = snapshot;
+    ++wrong_version.front();
+    EXPECT_THROW(std::ignore = ObpfTetrion::load_snapshot(wrong_version), SnapshotError);
+
+    EXPECT_THROW(std::ignore = ObpfTetrion::load_snapshot({}), SnapshotError);
+}
+
+TEST(TetrionTests, StateHashDetectsDivergingSimulations) {
+    auto random = std::mt19937_64{ 7 };
+    auto const random_key_state = [&random] {
+        return KeyState{}
+            .set(Key::Left, random() % 3 == 0)
+            .set(Key::Right, random() % 3 == 0)
+            .set(Key::Drop, random() % 20 == 0)
+            .set(Key::RotateClockwise, random() % 10 == 0);
+    };
+
+    auto first = ObpfTetrion{ 42, 0 };
+    auto second = ObpfTetrion{ 42, 0 };
+    EXPECT_EQ(first.state_hash(), second.state_hash());
+    for (auto i = 0; i < 400; ++i) {
+        auto const key_state = random_key_state();
+        std::ignore = first.simulate_next_frame(key_state);
+        std::ignore = second.simulate_next_frame(key_state);
+        ASSERT_EQ(first.state_hash(), second.state_hash());
+    }
+    first.receive_garbage(GarbageSendEvent{ first.next_frame(), 2 });
+    second.receive_garbage(GarbageSendEvent{ second.next_frame(), 2 });
+    for (auto i = u64{ 0 }; i < ObpfTetrion::garbage_delay_frames + 10; ++i) {
+        std::ignore = first.simulate_next_frame(KeyState{});
+        std::ignore = second.simulate_next_frame(KeyState{});
+    }
+    EXPECT_EQ(first.state_hash(), second.state_hash());
+    EXPECT_EQ(ObpfTetrion::load_snapshot(first.save_snapshot()).state_hash(), first.state_hash());
+
+    // The incrementally updated hash of the matrix only depends on its contents.
+    auto rebuilt = Matrix{};
+    for (auto row = usize{ 0 }; row < Matrix::height; ++row) {
+        for (auto column = usize{ 0 }; column < Matrix::width; ++column) {
+            auto const position = Vec2{ static_cast<i32>(column), static_cast<i32>(row) };
+            rebuilt.set(position, first.matrix()[position]);
+        }
+    }
+    EXPECT_EQ(rebuilt.hash(), first.matrix().hash());
+    EXPECT_EQ(Matrix{}.hash(), 0);
+
+    // The stack has topped out by now, so the diverging inputs are given to tetrions that are still in the game.
+    auto moved_left = ObpfTetrion{ 42, 0 };
+    auto moved_right = ObpfTetrion{ 42, 0 };
+    std::ignore = moved_left.simulate_next_frame(KeyState{});
+    std::ignore = moved_right.simulate_next_frame(KeyState{});
+    std::ignore = moved_left.simulate_next_frame(KeyState{}.set(Key::Left));
+    std::ignore = moved_right.simulate_next_frame(KeyState{}.set(Key::Right));
+    EXPECT_NE(moved_left.state_hash(), moved_right.state_hash());
+}
+
+TEST(TetrionTests, EventsAreRecordedUntilDrained) {
+    auto not_recording = ObpfTetrion{ 42, 0 };
+    auto recording = ObpfTetrion{ 42, 0 };
+    recording.set_event_recording(true);
+    auto expected_hard_drops = std::vector<Event>{};
+    auto events = std::vector<Event>{};
+    for (auto frame = u64{ 0 }; frame < 60; ++frame) {
+        auto const key_state = KeyState{}.set(Key::Drop, frame % 2 == 0);
+        // The next piece may spawn and be dropped within the same frame.
+        auto const piece = recording.active_tetromino().has_value() ? recording.active_tetromino()->type
+                                                                    : recording.get_preview_tetrominos().front();
+        auto const score = recording.score();
+        std::ignore = not_recording.simulate_next_frame(key_state);
+        std::ignore = recording.simulate_next_frame(key_state);
+        if (recording.score() > score) {
+            expected_hard_drops.push_back(Event{ frame, Action::HardDrop, piece, 0 });
+        }
+        // Drained in batches.
+        if (frame % 10 == 9) {
+            std::ranges::copy(recording.events().drain(), std::back_inserter(events));
+        }
+    }
+    EXPECT_EQ(not_recording.events().size(), 0);
+    EXPECT_EQ(recording.events().size(), 0);
+    EXPECT_EQ(not_recording.state_hash(), recording.state_hash());
+    EXPECT_TRUE(std::ranges::is_sorted(events, {}, &Event::frame));
+    EXPECT_FALSE(expected_hard_drops.empty());
+    auto const hard_drops = events | std::views::filter([](Event const& event) {
+                                return event.action == Action::HardDrop;
+                            })
+                            | std::ranges::to<std::vector>();
+    EXPECT_EQ(hard_drops, expected_hard_drops);
+
+    // If the host does not keep up, only the most recent events are kept.
+    auto falling_behind = ObpfTetrion{ 42, 0 };
+    falling_behind.set_event_recording(true);
+    for (auto frame = 0; frame < 2000; ++frame) {
+        std::ignore = falling_behind.simulate_next_frame(KeyState{}.set(Key::RotateClockwise, frame % 2 == 0));
+    }
+    ASSERT_EQ(falling_behind.events().size(), EventBuffer::capacity);
+    auto oldest = std::array<Event, 3>{};
+    EXPECT_EQ(falling_behind.events().drain(oldest), oldest.size());
+    auto const newest = falling_behind.events().drain();
+    EXPECT_EQ(newest.size(), EventBuffer::capacity - oldest.size());
+    EXPECT_GT(oldest.front().frame, 1000);
+    EXPECT_LE(oldest.back().frame, newest.front().frame);
+
+    falling_behind.set_event_recording(false);
+    std::ignore = falling_behind.simulate_next_frame(KeyState{}.set(Key::RotateClockwise, true));
+    EXPECT_EQ(falling_behind.events().size(), 0);
+}
+
+TEST(TetrionTests, MatrixTracksDirtyRows) {
+    auto matrix = Matrix{};
+    EXPECT_EQ(matrix.dirty_rows(), 0);
+    matrix.set(Vec2{ 3, 20 }, TetrominoType::T);
+    matrix.set(Vec2{ 4, 21 }, TetrominoType::T);
+    EXPECT_EQ(matrix.dirty_rows(), (u32{ 1 } << 20) | (u32{ 1 } << 21));
+
+    matrix.clear_dirty_rows();
+    // Writing the same mino again does not change anything.
+    matrix.set(Vec2{ 3, 20 }, TetrominoType::T);
+    EXPECT_EQ(matrix.dirty_rows(), 0);
+    matrix.copy_line(21, 20);
+    matrix.fill(0, TetrominoType::Garbage);
+    EXPECT_EQ(matrix.dirty_rows(), (u32{ 1 } << 0) | (u32{ 1 } << 21));
+
+    matrix.clear_dirty_rows();
+    auto other = matrix;
+    other.set(Vec2{ 0, 10 }, TetrominoType::I);
+    matrix.assign(other);
+    EXPECT_EQ(matrix, other);
+    EXPECT_EQ(matrix.hash(), other.hash());
+    EXPECT_EQ(matrix.dirty_rows(), u32{ 1 } << 10);
+}
+
+TEST(TetrionTests, RollbackOnlyMarksDifferingRowsAsDirty) {
+    auto confirmed = RollbackTetrion{ 42, 0 };
+    auto predicted = RollbackTetrion{ 42, 0 };
+    auto key_states = std::deque<KeyState>{};
+    for (auto frame = 0; frame < 200; ++frame) {
+        key_states.push_back(KeyState{}.set(Key::Drop, frame % 20 == 0));
+        std::ignore = predicted.simulate_next_frame(key_states.back());
+    }
+    ASSERT_NE(predicted.matrix().dirty_rows(), 0);
+    predicted.matrix().clear_dirty_rows();
+
+    // Re-simulating the same key states leads to the same matrix, although the rows have been changed in between.
+    predicted.rollback_and_resimulate(confirmed, key_states);
+    EXPECT_EQ(predicted.matrix().dirty_rows(), 0);
+
+    // Rolling back to the empty matrix only affects the rows that contained minos.
+    auto expected_dirty_rows = u32{ 0 };
+    for (auto row = usize{ 0 }; row < Matrix::height; ++row) {
+        for (auto column = usize{ 0 }; column < Matrix::width; ++column) {
+            auto const position = Vec2{ static_cast<i32>(column), static_cast<i32>(row) };
+            if (predicted.matrix()[position] != TetrominoType::Empty) {
+                expected_dirty_rows |= u32{ 1 } << row;
+            }
+        }
+    }
+    predicted.rollback_and_resimulate(confirmed, {});
+    EXPECT_EQ(predicted.matrix().dirty_rows(), expected_dirty_rows);
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <simulator/trace.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+
+[[nodiscard]] static usize count_occurrences(std::string_view const text, std::string_view const pattern) {
+    auto result = usize{ 0 };
+    for (auto position = text.find(pattern); position != std::string_view::npos;
+         position = text.find(pattern, position + pattern.size())) {
+        ++result;
+    }
+    return result;
+}
+
+TEST(TraceTests, SpansOfFinishedThreadsAreExported) {
+    std::jthread{ [] {
+        set_trace_thread_name("trace \"test\" thread");
+        auto const outer = TraceSpan{ "TraceTests::outer" };
+        {
+            auto const inner = TraceSpan{ "TraceTests::inner" };
+        }
+    } }.join();
+
+    auto const trace = chrome_trace();
+    EXPECT_TRUE(trace.starts_with(R"({"traceEvents":[)"));
+    EXPECT_EQ(count_occurrences(trace, R"("name":"TraceTests::outer","ph":"X")"), 1);
+    EXPECT_EQ(count_occurrences(trace, R"("name":"TraceTests::inner","ph":"X")"), 1);
+    EXPECT_EQ(count_occurrences(trace, R"("args":{"name":"trace \"test\" thread"})"), 1);
+}
+
+TEST(TraceTests, OnlyTheMostRecentSpansAreKept) {
+    std::jthread{ [] {
+        for (auto i = usize{ 0 }; i < 10; ++i) {
+            auto const span = TraceSpan{ "TraceTests::overwritten" };
+        }
+        for (auto i = usize{ 0 }; i < trace_buffer_capacity; ++i) {
+            auto const span = TraceSpan{ "TraceTests::kept" };
+        }
+    } }.join();
+
+    auto const trace = chrome_trace();
+    EXPECT_EQ(count_occurrences(trace, "TraceTests::overwritten"), 0);
+    EXPECT_EQ(count_occurrences(trace, "TraceTests::kept"), trace_buffer_capacity);
+}